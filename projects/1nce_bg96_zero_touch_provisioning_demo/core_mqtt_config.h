@@ -62,4 +62,39 @@
  */
 #define MQTT_STATE_ARRAY_MAX_COUNT    10U
 
+/**
+ * @brief Build the throughput benchmark of the publish window, which the demo
+ * runs before connecting. See mqtt_publish_benchmark.h.
+ *
+ * #define MQTT_PUBLISH_BENCHMARK
+ */
+
+/**
+ * @brief Build the microbenchmark of the topic router, which the demo runs
+ * before connecting. See mqtt_topic_router_benchmark.h.
+ *
+ * #define MQTT_TOPIC_ROUTER_BENCHMARK
+ */
+
+/**
+ * @brief Build the offline queue, which the demo uses with
+ * democonfigOFFLINE_QUEUE_FILE. See mqtt_offline_queue.h.
+ *
+ * #define MQTT_OFFLINE_QUEUE
+ */
+
+/**
+ * @brief Build the adaptive keep-alive, which the demo uses with
+ * democonfigADAPTIVE_KEEP_ALIVE_FILE. See mqtt_keep_alive.h.
+ *
+ * #define MQTT_ADAPTIVE_KEEP_ALIVE
+ */
+
+/**
+ * @brief Build the command agent, which the demo uses with
+ * democonfigMQTT_AGENT. See mqtt_command_agent.h.
+ *
+ * #define MQTT_COMMAND_AGENT
+ */
+
 #endif /* ifndef CORE_MQTT_CONFIG_H */
@@ -146,6 +146,19 @@
  * #define democonfigCLIENT_PRIVATE_KEY_PEM    "...insert here..."
  */
 
+/**
+ * @brief Use DER copies of the PEM credentials above.
+ *
+ * Run "python3 tools/pem_to_der_header.py projects/<project_name>/demo_config.h"
+ * to generate demo_credentials_der.h from democonfigROOT_CA_PEM,
+ * democonfigCLIENT_CERTIFICATE_PEM and democonfigCLIENT_PRIVATE_KEY_PEM, then
+ * define this macro. The TLS transport parses DER without base64 decoding, so
+ * MBEDTLS_PEM_PARSE_C and MBEDTLS_BASE64_C can then be removed from
+ * mbedtls_config.h, unless PEM credentials are still received at runtime.
+ *
+ * #define democonfigUSE_DER_CREDENTIALS
+ */
+
 /**
  * @brief An option to disable Server Name Indication.
  *
@@ -155,6 +168,56 @@
  */
 #define democonfigDISABLE_SNI    ( pdFALSE )
 
+/**
+ * @brief Store the messages produced while the connection is down in a
+ * durable queue in this file, and forward them in order once it is back.
+ * Requires MQTT_OFFLINE_QUEUE in core_mqtt_config.h.
+ *
+ * #define democonfigOFFLINE_QUEUE_FILE    "mqtt_offline_queue.bin"
+ */
+
+/**
+ * @brief Publish samples of producer tasks, aggregated into compact binary
+ * payloads, instead of one message per publish. The bytes on air per sample
+ * are logged with the session stats.
+ *
+ * #define democonfigTELEMETRY
+ */
+
+/**
+ * @brief Publish from several tasks through an agent task that owns the MQTT
+ * connection and takes their commands from a queue. Requires
+ * MQTT_COMMAND_AGENT in core_mqtt_config.h, and excludes democonfigTELEMETRY.
+ *
+ * #define democonfigMQTT_AGENT
+ */
+
+/**
+ * @brief Upload this file on each connection of the demo, as one QoS1
+ * message streamed from the file instead of copied into the network buffer,
+ * so it can be far larger than democonfigNETWORK_BUFFER_SIZE.
+ *
+ * #define democonfigLOG_UPLOAD_FILE    "demo.log"
+ */
+
+/**
+ * @brief Learn the keep-alive interval from the NAT of each network, and save
+ * it to this file. The demo then publishes every 30 minutes and stays idle in
+ * between. Requires MQTT_ADAPTIVE_KEEP_ALIVE in core_mqtt_config.h, and is
+ * exclusive with democonfigMQTT_AGENT.
+ *
+ * #define democonfigADAPTIVE_KEEP_ALIVE_FILE    "keep_alive.txt"
+ */
+
+/**
+ * @brief Sleep until the modem reports data or the keep-alive is due, instead
+ * of polling the connection, and only then process it. The latency from the
+ * arrival of a publish to its handler is logged with the session stats in
+ * both modes. Excludes democonfigMQTT_AGENT and democonfigTELEMETRY.
+ *
+ * #define democonfigEVENT_DRIVEN
+ */
+
 /**
  * @brief Configuration that indicates if the demo connection is made to the AWS IoT Core MQTT broker.
  *
@@ -76,6 +76,46 @@
 #define MBEDTLS_KEY_EXCHANGE_ECDHE_RSA_ENABLED
 #define MBEDTLS_KEY_EXCHANGE_ECDHE_ECDSA_ENABLED
 
+/* Pre-shared key authentication, used when NetworkCredentials_t.pPsk is set.
+ * No certificate is parsed or verified and, with plain PSK, no public key
+ * operation runs. ECDHE-PSK adds forward secrecy for one ECDH on each side. */
+/* #define MBEDTLS_KEY_EXCHANGE_PSK_ENABLED */
+/* #define MBEDTLS_KEY_EXCHANGE_ECDHE_PSK_ENABLED */
+
+/* ECC memory profile. By default, mbed TLS 2.28 multiplies the P-256
+ * generator, in ECDHE key generation and in ECDSA signing and verification,
+ * with the comb table that it precomputes in flash, and other points with a
+ * window of 4. That is the widest window the comb method picks for a 256-bit
+ * curve, so a larger MBEDTLS_ECP_WINDOW_SIZE only reserves RAM and the
+ * defaults are already the fastest setting. Define the profile to trade speed
+ * for RAM and flash with a window of 2 and no precomputed table. Define
+ * MBEDTLS_FREERTOS_ECP_BENCHMARK to log the cost of each operation. */
+/* #define MBEDTLS_FREERTOS_ECP_LOW_RAM_PROFILE */
+#ifdef MBEDTLS_FREERTOS_ECP_LOW_RAM_PROFILE
+    #define MBEDTLS_ECP_FIXED_POINT_OPTIM    0
+    #define MBEDTLS_ECP_WINDOW_SIZE          2
+#endif
+/* #define MBEDTLS_FREERTOS_ECP_BENCHMARK */
+
+/* Restartable ECC. The TLS transport then has mbed TLS return from the
+ * handshake after TLS_TRANSPORT_ECP_MAX_OPS basic ECC operations and yields
+ * before it resumes, so other tasks of the same priority still run during a
+ * handshake. This costs some time per slice and does not make ECC faster. */
+/* #define MBEDTLS_ECP_RESTARTABLE */
+#ifdef MBEDTLS_ECP_RESTARTABLE
+    #define MBEDTLS_ECDH_LEGACY_CONTEXT
+#endif
+
+/* Precompute ECDHE key pairs. mbedtls_platform_ecdhe_pool_start() creates a
+ * low-priority task that keeps MBEDTLS_FREERTOS_ECDHE_POOL_SIZE P-256 key
+ * pairs ready, and the handshake takes one instead of generating it after the
+ * ServerKeyExchange. Each key pair is used once. Cannot be combined with
+ * MBEDTLS_ECP_RESTARTABLE, and has no effect with MBEDTLS_USE_PSA_CRYPTO. */
+/* #define MBEDTLS_FREERTOS_ECDHE_POOL */
+#ifdef MBEDTLS_FREERTOS_ECDHE_POOL
+    #define MBEDTLS_ECDH_GEN_PUBLIC_ALT
+#endif
+
 /* Enable all SSL alert messages. */
 #define MBEDTLS_SSL_ALL_ALERT_MESSAGES
 
@@ -87,6 +127,77 @@
 #define MBEDTLS_SSL_ALPN
 #define MBEDTLS_SSL_SERVER_NAME_INDICATION
 
+/* Resize the record buffers of each connection to its maximum fragment length
+ * once the handshake completes. Outgoing records never exceed the fragment
+ * length requested by the transport, at most 4096 bytes, so the output buffer
+ * is capped at that size. The input buffer keeps the 16 KB default during the
+ * handshake because a server may ignore the max_fragment_length extension. */
+#define MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH
+#define MBEDTLS_SSL_OUT_CONTENT_LEN    4096
+
+/* Optional TLS 1.3 support, which reaches the first application byte one
+ * round-trip earlier than TLS 1.2. The transport offers TLS 1.3 with a TLS 1.2
+ * fallback when MBEDTLS_SSL_PROTO_TLS1_3 is defined. This requires the mbedtls
+ * submodule to be on a 3.x release, as 2.x has no TLS 1.3 client. TLS 1.3
+ * runs on PSA crypto, which draws entropy from mbedtls_hardware_poll. */
+/* #define MBEDTLS_SSL_PROTO_TLS1_3 */
+/* #define MBEDTLS_SSL_TLS1_3_COMPATIBILITY_MODE */
+/* #define MBEDTLS_SSL_TLS1_3_KEY_EXCHANGE_MODE_EPHEMERAL_ENABLED */
+/* #define MBEDTLS_PSA_CRYPTO_C */
+/* #define MBEDTLS_ENTROPY_HARDWARE_ALT */
+/* #define MBEDTLS_HKDF_C */
+
+/* Lean handshake profile for metered links. The TLS transport then offers
+ * only ECDHE-ECDSA-AES128-GCM-SHA256 with SHA-256 signatures, leaves out the
+ * encrypt-then-MAC extension, sends only the leaf client certificate, and
+ * requests a 1024 byte maximum fragment length unless the credentials set
+ * another. The broker must present an ECDSA certificate chain and already hold
+ * the CA of the client certificate. The mbed TLS 3.x TLS 1.3 client does not
+ * send max_fragment_length, so with TLS 1.3 enabled above the profile turns on
+ * the record size limit extension of RFC 8449 instead. That extension needs
+ * mbed TLS 3.6 and advertises MBEDTLS_SSL_IN_CONTENT_LEN as the limit. */
+/* #define TLS_TRANSPORT_LEAN_PROFILE */
+#if defined( TLS_TRANSPORT_LEAN_PROFILE ) && defined( MBEDTLS_SSL_PROTO_TLS1_3 )
+    #define MBEDTLS_SSL_RECORD_SIZE_LIMIT
+#endif
+
+/* Record the time, bytes and socket calls of each phase of TLS_FreeRTOS_Connect
+ * in NetworkContext_t.handshakeProfile and log a summary. Per-state details
+ * are logged at the debug level. */
+/* #define TLS_TRANSPORT_HANDSHAKE_PROFILE */
+
+/* Define when lib/coreMQTT is v2.0 or later, whose transport interface
+ * declares the TransportOutVector_t of TLS_FreeRTOS_writev(). The demo needs
+ * coreMQTT v1 and calls TLS_FreeRTOS_writev() itself, so that the header and
+ * payload of each publish share one TLS record. */
+/* #define TLS_TRANSPORT_INTERFACE_WRITEV */
+
+/* Keep the TLS session of each broker and offer it on reconnect for
+ * TLS_TRANSPORT_SESSION_CACHE_TTL_MS, so that a server which resumes it skips
+ * the certificate exchange and its signature checks. A session is only
+ * offered to the same host name with the same root CAs and client
+ * certificate. Full handshakes still verify the server chain. Sessions are
+ * cached for TLS 1.2; session tickets let the broker resume without keeping
+ * state of its own. DTLS connections do not use the cache. */
+/* #define TLS_TRANSPORT_SESSION_CACHE */
+#ifdef TLS_TRANSPORT_SESSION_CACHE
+    #define MBEDTLS_SSL_SESSION_TICKETS
+#endif
+
+/* Build the DTLS 1.2 transport of using_mbedtls_dtls.h, for MQTT over UDP.
+ * The connection ID lets a session survive a new address after the modem
+ * reattaches, without a new handshake. */
+/* #define MBEDTLS_SSL_PROTO_DTLS */
+#ifdef MBEDTLS_SSL_PROTO_DTLS
+    #define MBEDTLS_SSL_DTLS_ANTI_REPLAY
+    #define MBEDTLS_SSL_DTLS_HELLO_VERIFY
+    #define MBEDTLS_SSL_DTLS_CONNECTION_ID
+#endif
+
+/* Leave the error descriptions out of mbedtls_error.c, about 14 KB of flash,
+ * and log mbed TLS errors as numeric codes only. */
+/* #define MBEDTLS_ERROR_NUMERIC_ONLY */
+
 /* Check certificate key usage. */
 #define MBEDTLS_X509_CHECK_KEY_USAGE
 #define MBEDTLS_X509_CHECK_EXTENDED_KEY_USAGE
@@ -98,7 +209,6 @@
 #define MBEDTLS_AES_C
 #define MBEDTLS_ASN1_PARSE_C
 #define MBEDTLS_ASN1_WRITE_C
-#define MBEDTLS_BASE64_C
 #define MBEDTLS_BIGNUM_C
 #define MBEDTLS_CIPHER_C
 #define MBEDTLS_CTR_DRBG_C
@@ -109,7 +219,6 @@
 #define MBEDTLS_GCM_C
 #define MBEDTLS_MD_C
 #define MBEDTLS_OID_C
-#define MBEDTLS_PEM_PARSE_C
 #define MBEDTLS_PK_C
 #define MBEDTLS_PK_PARSE_C
 #define MBEDTLS_PKCS1_V15
@@ -124,13 +233,39 @@
 #define MBEDTLS_X509_USE_C
 #define MBEDTLS_X509_CRT_PARSE_C
 
-/* Set the memory allocation functions on FreeRTOS. */
+/* PEM parsing of credentials. The 1NCE onboarding service returns the device
+ * credentials as PEM strings, so these must remain enabled in this project. */
+#define MBEDTLS_BASE64_C
+#define MBEDTLS_PEM_PARSE_C
+
+/* Set the memory allocation functions on FreeRTOS. The ECP benchmark wraps
+ * them to count the heap that mbed TLS holds. */
 void * mbedtls_platform_calloc( size_t nmemb,
                                 size_t size );
 void mbedtls_platform_free( void * ptr );
 #define MBEDTLS_PLATFORM_MEMORY
-#define MBEDTLS_PLATFORM_CALLOC_MACRO    mbedtls_platform_calloc
-#define MBEDTLS_PLATFORM_FREE_MACRO      mbedtls_platform_free
+#ifdef MBEDTLS_FREERTOS_ECP_BENCHMARK
+    void * mbedtls_platform_heap_tracked_calloc( size_t nmemb,
+                                                 size_t size );
+    void mbedtls_platform_heap_tracked_free( void * ptr );
+    #define MBEDTLS_PLATFORM_CALLOC_MACRO    mbedtls_platform_heap_tracked_calloc
+    #define MBEDTLS_PLATFORM_FREE_MACRO      mbedtls_platform_heap_tracked_free
+#else
+    #define MBEDTLS_PLATFORM_CALLOC_MACRO    mbedtls_platform_calloc
+    #define MBEDTLS_PLATFORM_FREE_MACRO      mbedtls_platform_free
+#endif
+
+/* Serve mbed TLS allocations of up to 1024 bytes from fixed size-class pools
+ * (about 39 KB of static storage with the default counts) instead of the
+ * FreeRTOS heap; larger ones and those that find their pools full still use
+ * pvPortMalloc. The default block counts are the peaks of one mutual-auth
+ * TLS 1.2 connection with RSA-2048 or P-256 certificates, measured with the
+ * host build of mbed TLS 2.28. Check them on the target with
+ * MBEDTLS_FREERTOS_SLAB_HISTOGRAM and set MBEDTLS_FREERTOS_SLAB_BLOCKS_<size>
+ * from mbedtls_platform_slab_log_stats(), which logs the usage and peaks of
+ * each class. */
+/* #define MBEDTLS_FREERTOS_SLAB_ALLOC */
+/* #define MBEDTLS_FREERTOS_SLAB_HISTOGRAM */
 
 /* The network send and receive functions on FreeRTOS. */
 int mbedtls_platform_send( void * ctx,
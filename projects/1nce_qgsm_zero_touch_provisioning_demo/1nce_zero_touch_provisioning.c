@@ -52,6 +52,12 @@
 /* 1NCE onboarding header*/
 #include "1nce_zero_touch_provisioning.h"
 
+/* DER credentials converted from the PEM macros in demo_config.h by
+ * tools/pem_to_der_header.py. */
+#ifdef democonfigUSE_DER_CREDENTIALS
+    #include "demo_credentials_der.h"
+#endif
+
 /*-----------------------------------------------------------*/
 
 /**
@@ -347,12 +353,21 @@ TlsTransportStatus_t nce_connect( NetworkContext_t * pxNetworkContext )
 
     tNetworkCredentials.disableSni = democonfigDISABLE_SNI;
     /* Set the credentials for establishing a TLS connection. */
-    tNetworkCredentials.pRootCa = ( const unsigned char * ) democonfigROOT_CA_PEM;
-    tNetworkCredentials.rootCaSize = sizeof( democonfigROOT_CA_PEM );
-    tNetworkCredentials.pClientCert = ( const unsigned char * ) democonfigCLIENT_CERTIFICATE_PEM;
-    tNetworkCredentials.clientCertSize = sizeof( democonfigCLIENT_CERTIFICATE_PEM );
-    tNetworkCredentials.pPrivateKey = ( const unsigned char * ) democonfigCLIENT_PRIVATE_KEY_PEM;
-    tNetworkCredentials.privateKeySize = sizeof( democonfigCLIENT_PRIVATE_KEY_PEM );
+    #ifdef democonfigUSE_DER_CREDENTIALS
+        tNetworkCredentials.pRootCa = ucRootCaDer;
+        tNetworkCredentials.rootCaSize = sizeof( ucRootCaDer );
+        tNetworkCredentials.pClientCert = ucClientCertificateDer;
+        tNetworkCredentials.clientCertSize = sizeof( ucClientCertificateDer );
+        tNetworkCredentials.pPrivateKey = ucClientPrivateKeyDer;
+        tNetworkCredentials.privateKeySize = sizeof( ucClientPrivateKeyDer );
+    #else
+        tNetworkCredentials.pRootCa = ( const unsigned char * ) democonfigROOT_CA_PEM;
+        tNetworkCredentials.rootCaSize = sizeof( democonfigROOT_CA_PEM );
+        tNetworkCredentials.pClientCert = ( const unsigned char * ) democonfigCLIENT_CERTIFICATE_PEM;
+        tNetworkCredentials.clientCertSize = sizeof( democonfigCLIENT_CERTIFICATE_PEM );
+        tNetworkCredentials.pPrivateKey = ( const unsigned char * ) democonfigCLIENT_PRIVATE_KEY_PEM;
+        tNetworkCredentials.privateKeySize = sizeof( democonfigCLIENT_PRIVATE_KEY_PEM );
+    #endif /* ifdef democonfigUSE_DER_CREDENTIALS */
 
     /* Initialize reconnect attempts and interval. */
     BackoffAlgorithm_InitializeParams( &xReconnectParams,
@@ -46,6 +46,13 @@
 /* Demo Specific configs. */
 #include "demo_config.h"
 
+/* mbed TLS includes. */
+#include "mbedtls_config.h"
+
+#ifdef MBEDTLS_FREERTOS_ECDHE_POOL
+    #include "mbedtls_ecdhe_pool.h"
+#endif
+
 /* Use by the pseudo random number generator. */
 static UBaseType_t ulNextRand;
 
@@ -66,6 +73,11 @@ static void CellularDemoTask( void * pvParameters )
 {
     bool retCellular = true;
 
+    #ifdef MBEDTLS_FREERTOS_ECDHE_POOL
+        /* Precompute the ECDHE key pairs while the modem registers. */
+        ( void ) mbedtls_platform_ecdhe_pool_start( tskIDLE_PRIORITY );
+    #endif
+
     /* Setup cellular. */
     retCellular = setupCellular();
 
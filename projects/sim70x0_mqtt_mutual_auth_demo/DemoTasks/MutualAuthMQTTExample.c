@@ -38,6 +38,11 @@
  * democonfigROOT_CA_PEM, democonfigCLIENT_CERTIFICATE_PEM,
  * and democonfigCLIENT_PRIVATE_KEY_PEM in demo_config.h to establish a
  * mutually authenticated connection.
+ *
+ * The connection is run by mqtt_demo_session.c, which keeps one MQTT session
+ * across TLS connections and recovers the cellular link when they fail. This
+ * file provides the CONNECT and SUBSCRIBE of the demo, and handles the
+ * incoming publishes and acknowledgments.
  */
 
 /* Standard includes. */
@@ -54,17 +59,50 @@
 /* MQTT library includes. */
 #include "core_mqtt.h"
 
+/* Dispatch of incoming publishes by topic filter. */
+#include "mqtt_topic_router.h"
+
+/* Publish of payloads larger than the network buffer. */
+#ifdef democonfigLOG_UPLOAD_FILE
+    #include "mqtt_stream_publish.h"
+    #include "mqtt_publish_window.h"
+#endif
+
+/* Throughput benchmark of the publish window. */
+#ifdef MQTT_PUBLISH_BENCHMARK
+    #include "mqtt_publish_benchmark.h"
+#endif
+
+/* Microbenchmark of the topic router. */
+#ifdef MQTT_TOPIC_ROUTER_BENCHMARK
+    #include "mqtt_topic_router_benchmark.h"
+#endif
+
 /* Exponential backoff retry include. */
 #include "backoff_algorithm.h"
 
 /* Transport interface implementation include header for TLS. */
 #include "using_mbedtls.h"
 
+/* Persistent session over the cellular network. */
+#include "mqtt_demo_session.h"
+
+/* Benchmark of the ECC operations of a handshake. */
+#ifdef MBEDTLS_FREERTOS_ECP_BENCHMARK
+    #include "mbedtls_ecp_benchmark.h"
+#endif
+
 /* Use 1NCE service to onboard device. */
 #ifdef USE_1NCE_ZERO_TOUCH_PROVISIONING
     #include "1nce_zero_touch_provisioning.h"
 #endif
 
+/* DER credentials converted from the PEM macros in demo_config.h by
+ * tools/pem_to_der_header.py. */
+#ifdef democonfigUSE_DER_CREDENTIALS
+    #include "demo_credentials_der.h"
+#endif
+
 /*-----------------------------------------------------------*/
 
 /* Compile time error for undefined configs. */
@@ -173,12 +211,6 @@
  */
 #define mqttexampleMESSAGE                                "Hello World!"
 
-/**
- * @brief Time in ticks to wait between each cycle of the demo implemented
- * by RunMQTTTask().
- */
-#define mqttexampleDELAY_BETWEEN_DEMO_ITERATIONS_TICKS    ( pdMS_TO_TICKS( 5000U ) )
-
 /**
  * @brief Timeout for MQTT_ProcessLoop in milliseconds.
  */
@@ -196,19 +228,44 @@
 #define mqttexampleKEEP_ALIVE_TIMEOUT_SECONDS             ( 60U )
 
 /**
- * @brief Delay (in ticks) between consecutive cycles of MQTT publish operations in a
- * demo iteration.
- *
- * Note that the process loop also has a timeout, so the total time between
- * publishes is the sum of the two delays.
+ * @brief Delay (in milliseconds) between consecutive publishes.
  */
-#define mqttexampleDELAY_BETWEEN_PUBLISHES_TICKS          ( pdMS_TO_TICKS( 2000U ) )
+#define mqttexampleDELAY_BETWEEN_PUBLISHES_MS             ( 2000U )
 
 /**
  * @brief Transport timeout in milliseconds for transport send and receive.
  */
 #define mqttexampleTRANSPORT_SEND_RECV_TIMEOUT_MS         ( 5000U )
 
+/**
+ * @brief Number of runs of each operation of the ECC benchmark.
+ */
+#define mqttexampleECP_BENCHMARK_ITERATIONS               ( 20U )
+
+/**
+ * @brief Suffix of the topic of the log upload with democonfigLOG_UPLOAD_FILE,
+ * appended to the example topic. The demo does not subscribe to it, so the
+ * broker does not send the large message back.
+ */
+#define mqttexampleLOG_UPLOAD_TOPIC_SUFFIX                "/logs"
+
+/**
+ * @brief Number of messages of each run of the publish benchmark.
+ */
+#define mqttexamplePUBLISH_BENCHMARK_MESSAGES             ( 20U )
+
+/**
+ * @brief Round trip time simulated by the publish benchmark, typical of an
+ * LTE-M link.
+ */
+#define mqttexamplePUBLISH_BENCHMARK_ROUND_TRIP_MS        ( 600U )
+
+/**
+ * @brief Number of topics dispatched by each run of the topic router
+ * benchmark.
+ */
+#define mqttexampleTOPIC_ROUTER_BENCHMARK_DISPATCHES      ( 10000U )
+
 /**
  * @brief ALPN (Application-Layer Protocol Negotiation) protocol name for AWS IoT MQTT.
  *
@@ -288,27 +345,26 @@
 void RunMQTTTask( void * pvParameters );
 
 /**
- * @brief Connect to MQTT broker with reconnection retries.
+ * @brief Set the credentials of the TLS connections to the broker.
  *
- * If connection fails, retry is attempted after a timeout.
- * Timeout value will exponentially increase until maximum
- * timeout value is reached or the number of attempts are exhausted.
- *
- * @param[out] pxNetworkContext The parameter to return the created network context.
- *
- * @return The status of the final connection attempt.
+ * @param[out] pxNetworkCredentials Credentials of the TLS connection.
  */
-static TlsTransportStatus_t prvConnectToServerWithBackoffRetries( NetworkCredentials_t * pxNetworkCredentials,
-                                                                  NetworkContext_t * pNetworkContext );
+static void prvSetNetworkCredentials( NetworkCredentials_t * pxNetworkCredentials );
 
 /**
- * @brief Sends an MQTT Connect packet over the already connected TLS over TCP connection.
+ * @brief Sends an MQTT Connect packet over the already connected TLS over TCP
+ * connection. The broker keeps the session of the client while it is away.
  *
  * @param[in, out] pxMQTTContext MQTT context pointer.
- * @param[in] xNetworkContext Network context.
+ * @param[in] usKeepAliveSeconds Keep-alive interval sent to the broker.
+ * @param[out] pxSessionPresent Whether the broker resumed a session it held
+ * for the client.
+ *
+ * @return The status of MQTT_Connect().
  */
-static void prvCreateMQTTConnectionWithBroker( MQTTContext_t * pxMQTTContext,
-                                               NetworkContext_t * pxNetworkContext );
+static MQTTStatus_t prvCreateMQTTConnectionWithBroker( MQTTContext_t * pxMQTTContext,
+                                                       uint16_t usKeepAliveSeconds,
+                                                       bool * pxSessionPresent );
 
 /**
  * @brief Function to update variable #xTopicFilterContext with status
@@ -325,35 +381,35 @@ static void prvUpdateSubAckStatus( MQTTPacketInfo_t * pxPacketInfo );
  * retried using an exponential backoff strategy with jitter.
  *
  * @param[in] pxMQTTContext MQTT context pointer.
- */
-static void prvMQTTSubscribeWithBackoffRetries( MQTTContext_t * pxMQTTContext );
-
-/**
- * @brief Publishes a message mqttexampleMESSAGE on mqttexampleTOPIC topic.
  *
- * @param[in] pxMQTTContext MQTT context pointer.
+ * @return #MQTTSuccess, the status of the MQTT_Subscribe() or
+ * MQTT_ProcessLoop() that failed, or #MQTTServerRefused if the broker still
+ * rejected the subscription after the last retry.
  */
-static void prvMQTTPublishToTopic( MQTTContext_t * pxMQTTContext );
+static MQTTStatus_t prvMQTTSubscribeWithBackoffRetries( MQTTContext_t * pxMQTTContext );
 
 /**
- * @brief Unsubscribes from the previously subscribed topic as specified
- * in mqttexampleTOPIC.
+ * @brief The timer query function provided to the MQTT context.
  *
- * @param[in] pxMQTTContext MQTT context pointer.
+ * @return Time in milliseconds.
  */
-static void prvMQTTUnsubscribeFromTopic( MQTTContext_t * pxMQTTContext );
+static uint32_t prvGetTimeMs( void );
+
+#ifdef democonfigLOG_UPLOAD_FILE
 
 /**
- * @brief The timer query function provided to the MQTT context.
+ * @brief Stream the log file to the broker with QoS1, and wait for its
+ * PUBACK. Called on each connection, once the session is up.
  *
- * @return Time in milliseconds.
+ * @param[in] pxMQTTContext MQTT context pointer.
  */
-static uint32_t prvGetTimeMs( void );
+    static void prvUploadLogFile( MQTTContext_t * pxMQTTContext );
+#endif
 
 /**
- * @brief Process a response or ack to an MQTT request (PING, PUBLISH,
- * SUBSCRIBE or UNSUBSCRIBE). This function processes PINGRESP, PUBACK,
- * SUBACK, and UNSUBACK.
+ * @brief Process a response or ack to an MQTT request (PING, PUBLISH or
+ * SUBSCRIBE). This function processes PINGRESP, PUBACK and SUBACK. The
+ * PUBACKs of the messages of the session are matched before they get here.
  *
  * @param[in] pxIncomingPacket is a pointer to structure containing deserialized
  * MQTT response.
@@ -371,8 +427,24 @@ static void prvMQTTProcessResponse( MQTTPacketInfo_t * pxIncomingPacket,
 static void prvMQTTProcessIncomingPublish( MQTTPublishInfo_t * pxPublishInfo );
 
 /**
- * @brief The application callback function for getting the incoming publishes,
- * incoming acks, and ping responses reported from the MQTT library.
+ * @brief Process a publish to the example topic.
+ *
+ * @param[in] pvContext Not used.
+ * @param[in] pxPublishInfo is a pointer to structure containing deserialized
+ * Publish message.
+ */
+static void prvExampleTopicCallback( void * pvContext,
+                                     MQTTPublishInfo_t * pxPublishInfo );
+
+/**
+ * @brief The application callback function for the packets that the session
+ * of mqtt_demo_session.c passes on: incoming publishes, the SUBACK and UNSUBACK
+ * of the demo, and PUBACKs that match none of its messages.
+ *
+ * The session handles the other packets in its own event callback, which
+ * completes the commands of the MQTT agent, matches the PUBACKs of the
+ * publish window and times the incoming publishes. coreMQTT handles PINGRESPs
+ * itself in MQTT_ProcessLoop().
  *
  * @param[in] pxMQTTContext MQTT context pointer.
  * @param[in] pxPacketInfo Packet Info pointer for the incoming packet.
@@ -399,11 +471,13 @@ static uint8_t ucSharedBuffer[ democonfigNETWORK_BUFFER_SIZE ];
  */
 static uint32_t ulGlobalEntryTimeMs;
 
+#ifdef democonfigLOG_UPLOAD_FILE
+
 /**
- * @brief Packet Identifier generated when Publish request was sent to the broker;
- * it is used to match received Publish ACK to the transmitted Publish packet.
+ * @brief Packet ID of the log upload waiting for its PUBACK, or 0.
  */
-static uint16_t usPublishPacketIdentifier;
+    static uint16_t usLogUploadPacketIdentifier;
+#endif
 
 /**
  * @brief Packet Identifier generated when Subscribe request was sent to the broker;
@@ -411,13 +485,6 @@ static uint16_t usPublishPacketIdentifier;
  */
 static uint16_t usSubscribePacketIdentifier;
 
-/**
- * @brief Packet Identifier generated when Unsubscribe request was sent to the broker;
- * it is used to match received Unsubscribe response to the transmitted Unsubscribe
- * request.
- */
-static uint16_t usUnsubscribePacketIdentifier;
-
 /* A bridge to feed hard coded info or dynamic acquired info for MQTT connection. */
 static char * pThingName = NULL;
 static char * pEndpoint = NULL;
@@ -444,6 +511,11 @@ static topicFilterContext_t xTopicFilterContext[ mqttexampleTOPIC_COUNT ] =
     { mqttexampleTOPIC, MQTTSubAckFailure }
 };
 
+/**
+ * @brief Callbacks of the subscribed topic filters.
+ */
+static MQTTTopicRouter_t xTopicRouter;
+
 
 /** @brief Static buffer used to hold MQTT messages being sent and received. */
 static MQTTFixedBuffer_t xBuffer =
@@ -468,13 +540,10 @@ static MQTTFixedBuffer_t xBuffer =
  */
 void RunMQTTTask( void * pvParameters )
 {
-    uint32_t ulPublishCount = 0U, ulTopicCount = 0U;
-    const uint32_t ulMaxPublishCount = 5UL;
-    NetworkContext_t xNetworkContext = { 0 };
+    uint32_t ulTopicCount = 0U;
     NetworkCredentials_t xNetworkCredentials = { 0 };
-    MQTTContext_t xMQTTContext = { 0 };
+    MQTTDemoSessionConfig_t xSessionConfig = { 0 };
     MQTTStatus_t xMQTTStatus;
-    TlsTransportStatus_t xNetworkStatus;
 
     /* Remove compiler warnings about unused parameters. */
     ( void ) pvParameters;
@@ -485,6 +554,25 @@ void RunMQTTTask( void * pvParameters )
      */
     ulGlobalEntryTimeMs = prvGetTimeMs();
 
+    #ifdef MBEDTLS_FREERTOS_ECP_BENCHMARK
+        /* Log the cost of the ECC operations with the ECP settings selected in
+         * mbedtls_config.h, before any connection uses the heap. */
+        ( void ) mbedtls_platform_ecp_benchmark( mqttexampleECP_BENCHMARK_ITERATIONS, NULL );
+    #endif
+
+    #ifdef MQTT_PUBLISH_BENCHMARK
+        /* Compare the publish window with one PUBACK per round trip, against
+         * a broker stand-in that needs no network. */
+        ( void ) MQTTPublishBenchmark_Run( mqttexamplePUBLISH_BENCHMARK_MESSAGES,
+                                           mqttexamplePUBLISH_BENCHMARK_ROUND_TRIP_MS,
+                                           NULL );
+    #endif
+
+    #ifdef MQTT_TOPIC_ROUTER_BENCHMARK
+        /* Compare the topic router with a comparison against each filter. */
+        ( void ) MQTTTopicRouterBenchmark_Run( mqttexampleTOPIC_ROUTER_BENCHMARK_DISPATCHES, NULL );
+    #endif
+
     #ifdef USE_1NCE_ZERO_TOUCH_PROVISIONING
         uint8_t status = nce_onboard( &pThingName,
                                       &pEndpoint,
@@ -499,110 +587,127 @@ void RunMQTTTask( void * pvParameters )
         pExampleTopic = mqttexampleTOPIC;
     #endif /* ifdef USE_1NCE_ZERO_TOUCH_PROVISIONING */
 
+    xMQTTStatus = MQTTTopicRouter_Init( &xTopicRouter );
+    configASSERT( xMQTTStatus == MQTTSuccess );
+
     for( ulTopicCount = 0; ulTopicCount < mqttexampleTOPIC_COUNT; ulTopicCount++ )
     {
         xTopicFilterContext[ ulTopicCount ].pcTopicFilter = pExampleTopic;
+
+        /* Incoming publishes are dispatched by topic filter. */
+        xMQTTStatus = MQTTTopicRouter_Register( &xTopicRouter,
+                                                xTopicFilterContext[ ulTopicCount ].pcTopicFilter,
+                                                ( uint16_t ) strlen( xTopicFilterContext[ ulTopicCount ].pcTopicFilter ),
+                                                prvExampleTopicCallback,
+                                                NULL );
+        configASSERT( xMQTTStatus == MQTTSuccess );
     }
 
-    for( ; ; )
+    prvSetNetworkCredentials( &xNetworkCredentials );
+
+    /* Keep one MQTT session across the TLS connections. The connection is
+     * recovered through the cellular network whenever it fails. */
+    xSessionConfig.pHostName = pEndpoint;
+    xSessionConfig.port = democonfigMQTT_BROKER_PORT;
+    xSessionConfig.pNetworkCredentials = &xNetworkCredentials;
+    xSessionConfig.transportTimeoutMs = mqttexampleTRANSPORT_SEND_RECV_TIMEOUT_MS;
+    xSessionConfig.pTopic = pExampleTopic;
+    xSessionConfig.pMessage = mqttexampleMESSAGE;
+    xSessionConfig.publishIntervalMs = mqttexampleDELAY_BETWEEN_PUBLISHES_MS;
+    xSessionConfig.processLoopTimeoutMs = mqttexamplePROCESS_LOOP_TIMEOUT_MS;
+    xSessionConfig.keepAliveSeconds = mqttexampleKEEP_ALIVE_TIMEOUT_SECONDS;
+    xSessionConfig.pNetworkBuffer = &xBuffer;
+    xSessionConfig.getTime = prvGetTimeMs;
+    xSessionConfig.eventCallback = prvEventCallback;
+    xSessionConfig.sendConnect = prvCreateMQTTConnectionWithBroker;
+    xSessionConfig.subscribe = prvMQTTSubscribeWithBackoffRetries;
+
+    #ifdef democonfigLOG_UPLOAD_FILE
+        /* Upload the log file on each connection. */
+        xSessionConfig.ready = prvUploadLogFile;
+    #endif
+
+    MQTTDemoSession_Run( &xSessionConfig );
+}
+/*-----------------------------------------------------------*/
+
+#ifdef democonfigLOG_UPLOAD_FILE
+    static void prvUploadLogFile( MQTTContext_t * pxMQTTContext )
     {
-        /****************************** Connect. ******************************/
-
-        /* Attempt to establish TLS session with MQTT broker. If connection fails,
-         * retry after a timeout. Timeout value will be exponentially increased
-         * until  the maximum number of attempts are reached or the maximum timeout
-         * value is reached. The function returns a failure status if the TCP
-         * connection cannot be established to the broker after the configured
-         * number of attempts. */
-        xNetworkStatus = prvConnectToServerWithBackoffRetries( &xNetworkCredentials,
-                                                               &xNetworkContext );
-        configASSERT( xNetworkStatus == TLS_TRANSPORT_SUCCESS );
-
-        /* Sends an MQTT Connect packet over the already established TLS connection,
-         * and waits for connection acknowledgment (CONNACK) packet. */
-        LogInfo( ( "Creating an MQTT connection to %s.\r\n", pEndpoint ) );
-        prvCreateMQTTConnectionWithBroker( &xMQTTContext, &xNetworkContext );
-
-        /**************************** Subscribe. ******************************/
-
-        /* If server rejected the subscription request, attempt to resubscribe to
-         * topic. Attempts are made according to the exponential backoff retry
-         * strategy implemented in BackoffAlgorithm. */
-        prvMQTTSubscribeWithBackoffRetries( &xMQTTContext );
-
-        /****************** Publish and Keep Alive Loop. **********************/
-        /* Publish messages with QoS1, send and process Keep alive messages. */
-        for( ulPublishCount = 0; ulPublishCount < ulMaxPublishCount; ulPublishCount++ )
+        static char cLogTopic[ 128 ];
+        static MQTTStreamFileSource_t xFileSource;
+        MQTTStreamSource_t xSource;
+        MQTTPublishInfo_t xPublishInfo;
+        MQTTStatus_t xResult = MQTTSuccess;
+        FILE * pxFile;
+        long lFileSize = -1;
+        uint32_t ulStartTimeMs;
+
+        pxFile = fopen( democonfigLOG_UPLOAD_FILE, "rb" );
+
+        if( pxFile == NULL )
         {
-            LogInfo( ( "Publish to the MQTT topic %s.\r\n", pExampleTopic ) );
-            prvMQTTPublishToTopic( &xMQTTContext );
-
-            /* Process incoming publish echo, since application subscribed to the
-             * same topic, the broker will send publish message back to the
-             * application. */
-            LogInfo( ( "Attempt to receive publish message from broker.\r\n" ) );
-            xMQTTStatus = MQTT_ProcessLoop( &xMQTTContext, mqttexamplePROCESS_LOOP_TIMEOUT_MS );
-            configASSERT( xMQTTStatus == MQTTSuccess );
-
-            /* Leave Connection Idle for some time. */
-            LogInfo( ( "Keeping Connection Idle...\r\n\r\n" ) );
-            vTaskDelay( mqttexampleDELAY_BETWEEN_PUBLISHES_TICKS );
+            LogWarn( ( "No log file %s to upload.\r\n", democonfigLOG_UPLOAD_FILE ) );
         }
+        else
+        {
+            if( fseek( pxFile, 0L, SEEK_END ) == 0 )
+            {
+                lFileSize = ftell( pxFile );
+            }
 
-        /******************** Unsubscribe from the topic. *********************/
-        LogInfo( ( "Unsubscribe from the MQTT topic %s.\r\n", pExampleTopic ) );
-        prvMQTTUnsubscribeFromTopic( &xMQTTContext );
+            if( ( lFileSize <= 0 ) || ( fseek( pxFile, 0L, SEEK_SET ) != 0 ) )
+            {
+                LogWarn( ( "Log file %s is empty or unreadable.\r\n", democonfigLOG_UPLOAD_FILE ) );
+            }
+            else
+            {
+                ( void ) snprintf( cLogTopic, sizeof( cLogTopic ), "%s%s",
+                                   pExampleTopic, mqttexampleLOG_UPLOAD_TOPIC_SUFFIX );
 
-        /* Process incoming UNSUBACK packet from the broker. */
-        xMQTTStatus = MQTT_ProcessLoop( &xMQTTContext, mqttexamplePROCESS_LOOP_TIMEOUT_MS );
-        configASSERT( xMQTTStatus == MQTTSuccess );
+                ( void ) memset( ( void * ) &xPublishInfo, 0x00, sizeof( xPublishInfo ) );
+                xPublishInfo.qos = MQTTQoS1;
+                xPublishInfo.pTopicName = cLogTopic;
+                xPublishInfo.topicNameLength = ( uint16_t ) strlen( cLogTopic );
+                xPublishInfo.payloadLength = ( size_t ) lFileSize;
 
-        /**************************** Disconnect. *****************************/
+                /* Only one chunk of the file is in RAM at a time. */
+                MQTTStream_FileSource( &xFileSource, pxFile, &xSource );
+                usLogUploadPacketIdentifier = MQTT_GetPacketId( pxMQTTContext );
 
-        /* Send an MQTT Disconnect packet over the already connected TLS over
-         * TCP connection. There is no corresponding response for the disconnect
-         * packet. After sending disconnect, client must close the network
-         * connection. */
-        LogInfo( ( "Disconnecting the MQTT connection with %s.\r\n",
-                   pEndpoint ) );
-        xMQTTStatus = MQTT_Disconnect( &xMQTTContext );
-        configASSERT( xMQTTStatus == MQTTSuccess );
+                LogInfo( ( "Uploading %ld bytes of %s to %s.\r\n",
+                           lFileSize, democonfigLOG_UPLOAD_FILE, cLogTopic ) );
+                xResult = MQTTStream_Publish( pxMQTTContext, &xPublishInfo,
+                                              usLogUploadPacketIdentifier, &xSource );
 
-        /* Close the network connection.  */
-        TLS_FreeRTOS_Disconnect( &xNetworkContext );
+                /* The PUBACK handler clears the packet ID. */
+                ulStartTimeMs = prvGetTimeMs();
 
-        /* Reset SUBACK status for each topic filter after completion of
-         * subscription request cycle. */
-        for( ulTopicCount = 0; ulTopicCount < mqttexampleTOPIC_COUNT; ulTopicCount++ )
-        {
-            xTopicFilterContext[ ulTopicCount ].xSubAckStatus = MQTTSubAckFailure;
-        }
+                while( ( xResult == MQTTSuccess ) && ( usLogUploadPacketIdentifier != 0U ) &&
+                       ( ( prvGetTimeMs() - ulStartTimeMs ) < mqttexamplePROCESS_LOOP_TIMEOUT_MS ) )
+                {
+                    xResult = MQTT_ProcessLoop( pxMQTTContext, MQTT_PUBLISH_WINDOW_POLL_MS );
+                }
+
+                if( ( xResult != MQTTSuccess ) || ( usLogUploadPacketIdentifier != 0U ) )
+                {
+                    LogError( ( "Log upload failed with status %s.\r\n", MQTT_Status_strerror( xResult ) ) );
+                }
+            }
 
-        /* Wait for some time between two iterations to ensure that we do not
-         * bombard the broker. */
-        LogInfo( ( "RunMQTTTask() completed an iteration successfully. "
-                   "Total free heap is %u.\r\n",
-                   xPortGetFreeHeapSize() ) );
-        LogInfo( ( "Demo completed successfully.\r\n" ) );
-        LogInfo( ( "Short delay before starting the next iteration.... \r\n\r\n" ) );
-        vTaskDelay( mqttexampleDELAY_BETWEEN_DEMO_ITERATIONS_TICKS );
+            ( void ) fclose( pxFile );
+        }
     }
-}
 /*-----------------------------------------------------------*/
+#endif /* ifdef democonfigLOG_UPLOAD_FILE */
 
-static TlsTransportStatus_t prvConnectToServerWithBackoffRetries( NetworkCredentials_t * pxNetworkCredentials,
-                                                                  NetworkContext_t * pxNetworkContext )
+static void prvSetNetworkCredentials( NetworkCredentials_t * pxNetworkCredentials )
 {
-    TlsTransportStatus_t xNetworkStatus;
-    BackoffAlgorithmStatus_t xBackoffAlgStatus = BackoffAlgorithmSuccess;
-    BackoffAlgorithmContext_t xReconnectParams;
-    uint16_t usNextRetryBackOff = 0U;
-
     #ifdef democonfigUSE_AWS_IOT_CORE_BROKER
         /* ALPN protocols must be a NULL-terminated list of strings. Therefore,
          * the first entry will contain the actual ALPN protocol string while the
-         * second entry must remain NULL. */
-        char * pcAlpnProtocols[] = { NULL, NULL };
+         * second entry must remain NULL. The list is used by every connection. */
+        static char * pcAlpnProtocols[] = { NULL, NULL };
 
         /* The ALPN string changes depending on whether username/password authentication is used. */
         #ifdef democonfigCLIENT_USERNAME
@@ -624,6 +729,15 @@ static TlsTransportStatus_t prvConnectToServerWithBackoffRetries( NetworkCredent
             pxNetworkCredentials->pPrivateKey = ( uint8_t * ) pPrvKey;
             pxNetworkCredentials->privateKeySize = strlen( pPrvKey ) + 1;
         #endif /* #ifdef democonfigCLIENT_CERTIFICATE_PEM */
+    #elif defined( democonfigUSE_DER_CREDENTIALS )
+        pxNetworkCredentials->pRootCa = ucRootCaDer;
+        pxNetworkCredentials->rootCaSize = sizeof( ucRootCaDer );
+        #ifdef democonfigCLIENT_CERTIFICATE_PEM
+            pxNetworkCredentials->pClientCert = ucClientCertificateDer;
+            pxNetworkCredentials->clientCertSize = sizeof( ucClientCertificateDer );
+            pxNetworkCredentials->pPrivateKey = ucClientPrivateKeyDer;
+            pxNetworkCredentials->privateKeySize = sizeof( ucClientPrivateKeyDer );
+        #endif /* #ifdef democonfigCLIENT_CERTIFICATE_PEM */
     #else /* #ifdef USE_1NCE_ZERO_TOUCH_PROVISIONING */
         pxNetworkCredentials->pRootCa = ( const unsigned char * ) democonfigROOT_CA_PEM;
         pxNetworkCredentials->rootCaSize = sizeof( democonfigROOT_CA_PEM );
@@ -635,88 +749,26 @@ static TlsTransportStatus_t prvConnectToServerWithBackoffRetries( NetworkCredent
         #endif /* #ifdef democonfigCLIENT_CERTIFICATE_PEM */
     #endif /* #ifdef USE_1NCE_ZERO_TOUCH_PROVISIONING */
 
-    /* Initialize reconnect attempts and interval. */
-    BackoffAlgorithm_InitializeParams( &xReconnectParams,
-                                       mqttexampleRETRY_BACKOFF_BASE_MS,
-                                       mqttexampleRETRY_MAX_BACKOFF_DELAY_MS,
-                                       mqttexampleRETRY_MAX_ATTEMPTS );
-
-    /* Attempt to connect to MQTT broker. If connection fails, retry after
-     * a timeout. Timeout value will exponentially increase till maximum
-     * attempts are reached.
-     */
-    do
-    {
-        /* Establish a TLS session with the MQTT broker. This example connects to
-         * the MQTT broker as specified in democonfigMQTT_BROKER_ENDPOINT and
-         * democonfigMQTT_BROKER_PORT at the top of this file. */
-        LogInfo( ( "Creating a TLS connection to %s:%u.\r\n",
-                   pEndpoint,
-                   democonfigMQTT_BROKER_PORT ) );
-        /* Attempt to create a mutually authenticated TLS connection. */
-        xNetworkStatus = TLS_FreeRTOS_Connect( pxNetworkContext,
-                                               pEndpoint,
-                                               democonfigMQTT_BROKER_PORT,
-                                               pxNetworkCredentials,
-                                               mqttexampleTRANSPORT_SEND_RECV_TIMEOUT_MS,
-                                               mqttexampleTRANSPORT_SEND_RECV_TIMEOUT_MS );
-
-        if( xNetworkStatus != TLS_TRANSPORT_SUCCESS )
-        {
-            /* Generate a random number and calculate backoff value (in milliseconds) for
-             * the next connection retry.
-             * Note: It is recommended to seed the random number generator with a device-specific
-             * entropy source so that possibility of multiple devices retrying failed network operations
-             * at similar intervals can be avoided. */
-            xBackoffAlgStatus = BackoffAlgorithm_GetNextBackoff( &xReconnectParams, uxRand(), &usNextRetryBackOff );
-
-            if( xBackoffAlgStatus == BackoffAlgorithmRetriesExhausted )
-            {
-                LogError( ( "Connection to the broker failed, all attempts exhausted." ) );
-            }
-            else if( xBackoffAlgStatus == BackoffAlgorithmSuccess )
-            {
-                LogWarn( ( "Connection to the broker failed. "
-                           "Retrying connection with backoff and jitter." ) );
-                vTaskDelay( pdMS_TO_TICKS( usNextRetryBackOff ) );
-            }
-        }
-    } while( ( xNetworkStatus != TLS_TRANSPORT_SUCCESS ) && ( xBackoffAlgStatus == BackoffAlgorithmSuccess ) );
-
-    return xNetworkStatus;
 }
 /*-----------------------------------------------------------*/
 
-static void prvCreateMQTTConnectionWithBroker( MQTTContext_t * pxMQTTContext,
-                                               NetworkContext_t * pxNetworkContext )
+static MQTTStatus_t prvCreateMQTTConnectionWithBroker( MQTTContext_t * pxMQTTContext,
+                                                       uint16_t usKeepAliveSeconds,
+                                                       bool * pxSessionPresent )
 {
     MQTTStatus_t xResult;
     MQTTConnectInfo_t xConnectInfo;
-    bool xSessionPresent;
-    TransportInterface_t xTransport;
-
-    /***
-     * For readability, error handling in this function is restricted to the use of
-     * asserts().
-     ***/
 
-    /* Fill in Transport Interface send and receive function pointers. */
-    xTransport.pNetworkContext = pxNetworkContext;
-    xTransport.send = TLS_FreeRTOS_send;
-    xTransport.recv = TLS_FreeRTOS_recv;
+    configASSERT( pxSessionPresent != NULL );
 
-    /* Initialize MQTT library. */
-    xResult = MQTT_Init( pxMQTTContext, &xTransport, prvGetTimeMs, prvEventCallback, &xBuffer );
-    configASSERT( xResult == MQTTSuccess );
+    *pxSessionPresent = false;
 
     /* Some fields are not used in this demo so start with everything at 0. */
     ( void ) memset( ( void * ) &xConnectInfo, 0x00, sizeof( xConnectInfo ) );
 
-    /* Start with a clean session i.e. direct the MQTT broker to discard any
-     * previous session data. Also, establishing a connection with clean session
-     * will ensure that the broker does not store any data when this client
-     * gets disconnected. */
-    xConnectInfo.cleanSession = true;
+    /* Without a clean session, the MQTT broker keeps the subscriptions and
+     * queues QoS1 messages for the client until it reconnects. */
+    xConnectInfo.cleanSession = false;
 
     /* The client identifier is used to uniquely identify this MQTT client to
      * the MQTT broker. In a production device the identifier can be something
@@ -726,7 +778,7 @@ static void prvCreateMQTTConnectionWithBroker( MQTTContext_t * pxMQTTContext,
 
     /* Set MQTT keep-alive period. If the application does not send packets at an interval less than
      * the keep-alive period, the MQTT library will send PINGREQ packets. */
-    xConnectInfo.keepAliveSeconds = mqttexampleKEEP_ALIVE_TIMEOUT_SECONDS;
+    xConnectInfo.keepAliveSeconds = usKeepAliveSeconds;
 
     /* Append metrics when connecting to the AWS IoT Core broker. */
     #ifdef democonfigUSE_AWS_IOT_CORE_BROKER
@@ -757,11 +809,20 @@ static void prvCreateMQTTConnectionWithBroker( MQTTContext_t * pxMQTTContext,
                             &xConnectInfo,
                             NULL,
                             mqttexampleCONNACK_RECV_TIMEOUT_MS,
-                            &xSessionPresent );
-    configASSERT( xResult == MQTTSuccess );
+                            pxSessionPresent );
+
+    if( xResult == MQTTSuccess )
+    {
+        /* Successfully established and MQTT connection with the broker. */
+        LogInfo( ( "An MQTT connection is established with %s.", pEndpoint ) );
+    }
+    else
+    {
+        LogError( ( "Failed to establish an MQTT connection with %s: %s.",
+                    pEndpoint, MQTT_Status_strerror( xResult ) ) );
+    }
 
-    /* Successfully established and MQTT connection with the broker. */
-    LogInfo( ( "An MQTT connection is established with %s.", pEndpoint ) );
+    return xResult;
 }
 /*-----------------------------------------------------------*/
 
@@ -785,7 +846,7 @@ static void prvUpdateSubAckStatus( MQTTPacketInfo_t * pxPacketInfo )
 }
 /*-----------------------------------------------------------*/
 
-static void prvMQTTSubscribeWithBackoffRetries( MQTTContext_t * pxMQTTContext )
+static MQTTStatus_t prvMQTTSubscribeWithBackoffRetries( MQTTContext_t * pxMQTTContext )
 {
     MQTTStatus_t xResult = MQTTSuccess;
     BackoffAlgorithmStatus_t xBackoffAlgStatus = BackoffAlgorithmSuccess;
@@ -827,7 +888,13 @@ static void prvMQTTSubscribeWithBackoffRetries( MQTTContext_t * pxMQTTContext )
                                   xMQTTSubscription,
                                   sizeof( xMQTTSubscription ) / sizeof( MQTTSubscribeInfo_t ),
                                   usSubscribePacketIdentifier );
-        configASSERT( xResult == MQTTSuccess );
+
+        if( xResult != MQTTSuccess )
+        {
+            LogError( ( "Failed to send SUBSCRIBE for topic %s: %s.",
+                        pExampleTopic, MQTT_Status_strerror( xResult ) ) );
+            break;
+        }
 
         LogInfo( ( "SUBSCRIBE sent for topic %s to broker.\n\n", pExampleTopic ) );
 
@@ -839,7 +906,12 @@ static void prvMQTTSubscribeWithBackoffRetries( MQTTContext_t * pxMQTTContext )
          * must be ready to receive any packet.  This demo uses the generic packet
          * processing function everywhere to highlight this fact. */
         xResult = MQTT_ProcessLoop( pxMQTTContext, mqttexamplePROCESS_LOOP_TIMEOUT_MS );
-        configASSERT( xResult == MQTTSuccess );
+
+        if( xResult != MQTTSuccess )
+        {
+            LogError( ( "Failed to receive the SUBACK: %s.", MQTT_Status_strerror( xResult ) ) );
+            break;
+        }
 
         /* Reset flag before checking suback responses. */
         xFailedSubscribeToTopic = false;
@@ -865,6 +937,7 @@ static void prvMQTTSubscribeWithBackoffRetries( MQTTContext_t * pxMQTTContext )
                 {
                     LogError( ( "Server rejected subscription request. All retry attempts have exhausted. Topic=%s",
                                 xTopicFilterContext[ ulTopicCount ].pcTopicFilter ) );
+                    xResult = MQTTServerRefused;
                 }
                 else if( xBackoffAlgStatus == BackoffAlgorithmSuccess )
                 {
@@ -877,70 +950,9 @@ static void prvMQTTSubscribeWithBackoffRetries( MQTTContext_t * pxMQTTContext )
                 break;
             }
         }
-
-        configASSERT( xBackoffAlgStatus != BackoffAlgorithmRetriesExhausted );
     } while( ( xFailedSubscribeToTopic == true ) && ( xBackoffAlgStatus == BackoffAlgorithmSuccess ) );
-}
-/*-----------------------------------------------------------*/
 
-static void prvMQTTPublishToTopic( MQTTContext_t * pxMQTTContext )
-{
-    MQTTStatus_t xResult;
-    MQTTPublishInfo_t xMQTTPublishInfo;
-
-    /***
-     * For readability, error handling in this function is restricted to the use of
-     * asserts().
-     ***/
-
-    /* Some fields are not used by this demo so start with everything at 0. */
-    ( void ) memset( ( void * ) &xMQTTPublishInfo, 0x00, sizeof( xMQTTPublishInfo ) );
-
-    /* This demo uses QoS1. */
-    xMQTTPublishInfo.qos = MQTTQoS1;
-    xMQTTPublishInfo.retain = false;
-    xMQTTPublishInfo.pTopicName = pExampleTopic;
-    xMQTTPublishInfo.topicNameLength = ( uint16_t ) strlen( pExampleTopic );
-    xMQTTPublishInfo.pPayload = mqttexampleMESSAGE;
-    xMQTTPublishInfo.payloadLength = strlen( mqttexampleMESSAGE );
-
-    /* Get a unique packet id. */
-    usPublishPacketIdentifier = MQTT_GetPacketId( pxMQTTContext );
-
-    /* Send PUBLISH packet. Packet ID is not used for a QoS1 publish. */
-    xResult = MQTT_Publish( pxMQTTContext, &xMQTTPublishInfo, usPublishPacketIdentifier );
-
-    configASSERT( xResult == MQTTSuccess );
-}
-/*-----------------------------------------------------------*/
-
-static void prvMQTTUnsubscribeFromTopic( MQTTContext_t * pxMQTTContext )
-{
-    MQTTStatus_t xResult;
-    MQTTSubscribeInfo_t xMQTTSubscription[ mqttexampleTOPIC_COUNT ];
-
-    /* Some fields not used by this demo so start with everything at 0. */
-    ( void ) memset( ( void * ) &xMQTTSubscription, 0x00, sizeof( xMQTTSubscription ) );
-
-    /* Get a unique packet id. */
-    usSubscribePacketIdentifier = MQTT_GetPacketId( pxMQTTContext );
-
-    /* Subscribe to the mqttexampleTOPIC topic filter. This example subscribes to
-     * only one topic and uses QoS1. */
-    xMQTTSubscription[ 0 ].qos = MQTTQoS1;
-    xMQTTSubscription[ 0 ].pTopicFilter = pExampleTopic;
-    xMQTTSubscription[ 0 ].topicFilterLength = ( uint16_t ) strlen( pExampleTopic );
-
-    /* Get next unique packet identifier. */
-    usUnsubscribePacketIdentifier = MQTT_GetPacketId( pxMQTTContext );
-
-    /* Send UNSUBSCRIBE packet. */
-    xResult = MQTT_Unsubscribe( pxMQTTContext,
-                                xMQTTSubscription,
-                                sizeof( xMQTTSubscription ) / sizeof( MQTTSubscribeInfo_t ),
-                                usUnsubscribePacketIdentifier );
-
-    configASSERT( xResult == MQTTSuccess );
+    return xResult;
 }
 /*-----------------------------------------------------------*/
 
@@ -952,9 +964,18 @@ static void prvMQTTProcessResponse( MQTTPacketInfo_t * pxIncomingPacket,
     switch( pxIncomingPacket->type )
     {
         case MQTT_PACKET_TYPE_PUBACK:
-            LogInfo( ( "PUBACK received for packet Id %u.\r\n", usPacketId ) );
-            /* Make sure ACK packet identifier matches with Request packet identifier. */
-            configASSERT( usPublishPacketIdentifier == usPacketId );
+
+            /* The session matches the PUBACKs of its own messages. */
+            #ifdef democonfigLOG_UPLOAD_FILE
+                if( usPacketId == usLogUploadPacketIdentifier )
+                {
+                    LogInfo( ( "PUBACK received for the log upload.\r\n" ) );
+                    usLogUploadPacketIdentifier = 0U;
+                    break;
+                }
+            #endif
+
+            LogWarn( ( "PUBACK for packet Id %u matches no message in flight.\r\n", usPacketId ) );
             break;
 
         case MQTT_PACKET_TYPE_SUBACK:
@@ -979,12 +1000,6 @@ static void prvMQTTProcessResponse( MQTTPacketInfo_t * pxIncomingPacket,
             configASSERT( usSubscribePacketIdentifier == usPacketId );
             break;
 
-        case MQTT_PACKET_TYPE_UNSUBACK:
-            LogInfo( ( "Unsubscribed from the topic %s.\r\n", pExampleTopic ) );
-            /* Make sure ACK packet identifier matches with Request packet identifier. */
-            configASSERT( usUnsubscribePacketIdentifier == usPacketId );
-            break;
-
         case MQTT_PACKET_TYPE_PINGRESP:
 
             /* Nothing to be done from application as library handles
@@ -1009,23 +1024,37 @@ static void prvMQTTProcessIncomingPublish( MQTTPublishInfo_t * pxPublishInfo )
     /* Process incoming Publish. */
     LogInfo( ( "Incoming QoS : %d\n", pxPublishInfo->qos ) );
 
-    /* Verify the received publish is for the we have subscribed to. */
-    if( ( pxPublishInfo->topicNameLength == strlen( pExampleTopic ) ) &&
-        ( 0 == strncmp( pExampleTopic, pxPublishInfo->pTopicName, pxPublishInfo->topicNameLength ) ) )
+    /* Call the callbacks of the subscribed filters that match the topic. */
+    if( MQTTTopicRouter_Dispatch( &xTopicRouter, pxPublishInfo ) == 0U )
     {
+        LogInfo( ( "Incoming Publish Topic Name: %.*s does not match subscribed topic.\r\n",
+                   pxPublishInfo->topicNameLength,
+                   pxPublishInfo->pTopicName ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvExampleTopicCallback( void * pvContext,
+                                     MQTTPublishInfo_t * pxPublishInfo )
+{
+    ( void ) pvContext;
+
+    #ifdef democonfigTELEMETRY
+        /* Telemetry payloads are binary. */
+        LogInfo( ( "\r\nIncoming Publish Topic Name: %.*s matches subscribed topic.\r\n"
+                   "Incoming Publish Message of %u bytes.\r\n",
+                   pxPublishInfo->topicNameLength,
+                   pxPublishInfo->pTopicName,
+                   ( unsigned int ) pxPublishInfo->payloadLength ) );
+    #else
         LogInfo( ( "\r\nIncoming Publish Topic Name: %.*s matches subscribed topic.\r\n"
                    "Incoming Publish Message : %.*s\r\n",
                    pxPublishInfo->topicNameLength,
                    pxPublishInfo->pTopicName,
                    pxPublishInfo->payloadLength,
                    ( char * ) pxPublishInfo->pPayload ) );
-    }
-    else
-    {
-        LogInfo( ( "Incoming Publish Topic Name: %.*s does not match subscribed topic.\r\n",
-                   pxPublishInfo->topicNameLength,
-                   pxPublishInfo->pTopicName ) );
-    }
+    #endif /* ifdef democonfigTELEMETRY */
 }
 
 /*-----------------------------------------------------------*/
@@ -1034,7 +1063,8 @@ static void prvEventCallback( MQTTContext_t * pxMQTTContext,
                               MQTTPacketInfo_t * pxPacketInfo,
                               MQTTDeserializedInfo_t * pxDeserializedInfo )
 {
-    /* The MQTT context is not used for this demo. */
+    /* The session forwards the packets of its own MQTT context, and the
+     * handlers below need only the packets. */
     ( void ) pxMQTTContext;
 
     if( ( pxPacketInfo->type & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH )
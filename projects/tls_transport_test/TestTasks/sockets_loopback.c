@@ -0,0 +1,582 @@
+/*
+ * FreeRTOS
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file sockets_loopback.c
+ * @brief Sockets of sockets_wrapper.h connected through buffers in RAM.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "stream_buffer.h"
+#include "message_buffer.h"
+
+/* Include header that defines log levels. */
+#include "logging_levels.h"
+
+/* Logging configuration for the loopback. */
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "LOOPBACK_SOCKETS"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_INFO
+#endif
+
+#include "logging_stack.h"
+
+/* Loopback sockets include. */
+#include "sockets_loopback.h"
+
+/*-----------------------------------------------------------*/
+
+/* One end of a loopback connection. */
+typedef struct xSOCKET
+{
+    struct loopbackPair * pPair;
+    UBaseType_t end;
+
+    TickType_t receiveTimeout;
+    TickType_t sendTimeout;
+    BaseType_t nonBlocking;
+
+    SocketsDataReadyCallback_t dataReadyCallback;
+    void * pDataReadyContext;
+} loopbackSocket_t;
+
+/* The two directions of a loopback connection. Each end receives from
+ * toEnd[ end ] and sends to the buffer of the other end. The buffers are
+ * deleted by the second end to close, so that an end never sends into a
+ * deleted buffer. */
+typedef struct loopbackPair
+{
+    StreamBufferHandle_t toEnd[ 2 ];
+    loopbackSocket_t * pEnds[ 2 ];
+    BaseType_t datagram;
+} loopbackPair_t;
+
+/* A port accepting loopback connections. */
+typedef struct loopbackListener
+{
+    uint16_t port;
+    QueueHandle_t acceptQueue;
+} loopbackListener_t;
+
+/*-----------------------------------------------------------*/
+
+/* Listening ports. An entry with a NULL acceptQueue is free. */
+static loopbackListener_t loopbackListeners[ SOCKETS_LOOPBACK_MAX_LISTENERS ];
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Connect to a loopback listener.
+ *
+ * @param[out] pSocket The output parameter to return the client end.
+ * @param[in] pHostName Must be #SOCKETS_LOOPBACK_HOST.
+ * @param[in] port Port of the listener.
+ * @param[in] receiveTimeoutMs Timeout (in milliseconds) for transport receive.
+ * @param[in] sendTimeoutMs Timeout (in milliseconds) for transport send.
+ * @param[in] datagram pdTRUE to keep the boundaries of each send, like UDP.
+ *
+ * @return SOCKETS_ERROR_NONE on success, SOCKETS_ENOTCONN if no listener
+ * accepts the connection, SOCKETS_EINVAL for another host, or SOCKETS_ENOMEM.
+ */
+static BaseType_t loopbackConnect( Socket_t * pSocket,
+                                   const char * pHostName,
+                                   uint16_t port,
+                                   uint32_t receiveTimeoutMs,
+                                   uint32_t sendTimeoutMs,
+                                   BaseType_t datagram );
+
+/**
+ * @brief Check that a socket handle is an open end.
+ *
+ * @param[in] xSocket The socket handle.
+ *
+ * @return pdTRUE for an open end, pdFALSE otherwise.
+ */
+static BaseType_t isValidSocket( Socket_t xSocket );
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t loopbackConnect( Socket_t * pSocket,
+                                   const char * pHostName,
+                                   uint16_t port,
+                                   uint32_t receiveTimeoutMs,
+                                   uint32_t sendTimeoutMs,
+                                   BaseType_t datagram )
+{
+    BaseType_t retConnect = SOCKETS_ERROR_NONE;
+    QueueHandle_t acceptQueue = NULL;
+    loopbackPair_t * pPair = NULL;
+    loopbackSocket_t * pEnds[ 2 ] = { NULL, NULL };
+    uint32_t i = 0;
+
+    if( ( pSocket == NULL ) || ( pHostName == NULL ) ||
+        ( strcmp( pHostName, SOCKETS_LOOPBACK_HOST ) != 0 ) )
+    {
+        LogError( ( "Only %s can be reached through the loopback.", SOCKETS_LOOPBACK_HOST ) );
+        retConnect = SOCKETS_EINVAL;
+    }
+
+    if( retConnect == SOCKETS_ERROR_NONE )
+    {
+        pPair = pvPortMalloc( sizeof( loopbackPair_t ) );
+        pEnds[ 0 ] = pvPortMalloc( sizeof( loopbackSocket_t ) );
+        pEnds[ 1 ] = pvPortMalloc( sizeof( loopbackSocket_t ) );
+
+        if( ( pPair == NULL ) || ( pEnds[ 0 ] == NULL ) || ( pEnds[ 1 ] == NULL ) )
+        {
+            LogError( ( "Failed to allocate a loopback connection." ) );
+            retConnect = SOCKETS_ENOMEM;
+        }
+    }
+
+    if( retConnect == SOCKETS_ERROR_NONE )
+    {
+        ( void ) memset( pPair, 0, sizeof( loopbackPair_t ) );
+        pPair->datagram = datagram;
+
+        for( i = 0; i < 2U; i++ )
+        {
+            if( datagram == pdTRUE )
+            {
+                pPair->toEnd[ i ] = ( StreamBufferHandle_t ) xMessageBufferCreate( SOCKETS_LOOPBACK_BUFFER_SIZE );
+            }
+            else
+            {
+                pPair->toEnd[ i ] = xStreamBufferCreate( SOCKETS_LOOPBACK_BUFFER_SIZE, 1U );
+            }
+
+            if( pPair->toEnd[ i ] == NULL )
+            {
+                LogError( ( "Failed to allocate a loopback buffer." ) );
+                retConnect = SOCKETS_ENOMEM;
+            }
+        }
+    }
+
+    if( retConnect == SOCKETS_ERROR_NONE )
+    {
+        for( i = 0; i < 2U; i++ )
+        {
+            ( void ) memset( pEnds[ i ], 0, sizeof( loopbackSocket_t ) );
+            pEnds[ i ]->receiveTimeout = portMAX_DELAY;
+            pEnds[ i ]->sendTimeout = portMAX_DELAY;
+            pEnds[ i ]->pPair = pPair;
+            pEnds[ i ]->end = i;
+            pPair->pEnds[ i ] = pEnds[ i ];
+        }
+
+        /* End 0 is the client, end 1 the server end given to the listener. */
+        ( void ) Sockets_SetReceiveTimeout( pEnds[ 0 ], receiveTimeoutMs );
+
+        if( pdMS_TO_TICKS( sendTimeoutMs ) < portMAX_DELAY )
+        {
+            pEnds[ 0 ]->sendTimeout = pdMS_TO_TICKS( sendTimeoutMs );
+        }
+
+        /* Look up the listener and post to its queue with the scheduler
+         * suspended, so that the queue cannot stop listening and be deleted in
+         * between. A full queue refuses the connection. */
+        vTaskSuspendAll();
+        {
+            for( i = 0; i < SOCKETS_LOOPBACK_MAX_LISTENERS; i++ )
+            {
+                if( ( loopbackListeners[ i ].acceptQueue != NULL ) && ( loopbackListeners[ i ].port == port ) )
+                {
+                    acceptQueue = loopbackListeners[ i ].acceptQueue;
+                }
+            }
+
+            if( ( acceptQueue == NULL ) || ( xQueueSend( acceptQueue, &( pEnds[ 1 ] ), 0 ) != pdPASS ) )
+            {
+                retConnect = SOCKETS_ENOTCONN;
+            }
+        }
+        ( void ) xTaskResumeAll();
+
+        if( retConnect != SOCKETS_ERROR_NONE )
+        {
+            LogError( ( "Loopback connection to port %u refused.", port ) );
+        }
+    }
+
+    /* Cleanup the connection if any error. */
+    if( retConnect != SOCKETS_ERROR_NONE )
+    {
+        if( pPair != NULL )
+        {
+            for( i = 0; i < 2U; i++ )
+            {
+                if( pPair->toEnd[ i ] != NULL )
+                {
+                    vStreamBufferDelete( pPair->toEnd[ i ] );
+                }
+            }
+        }
+
+        vPortFree( pPair );
+        vPortFree( pEnds[ 0 ] );
+        vPortFree( pEnds[ 1 ] );
+        pEnds[ 0 ] = NULL;
+    }
+
+    if( pSocket != NULL )
+    {
+        *pSocket = pEnds[ 0 ];
+    }
+
+    return retConnect;
+}
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t isValidSocket( Socket_t xSocket )
+{
+    BaseType_t valid = pdTRUE;
+
+    /* coverity[misra_c_2012_rule_11_4_violation] */
+    if( ( xSocket == NULL ) || ( xSocket == SOCKETS_INVALID_SOCKET ) || ( xSocket->pPair == NULL ) )
+    {
+        LogError( ( "Invalid xSocket %p", xSocket ) );
+        valid = pdFALSE;
+    }
+
+    return valid;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_Connect( Socket_t * pTcpSocket,
+                            const char * pHostName,
+                            uint16_t port,
+                            uint32_t receiveTimeoutMs,
+                            uint32_t sendTimeoutMs )
+{
+    return loopbackConnect( pTcpSocket, pHostName, port, receiveTimeoutMs, sendTimeoutMs, pdFALSE );
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_GetHostByName( const char * pHostName,
+                                  char * pAddress,
+                                  size_t addressLength )
+{
+    BaseType_t retResolve = SOCKETS_ERROR_NONE;
+
+    /* The loopback host is its own address. */
+    if( ( pHostName == NULL ) || ( pAddress == NULL ) ||
+        ( addressLength <= strlen( SOCKETS_LOOPBACK_HOST ) ) )
+    {
+        retResolve = SOCKETS_EINVAL;
+    }
+    else if( strcmp( pHostName, SOCKETS_LOOPBACK_HOST ) != 0 )
+    {
+        LogError( ( "Only %s can be resolved through the loopback.", SOCKETS_LOOPBACK_HOST ) );
+        retResolve = SOCKETS_SOCKET_ERROR;
+    }
+    else
+    {
+        ( void ) strncpy( pAddress, SOCKETS_LOOPBACK_HOST, addressLength );
+    }
+
+    return retResolve;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_ConnectUdp( Socket_t * pUdpSocket,
+                               const char * pHostName,
+                               uint16_t port,
+                               uint32_t receiveTimeoutMs,
+                               uint32_t sendTimeoutMs )
+{
+    return loopbackConnect( pUdpSocket, pHostName, port, receiveTimeoutMs, sendTimeoutMs, pdTRUE );
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_SetDataReadyCallback( Socket_t xSocket,
+                                         SocketsDataReadyCallback_t dataReadyCallback,
+                                         void * pvContext )
+{
+    BaseType_t retSetCallback = SOCKETS_ERROR_NONE;
+
+    if( isValidSocket( xSocket ) == pdFALSE )
+    {
+        retSetCallback = SOCKETS_EINVAL;
+    }
+    else
+    {
+        /* The sender calls the callback with the scheduler suspended. */
+        vTaskSuspendAll();
+        xSocket->dataReadyCallback = dataReadyCallback;
+        xSocket->pDataReadyContext = pvContext;
+        ( void ) xTaskResumeAll();
+    }
+
+    return retSetCallback;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_SetNonBlocking( Socket_t xSocket,
+                                   BaseType_t xNonBlocking )
+{
+    BaseType_t retSetNonBlocking = SOCKETS_ERROR_NONE;
+
+    if( isValidSocket( xSocket ) == pdFALSE )
+    {
+        retSetNonBlocking = SOCKETS_EINVAL;
+    }
+    else
+    {
+        xSocket->nonBlocking = ( xNonBlocking != pdFALSE ) ? pdTRUE : pdFALSE;
+    }
+
+    return retSetNonBlocking;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_SetReceiveTimeout( Socket_t xSocket,
+                                      uint32_t receiveTimeoutMs )
+{
+    BaseType_t retSetTimeout = SOCKETS_ERROR_NONE;
+
+    if( isValidSocket( xSocket ) == pdFALSE )
+    {
+        retSetTimeout = SOCKETS_EINVAL;
+    }
+    else if( pdMS_TO_TICKS( receiveTimeoutMs ) >= portMAX_DELAY )
+    {
+        xSocket->receiveTimeout = portMAX_DELAY;
+    }
+    else
+    {
+        xSocket->receiveTimeout = pdMS_TO_TICKS( receiveTimeoutMs );
+    }
+
+    return retSetTimeout;
+}
+
+/*-----------------------------------------------------------*/
+
+void Sockets_Disconnect( Socket_t xSocket )
+{
+    loopbackPair_t * pPair = NULL;
+    BaseType_t lastEnd = pdFALSE;
+
+    if( isValidSocket( xSocket ) == pdTRUE )
+    {
+        pPair = xSocket->pPair;
+
+        vTaskSuspendAll();
+        pPair->pEnds[ xSocket->end ] = NULL;
+        lastEnd = ( pPair->pEnds[ 1U - xSocket->end ] == NULL ) ? pdTRUE : pdFALSE;
+        ( void ) xTaskResumeAll();
+
+        if( lastEnd == pdTRUE )
+        {
+            vStreamBufferDelete( pPair->toEnd[ 0 ] );
+            vStreamBufferDelete( pPair->toEnd[ 1 ] );
+            vPortFree( pPair );
+        }
+
+        vPortFree( xSocket );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t Sockets_Recv( Socket_t xSocket,
+                      void * pvBuffer,
+                      size_t xBufferLength )
+{
+    loopbackPair_t * pPair = NULL;
+    UBaseType_t end = 0;
+    TickType_t recvTimeout = 0;
+    int32_t retRecvLength = 0;
+    BaseType_t closed = pdFALSE;
+
+    if( isValidSocket( xSocket ) == pdFALSE )
+    {
+        retRecvLength = SOCKETS_EINVAL;
+    }
+    else
+    {
+        pPair = xSocket->pPair;
+        end = xSocket->end;
+        recvTimeout = ( xSocket->nonBlocking == pdTRUE ) ? 0U : xSocket->receiveTimeout;
+
+        retRecvLength = ( int32_t ) xStreamBufferReceive( pPair->toEnd[ end ], pvBuffer, xBufferLength, recvTimeout );
+
+        if( retRecvLength == 0 )
+        {
+            vTaskSuspendAll();
+            closed = ( ( pPair->pEnds[ 1U - end ] == NULL ) &&
+                       ( xStreamBufferIsEmpty( pPair->toEnd[ end ] ) == pdTRUE ) ) ? pdTRUE : pdFALSE;
+            ( void ) xTaskResumeAll();
+
+            if( closed == pdTRUE )
+            {
+                LogDebug( ( "Loopback receive on a connection closed by the other end." ) );
+                retRecvLength = SOCKETS_SOCKET_ERROR;
+            }
+        }
+    }
+
+    return retRecvLength;
+}
+
+/*-----------------------------------------------------------*/
+
+int32_t Sockets_Send( Socket_t xSocket,
+                      const void * pvBuffer,
+                      size_t xDataLength )
+{
+    loopbackPair_t * pPair = NULL;
+    UBaseType_t peerEnd = 0;
+    loopbackSocket_t * pPeer = NULL;
+    int32_t retSendLength = 0;
+
+    if( isValidSocket( xSocket ) == pdTRUE )
+    {
+        pPair = xSocket->pPair;
+        peerEnd = 1U - xSocket->end;
+
+        vTaskSuspendAll();
+        pPeer = pPair->pEnds[ peerEnd ];
+        ( void ) xTaskResumeAll();
+    }
+
+    if( pPeer == NULL )
+    {
+        LogError( ( "Loopback send on a closed connection." ) );
+        retSendLength = SOCKETS_SOCKET_ERROR;
+    }
+    else if( ( pPair->datagram == pdTRUE ) && ( ( xDataLength + sizeof( size_t ) ) > SOCKETS_LOOPBACK_BUFFER_SIZE ) )
+    {
+        /* A message buffer stores the length before each datagram. */
+        LogError( ( "Loopback datagram of %u bytes is too large.", ( unsigned ) xDataLength ) );
+        retSendLength = SOCKETS_SOCKET_ERROR;
+    }
+    else
+    {
+        retSendLength = ( int32_t ) xStreamBufferSend( pPair->toEnd[ peerEnd ],
+                                                      pvBuffer,
+                                                      xDataLength,
+                                                      xSocket->sendTimeout );
+
+        if( retSendLength > 0 )
+        {
+            /* The other end cannot close while the scheduler is suspended,
+             * and the callback must not block anyway. */
+            vTaskSuspendAll();
+            pPeer = pPair->pEnds[ peerEnd ];
+
+            if( ( pPeer != NULL ) && ( pPeer->dataReadyCallback != NULL ) )
+            {
+                pPeer->dataReadyCallback( pPeer, pPeer->pDataReadyContext );
+            }
+
+            ( void ) xTaskResumeAll();
+        }
+    }
+
+    return retSendLength;
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t Sockets_GetTransactionCount( Socket_t xSocket )
+{
+    /* No modem, no AT transactions. */
+    ( void ) xSocket;
+
+    return 0U;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_LoopbackListen( uint16_t port,
+                                   QueueHandle_t acceptQueue )
+{
+    BaseType_t retListen = SOCKETS_ERROR_NONE;
+    loopbackListener_t * pListener = NULL;
+    loopbackListener_t * pFree = NULL;
+    uint32_t i = 0;
+
+    vTaskSuspendAll();
+
+    for( i = 0; i < SOCKETS_LOOPBACK_MAX_LISTENERS; i++ )
+    {
+        if( loopbackListeners[ i ].acceptQueue == NULL )
+        {
+            pFree = &( loopbackListeners[ i ] );
+        }
+        else if( loopbackListeners[ i ].port == port )
+        {
+            pListener = &( loopbackListeners[ i ] );
+        }
+        else
+        {
+            /* Another port. */
+        }
+    }
+
+    if( acceptQueue == NULL )
+    {
+        if( pListener != NULL )
+        {
+            pListener->acceptQueue = NULL;
+        }
+    }
+    else if( pListener != NULL )
+    {
+        retListen = ( pListener->acceptQueue == acceptQueue ) ? SOCKETS_ERROR_NONE : SOCKETS_EISCONN;
+    }
+    else if( pFree != NULL )
+    {
+        pFree->port = port;
+        pFree->acceptQueue = acceptQueue;
+    }
+    else
+    {
+        retListen = SOCKETS_ENOMEM;
+    }
+
+    ( void ) xTaskResumeAll();
+
+    return retListen;
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,88 @@
+/*
+ * FreeRTOS
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file sockets_loopback.h
+ * @brief In-process implementation of sockets_wrapper.h for the TLS transport
+ * tests.
+ *
+ * The test project links sockets_loopback.c instead of the cellular
+ * sockets_wrapper.c. Sockets_Connect() to #SOCKETS_LOOPBACK_HOST and a port
+ * registered with Sockets_LoopbackListen() connects to the listener through
+ * buffers in RAM, so that the tests can run a server stand-in in the same
+ * program.
+ */
+
+#ifndef SOCKETS_LOOPBACK_H
+#define SOCKETS_LOOPBACK_H
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "queue.h"
+
+/* Sockets interface implemented by the loopback. */
+#include "sockets_wrapper.h"
+
+/**
+ * @brief Host name of the loopback. Connections to any other host fail.
+ */
+#define SOCKETS_LOOPBACK_HOST    "loopback"
+
+/**
+ * @brief Number of ports that can listen at the same time.
+ */
+#ifndef SOCKETS_LOOPBACK_MAX_LISTENERS
+    #define SOCKETS_LOOPBACK_MAX_LISTENERS    ( 2U )
+#endif
+
+/**
+ * @brief Bytes buffered in each direction of a loopback connection.
+ */
+#ifndef SOCKETS_LOOPBACK_BUFFER_SIZE
+    #define SOCKETS_LOOPBACK_BUFFER_SIZE    ( 2048U )
+#endif
+
+/**
+ * @brief Accept loopback connections on a port.
+ *
+ * For each connection to the port, the server end of the connection is sent
+ * to @p acceptQueue as a Socket_t, which the receiver closes with
+ * Sockets_Disconnect(). A connection is refused when the queue is full. The
+ * server end has no receive or send timeout until one is set.
+ *
+ * When a side closes, the other side can still receive what was sent before.
+ * After that, Sockets_Recv() fails, but a reader blocked at that time only
+ * notices at the end of its receive timeout.
+ *
+ * @param[in] port The port.
+ * @param[in] acceptQueue Queue of Socket_t items, or NULL to stop listening.
+ *
+ * @return SOCKETS_ERROR_NONE, SOCKETS_EISCONN if another queue listens on the
+ * port, or SOCKETS_ENOMEM if #SOCKETS_LOOPBACK_MAX_LISTENERS ports listen.
+ */
+BaseType_t Sockets_LoopbackListen( uint16_t port,
+                                   QueueHandle_t acceptQueue );
+
+#endif /* ifndef SOCKETS_LOOPBACK_H */
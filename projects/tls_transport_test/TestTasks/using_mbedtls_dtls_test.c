@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file using_mbedtls_dtls_test.c
+ * @brief Test of the DTLS transport and of its connection ID rebind.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Configure logs for the functions in this file. */
+#include "logging_levels.h"
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "DtlsTest"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_INFO
+#endif
+#include "logging_stack.h"
+
+/* DTLS test headers. */
+#include "using_mbedtls_dtls_test.h"
+#include "using_mbedtls_standin.h"
+
+#ifdef DTLS_TRANSPORT_TEST
+
+/**
+ * @brief Receive and send timeout of the client.
+ */
+    #define DTLS_TEST_TIMEOUT_MS         ( 2000U )
+
+/**
+ * @brief Size of the message that the client sends and reads back.
+ */
+    #define DTLS_TEST_MESSAGE_SIZE       ( 64U )
+
+/**
+ * @brief Reads that may time out before the echo of a message is complete.
+ * After a rebind, the stand-in first has to notice that the old socket closed.
+ */
+    #define DTLS_TEST_MAX_EMPTY_READS    ( 3U )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Send a message made from a seed, and read it back.
+ *
+ * @param[in] pNetworkContext Network context of a DTLS connection.
+ * @param[in] seed Value from which the message is made.
+ *
+ * @return pdPASS if the message came back unchanged, pdFAIL otherwise.
+ */
+    static BaseType_t exchangeMessage( NetworkContext_t * pNetworkContext,
+                                       uint32_t seed );
+
+/*-----------------------------------------------------------*/
+
+    static BaseType_t exchangeMessage( NetworkContext_t * pNetworkContext,
+                                       uint32_t seed )
+    {
+        uint8_t message[ DTLS_TEST_MESSAGE_SIZE ];
+        uint8_t echo[ DTLS_TEST_MESSAGE_SIZE ];
+        BaseType_t returnStatus = pdPASS;
+        int32_t transferred = 0;
+        size_t received = 0U;
+        uint32_t emptyReads = 0U;
+        size_t i = 0U;
+
+        for( i = 0U; i < sizeof( message ); i++ )
+        {
+            message[ i ] = ( uint8_t ) ( seed + ( i * 31U ) );
+        }
+
+        transferred = TLS_FreeRTOS_send( pNetworkContext, message, sizeof( message ) );
+
+        if( transferred != ( int32_t ) sizeof( message ) )
+        {
+            LogError( ( "Sent %d of %u bytes.", ( int ) transferred, ( unsigned int ) sizeof( message ) ) );
+            returnStatus = pdFAIL;
+        }
+
+        while( ( returnStatus == pdPASS ) && ( received < sizeof( echo ) ) )
+        {
+            transferred = TLS_FreeRTOS_recv( pNetworkContext,
+                                             &( echo[ received ] ),
+                                             sizeof( echo ) - received );
+
+            if( transferred > 0 )
+            {
+                received += ( size_t ) transferred;
+            }
+            else if( ( transferred == 0 ) && ( emptyReads < DTLS_TEST_MAX_EMPTY_READS ) )
+            {
+                emptyReads++;
+            }
+            else
+            {
+                LogError( ( "Echo incomplete after %u bytes.", ( unsigned int ) received ) );
+                returnStatus = pdFAIL;
+            }
+        }
+
+        if( ( returnStatus == pdPASS ) && ( memcmp( message, echo, sizeof( message ) ) != 0 ) )
+        {
+            LogError( ( "Echo differs from the message sent." ) );
+            returnStatus = pdFAIL;
+        }
+
+        return returnStatus;
+    }
+/*-----------------------------------------------------------*/
+
+    TlsTransportStatus_t DTLS_FreeRTOS_RebindTest( UBaseType_t priority )
+    {
+        TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
+        TlsStandin_t * pStandin = NULL;
+        NetworkContext_t * pNetworkContext = NULL;
+        NetworkCredentials_t networkCredentials;
+        BaseType_t connected = pdFALSE;
+
+        ( void ) memset( &networkCredentials, 0, sizeof( networkCredentials ) );
+        TLS_Standin_GetCredentials( &networkCredentials );
+
+        /* The network context holds the whole DTLS session, which is too
+         * large for the stack of the task. */
+        pStandin = pvPortMalloc( sizeof( TlsStandin_t ) );
+        pNetworkContext = pvPortMalloc( sizeof( NetworkContext_t ) );
+
+        if( ( pStandin == NULL ) || ( pNetworkContext == NULL ) )
+        {
+            returnStatus = TLS_TRANSPORT_INSUFFICIENT_MEMORY;
+        }
+        else
+        {
+            ( void ) memset( pNetworkContext, 0, sizeof( NetworkContext_t ) );
+            returnStatus = TLS_Standin_Start( pStandin,
+                                              DTLS_TEST_PORT,
+                                              MBEDTLS_SSL_TRANSPORT_DATAGRAM,
+                                              1U,
+                                              priority );
+        }
+
+        if( returnStatus == TLS_TRANSPORT_SUCCESS )
+        {
+            returnStatus = DTLS_FreeRTOS_Connect( pNetworkContext,
+                                                  SOCKETS_LOOPBACK_HOST,
+                                                  DTLS_TEST_PORT,
+                                                  &networkCredentials,
+                                                  DTLS_TEST_TIMEOUT_MS,
+                                                  DTLS_TEST_TIMEOUT_MS );
+
+            if( returnStatus == TLS_TRANSPORT_SUCCESS )
+            {
+                connected = pdTRUE;
+                LogInfo( ( "DTLS test: handshake complete." ) );
+
+                if( exchangeMessage( pNetworkContext, 1U ) != pdPASS )
+                {
+                    returnStatus = TLS_TRANSPORT_INTERNAL_ERROR;
+                }
+            }
+
+            if( returnStatus == TLS_TRANSPORT_SUCCESS )
+            {
+                returnStatus = DTLS_FreeRTOS_Rebind( pNetworkContext,
+                                                     SOCKETS_LOOPBACK_HOST,
+                                                     DTLS_TEST_PORT,
+                                                     DTLS_TEST_TIMEOUT_MS,
+                                                     DTLS_TEST_TIMEOUT_MS );
+            }
+
+            if( returnStatus == TLS_TRANSPORT_SUCCESS )
+            {
+                LogInfo( ( "DTLS test: session moved to a new socket." ) );
+
+                if( exchangeMessage( pNetworkContext, 2U ) != pdPASS )
+                {
+                    returnStatus = TLS_TRANSPORT_INTERNAL_ERROR;
+                }
+            }
+
+            if( connected == pdTRUE )
+            {
+                TLS_FreeRTOS_Disconnect( pNetworkContext );
+            }
+
+            /* The stand-in serves the close_notify before it stops. */
+            TLS_Standin_Stop( pStandin );
+
+            if( ( returnStatus == TLS_TRANSPORT_SUCCESS ) &&
+                ( ( pStandin->handshakes != 1U ) ||
+                  ( pStandin->rebinds != 1U ) ||
+                  ( pStandin->failures != 0U ) ) )
+            {
+                returnStatus = TLS_TRANSPORT_INTERNAL_ERROR;
+            }
+
+            LogInfo( ( "DTLS test: %u handshakes, %u rebinds, %u failed connections on the stand-in.",
+                       ( unsigned int ) pStandin->handshakes,
+                       ( unsigned int ) pStandin->rebinds,
+                       ( unsigned int ) pStandin->failures ) );
+        }
+
+        vPortFree( pNetworkContext );
+        vPortFree( pStandin );
+
+        if( returnStatus == TLS_TRANSPORT_SUCCESS )
+        {
+            LogInfo( ( "DTLS test passed." ) );
+        }
+        else
+        {
+            LogError( ( "DTLS test failed: status=%d.", ( int ) returnStatus ) );
+        }
+
+        return returnStatus;
+    }
+
+#endif /* ifdef DTLS_TRANSPORT_TEST */
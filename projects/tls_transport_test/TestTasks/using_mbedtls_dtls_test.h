@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file using_mbedtls_dtls_test.h
+ * @brief Test of the DTLS transport and of its connection ID rebind.
+ *
+ * Built when DTLS_TRANSPORT_TEST is defined in the mbedtls_config.h of the
+ * test project. A client connects to the DTLS server stand-in of
+ * using_mbedtls_standin.h, exchanges a message, moves the session to a new
+ * socket with DTLS_FreeRTOS_Rebind(), and exchanges another. The test checks that the handshake completes over
+ * datagrams, and that the server finds the session by its connection ID on
+ * the new socket instead of running a new handshake.
+ */
+
+#ifndef USING_MBEDTLS_DTLS_TEST_H
+#define USING_MBEDTLS_DTLS_TEST_H
+
+/* DTLS transport header. */
+#include "using_mbedtls_dtls.h"
+
+#if defined( DTLS_TRANSPORT_TEST ) && !defined( MBEDTLS_SSL_DTLS_CONNECTION_ID )
+    #error "DTLS_TRANSPORT_TEST requires MBEDTLS_SSL_PROTO_DTLS and MBEDTLS_SSL_DTLS_CONNECTION_ID in mbedtls_config.h."
+#endif
+
+/**
+ * @brief Loopback port of the server stand-in of the DTLS test.
+ */
+#ifndef DTLS_TEST_PORT
+    #define DTLS_TEST_PORT    ( 5684U )
+#endif
+
+/**
+ * @brief Connect, rebind and disconnect a DTLS session with a stand-in.
+ *
+ * The function runs the client in the calling task, and returns when the
+ * stand-in has stopped. It logs each step.
+ *
+ * @param[in] priority Priority of the server task.
+ *
+ * @return #TLS_TRANSPORT_SUCCESS if both messages came back, the stand-in ran
+ * one handshake and one rebind, and no connection failed. Otherwise the
+ * status of the step that failed, or #TLS_TRANSPORT_INTERNAL_ERROR.
+ */
+TlsTransportStatus_t DTLS_FreeRTOS_RebindTest( UBaseType_t priority );
+
+#endif /* ifndef USING_MBEDTLS_DTLS_TEST_H */
@@ -0,0 +1,763 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file using_mbedtls_standin.c
+ * @brief TLS server stand-in for the tests of the TLS transport.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Configure logs for the functions in this file. */
+#include "logging_levels.h"
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "TlsStandin"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_INFO
+#endif
+#include "logging_stack.h"
+
+/* Stand-in header. */
+#include "using_mbedtls_standin.h"
+
+/* DTLS transport header, for the retransmission timer. */
+#include "using_mbedtls_dtls.h"
+
+#ifdef TLS_TRANSPORT_STANDIN
+
+/**
+ * @brief Size of the buffer in which a task echoes application data.
+ */
+    #define STANDIN_ECHO_BUFFER_SIZE    ( 256U )
+
+/**
+ * @brief Time for which a DTLS read waits before the task checks that the
+ * socket of the client still exists.
+ */
+    #define STANDIN_DTLS_POLL_MS        ( 500U )
+
+/**
+ * @brief Length of the connection ID the stand-in gives each DTLS session.
+ */
+    #define STANDIN_CID_LENGTH          ( 4U )
+
+/**
+ * @brief Offset of the connection ID in a DTLS 1.2 record that carries one:
+ * after the content type, version, epoch and sequence number.
+ */
+    #define STANDIN_CID_OFFSET          ( 11U )
+
+/**
+ * @brief Pre-shared key of the stand-in.
+ *
+ * It only protects connections that never leave the program, and must not be
+ * given to a real server.
+ */
+    static const uint8_t standinPsk[] =
+    {
+        0x4cU, 0x6fU, 0x6fU, 0x70U, 0x62U, 0x61U, 0x63U, 0x6bU,
+        0x20U, 0x74U, 0x65U, 0x73U, 0x74U, 0x20U, 0x6bU, 0x79U
+    };
+
+/**
+ * @brief PSK identity of the stand-in.
+ */
+    static const char standinPskIdentity[] = "standin";
+
+/**
+ * @brief Server end of a connection, as seen by mbed TLS.
+ */
+    typedef struct StandinConnection
+    {
+        Socket_t socket;       /**< @brief Current socket of the connection. */
+        uint8_t * pPending;    /**< @brief Datagram read from a new socket before mbed TLS, or NULL. */
+        size_t pendingLength;  /**< @brief Length of the pending datagram. */
+        #ifdef MBEDTLS_SSL_PROTO_DTLS
+            DtlsTimer_t timer; /**< @brief Retransmission timer of a DTLS connection. */
+        #endif
+    } StandinConnection_t;
+
+/*-----------------------------------------------------------*/
+
+    #ifdef MBEDTLS_SSL_PROTO_DTLS
+
+/**
+ * @brief Send callback of a DTLS connection.
+ *
+ * @param[in] pContext The #StandinConnection_t.
+ * @param[in] pBuffer Datagram to send.
+ * @param[in] bufferLength Length of the datagram.
+ *
+ * @return Number of bytes sent, or a negative value on error.
+ */
+        static int standinDatagramSend( void * pContext,
+                                        const unsigned char * pBuffer,
+                                        size_t bufferLength );
+
+/**
+ * @brief Receive callback of a DTLS connection. It returns the pending
+ * datagram first, if any.
+ *
+ * @param[in] pContext The #StandinConnection_t.
+ * @param[out] pBuffer Buffer to receive a datagram into.
+ * @param[in] bufferLength Size of the buffer.
+ * @param[in] timeoutMs Time to wait for a datagram, or 0 to keep the receive
+ * timeout of the socket.
+ *
+ * @return Number of bytes received, MBEDTLS_ERR_SSL_TIMEOUT, or a negative
+ * value on error.
+ */
+        static int standinDatagramRecv( void * pContext,
+                                        unsigned char * pBuffer,
+                                        size_t bufferLength,
+                                        uint32_t timeoutMs );
+
+        #ifdef MBEDTLS_SSL_DTLS_CONNECTION_ID
+
+/**
+ * @brief Move a DTLS session whose client closed its socket to the next
+ * connection to the port, if the first record on it carries the connection
+ * ID of the session.
+ *
+ * @param[in] pStandin The stand-in.
+ * @param[in,out] pConnection The connection of the session.
+ * @param[in] pConnectionId Connection ID of the session.
+ *
+ * @return pdPASS if the session moved, pdFAIL otherwise.
+ */
+            static BaseType_t rebindConnection( TlsStandin_t * pStandin,
+                                                StandinConnection_t * pConnection,
+                                                const uint8_t * pConnectionId );
+        #endif
+    #endif /* ifdef MBEDTLS_SSL_PROTO_DTLS */
+
+/**
+ * @brief Run the handshake on a connection, then echo what the client sends
+ * until it closes the connection, and close the socket.
+ *
+ * @param[in] pStandin The stand-in.
+ * @param[in] socket The server end of the connection.
+ *
+ * @return pdPASS if the client closed the connection with a close_notify
+ * alert, pdFAIL otherwise.
+ */
+    static BaseType_t serveConnection( TlsStandin_t * pStandin,
+                                       Socket_t socket );
+
+/**
+ * @brief Task of the stand-in. It serves the connections of the accept queue
+ * one at a time until it receives NULL.
+ *
+ * @param[in] pParameters The stand-in.
+ */
+    static void standinTask( void * pParameters );
+
+/*-----------------------------------------------------------*/
+
+    #ifdef MBEDTLS_SSL_PROTO_DTLS
+
+        static int standinDatagramSend( void * pContext,
+                                        const unsigned char * pBuffer,
+                                        size_t bufferLength )
+        {
+            const StandinConnection_t * pConnection = ( const StandinConnection_t * ) pContext;
+
+            configASSERT( pConnection != NULL );
+
+            return mbedtls_platform_send( ( void * ) pConnection->socket, pBuffer, bufferLength );
+        }
+/*-----------------------------------------------------------*/
+
+        static int standinDatagramRecv( void * pContext,
+                                        unsigned char * pBuffer,
+                                        size_t bufferLength,
+                                        uint32_t timeoutMs )
+        {
+            StandinConnection_t * pConnection = ( StandinConnection_t * ) pContext;
+            int recvStatus = 0;
+
+            configASSERT( pConnection != NULL );
+
+            if( pConnection->pPending != NULL )
+            {
+                /* A datagram that does not fit is truncated, as by a socket. */
+                recvStatus = ( int ) ( ( pConnection->pendingLength < bufferLength ) ?
+                                       pConnection->pendingLength : bufferLength );
+                ( void ) memcpy( pBuffer, pConnection->pPending, ( size_t ) recvStatus );
+
+                vPortFree( pConnection->pPending );
+                pConnection->pPending = NULL;
+                pConnection->pendingLength = 0U;
+            }
+            else
+            {
+                if( timeoutMs != 0U )
+                {
+                    ( void ) Sockets_SetReceiveTimeout( pConnection->socket, timeoutMs );
+                }
+
+                recvStatus = mbedtls_platform_recv( ( void * ) pConnection->socket, pBuffer, bufferLength );
+
+                if( recvStatus == 0 )
+                {
+                    recvStatus = MBEDTLS_ERR_SSL_TIMEOUT;
+                }
+            }
+
+            return recvStatus;
+        }
+/*-----------------------------------------------------------*/
+
+        #ifdef MBEDTLS_SSL_DTLS_CONNECTION_ID
+
+            static BaseType_t rebindConnection( TlsStandin_t * pStandin,
+                                                StandinConnection_t * pConnection,
+                                                const uint8_t * pConnectionId )
+            {
+                Socket_t socket = NULL;
+                uint8_t * pDatagram = NULL;
+                int32_t received = 0;
+                BaseType_t returnStatus = pdFAIL;
+
+                if( xQueueReceive( pStandin->acceptQueue,
+                                   &socket,
+                                   pdMS_TO_TICKS( TLS_STANDIN_RECV_TIMEOUT_MS ) ) != pdPASS )
+                {
+                    LogError( ( "The client closed its socket and did not rebind." ) );
+                }
+                else if( socket == NULL )
+                {
+                    /* The stand-in is stopping. Leave the item to the task
+                     * loop; the queue has room, since the item was just
+                     * taken from it. */
+                    ( void ) xQueueSendToFront( pStandin->acceptQueue, &socket, 0U );
+                }
+                else
+                {
+                    pDatagram = pvPortMalloc( DTLS_TRANSPORT_MTU );
+
+                    if( pDatagram == NULL )
+                    {
+                        LogError( ( "Failed to allocate a datagram to rebind the session." ) );
+                    }
+                    else
+                    {
+                        ( void ) Sockets_SetReceiveTimeout( socket, TLS_STANDIN_RECV_TIMEOUT_MS );
+                        received = Sockets_Recv( socket, pDatagram, DTLS_TRANSPORT_MTU );
+
+                        if( ( received > ( int32_t ) ( STANDIN_CID_OFFSET + STANDIN_CID_LENGTH ) ) &&
+                            ( pDatagram[ 0 ] == ( uint8_t ) MBEDTLS_SSL_MSG_CID ) &&
+                            ( memcmp( &( pDatagram[ STANDIN_CID_OFFSET ] ),
+                                      pConnectionId,
+                                      STANDIN_CID_LENGTH ) == 0 ) )
+                        {
+                            returnStatus = pdPASS;
+                        }
+                        else
+                        {
+                            LogError( ( "The first record on the new socket does not carry the connection ID of the session." ) );
+                        }
+                    }
+                }
+
+                if( returnStatus == pdPASS )
+                {
+                    /* mbed TLS reads the datagram first, and authenticates
+                     * it with the keys of the session. */
+                    Sockets_Disconnect( pConnection->socket );
+                    pConnection->socket = socket;
+                    pConnection->pPending = pDatagram;
+                    pConnection->pendingLength = ( size_t ) received;
+
+                    taskENTER_CRITICAL();
+                    {
+                        pStandin->rebinds++;
+                    }
+                    taskEXIT_CRITICAL();
+
+                    LogInfo( ( "DTLS session moved to a new socket by its connection ID." ) );
+                }
+                else
+                {
+                    if( pDatagram != NULL )
+                    {
+                        vPortFree( pDatagram );
+                    }
+
+                    if( socket != NULL )
+                    {
+                        Sockets_Disconnect( socket );
+                    }
+                }
+
+                return returnStatus;
+            }
+/*-----------------------------------------------------------*/
+
+        #endif /* ifdef MBEDTLS_SSL_DTLS_CONNECTION_ID */
+    #endif /* ifdef MBEDTLS_SSL_PROTO_DTLS */
+
+    static BaseType_t serveConnection( TlsStandin_t * pStandin,
+                                       Socket_t socket )
+    {
+        mbedtls_ssl_context context;
+        StandinConnection_t connection;
+        uint8_t buffer[ STANDIN_ECHO_BUFFER_SIZE ];
+        BaseType_t returnStatus = pdPASS;
+        int mbedtlsError = 0;
+        int received = 0;
+        int sent = 0;
+        uint32_t idleMs = 0U;
+
+        #ifdef MBEDTLS_SSL_DTLS_CONNECTION_ID
+            uint8_t connectionId[ STANDIN_CID_LENGTH ];
+        #endif
+
+        mbedtls_ssl_init( &context );
+        ( void ) memset( &connection, 0, sizeof( connection ) );
+        connection.socket = socket;
+
+        ( void ) Sockets_SetReceiveTimeout( socket, TLS_STANDIN_RECV_TIMEOUT_MS );
+
+        mbedtlsError = mbedtls_ssl_setup( &context, &( pStandin->config ) );
+
+        if( mbedtlsError != 0 )
+        {
+            LogError( ( "Failed to set up the server context: mbedTLSError= -0x%04X.",
+                        ( unsigned int ) -mbedtlsError ) );
+            returnStatus = pdFAIL;
+        }
+        else if( pStandin->transport == MBEDTLS_SSL_TRANSPORT_STREAM )
+        {
+            mbedtls_ssl_set_bio( &context,
+                                 ( void * ) socket,
+                                 mbedtls_platform_send,
+                                 mbedtls_platform_recv,
+                                 NULL );
+        }
+        else
+        {
+            #ifdef MBEDTLS_SSL_PROTO_DTLS
+                mbedtls_ssl_set_bio( &context,
+                                     &connection,
+                                     standinDatagramSend,
+                                     NULL,
+                                     standinDatagramRecv );
+                mbedtls_ssl_set_timer_cb( &context,
+                                          &( connection.timer ),
+                                          DTLS_FreeRTOS_SetDelay,
+                                          DTLS_FreeRTOS_GetDelay );
+                mbedtls_ssl_set_mtu( &context, ( uint16_t ) DTLS_TRANSPORT_MTU );
+
+                #ifdef MBEDTLS_SSL_DTLS_CONNECTION_ID
+                    mbedtlsError = mbedtls_ctr_drbg_random( &( pStandin->ctrDrgbContext ),
+                                                            connectionId,
+                                                            sizeof( connectionId ) );
+
+                    if( mbedtlsError == 0 )
+                    {
+                        mbedtlsError = mbedtls_ssl_set_cid( &context,
+                                                            MBEDTLS_SSL_CID_ENABLED,
+                                                            connectionId,
+                                                            sizeof( connectionId ) );
+                    }
+
+                    if( mbedtlsError != 0 )
+                    {
+                        LogError( ( "Failed to set the connection ID of the session: mbedTLSError= -0x%04X.",
+                                    ( unsigned int ) -mbedtlsError ) );
+                        returnStatus = pdFAIL;
+                    }
+                #endif /* ifdef MBEDTLS_SSL_DTLS_CONNECTION_ID */
+            #endif /* ifdef MBEDTLS_SSL_PROTO_DTLS */
+        }
+
+        if( returnStatus == pdPASS )
+        {
+            do
+            {
+                mbedtlsError = mbedtls_ssl_handshake( &context );
+            } while( ( mbedtlsError == MBEDTLS_ERR_SSL_WANT_READ ) ||
+                     ( mbedtlsError == MBEDTLS_ERR_SSL_WANT_WRITE ) );
+
+            if( mbedtlsError != 0 )
+            {
+                LogError( ( "Server handshake failed: mbedTLSError= -0x%04X.",
+                            ( unsigned int ) -mbedtlsError ) );
+                returnStatus = pdFAIL;
+            }
+            else
+            {
+                taskENTER_CRITICAL();
+                {
+                    pStandin->handshakes++;
+                }
+                taskEXIT_CRITICAL();
+            }
+        }
+
+        /* Echo each read back in full. A read returns at most one record. */
+        while( ( returnStatus == pdPASS ) && ( mbedtlsError == 0 ) )
+        {
+            received = mbedtls_ssl_read( &context, buffer, sizeof( buffer ) );
+
+            if( received > 0 )
+            {
+                sent = 0;
+                idleMs = 0U;
+
+                while( ( sent < received ) && ( mbedtlsError == 0 ) )
+                {
+                    mbedtlsError = mbedtls_ssl_write( &context,
+                                                      &( buffer[ sent ] ),
+                                                      ( size_t ) ( received - sent ) );
+
+                    if( mbedtlsError > 0 )
+                    {
+                        sent += mbedtlsError;
+                        mbedtlsError = 0;
+                    }
+                    else if( ( mbedtlsError == MBEDTLS_ERR_SSL_WANT_READ ) ||
+                             ( mbedtlsError == MBEDTLS_ERR_SSL_WANT_WRITE ) )
+                    {
+                        mbedtlsError = 0;
+                    }
+                    else
+                    {
+                        LogError( ( "Server write failed: mbedTLSError= -0x%04X.",
+                                    ( unsigned int ) -mbedtlsError ) );
+                        returnStatus = pdFAIL;
+                    }
+                }
+            }
+            else if( received == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY )
+            {
+                ( void ) mbedtls_ssl_close_notify( &context );
+
+                /* Leave the loop. */
+                mbedtlsError = received;
+            }
+            else if( ( received == MBEDTLS_ERR_SSL_WANT_READ ) ||
+                     ( received == MBEDTLS_ERR_SSL_WANT_WRITE ) )
+            {
+                /* Nothing to echo yet. */
+            }
+            else if( received == MBEDTLS_ERR_SSL_TIMEOUT )
+            {
+                /* A DTLS read returns at each poll, so that a closed socket
+                 * is noticed quickly. */
+                idleMs += STANDIN_DTLS_POLL_MS;
+
+                if( idleMs >= TLS_STANDIN_RECV_TIMEOUT_MS )
+                {
+                    LogError( ( "The client sent nothing for %u ms.", ( unsigned int ) idleMs ) );
+                    returnStatus = pdFAIL;
+                }
+            }
+
+            #if defined( MBEDTLS_SSL_PROTO_DTLS ) && defined( MBEDTLS_SSL_DTLS_CONNECTION_ID )
+                else if( ( pStandin->transport == MBEDTLS_SSL_TRANSPORT_DATAGRAM ) &&
+                         ( received == SOCKETS_SOCKET_ERROR ) )
+                {
+                    /* The client closed its socket. */
+                    returnStatus = rebindConnection( pStandin, &connection, connectionId );
+                    idleMs = 0U;
+                }
+            #endif
+            else
+            {
+                LogError( ( "Server read failed: mbedTLSError= -0x%04X.",
+                            ( unsigned int ) -received ) );
+                returnStatus = pdFAIL;
+            }
+        }
+
+        mbedtls_ssl_free( &context );
+
+        if( connection.pPending != NULL )
+        {
+            vPortFree( connection.pPending );
+        }
+
+        Sockets_Disconnect( connection.socket );
+
+        return returnStatus;
+    }
+/*-----------------------------------------------------------*/
+
+    static void standinTask( void * pParameters )
+    {
+        TlsStandin_t * pStandin = ( TlsStandin_t * ) pParameters;
+        Socket_t socket = NULL;
+        BaseType_t running = pdTRUE;
+
+        configASSERT( pStandin != NULL );
+
+        while( running == pdTRUE )
+        {
+            ( void ) xQueueReceive( pStandin->acceptQueue, &socket, portMAX_DELAY );
+
+            if( socket == NULL )
+            {
+                running = pdFALSE;
+            }
+            else if( serveConnection( pStandin, socket ) != pdPASS )
+            {
+                taskENTER_CRITICAL();
+                {
+                    pStandin->failures++;
+                }
+                taskEXIT_CRITICAL();
+            }
+            else
+            {
+                /* Empty else for MISRA 15.7 compliance. */
+            }
+        }
+
+        ( void ) xSemaphoreGive( pStandin->stoppedSemaphore );
+        vTaskDelete( NULL );
+    }
+/*-----------------------------------------------------------*/
+
+    TlsTransportStatus_t TLS_Standin_Start( TlsStandin_t * pStandin,
+                                            uint16_t port,
+                                            int32_t transport,
+                                            UBaseType_t taskCount,
+                                            UBaseType_t priority )
+    {
+        TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
+        int mbedtlsError = 0;
+
+        configASSERT( pStandin != NULL );
+        configASSERT( taskCount > 0U );
+
+        #ifdef MBEDTLS_SSL_PROTO_DTLS
+            configASSERT( ( transport == MBEDTLS_SSL_TRANSPORT_STREAM ) || ( taskCount == 1U ) );
+        #else
+            configASSERT( transport == MBEDTLS_SSL_TRANSPORT_STREAM );
+        #endif
+
+        ( void ) memset( pStandin, 0, sizeof( TlsStandin_t ) );
+        pStandin->port = port;
+        pStandin->transport = transport;
+
+        /* The configuration and random number generator are shared by the
+         * tasks, so the mbed TLS mutexes must exist before they are
+         * initialized. */
+        TLS_FreeRTOS_InitThreading();
+
+        mbedtls_entropy_init( &( pStandin->entropyContext ) );
+        mbedtls_ctr_drbg_init( &( pStandin->ctrDrgbContext ) );
+        mbedtls_ssl_config_init( &( pStandin->config ) );
+
+        mbedtlsError = mbedtls_entropy_add_source( &( pStandin->entropyContext ),
+                                                   mbedtls_platform_entropy_poll,
+                                                   NULL,
+                                                   32,
+                                                   MBEDTLS_ENTROPY_SOURCE_STRONG );
+
+        if( mbedtlsError == 0 )
+        {
+            mbedtlsError = mbedtls_ctr_drbg_seed( &( pStandin->ctrDrgbContext ),
+                                                  mbedtls_entropy_func,
+                                                  &( pStandin->entropyContext ),
+                                                  NULL,
+                                                  0 );
+        }
+
+        if( mbedtlsError == 0 )
+        {
+            mbedtlsError = mbedtls_ssl_config_defaults( &( pStandin->config ),
+                                                        MBEDTLS_SSL_IS_SERVER,
+                                                        transport,
+                                                        MBEDTLS_SSL_PRESET_DEFAULT );
+        }
+
+        if( mbedtlsError == 0 )
+        {
+            mbedtls_ssl_conf_rng( &( pStandin->config ),
+                                  mbedtls_ctr_drbg_random,
+                                  &( pStandin->ctrDrgbContext ) );
+
+            mbedtlsError = mbedtls_ssl_conf_psk( &( pStandin->config ),
+                                                 standinPsk,
+                                                 sizeof( standinPsk ),
+                                                 ( const unsigned char * ) standinPskIdentity,
+                                                 strlen( standinPskIdentity ) );
+        }
+
+        #ifdef MBEDTLS_SSL_PROTO_DTLS
+            if( ( mbedtlsError == 0 ) && ( transport == MBEDTLS_SSL_TRANSPORT_DATAGRAM ) )
+            {
+                #ifdef MBEDTLS_SSL_DTLS_HELLO_VERIFY
+                    /* A loopback client cannot spoof its address, so skip the
+                     * cookie exchange. */
+                    mbedtls_ssl_conf_dtls_cookies( &( pStandin->config ), NULL, NULL, NULL );
+                #endif
+
+                mbedtls_ssl_conf_handshake_timeout( &( pStandin->config ),
+                                                    DTLS_TRANSPORT_HANDSHAKE_TIMEOUT_MIN_MS,
+                                                    DTLS_TRANSPORT_HANDSHAKE_TIMEOUT_MAX_MS );
+                mbedtls_ssl_conf_read_timeout( &( pStandin->config ), STANDIN_DTLS_POLL_MS );
+
+                #ifdef MBEDTLS_SSL_DTLS_CONNECTION_ID
+                    mbedtlsError = mbedtls_ssl_conf_cid( &( pStandin->config ),
+                                                         STANDIN_CID_LENGTH,
+                                                         MBEDTLS_SSL_UNEXPECTED_CID_IGNORE );
+                #endif
+            }
+        #endif /* ifdef MBEDTLS_SSL_PROTO_DTLS */
+
+        if( mbedtlsError != 0 )
+        {
+            LogError( ( "Failed to configure the server: mbedTLSError= -0x%04X.",
+                        ( unsigned int ) -mbedtlsError ) );
+            returnStatus = TLS_TRANSPORT_INTERNAL_ERROR;
+        }
+
+        if( returnStatus == TLS_TRANSPORT_SUCCESS )
+        {
+            pStandin->acceptQueue = xQueueCreate( taskCount, sizeof( Socket_t ) );
+            pStandin->stoppedSemaphore = xSemaphoreCreateCounting( taskCount, 0U );
+
+            if( ( pStandin->acceptQueue == NULL ) || ( pStandin->stoppedSemaphore == NULL ) )
+            {
+                returnStatus = TLS_TRANSPORT_INSUFFICIENT_MEMORY;
+            }
+        }
+
+        if( returnStatus == TLS_TRANSPORT_SUCCESS )
+        {
+            if( Sockets_LoopbackListen( port, pStandin->acceptQueue ) != SOCKETS_ERROR_NONE )
+            {
+                LogError( ( "Failed to listen on loopback port %u.", ( unsigned int ) port ) );
+                returnStatus = TLS_TRANSPORT_INTERNAL_ERROR;
+            }
+            else
+            {
+                pStandin->listening = pdTRUE;
+            }
+        }
+
+        while( ( returnStatus == TLS_TRANSPORT_SUCCESS ) && ( pStandin->taskCount < taskCount ) )
+        {
+            if( xTaskCreate( standinTask,
+                             "TlsStandin",
+                             TLS_STANDIN_TASK_STACK_SIZE,
+                             pStandin,
+                             priority,
+                             NULL ) == pdPASS )
+            {
+                pStandin->taskCount++;
+            }
+            else
+            {
+                returnStatus = TLS_TRANSPORT_INSUFFICIENT_MEMORY;
+            }
+        }
+
+        if( returnStatus != TLS_TRANSPORT_SUCCESS )
+        {
+            TLS_Standin_Stop( pStandin );
+        }
+        else
+        {
+            LogInfo( ( "Server stand-in listening on loopback port %u with %u %s tasks.",
+                       ( unsigned int ) port,
+                       ( unsigned int ) taskCount,
+                       ( transport == MBEDTLS_SSL_TRANSPORT_STREAM ) ? "TLS" : "DTLS" ) );
+        }
+
+        return returnStatus;
+    }
+/*-----------------------------------------------------------*/
+
+    void TLS_Standin_Stop( TlsStandin_t * pStandin )
+    {
+        Socket_t stopSocket = NULL;
+        UBaseType_t i = 0U;
+
+        configASSERT( pStandin != NULL );
+
+        if( pStandin->listening == pdTRUE )
+        {
+            /* Refuse new connections. Those already queued are served before
+             * the tasks see the NULL items behind them. */
+            ( void ) Sockets_LoopbackListen( pStandin->port, NULL );
+            pStandin->listening = pdFALSE;
+        }
+
+        if( pStandin->acceptQueue != NULL )
+        {
+            for( i = 0U; i < pStandin->taskCount; i++ )
+            {
+                ( void ) xQueueSend( pStandin->acceptQueue, &stopSocket, portMAX_DELAY );
+            }
+
+            for( i = 0U; i < pStandin->taskCount; i++ )
+            {
+                ( void ) xSemaphoreTake( pStandin->stoppedSemaphore, portMAX_DELAY );
+            }
+
+            vQueueDelete( pStandin->acceptQueue );
+            pStandin->acceptQueue = NULL;
+        }
+
+        if( pStandin->stoppedSemaphore != NULL )
+        {
+            vSemaphoreDelete( pStandin->stoppedSemaphore );
+            pStandin->stoppedSemaphore = NULL;
+        }
+
+        pStandin->taskCount = 0U;
+
+        mbedtls_ssl_config_free( &( pStandin->config ) );
+        mbedtls_ctr_drbg_free( &( pStandin->ctrDrgbContext ) );
+        mbedtls_entropy_free( &( pStandin->entropyContext ) );
+
+        LogInfo( ( "Server stand-in stopped after %u handshakes, %u rebinds and %u failed connections.",
+                   ( unsigned int ) pStandin->handshakes,
+                   ( unsigned int ) pStandin->rebinds,
+                   ( unsigned int ) pStandin->failures ) );
+    }
+/*-----------------------------------------------------------*/
+
+    void TLS_Standin_GetCredentials( NetworkCredentials_t * pNetworkCredentials )
+    {
+        configASSERT( pNetworkCredentials != NULL );
+
+        pNetworkCredentials->pPsk = standinPsk;
+        pNetworkCredentials->pskSize = sizeof( standinPsk );
+        pNetworkCredentials->pPskIdentity = ( const uint8_t * ) standinPskIdentity;
+        pNetworkCredentials->pskIdentitySize = strlen( standinPskIdentity );
+        pNetworkCredentials->pskEcdhe = pdFALSE;
+        pNetworkCredentials->disableSni = pdTRUE;
+    }
+
+#endif /* ifdef TLS_TRANSPORT_STANDIN */
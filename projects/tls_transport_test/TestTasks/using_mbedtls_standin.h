@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file using_mbedtls_standin.h
+ * @brief TLS server stand-in for the tests of the TLS transport.
+ *
+ * Built when TLS_TRANSPORT_STANDIN is defined, which the mbedtls_config.h of
+ * the test project does for each transport test. The stand-in listens on a
+ * port of the loopback of sockets_loopback.c and runs an mbed TLS server in tasks of the same program,
+ * so that the transport can be tested without a network. It authenticates
+ * with a pre-shared key, so that no certificate has to be shipped, and echoes
+ * the application data it receives.
+ *
+ * Over DTLS, the stand-in gives each session a connection ID. When the client
+ * closes its socket, as DTLS_FreeRTOS_Rebind() does, the session continues on
+ * the next connection to the port if its first record carries that ID, as a
+ * server would find the session of a client whose address changed.
+ */
+
+#ifndef USING_MBEDTLS_STANDIN_H
+#define USING_MBEDTLS_STANDIN_H
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "semphr.h"
+
+/* TLS transport header. */
+#include "using_mbedtls.h"
+
+/* Loopback sockets of the test project. */
+#include "sockets_loopback.h"
+
+/**
+ * @brief Time after which the stand-in drops a connection on which the client
+ * sends nothing.
+ */
+#ifndef TLS_STANDIN_RECV_TIMEOUT_MS
+    #define TLS_STANDIN_RECV_TIMEOUT_MS    ( 10000U )
+#endif
+
+/**
+ * @brief Stack size of each task of the stand-in.
+ */
+#ifndef TLS_STANDIN_TASK_STACK_SIZE
+    #define TLS_STANDIN_TASK_STACK_SIZE    ( configMINIMAL_STACK_SIZE * 8U )
+#endif
+
+/**
+ * @brief A server stand-in. Each task serves one connection at a time.
+ */
+typedef struct TlsStandin
+{
+    mbedtls_entropy_context entropyContext;  /**< @brief Entropy of the server. */
+    mbedtls_ctr_drbg_context ctrDrgbContext; /**< @brief Random numbers of the server. */
+    mbedtls_ssl_config config;               /**< @brief Configuration shared by the connections. */
+    QueueHandle_t acceptQueue;               /**< @brief Server ends of new connections. */
+    SemaphoreHandle_t stoppedSemaphore;      /**< @brief Given by each task when it stops. */
+    UBaseType_t taskCount;                   /**< @brief Number of running tasks. */
+    uint16_t port;                           /**< @brief Loopback port of the stand-in. */
+    int32_t transport;                       /**< @brief MBEDTLS_SSL_TRANSPORT_STREAM or MBEDTLS_SSL_TRANSPORT_DATAGRAM. */
+    BaseType_t listening;                    /**< @brief Whether the port was claimed. */
+    uint32_t handshakes;                     /**< @brief Handshakes completed. */
+    uint32_t rebinds;                        /**< @brief DTLS sessions moved to a new socket. */
+    uint32_t failures;                       /**< @brief Connections that ended with an error. */
+} TlsStandin_t;
+
+/**
+ * @brief Start a server stand-in on a loopback port.
+ *
+ * @param[out] pStandin The stand-in.
+ * @param[in] port Loopback port to listen on.
+ * @param[in] transport MBEDTLS_SSL_TRANSPORT_STREAM for TLS, or
+ * MBEDTLS_SSL_TRANSPORT_DATAGRAM for DTLS, which requires
+ * MBEDTLS_SSL_PROTO_DTLS.
+ * @param[in] taskCount Number of connections served at the same time. Must be
+ * 1 for DTLS, so that a session waiting for its client to rebind is the only
+ * reader of the new connections.
+ * @param[in] priority Priority of the tasks.
+ *
+ * @return #TLS_TRANSPORT_SUCCESS, #TLS_TRANSPORT_INSUFFICIENT_MEMORY or
+ * #TLS_TRANSPORT_INTERNAL_ERROR. On failure, nothing is left running.
+ */
+TlsTransportStatus_t TLS_Standin_Start( TlsStandin_t * pStandin,
+                                        uint16_t port,
+                                        int32_t transport,
+                                        UBaseType_t taskCount,
+                                        UBaseType_t priority );
+
+/**
+ * @brief Stop listening, wait for the connections in progress to end, and
+ * release the stand-in.
+ *
+ * @param[in] pStandin A stand-in started by #TLS_Standin_Start.
+ */
+void TLS_Standin_Stop( TlsStandin_t * pStandin );
+
+/**
+ * @brief Fill in the credentials with which a client connects to the
+ * stand-in: its pre-shared key and identity, without SNI.
+ *
+ * @param[out] pNetworkCredentials The credentials. Other members are left
+ * unchanged.
+ */
+void TLS_Standin_GetCredentials( NetworkCredentials_t * pNetworkCredentials );
+
+#endif /* ifndef USING_MBEDTLS_STANDIN_H */
@@ -0,0 +1,339 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file using_mbedtls_stress.c
+ * @brief Stress test of concurrent connections of the TLS transport.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+/* Configure logs for the functions in this file. */
+#include "logging_levels.h"
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "TlsStress"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_INFO
+#endif
+#include "logging_stack.h"
+
+/* Stress test headers. */
+#include "using_mbedtls_stress.h"
+#include "using_mbedtls_standin.h"
+
+#ifdef TLS_TRANSPORT_STRESS_TEST
+
+/**
+ * @brief Receive and send timeout of the client connections.
+ */
+    #define STRESS_TIMEOUT_MS           ( 5000U )
+
+/**
+ * @brief Size of the message that each connection sends and reads back.
+ */
+    #define STRESS_MESSAGE_SIZE         ( 64U )
+
+/**
+ * @brief Reads that may time out before the echo of a message is complete.
+ */
+    #define STRESS_MAX_EMPTY_READS      ( 3U )
+
+/**
+ * @brief Time given to the idle task to free the stacks of deleted tasks
+ * before the free heap is measured.
+ */
+    #define STRESS_SETTLE_DELAY_MS      ( 100U )
+
+/**
+ * @brief State shared by the client tasks of a stress test.
+ */
+    typedef struct StressRun
+    {
+        SemaphoreHandle_t doneSemaphore; /**< @brief Given by each client task when it is done. */
+        uint32_t connectionsPerTask;     /**< @brief Connections made by each task. */
+        uint32_t connections;            /**< @brief Connections that succeeded. */
+        uint32_t failures;               /**< @brief Connections that failed. */
+    } StressRun_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Connect to the stand-in, send a message that depends on the task and
+ * connection, read it back, and disconnect.
+ *
+ * @param[in] pNetworkContext Network context of the task.
+ * @param[in] pNetworkCredentials Credentials of the stand-in.
+ * @param[in] seed Value from which the message is made.
+ *
+ * @return pdPASS if the message came back unchanged, pdFAIL otherwise.
+ */
+    static BaseType_t stressConnection( NetworkContext_t * pNetworkContext,
+                                        const NetworkCredentials_t * pNetworkCredentials,
+                                        uint32_t seed );
+
+/**
+ * @brief Client task of the stress test.
+ *
+ * @param[in] pParameters The #StressRun_t of the test.
+ */
+    static void stressTask( void * pParameters );
+
+/*-----------------------------------------------------------*/
+
+    static BaseType_t stressConnection( NetworkContext_t * pNetworkContext,
+                                        const NetworkCredentials_t * pNetworkCredentials,
+                                        uint32_t seed )
+    {
+        uint8_t message[ STRESS_MESSAGE_SIZE ];
+        uint8_t echo[ STRESS_MESSAGE_SIZE ];
+        BaseType_t returnStatus = pdPASS;
+        int32_t transferred = 0;
+        size_t received = 0U;
+        uint32_t emptyReads = 0U;
+        size_t i = 0U;
+
+        for( i = 0U; i < sizeof( message ); i++ )
+        {
+            message[ i ] = ( uint8_t ) ( seed + ( i * 31U ) );
+        }
+
+        if( TLS_FreeRTOS_Connect( pNetworkContext,
+                                  SOCKETS_LOOPBACK_HOST,
+                                  TLS_STRESS_PORT,
+                                  pNetworkCredentials,
+                                  STRESS_TIMEOUT_MS,
+                                  STRESS_TIMEOUT_MS ) != TLS_TRANSPORT_SUCCESS )
+        {
+            returnStatus = pdFAIL;
+        }
+        else
+        {
+            transferred = TLS_FreeRTOS_send( pNetworkContext, message, sizeof( message ) );
+
+            if( transferred != ( int32_t ) sizeof( message ) )
+            {
+                LogError( ( "Sent %d of %u bytes.", ( int ) transferred, ( unsigned int ) sizeof( message ) ) );
+                returnStatus = pdFAIL;
+            }
+
+            while( ( returnStatus == pdPASS ) && ( received < sizeof( echo ) ) )
+            {
+                transferred = TLS_FreeRTOS_recv( pNetworkContext,
+                                                 &( echo[ received ] ),
+                                                 sizeof( echo ) - received );
+
+                if( transferred > 0 )
+                {
+                    received += ( size_t ) transferred;
+                }
+                else if( ( transferred == 0 ) && ( emptyReads < STRESS_MAX_EMPTY_READS ) )
+                {
+                    emptyReads++;
+                }
+                else
+                {
+                    LogError( ( "Echo incomplete after %u bytes.", ( unsigned int ) received ) );
+                    returnStatus = pdFAIL;
+                }
+            }
+
+            if( ( returnStatus == pdPASS ) && ( memcmp( message, echo, sizeof( message ) ) != 0 ) )
+            {
+                LogError( ( "Echo differs from the message sent." ) );
+                returnStatus = pdFAIL;
+            }
+
+            TLS_FreeRTOS_Disconnect( pNetworkContext );
+        }
+
+        return returnStatus;
+    }
+/*-----------------------------------------------------------*/
+
+    static void stressTask( void * pParameters )
+    {
+        StressRun_t * pRun = ( StressRun_t * ) pParameters;
+        NetworkCredentials_t networkCredentials;
+        NetworkContext_t * pNetworkContext = NULL;
+        uint32_t seed = ( uint32_t ) ( uintptr_t ) xTaskGetCurrentTaskHandle();
+        uint32_t connections = 0U;
+        uint32_t failures = 0U;
+        uint32_t i = 0U;
+
+        configASSERT( pRun != NULL );
+
+        ( void ) memset( &networkCredentials, 0, sizeof( networkCredentials ) );
+        TLS_Standin_GetCredentials( &networkCredentials );
+
+        /* The network context holds the whole TLS session, which is too large
+         * for the stack of the task. */
+        pNetworkContext = pvPortMalloc( sizeof( NetworkContext_t ) );
+
+        for( i = 0U; i < pRun->connectionsPerTask; i++ )
+        {
+            if( pNetworkContext == NULL )
+            {
+                failures++;
+            }
+            else
+            {
+                ( void ) memset( pNetworkContext, 0, sizeof( NetworkContext_t ) );
+
+                if( stressConnection( pNetworkContext, &networkCredentials, seed + i ) == pdPASS )
+                {
+                    connections++;
+                }
+                else
+                {
+                    failures++;
+                }
+            }
+        }
+
+        vPortFree( pNetworkContext );
+
+        taskENTER_CRITICAL();
+        {
+            pRun->connections += connections;
+            pRun->failures += failures;
+        }
+        taskEXIT_CRITICAL();
+
+        ( void ) xSemaphoreGive( pRun->doneSemaphore );
+        vTaskDelete( NULL );
+    }
+/*-----------------------------------------------------------*/
+
+    TlsTransportStatus_t TLS_FreeRTOS_StressTest( UBaseType_t taskCount,
+                                                  uint32_t connectionsPerTask,
+                                                  UBaseType_t priority,
+                                                  TlsStressResult_t * pResult )
+    {
+        TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
+        TlsStandin_t * pStandin = NULL;
+        StressRun_t run;
+        size_t freeHeapBefore = 0U;
+        TickType_t startTicks = 0U;
+        UBaseType_t started = 0U;
+        UBaseType_t i = 0U;
+
+        configASSERT( pResult != NULL );
+        configASSERT( taskCount > 0U );
+
+        ( void ) memset( pResult, 0, sizeof( TlsStressResult_t ) );
+        ( void ) memset( &run, 0, sizeof( run ) );
+        run.connectionsPerTask = connectionsPerTask;
+
+        /* Let the idle task free the stacks of tasks deleted earlier, so that
+         * they do not count as heap given back by the test. */
+        vTaskDelay( pdMS_TO_TICKS( STRESS_SETTLE_DELAY_MS ) );
+        freeHeapBefore = xPortGetFreeHeapSize();
+        startTicks = xTaskGetTickCount();
+
+        pStandin = pvPortMalloc( sizeof( TlsStandin_t ) );
+        run.doneSemaphore = xSemaphoreCreateCounting( taskCount, 0U );
+
+        if( ( pStandin == NULL ) || ( run.doneSemaphore == NULL ) )
+        {
+            returnStatus = TLS_TRANSPORT_INSUFFICIENT_MEMORY;
+        }
+        else
+        {
+            returnStatus = TLS_Standin_Start( pStandin,
+                                              TLS_STRESS_PORT,
+                                              MBEDTLS_SSL_TRANSPORT_STREAM,
+                                              taskCount,
+                                              priority );
+        }
+
+        if( returnStatus == TLS_TRANSPORT_SUCCESS )
+        {
+            LogInfo( ( "Stress test: %u tasks make %u connections each.",
+                       ( unsigned int ) taskCount,
+                       ( unsigned int ) connectionsPerTask ) );
+
+            while( ( started < taskCount ) &&
+                   ( xTaskCreate( stressTask,
+                                  "TlsStress",
+                                  TLS_STRESS_TASK_STACK_SIZE,
+                                  &run,
+                                  priority,
+                                  NULL ) == pdPASS ) )
+            {
+                started++;
+            }
+
+            if( started < taskCount )
+            {
+                LogError( ( "Created %u of %u client tasks.",
+                            ( unsigned int ) started,
+                            ( unsigned int ) taskCount ) );
+                returnStatus = TLS_TRANSPORT_INSUFFICIENT_MEMORY;
+            }
+
+            for( i = 0U; i < started; i++ )
+            {
+                ( void ) xSemaphoreTake( run.doneSemaphore, portMAX_DELAY );
+            }
+
+            TLS_Standin_Stop( pStandin );
+            pResult->failures = pStandin->failures;
+        }
+
+        pResult->connections = run.connections;
+        pResult->failures += run.failures;
+        pResult->elapsedMs = ( uint32_t ) ( ( ( uint64_t ) ( xTaskGetTickCount() - startTicks ) * 1000U ) / configTICK_RATE_HZ );
+
+        if( run.doneSemaphore != NULL )
+        {
+            vSemaphoreDelete( run.doneSemaphore );
+        }
+
+        vPortFree( pStandin );
+
+        /* The client and server tasks have deleted themselves. */
+        vTaskDelay( pdMS_TO_TICKS( STRESS_SETTLE_DELAY_MS ) );
+        pResult->heapDelta = ( int32_t ) xPortGetFreeHeapSize() - ( int32_t ) freeHeapBefore;
+
+        LogInfo( ( "Stress test: %u connections, %u failures in %u ms. Free heap changed by %d bytes.",
+                   ( unsigned int ) pResult->connections,
+                   ( unsigned int ) pResult->failures,
+                   ( unsigned int ) pResult->elapsedMs,
+                   ( int ) pResult->heapDelta ) );
+
+        if( ( returnStatus == TLS_TRANSPORT_SUCCESS ) &&
+            ( ( pResult->failures != 0U ) || ( pResult->heapDelta != 0 ) ) )
+        {
+            returnStatus = TLS_TRANSPORT_INTERNAL_ERROR;
+        }
+
+        return returnStatus;
+    }
+
+#endif /* ifdef TLS_TRANSPORT_STRESS_TEST */
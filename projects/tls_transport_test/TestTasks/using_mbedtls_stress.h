@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file using_mbedtls_stress.h
+ * @brief Stress test of concurrent connections of the TLS transport.
+ *
+ * Built when TLS_TRANSPORT_STRESS_TEST is defined in the mbedtls_config.h of
+ * the test project. Several tasks connect to the server stand-in of
+ * using_mbedtls_standin.h at the same time, exchange a message, and
+ * disconnect, over and over. The test checks that connections in different
+ * tasks do not share state, that the shared parts of mbed TLS are set up once,
+ * and that no heap is lost.
+ */
+
+#ifndef USING_MBEDTLS_STRESS_H
+#define USING_MBEDTLS_STRESS_H
+
+/* TLS transport header. */
+#include "using_mbedtls.h"
+
+/**
+ * @brief Loopback port of the server stand-in of the stress test.
+ */
+#ifndef TLS_STRESS_PORT
+    #define TLS_STRESS_PORT    ( 8883U )
+#endif
+
+/**
+ * @brief Stack size of each client task.
+ */
+#ifndef TLS_STRESS_TASK_STACK_SIZE
+    #define TLS_STRESS_TASK_STACK_SIZE    ( configMINIMAL_STACK_SIZE * 8U )
+#endif
+
+/**
+ * @brief Result of a stress test.
+ */
+typedef struct TlsStressResult
+{
+    uint32_t connections; /**< @brief Connections that exchanged their message and closed cleanly. */
+    uint32_t failures;    /**< @brief Connections that failed, on either side. */
+    uint32_t elapsedMs;   /**< @brief Duration of the test. */
+    int32_t heapDelta;    /**< @brief Free heap after the test minus free heap before it. */
+} TlsStressResult_t;
+
+/**
+ * @brief Connect and disconnect from several tasks at the same time.
+ *
+ * Each of @p taskCount tasks makes @p connectionsPerTask connections to the
+ * stand-in, one after the other. The stand-in serves as many connections at
+ * the same time. The function returns when all tasks are done and logs the
+ * result.
+ *
+ * @param[in] taskCount Number of client tasks.
+ * @param[in] connectionsPerTask Connections made by each task.
+ * @param[in] priority Priority of the client and server tasks.
+ * @param[out] pResult The result.
+ *
+ * @return #TLS_TRANSPORT_SUCCESS if every connection succeeded and the free
+ * heap is back to where it was, #TLS_TRANSPORT_INSUFFICIENT_MEMORY if the
+ * tasks could not be created, and #TLS_TRANSPORT_INTERNAL_ERROR otherwise.
+ */
+TlsTransportStatus_t TLS_FreeRTOS_StressTest( UBaseType_t taskCount,
+                                              uint32_t connectionsPerTask,
+                                              UBaseType_t priority,
+                                              TlsStressResult_t * pResult );
+
+#endif /* ifndef USING_MBEDTLS_STRESS_H */
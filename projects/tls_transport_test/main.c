@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ *
+ * 1 tab == 4 spaces!
+ */
+
+/***
+ * Tests of the TLS transport against a server stand-in in the same program.
+ * The sockets are the loopback of TestTasks/sockets_loopback.c, so the tests
+ * need neither a modem nor a network. The process exits with EXIT_SUCCESS
+ * when every test passed.
+ ***/
+
+/* Standard includes. */
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Visual studio intrinsics used so the __debugbreak() function is available
+ * should an assert get hit. */
+#if defined( _WIN32 )
+    #include <intrin.h>
+#endif
+
+/* FreeRTOS includes. */
+#include <FreeRTOS.h>
+#include "task.h"
+
+/* mbed TLS includes. */
+#include "mbedtls_config.h"
+
+/* Tests. */
+#ifdef TLS_TRANSPORT_STRESS_TEST
+    #include "using_mbedtls_stress.h"
+#endif
+
+#ifdef DTLS_TRANSPORT_TEST
+    #include "using_mbedtls_dtls_test.h"
+#endif
+
+/**
+ * @brief Number of tasks that connect at the same time in the TLS stress test.
+ */
+#define testTLS_STRESS_TASKS          ( 3U )
+
+/**
+ * @brief Number of connections made by each task of the TLS stress test.
+ */
+#define testTLS_STRESS_CONNECTIONS    ( 10U )
+
+/**
+ * @brief Stack size of the task that runs the tests.
+ */
+#define testTASK_STACK_SIZE           ( configMINIMAL_STACK_SIZE * 8U )
+
+/**
+ * @brief Priority of the task that runs the tests, and of the tasks that the
+ * tests start.
+ */
+#define testTASK_PRIORITY             ( tskIDLE_PRIORITY + 1U )
+
+/*-----------------------------------------------------------*/
+
+/* The task that runs the tests one after the other. */
+static void TestTask( void * pvParameters );
+
+/*-----------------------------------------------------------*/
+
+static void TestTask( void * pvParameters )
+{
+    uint32_t ulFailures = 0U;
+
+    ( void ) pvParameters;
+
+    #ifdef TLS_TRANSPORT_STRESS_TEST
+        {
+            TlsStressResult_t xStressResult = { 0 };
+
+            /* Connect and disconnect from several tasks at the same time. */
+            if( TLS_FreeRTOS_StressTest( testTLS_STRESS_TASKS,
+                                         testTLS_STRESS_CONNECTIONS,
+                                         testTASK_PRIORITY,
+                                         &xStressResult ) != TLS_TRANSPORT_SUCCESS )
+            {
+                configPRINTF( ( "FAIL: TLS stress test.\r\n" ) );
+                ulFailures++;
+            }
+            else
+            {
+                configPRINTF( ( "PASS: TLS stress test, %u connections in %u ms.\r\n",
+                                ( unsigned int ) xStressResult.connections,
+                                ( unsigned int ) xStressResult.elapsedMs ) );
+            }
+        }
+    #endif /* ifdef TLS_TRANSPORT_STRESS_TEST */
+
+    #ifdef DTLS_TRANSPORT_TEST
+        /* Connect over DTLS and move the session to a new socket. */
+        if( DTLS_FreeRTOS_RebindTest( testTASK_PRIORITY ) != TLS_TRANSPORT_SUCCESS )
+        {
+            configPRINTF( ( "FAIL: DTLS rebind test.\r\n" ) );
+            ulFailures++;
+        }
+        else
+        {
+            configPRINTF( ( "PASS: DTLS rebind test.\r\n" ) );
+        }
+    #endif /* ifdef DTLS_TRANSPORT_TEST */
+
+    configPRINTF( ( "%u test(s) failed.\r\n", ( unsigned int ) ulFailures ) );
+
+    exit( ( ulFailures == 0U ) ? EXIT_SUCCESS : EXIT_FAILURE );
+}
+
+/*-----------------------------------------------------------*/
+
+int main( void )
+{
+    xTaskCreate( TestTask,            /* Function that implements the task. */
+                 "TransportTest",     /* Text name for the task - only used for debugging. */
+                 testTASK_STACK_SIZE, /* Size of stack (in words, not bytes) to allocate for the task. */
+                 NULL,                /* Task parameter - not used in this case. */
+                 testTASK_PRIORITY,   /* Task priority, must be between 0 and configMAX_PRIORITIES - 1. */
+                 NULL );              /* Used to pass out a handle to the created task - not used in this case. */
+
+    /* Start the RTOS scheduler. */
+    vTaskStartScheduler();
+
+    /* If all is well, the scheduler will now be running, and the following
+     * line will never be reached.  If the following line does execute, then
+     * there was insufficient FreeRTOS heap memory available for the idle and/or
+     * timer tasks to be created. */
+    for( ; ; )
+    {
+        #if defined( _WIN32 )
+            __debugbreak();
+        #endif
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void vAssertCalled( const char * pcFile,
+                    uint32_t ulLine )
+{
+    configPRINTF( ( "vAssertCalled( %s, %u\n", pcFile, ulLine ) );
+
+    /* A failed assertion fails the tests. */
+    exit( EXIT_FAILURE );
+}
+
+/*-----------------------------------------------------------*/
+
+/* configUSE_STATIC_ALLOCATION is set to 1, so the application must provide an
+ * implementation of vApplicationGetIdleTaskMemory() to provide the memory that is
+ * used by the Idle task. */
+void vApplicationGetIdleTaskMemory( StaticTask_t ** ppxIdleTaskTCBBuffer,
+                                    StackType_t ** ppxIdleTaskStackBuffer,
+                                    uint32_t * pulIdleTaskStackSize )
+{
+    static StaticTask_t xIdleTaskTCB;
+    static StackType_t uxIdleTaskStack[ configMINIMAL_STACK_SIZE ];
+
+    *ppxIdleTaskTCBBuffer = &xIdleTaskTCB;
+    *ppxIdleTaskStackBuffer = uxIdleTaskStack;
+    *pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+}
+
+/*-----------------------------------------------------------*/
+
+/* configUSE_STATIC_ALLOCATION and configUSE_TIMERS are both set to 1, so the
+ * application must provide an implementation of vApplicationGetTimerTaskMemory()
+ * to provide the memory that is used by the Timer service task. */
+void vApplicationGetTimerTaskMemory( StaticTask_t ** ppxTimerTaskTCBBuffer,
+                                     StackType_t ** ppxTimerTaskStackBuffer,
+                                     uint32_t * pulTimerTaskStackSize )
+{
+    static StaticTask_t xTimerTaskTCB;
+    static StackType_t uxTimerTaskStack[ configTIMER_TASK_STACK_DEPTH ];
+
+    *ppxTimerTaskTCBBuffer = &xTimerTaskTCB;
+    *ppxTimerTaskStackBuffer = uxTimerTaskStack;
+    *pulTimerTaskStackSize = configTIMER_TASK_STACK_DEPTH;
+}
+
+/*-----------------------------------------------------------*/
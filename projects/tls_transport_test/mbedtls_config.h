@@ -0,0 +1,83 @@
+/*
+ *  Copyright (C) 2006-2018, ARM Limited, All Rights Reserved
+ *  SPDX-License-Identifier: Apache-2.0 OR GPL-2.0-or-later
+ *
+ *  This file is provided under the Apache License 2.0, or the
+ *  GNU General Public License v2.0 or later.
+ *
+ *  **********
+ *  Apache License 2.0:
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License"); you may
+ *  not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ *  WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  **********
+ *
+ *  **********
+ *  GNU General Public License v2.0 or later:
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ *  **********
+ *
+ *  This repository uses Mbed TLS under Apache 2.0
+ */
+
+/* This file configures mbed TLS for the tests of the TLS transport. It adds
+ * the server side that the stand-in of using_mbedtls_standin.h needs to the
+ * configuration of the demos, which is included from the sim70x0 project so
+ * that the transport is tested as the demos build it. */
+
+#ifndef TLS_TRANSPORT_TEST_MBEDTLS_CONFIG_H
+#define TLS_TRANSPORT_TEST_MBEDTLS_CONFIG_H
+
+/* Run TLS_FreeRTOS_StressTest() of using_mbedtls_stress.h: several tasks
+ * connect to a TLS server stand-in in the same program, exchange a message and
+ * disconnect, over and over. */
+#define TLS_TRANSPORT_STRESS_TEST
+
+/* Run DTLS_FreeRTOS_RebindTest() of using_mbedtls_dtls_test.h: a client
+ * connects to a DTLS server stand-in in the same program, moves the session to
+ * a new socket with DTLS_FreeRTOS_Rebind(), and checks that the stand-in finds
+ * it by its connection ID. */
+#define DTLS_TRANSPORT_TEST
+#ifdef DTLS_TRANSPORT_TEST
+    #define MBEDTLS_SSL_PROTO_DTLS
+#endif
+
+/* The stand-in runs an mbed TLS server, and authenticates with a pre-shared
+ * key so that no certificate has to be shipped. */
+#if defined( TLS_TRANSPORT_STRESS_TEST ) || defined( DTLS_TRANSPORT_TEST )
+    #define TLS_TRANSPORT_STANDIN
+#endif
+#ifdef TLS_TRANSPORT_STANDIN
+    #define MBEDTLS_SSL_SRV_C
+    #define MBEDTLS_KEY_EXCHANGE_PSK_ENABLED
+#endif
+
+/* The configuration of the demos, which defines the DTLS options when
+ * MBEDTLS_SSL_PROTO_DTLS is defined above. */
+#include "../sim70x0_mqtt_mutual_auth_demo/mbedtls_config.h"
+
+#endif /* ifndef TLS_TRANSPORT_TEST_MBEDTLS_CONFIG_H */
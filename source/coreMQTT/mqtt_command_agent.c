@@ -0,0 +1,455 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file mqtt_command_agent.c
+ * @brief Agent that shares one MQTT connection between tasks.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/* Configure logs for the functions in this file, before core_mqtt_config.h
+ * sets those of coreMQTT. */
+#include "logging_levels.h"
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "CommandAgent"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_INFO
+#endif
+#include "logging_stack.h"
+
+#include "mqtt_command_agent.h"
+
+#ifdef MQTT_COMMAND_AGENT
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Validate a command and add it to the queue.
+ *
+ * @param[in] pAgent The agent.
+ * @param[in] pCommand The command.
+ * @param[in] blockTimeTicks Longest wait for room in the queue.
+ *
+ * @return #MQTTSuccess, or #MQTTNoMemory if the queue stayed full.
+ */
+    static MQTTStatus_t queueCommand( MQTTCommandAgent_t * pAgent,
+                                      const MQTTCommand_t * pCommand,
+                                      TickType_t blockTimeTicks );
+
+/**
+ * @brief Process the connection until an entry for a pending command is
+ * free.
+ *
+ * @param[in] pAgent The agent.
+ * @param[out] ppPending The free entry.
+ *
+ * @return #MQTTSuccess, or the first error of the publish window.
+ */
+    static MQTTStatus_t waitForPending( MQTTCommandAgent_t * pAgent,
+                                        MQTTCommandPending_t ** ppPending );
+
+/**
+ * @brief Call the callback of a command, if it has one.
+ *
+ * @param[in] callback The callback.
+ * @param[in] pCallbackContext Its context.
+ * @param[in] status Outcome of the command.
+ */
+    static void complete( MQTTCommandCallback_t callback,
+                          void * pCallbackContext,
+                          MQTTStatus_t status );
+
+/**
+ * @brief Send a command, and track its acknowledgment.
+ *
+ * @param[in] pAgent The agent.
+ * @param[in] pCommand The command.
+ *
+ * @return #MQTTSuccess, or the error of coreMQTT, after which the agent
+ * stops.
+ */
+    static MQTTStatus_t executeCommand( MQTTCommandAgent_t * pAgent,
+                                        MQTTCommand_t * pCommand );
+
+/*-----------------------------------------------------------*/
+
+    static MQTTStatus_t queueCommand( MQTTCommandAgent_t * pAgent,
+                                      const MQTTCommand_t * pCommand,
+                                      TickType_t blockTimeTicks )
+    {
+        MQTTStatus_t status = MQTTSuccess;
+
+        if( xQueueSend( pAgent->queue, pCommand, blockTimeTicks ) != pdTRUE )
+        {
+            LogWarn( ( "Command queue full. Dropped a command of type %d.", ( int ) pCommand->type ) );
+            status = MQTTNoMemory;
+        }
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static MQTTStatus_t waitForPending( MQTTCommandAgent_t * pAgent,
+                                        MQTTCommandPending_t ** ppPending )
+    {
+        MQTTStatus_t status = MQTTSuccess;
+        size_t i;
+
+        *ppPending = NULL;
+
+        while( ( status == MQTTSuccess ) && ( *ppPending == NULL ) )
+        {
+            for( i = 0U; ( i < MQTT_COMMAND_AGENT_MAX_PENDING ) && ( *ppPending == NULL ); i++ )
+            {
+                if( pAgent->pending[ i ].packetId == 0U )
+                {
+                    *ppPending = &( pAgent->pending[ i ] );
+                }
+            }
+
+            if( *ppPending == NULL )
+            {
+                status = MQTTPublishWindow_Process( pAgent->pWindow, MQTT_PUBLISH_WINDOW_POLL_MS );
+            }
+        }
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void complete( MQTTCommandCallback_t callback,
+                          void * pCallbackContext,
+                          MQTTStatus_t status )
+    {
+        if( callback != NULL )
+        {
+            callback( pCallbackContext, status );
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    static MQTTStatus_t executeCommand( MQTTCommandAgent_t * pAgent,
+                                        MQTTCommand_t * pCommand )
+    {
+        MQTTStatus_t status;
+        MQTTCommandPending_t * pPending = NULL;
+        MQTTContext_t * pMqttContext = pAgent->pWindow->pMqttContext;
+        uint16_t packetId = 0U;
+
+        if( ( pCommand->type == MQTT_COMMAND_PUBLISH ) && ( pCommand->publishInfo.qos == MQTTQoS0 ) )
+        {
+            /* Nothing to wait for. */
+            status = MQTT_Publish( pMqttContext, &( pCommand->publishInfo ), 0U );
+            complete( pCommand->callback, pCommand->pCallbackContext, status );
+        }
+        else
+        {
+            status = waitForPending( pAgent, &pPending );
+
+            if( status != MQTTSuccess )
+            {
+                complete( pCommand->callback, pCommand->pCallbackContext, status );
+            }
+            else if( pCommand->type == MQTT_COMMAND_PUBLISH )
+            {
+                status = MQTTPublishWindow_Publish( pAgent->pWindow, &( pCommand->publishInfo ), &packetId );
+                pPending->ackType = MQTT_PACKET_TYPE_PUBACK;
+            }
+            else
+            {
+                packetId = MQTT_GetPacketId( pMqttContext );
+
+                if( pCommand->type == MQTT_COMMAND_SUBSCRIBE )
+                {
+                    status = MQTT_Subscribe( pMqttContext, &( pCommand->subscribe ), 1U, packetId );
+                    pPending->ackType = MQTT_PACKET_TYPE_SUBACK;
+                }
+                else
+                {
+                    status = MQTT_Unsubscribe( pMqttContext, &( pCommand->subscribe ), 1U, packetId );
+                    pPending->ackType = MQTT_PACKET_TYPE_UNSUBACK;
+                }
+
+                /* Subscriptions are not sent again after a reconnect. */
+                if( status != MQTTSuccess )
+                {
+                    packetId = 0U;
+                }
+            }
+
+            /* A publish whose send failed still has a packet ID: it stays in the
+             * window, and is completed by its PUBACK after the reconnect. */
+            if( packetId != 0U )
+            {
+                pPending->packetId = packetId;
+                pPending->callback = pCommand->callback;
+                pPending->pCallbackContext = pCommand->pCallbackContext;
+            }
+            else if( pPending != NULL )
+            {
+                complete( pCommand->callback, pCommand->pCallbackContext, status );
+            }
+            else
+            {
+                /* Empty else MISRA 15.7 */
+            }
+        }
+
+        if( status != MQTTSuccess )
+        {
+            LogError( ( "Command of type %d failed: %s.",
+                        ( int ) pCommand->type,
+                        MQTT_Status_strerror( status ) ) );
+        }
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+    MQTTStatus_t MQTTCommandAgent_Init( MQTTCommandAgent_t * pAgent,
+                                        MQTTPublishWindow_t * pWindow )
+    {
+        MQTTStatus_t status = MQTTSuccess;
+
+        if( ( pAgent == NULL ) || ( pWindow == NULL ) )
+        {
+            LogError( ( "Invalid parameter: pAgent=%p, pWindow=%p.",
+                        ( void * ) pAgent,
+                        ( void * ) pWindow ) );
+            status = MQTTBadParameter;
+        }
+        else
+        {
+            ( void ) memset( pAgent, 0, sizeof( MQTTCommandAgent_t ) );
+            pAgent->pWindow = pWindow;
+            pAgent->queue = xQueueCreateStatic( MQTT_COMMAND_AGENT_QUEUE_LENGTH,
+                                                sizeof( MQTTCommand_t ),
+                                                pAgent->queueStorage,
+                                                &( pAgent->queueStruct ) );
+            configASSERT( pAgent->queue != NULL );
+        }
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+    MQTTStatus_t MQTTCommandAgent_Publish( MQTTCommandAgent_t * pAgent,
+                                           const MQTTPublishInfo_t * pPublishInfo,
+                                           MQTTCommandCallback_t callback,
+                                           void * pCallbackContext,
+                                           TickType_t blockTimeTicks )
+    {
+        MQTTStatus_t status = MQTTSuccess;
+        MQTTCommand_t command;
+
+        if( ( pAgent == NULL ) || ( pPublishInfo == NULL ) || ( pPublishInfo->qos == MQTTQoS2 ) )
+        {
+            LogError( ( "Invalid parameter: pAgent=%p, pPublishInfo=%p. QoS2 is not supported.",
+                        ( void * ) pAgent,
+                        ( const void * ) pPublishInfo ) );
+            status = MQTTBadParameter;
+        }
+        else
+        {
+            ( void ) memset( &command, 0, sizeof( command ) );
+            command.type = MQTT_COMMAND_PUBLISH;
+            command.publishInfo = *pPublishInfo;
+            command.callback = callback;
+            command.pCallbackContext = pCallbackContext;
+            status = queueCommand( pAgent, &command, blockTimeTicks );
+        }
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+    MQTTStatus_t MQTTCommandAgent_Subscribe( MQTTCommandAgent_t * pAgent,
+                                             const MQTTSubscribeInfo_t * pSubscribeInfo,
+                                             MQTTCommandCallback_t callback,
+                                             void * pCallbackContext,
+                                             TickType_t blockTimeTicks )
+    {
+        MQTTStatus_t status = MQTTSuccess;
+        MQTTCommand_t command;
+
+        if( ( pAgent == NULL ) || ( pSubscribeInfo == NULL ) )
+        {
+            LogError( ( "Invalid parameter: pAgent=%p, pSubscribeInfo=%p.",
+                        ( void * ) pAgent,
+                        ( const void * ) pSubscribeInfo ) );
+            status = MQTTBadParameter;
+        }
+        else
+        {
+            ( void ) memset( &command, 0, sizeof( command ) );
+            command.type = MQTT_COMMAND_SUBSCRIBE;
+            command.subscribe = *pSubscribeInfo;
+            command.callback = callback;
+            command.pCallbackContext = pCallbackContext;
+            status = queueCommand( pAgent, &command, blockTimeTicks );
+        }
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+    MQTTStatus_t MQTTCommandAgent_Unsubscribe( MQTTCommandAgent_t * pAgent,
+                                               const MQTTSubscribeInfo_t * pSubscribeInfo,
+                                               MQTTCommandCallback_t callback,
+                                               void * pCallbackContext,
+                                               TickType_t blockTimeTicks )
+    {
+        MQTTStatus_t status = MQTTSuccess;
+        MQTTCommand_t command;
+
+        if( ( pAgent == NULL ) || ( pSubscribeInfo == NULL ) )
+        {
+            LogError( ( "Invalid parameter: pAgent=%p, pSubscribeInfo=%p.",
+                        ( void * ) pAgent,
+                        ( const void * ) pSubscribeInfo ) );
+            status = MQTTBadParameter;
+        }
+        else
+        {
+            ( void ) memset( &command, 0, sizeof( command ) );
+            command.type = MQTT_COMMAND_UNSUBSCRIBE;
+            command.subscribe = *pSubscribeInfo;
+            command.callback = callback;
+            command.pCallbackContext = pCallbackContext;
+            status = queueCommand( pAgent, &command, blockTimeTicks );
+        }
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+    MQTTStatus_t MQTTCommandAgent_Run( MQTTCommandAgent_t * pAgent )
+    {
+        MQTTStatus_t status = MQTTSuccess;
+        MQTTCommand_t command;
+        TickType_t waitTicks;
+        size_t executed;
+
+        configASSERT( pAgent != NULL );
+
+        while( status == MQTTSuccess )
+        {
+            /* Wait for the first command only. Commands queued meanwhile are sent
+             * back to back, up to one queue length, to keep the window full. */
+            waitTicks = pdMS_TO_TICKS( MQTT_COMMAND_AGENT_WAIT_MS );
+
+            for( executed = 0U;
+                 ( status == MQTTSuccess ) && ( executed < MQTT_COMMAND_AGENT_QUEUE_LENGTH ) &&
+                 ( xQueueReceive( pAgent->queue, &command, waitTicks ) == pdTRUE );
+                 executed++ )
+            {
+                status = executeCommand( pAgent, &command );
+                waitTicks = 0U;
+            }
+
+            if( status == MQTTSuccess )
+            {
+                status = MQTTPublishWindow_Process( pAgent->pWindow, 0U );
+            }
+        }
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+    bool MQTTCommandAgent_Ack( MQTTCommandAgent_t * pAgent,
+                               uint8_t packetType,
+                               uint16_t packetId,
+                               MQTTStatus_t status )
+    {
+        MQTTCommandPending_t * pPending = NULL;
+        size_t i;
+
+        configASSERT( pAgent != NULL );
+
+        for( i = 0U; ( i < MQTT_COMMAND_AGENT_MAX_PENDING ) && ( pPending == NULL ); i++ )
+        {
+            if( ( packetId != 0U ) &&
+                ( pAgent->pending[ i ].packetId == packetId ) &&
+                ( pAgent->pending[ i ].ackType == packetType ) )
+            {
+                pPending = &( pAgent->pending[ i ] );
+            }
+        }
+
+        if( pPending != NULL )
+        {
+            if( packetType == MQTT_PACKET_TYPE_PUBACK )
+            {
+                ( void ) MQTTPublishWindow_Ack( pAgent->pWindow, packetId );
+            }
+
+            /* Free the entry first, so that the callback may queue a command. */
+            pPending->packetId = 0U;
+            complete( pPending->callback, pPending->pCallbackContext, status );
+        }
+
+        return( pPending != NULL );
+    }
+
+/*-----------------------------------------------------------*/
+
+    void MQTTCommandAgent_Resume( MQTTCommandAgent_t * pAgent,
+                                  bool sessionPresent )
+    {
+        MQTTCommandPending_t * pPending;
+        size_t i;
+
+        configASSERT( pAgent != NULL );
+
+        for( i = 0U; i < MQTT_COMMAND_AGENT_MAX_PENDING; i++ )
+        {
+            pPending = &( pAgent->pending[ i ] );
+
+            if( ( pPending->packetId != 0U ) &&
+                ( ( pPending->ackType != MQTT_PACKET_TYPE_PUBACK ) || ( sessionPresent == false ) ) )
+            {
+                LogWarn( ( "Acknowledgment of packet ID %u lost with the connection.",
+                           ( unsigned int ) pPending->packetId ) );
+                pPending->packetId = 0U;
+                complete( pPending->callback, pPending->pCallbackContext, MQTTRecvFailed );
+            }
+        }
+    }
+
+#endif /* ifdef MQTT_COMMAND_AGENT */
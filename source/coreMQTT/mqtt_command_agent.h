@@ -0,0 +1,261 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file mqtt_command_agent.h
+ * @brief Agent that shares one MQTT connection between tasks.
+ *
+ * Built when MQTT_COMMAND_AGENT is defined in core_mqtt_config.h.
+ *
+ * coreMQTT is not thread safe, so a single agent task owns the MQTT context.
+ * Other tasks send it publish, subscribe and unsubscribe commands through a
+ * queue, and learn the outcome from a completion callback, called by the
+ * agent task once the broker has acknowledged the command. Between commands,
+ * the agent runs MQTT_ProcessLoop(), so incoming packets and keep-alive are
+ * handled while the producers wait.
+ *
+ * QoS1 publishes go through the publish window, so the commands of several
+ * producers are in flight together. The topics, payloads and topic filters
+ * of a command must stay valid until its callback is called.
+ *
+ * When idle, MQTT_ProcessLoop() waits for the receive timeout of the
+ * transport: keep it short, for example with Sockets_SetReceiveTimeout(), or
+ * commands wait as long.
+ */
+
+#ifndef MQTT_COMMAND_AGENT_H
+#define MQTT_COMMAND_AGENT_H
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "queue.h"
+
+/* MQTT library includes. */
+#include "core_mqtt.h"
+
+/* Publish window of the QoS1 publishes. */
+#include "mqtt_publish_window.h"
+
+/**
+ * @brief Number of commands waiting for the agent. Further commands wait, up
+ * to their block time, for room in the queue.
+ */
+#ifndef MQTT_COMMAND_AGENT_QUEUE_LENGTH
+    #define MQTT_COMMAND_AGENT_QUEUE_LENGTH    ( 10U )
+#endif
+
+/**
+ * @brief Number of commands waiting for their acknowledgment: the messages
+ * in flight, plus the subscriptions and unsubscriptions.
+ */
+#ifndef MQTT_COMMAND_AGENT_MAX_PENDING
+    #define MQTT_COMMAND_AGENT_MAX_PENDING    ( MQTT_PUBLISH_WINDOW_SIZE + 2U )
+#endif
+
+/**
+ * @brief Longest time the agent waits for a command before it runs
+ * MQTT_ProcessLoop() again.
+ */
+#ifndef MQTT_COMMAND_AGENT_WAIT_MS
+    #define MQTT_COMMAND_AGENT_WAIT_MS    ( 10U )
+#endif
+
+/**
+ * @brief Called by the agent task once a command is complete.
+ *
+ * @param[in] pCallbackContext Context given with the command.
+ * @param[in] status #MQTTSuccess once acknowledged, #MQTTServerRefused if the
+ * broker rejected the subscription, #MQTTRecvFailed if the acknowledgment
+ * was lost with the connection, or the error of coreMQTT.
+ */
+typedef void ( * MQTTCommandCallback_t )( void * pCallbackContext,
+                                          MQTTStatus_t status );
+
+/**
+ * @brief Kinds of command.
+ */
+typedef enum MQTTCommandType
+{
+    MQTT_COMMAND_PUBLISH,    /**< @brief Publish a message. */
+    MQTT_COMMAND_SUBSCRIBE,  /**< @brief Subscribe to a topic filter. */
+    MQTT_COMMAND_UNSUBSCRIBE /**< @brief Unsubscribe from a topic filter. */
+} MQTTCommandType_t;
+
+/**
+ * @brief A command, as queued for the agent.
+ */
+typedef struct MQTTCommand
+{
+    MQTTCommandType_t type;         /**< @brief Kind of command. */
+    MQTTPublishInfo_t publishInfo;  /**< @brief Message of #MQTT_COMMAND_PUBLISH. */
+    MQTTSubscribeInfo_t subscribe;  /**< @brief Topic filter of the other commands. */
+    MQTTCommandCallback_t callback; /**< @brief Completion callback. May be NULL. */
+    void * pCallbackContext;        /**< @brief Passed to the callback. */
+} MQTTCommand_t;
+
+/**
+ * @brief A command waiting for its acknowledgment.
+ */
+typedef struct MQTTCommandPending
+{
+    uint16_t packetId;              /**< @brief Packet ID of the command, or 0 if the entry is free. */
+    uint8_t ackType;                /**< @brief Packet type of the acknowledgment. */
+    MQTTCommandCallback_t callback; /**< @brief Completion callback. May be NULL. */
+    void * pCallbackContext;        /**< @brief Passed to the callback. */
+} MQTTCommandPending_t;
+
+/**
+ * @brief Command agent. Its fields are private.
+ */
+typedef struct MQTTCommandAgent
+{
+    MQTTPublishWindow_t * pWindow;                                                     /**< @brief Window of the connection, whose context the agent uses. */
+    QueueHandle_t queue;                                                               /**< @brief Commands from the other tasks. */
+    StaticQueue_t queueStruct;                                                         /**< @brief Storage of the queue. */
+    uint8_t queueStorage[ MQTT_COMMAND_AGENT_QUEUE_LENGTH * sizeof( MQTTCommand_t ) ]; /**< @brief Storage of the queued commands. */
+    MQTTCommandPending_t pending[ MQTT_COMMAND_AGENT_MAX_PENDING ];                    /**< @brief Commands waiting for their acknowledgment. */
+} MQTTCommandAgent_t;
+
+/**
+ * @brief Set up an agent on the publish window of a connection.
+ *
+ * @param[out] pAgent The agent.
+ * @param[in] pWindow Publish window, initialized on the MQTT context. It may
+ * be initialized again, after a reconnect, while the agent is in use.
+ *
+ * @return #MQTTSuccess, or #MQTTBadParameter.
+ */
+MQTTStatus_t MQTTCommandAgent_Init( MQTTCommandAgent_t * pAgent,
+                                    MQTTPublishWindow_t * pWindow );
+
+/**
+ * @brief Queue a publish. Can be called from any task.
+ *
+ * QoS0 messages complete once sent, QoS1 messages once acknowledged. QoS2 is
+ * not supported.
+ *
+ * @param[in] pAgent The agent.
+ * @param[in] pPublishInfo The message, copied to the queue. Its topic and
+ * payload must stay valid until the callback.
+ * @param[in] callback Completion callback. May be NULL.
+ * @param[in] pCallbackContext Passed to the callback.
+ * @param[in] blockTimeTicks Longest wait for room in the queue.
+ *
+ * @return #MQTTSuccess, #MQTTBadParameter, or #MQTTNoMemory if the queue
+ * stayed full.
+ */
+MQTTStatus_t MQTTCommandAgent_Publish( MQTTCommandAgent_t * pAgent,
+                                       const MQTTPublishInfo_t * pPublishInfo,
+                                       MQTTCommandCallback_t callback,
+                                       void * pCallbackContext,
+                                       TickType_t blockTimeTicks );
+
+/**
+ * @brief Queue a subscription. Can be called from any task.
+ *
+ * @param[in] pAgent The agent.
+ * @param[in] pSubscribeInfo The topic filter and QoS, copied to the queue.
+ * The topic filter must stay valid until the callback.
+ * @param[in] callback Completion callback. May be NULL.
+ * @param[in] pCallbackContext Passed to the callback.
+ * @param[in] blockTimeTicks Longest wait for room in the queue.
+ *
+ * @return #MQTTSuccess, #MQTTBadParameter, or #MQTTNoMemory if the queue
+ * stayed full.
+ */
+MQTTStatus_t MQTTCommandAgent_Subscribe( MQTTCommandAgent_t * pAgent,
+                                         const MQTTSubscribeInfo_t * pSubscribeInfo,
+                                         MQTTCommandCallback_t callback,
+                                         void * pCallbackContext,
+                                         TickType_t blockTimeTicks );
+
+/**
+ * @brief Queue an unsubscription. Can be called from any task.
+ *
+ * @param[in] pAgent The agent.
+ * @param[in] pSubscribeInfo The topic filter, copied to the queue. It must
+ * stay valid until the callback.
+ * @param[in] callback Completion callback. May be NULL.
+ * @param[in] pCallbackContext Passed to the callback.
+ * @param[in] blockTimeTicks Longest wait for room in the queue.
+ *
+ * @return #MQTTSuccess, #MQTTBadParameter, or #MQTTNoMemory if the queue
+ * stayed full.
+ */
+MQTTStatus_t MQTTCommandAgent_Unsubscribe( MQTTCommandAgent_t * pAgent,
+                                           const MQTTSubscribeInfo_t * pSubscribeInfo,
+                                           MQTTCommandCallback_t callback,
+                                           void * pCallbackContext,
+                                           TickType_t blockTimeTicks );
+
+/**
+ * @brief Execute the queued commands and process the connection, until the
+ * connection fails. Call it from the agent task once connected.
+ *
+ * Commands that are still queued when the function returns are executed by
+ * the next call, after the reconnect.
+ *
+ * @param[in] pAgent The agent.
+ *
+ * @return The error of coreMQTT that ended the connection.
+ */
+MQTTStatus_t MQTTCommandAgent_Run( MQTTCommandAgent_t * pAgent );
+
+/**
+ * @brief Complete the command of an acknowledgment. Call it from the MQTT
+ * event callback with every PUBACK, SUBACK and UNSUBACK. The function passes
+ * the PUBACKs of its commands to MQTTPublishWindow_Ack().
+ *
+ * @param[in] pAgent The agent.
+ * @param[in] packetType Type of the incoming packet.
+ * @param[in] packetId Packet ID of the incoming packet.
+ * @param[in] status Deserialization result of the packet, which is
+ * #MQTTServerRefused for a rejected subscription.
+ *
+ * @return true if the acknowledgment completed a command of the agent,
+ * otherwise false.
+ */
+bool MQTTCommandAgent_Ack( MQTTCommandAgent_t * pAgent,
+                           uint8_t packetType,
+                           uint16_t packetId,
+                           MQTTStatus_t status );
+
+/**
+ * @brief Complete, with #MQTTRecvFailed, the commands whose acknowledgment
+ * was lost with the last connection. Call it after reconnecting, before
+ * MQTTCommandAgent_Run().
+ *
+ * Subscriptions and unsubscriptions are not sent again. Publishes are, by
+ * MQTTPublishWindow_ResendAll(), if the broker resumed the session.
+ *
+ * @param[in] pAgent The agent.
+ * @param[in] sessionPresent Whether the broker resumed the session.
+ */
+void MQTTCommandAgent_Resume( MQTTCommandAgent_t * pAgent,
+                              bool sessionPresent );
+
+#endif /* ifndef MQTT_COMMAND_AGENT_H */
@@ -0,0 +1,651 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/**
+ * @file mqtt_keep_alive.c
+ * @brief Keep-alive interval learned from the NAT of the network.
+ */
+
+/* Standard includes. */
+#include <stdio.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/* Configure logs for the functions in this file, before core_mqtt_config.h
+ * sets those of coreMQTT. */
+#include "logging_levels.h"
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "KeepAlive"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_INFO
+#endif
+#include "logging_stack.h"
+
+#include "mqtt_keep_alive.h"
+
+#ifdef MQTT_ADAPTIVE_KEEP_ALIVE
+
+/* The keepAliveIntervalSec, pingReqSendTimeMs and waitingForPingResp fields
+ * of MQTTContext_t are internal to coreMQTT v1. coreMQTT v2.0 replaced
+ * MQTT_SEND_RETRY_TIMEOUT_MS with MQTT_SEND_TIMEOUT_MS, which its config
+ * defaults always define. */
+    #ifdef MQTT_SEND_TIMEOUT_MS
+        #error "MQTT_ADAPTIVE_KEEP_ALIVE requires coreMQTT v1. Check the MQTTContext_t fields it uses before porting it."
+    #endif
+
+/**
+ * @brief Longest line of the file of saved intervals.
+ */
+    #define FILE_LINE_LENGTH      ( MQTT_KEEP_ALIVE_NETWORK_ID_LENGTH + 16U )
+
+/**
+ * @brief Size of the sscanf() format of a line of the file.
+ */
+    #define FILE_FORMAT_LENGTH    ( 16U )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Set the interval of the PINGREQs, bounded by the keep-alive of the
+ * CONNECT packet.
+ *
+ * @param[in] pKeepAlive The adaptive keep-alive.
+ * @param[in] intervalSec The interval.
+ */
+    static void setInterval( MQTTKeepAlive_t * pKeepAlive,
+                             uint32_t intervalSec );
+
+/**
+ * @brief End the search at the longest idle time that worked, less the
+ * margin, and save it.
+ *
+ * @param[in] pKeepAlive The adaptive keep-alive.
+ */
+    static void settle( MQTTKeepAlive_t * pKeepAlive );
+
+/**
+ * @brief Adjust the interval after a PINGRESP.
+ *
+ * @param[in] pKeepAlive The adaptive keep-alive.
+ * @param[in] idleSec Idle time before the PINGREQ.
+ */
+    static void probeSucceeded( MQTTKeepAlive_t * pKeepAlive,
+                                uint16_t idleSec );
+
+/**
+ * @brief Fall back after a connection lost while waiting for a PINGRESP.
+ *
+ * @param[in] pKeepAlive The adaptive keep-alive.
+ * @param[in] idleSec Idle time before the PINGREQ.
+ */
+    static void probeFailed( MQTTKeepAlive_t * pKeepAlive,
+                             uint16_t idleSec );
+
+/**
+ * @brief Start a probe if a PINGREQ was sent since the last call.
+ *
+ * @param[in] pKeepAlive The adaptive keep-alive.
+ */
+    static void detectPingRequest( MQTTKeepAlive_t * pKeepAlive );
+
+/**
+ * @brief Find the saved interval of a network.
+ *
+ * @param[in] pKeepAlive The adaptive keep-alive.
+ * @param[in] pNetworkId Identifier of the network.
+ *
+ * @return Index in the saved intervals, or #MQTT_KEEP_ALIVE_MAX_NETWORKS.
+ */
+    static size_t findNetwork( const MQTTKeepAlive_t * pKeepAlive,
+                               const char * pNetworkId );
+
+/**
+ * @brief Remove the saved interval of the current network, if any.
+ *
+ * @param[in] pKeepAlive The adaptive keep-alive.
+ */
+    static void forgetNetwork( MQTTKeepAlive_t * pKeepAlive );
+
+/**
+ * @brief Read the saved intervals from the file.
+ *
+ * @param[in] pKeepAlive The adaptive keep-alive.
+ */
+    static void loadNetworks( MQTTKeepAlive_t * pKeepAlive );
+
+/**
+ * @brief Write the saved intervals to the file.
+ *
+ * @param[in] pKeepAlive The adaptive keep-alive.
+ */
+    static void saveNetworks( const MQTTKeepAlive_t * pKeepAlive );
+
+/*-----------------------------------------------------------*/
+
+    static void setInterval( MQTTKeepAlive_t * pKeepAlive,
+                             uint32_t intervalSec )
+    {
+        uint32_t seconds = intervalSec;
+
+        if( seconds < MQTT_KEEP_ALIVE_MIN_SECONDS )
+        {
+            seconds = MQTT_KEEP_ALIVE_MIN_SECONDS;
+        }
+
+        if( seconds > MQTT_KEEP_ALIVE_MAX_SECONDS )
+        {
+            seconds = MQTT_KEEP_ALIVE_MAX_SECONDS;
+        }
+
+        if( seconds != pKeepAlive->intervalSec )
+        {
+            LogInfo( ( "Keep-alive interval %u s on network %s.",
+                       ( unsigned int ) seconds, pKeepAlive->networkId ) );
+        }
+
+        pKeepAlive->intervalSec = ( uint16_t ) seconds;
+
+        /* The broker only tolerates the keep-alive of the CONNECT packet. The
+         * interval is applied through a field internal to coreMQTT v1, which
+         * reads it at each MQTT_ProcessLoop(). */
+        if( ( pKeepAlive->connectSec != 0U ) && ( seconds > pKeepAlive->connectSec ) )
+        {
+            seconds = pKeepAlive->connectSec;
+        }
+
+        pKeepAlive->pContext->keepAliveIntervalSec = ( uint16_t ) seconds;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void settle( MQTTKeepAlive_t * pKeepAlive )
+    {
+        MQTTKeepAliveNetwork_t network;
+        size_t index;
+
+        setInterval( pKeepAlive, pKeepAlive->goodSec -
+                     ( ( ( uint32_t ) pKeepAlive->goodSec * MQTT_KEEP_ALIVE_MARGIN_PERCENT ) / 100U ) );
+        pKeepAlive->settled = true;
+
+        LogInfo( ( "Keep-alive of network %s settled at %u s: idle %u s worked, %u s failed.",
+                   pKeepAlive->networkId,
+                   ( unsigned int ) pKeepAlive->intervalSec,
+                   ( unsigned int ) pKeepAlive->goodSec,
+                   ( unsigned int ) pKeepAlive->badSec ) );
+
+        /* Move the network first, which drops the least recently used one when
+         * the table is full. */
+        if( pKeepAlive->networkId[ 0 ] != '\0' )
+        {
+            index = findNetwork( pKeepAlive, pKeepAlive->networkId );
+
+            if( index == MQTT_KEEP_ALIVE_MAX_NETWORKS )
+            {
+                index = MQTT_KEEP_ALIVE_MAX_NETWORKS - 1U;
+            }
+
+            ( void ) memcpy( network.id, pKeepAlive->networkId, sizeof( network.id ) );
+            network.intervalSec = pKeepAlive->intervalSec;
+            ( void ) memmove( &( pKeepAlive->networks[ 1 ] ), &( pKeepAlive->networks[ 0 ] ),
+                              index * sizeof( MQTTKeepAliveNetwork_t ) );
+            pKeepAlive->networks[ 0 ] = network;
+            saveNetworks( pKeepAlive );
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void probeSucceeded( MQTTKeepAlive_t * pKeepAlive,
+                                uint16_t idleSec )
+    {
+        if( idleSec > pKeepAlive->goodSec )
+        {
+            pKeepAlive->goodSec = idleSec;
+        }
+
+        /* The NAT now keeps the binding for longer than a past failure. */
+        if( ( pKeepAlive->badSec != 0U ) && ( pKeepAlive->goodSec >= pKeepAlive->badSec ) )
+        {
+            pKeepAlive->badSec = 0U;
+        }
+
+        if( pKeepAlive->settled == false )
+        {
+            if( pKeepAlive->goodSec >= MQTT_KEEP_ALIVE_MAX_SECONDS )
+            {
+                settle( pKeepAlive );
+            }
+            else if( pKeepAlive->badSec == 0U )
+            {
+                setInterval( pKeepAlive, ( uint32_t ) pKeepAlive->goodSec * 2U );
+            }
+            else if( ( uint32_t ) ( pKeepAlive->badSec - pKeepAlive->goodSec ) <= MQTT_KEEP_ALIVE_RESOLUTION_SECONDS )
+            {
+                settle( pKeepAlive );
+            }
+            else
+            {
+                setInterval( pKeepAlive, ( ( uint32_t ) pKeepAlive->goodSec + pKeepAlive->badSec ) / 2U );
+            }
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void probeFailed( MQTTKeepAlive_t * pKeepAlive,
+                             uint16_t idleSec )
+    {
+        if( ( pKeepAlive->settled == true ) || ( idleSec <= pKeepAlive->goodSec ) )
+        {
+            /* An idle time that worked no longer does: the NAT of the network
+             * changed, or the connection was lost for another reason. Either
+             * way, start again from a shorter interval. */
+            LogWarn( ( "Idle %u s no longer works on network %s. Searching again.",
+                       ( unsigned int ) idleSec, pKeepAlive->networkId ) );
+            forgetNetwork( pKeepAlive );
+            pKeepAlive->settled = false;
+            pKeepAlive->goodSec = 0U;
+            pKeepAlive->badSec = idleSec;
+            setInterval( pKeepAlive, ( uint32_t ) idleSec / 2U );
+        }
+        else
+        {
+            if( ( pKeepAlive->badSec == 0U ) || ( idleSec < pKeepAlive->badSec ) )
+            {
+                pKeepAlive->badSec = idleSec;
+            }
+
+            if( pKeepAlive->goodSec == 0U )
+            {
+                setInterval( pKeepAlive, ( uint32_t ) idleSec / 2U );
+            }
+            else if( ( uint32_t ) ( pKeepAlive->badSec - pKeepAlive->goodSec ) <= MQTT_KEEP_ALIVE_RESOLUTION_SECONDS )
+            {
+                settle( pKeepAlive );
+            }
+            else
+            {
+                /* Fall back to the idle time that worked until the next probe. */
+                setInterval( pKeepAlive, pKeepAlive->goodSec );
+            }
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void detectPingRequest( MQTTKeepAlive_t * pKeepAlive )
+    {
+        const MQTTContext_t * pContext = pKeepAlive->pContext;
+
+        /* The PINGRESP may have arrived in the same MQTT_ProcessLoop(), so a
+         * new PINGREQ is only seen from its send time. */
+        if( pContext->pingReqSendTimeMs != pKeepAlive->lastPingReqMs )
+        {
+            /* The PINGREQ ended the longest idle time since the last call. */
+            pKeepAlive->lastPingReqMs = pContext->pingReqSendTimeMs;
+            pKeepAlive->probing = true;
+            pKeepAlive->probeSec = ( uint16_t ) ( pKeepAlive->longestGapMs / 1000U );
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    static size_t findNetwork( const MQTTKeepAlive_t * pKeepAlive,
+                               const char * pNetworkId )
+    {
+        size_t index = 0U;
+
+        while( ( index < MQTT_KEEP_ALIVE_MAX_NETWORKS ) &&
+               ( strncmp( pKeepAlive->networks[ index ].id, pNetworkId,
+                          sizeof( pKeepAlive->networks[ index ].id ) ) != 0 ) )
+        {
+            index++;
+        }
+
+        return index;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void forgetNetwork( MQTTKeepAlive_t * pKeepAlive )
+    {
+        size_t index = findNetwork( pKeepAlive, pKeepAlive->networkId );
+
+        if( ( pKeepAlive->networkId[ 0 ] != '\0' ) && ( index < MQTT_KEEP_ALIVE_MAX_NETWORKS ) )
+        {
+            ( void ) memmove( &( pKeepAlive->networks[ index ] ), &( pKeepAlive->networks[ index + 1U ] ),
+                              ( MQTT_KEEP_ALIVE_MAX_NETWORKS - 1U - index ) * sizeof( MQTTKeepAliveNetwork_t ) );
+            ( void ) memset( &( pKeepAlive->networks[ MQTT_KEEP_ALIVE_MAX_NETWORKS - 1U ] ), 0x00,
+                             sizeof( MQTTKeepAliveNetwork_t ) );
+            saveNetworks( pKeepAlive );
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void loadNetworks( MQTTKeepAlive_t * pKeepAlive )
+    {
+        FILE * pFile = NULL;
+        char line[ FILE_LINE_LENGTH ];
+        char id[ MQTT_KEEP_ALIVE_NETWORK_ID_LENGTH + 1U ];
+        char format[ FILE_FORMAT_LENGTH ];
+        unsigned int intervalSec;
+        size_t count = 0U;
+
+        /* Bound the identifier to the size of id. */
+        ( void ) snprintf( format, sizeof( format ), "%%%us %%u",
+                           ( unsigned int ) MQTT_KEEP_ALIVE_NETWORK_ID_LENGTH );
+
+        if( pKeepAlive->pPath != NULL )
+        {
+            pFile = fopen( pKeepAlive->pPath, "r" );
+        }
+
+        if( pFile != NULL )
+        {
+            /* One network per line: its identifier and its interval. */
+            while( ( count < MQTT_KEEP_ALIVE_MAX_NETWORKS ) &&
+                   ( fgets( line, ( int ) sizeof( line ), pFile ) != NULL ) )
+            {
+                if( ( sscanf( line, format, id, &intervalSec ) == 2 ) &&
+                    ( intervalSec >= MQTT_KEEP_ALIVE_MIN_SECONDS ) &&
+                    ( intervalSec <= MQTT_KEEP_ALIVE_MAX_SECONDS ) )
+                {
+                    ( void ) memcpy( pKeepAlive->networks[ count ].id, id, sizeof( id ) );
+                    pKeepAlive->networks[ count ].intervalSec = ( uint16_t ) intervalSec;
+                    count++;
+                }
+            }
+
+            ( void ) fclose( pFile );
+            LogInfo( ( "Loaded the keep-alive of %u networks from %s.",
+                       ( unsigned int ) count, pKeepAlive->pPath ) );
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void saveNetworks( const MQTTKeepAlive_t * pKeepAlive )
+    {
+        FILE * pFile = NULL;
+        size_t index;
+        bool success = true;
+
+        if( pKeepAlive->pPath != NULL )
+        {
+            pFile = fopen( pKeepAlive->pPath, "w" );
+            success = ( pFile != NULL );
+        }
+
+        if( pFile != NULL )
+        {
+            for( index = 0U; index < MQTT_KEEP_ALIVE_MAX_NETWORKS; index++ )
+            {
+                if( ( pKeepAlive->networks[ index ].id[ 0 ] != '\0' ) &&
+                    ( fprintf( pFile, "%s %u\n", pKeepAlive->networks[ index ].id,
+                               ( unsigned int ) pKeepAlive->networks[ index ].intervalSec ) < 0 ) )
+                {
+                    success = false;
+                }
+            }
+
+            if( fclose( pFile ) != 0 )
+            {
+                success = false;
+            }
+        }
+
+        if( success == false )
+        {
+            LogWarn( ( "Failed to save the keep-alive intervals to %s.", pKeepAlive->pPath ) );
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    MQTTStatus_t MQTTKeepAlive_Init( MQTTKeepAlive_t * pKeepAlive,
+                                     MQTTContext_t * pContext,
+                                     const char * pPath )
+    {
+        MQTTStatus_t status = MQTTSuccess;
+
+        if( ( pKeepAlive == NULL ) || ( pContext == NULL ) || ( pContext->getTime == NULL ) )
+        {
+            LogError( ( "Argument cannot be NULL: pKeepAlive=%p, pContext=%p.",
+                        ( void * ) pKeepAlive,
+                        ( void * ) pContext ) );
+            status = MQTTBadParameter;
+        }
+        else
+        {
+            ( void ) memset( pKeepAlive, 0x00, sizeof( MQTTKeepAlive_t ) );
+            pKeepAlive->pContext = pContext;
+            pKeepAlive->pPath = pPath;
+            pKeepAlive->startMs = pContext->getTime();
+            pKeepAlive->lastActivityMs = pKeepAlive->startMs;
+            pKeepAlive->intervalSec = MQTT_KEEP_ALIVE_INITIAL_SECONDS;
+            loadNetworks( pKeepAlive );
+        }
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+    void MQTTKeepAlive_SelectNetwork( MQTTKeepAlive_t * pKeepAlive,
+                                      const char * pNetworkId )
+    {
+        size_t index;
+
+        configASSERT( pKeepAlive != NULL );
+        configASSERT( pNetworkId != NULL );
+
+        if( strncmp( pKeepAlive->networkId, pNetworkId, MQTT_KEEP_ALIVE_NETWORK_ID_LENGTH ) != 0 )
+        {
+            ( void ) strncpy( pKeepAlive->networkId, pNetworkId, MQTT_KEEP_ALIVE_NETWORK_ID_LENGTH );
+            pKeepAlive->networkId[ MQTT_KEEP_ALIVE_NETWORK_ID_LENGTH ] = '\0';
+            pKeepAlive->probing = false;
+            index = findNetwork( pKeepAlive, pKeepAlive->networkId );
+
+            if( index < MQTT_KEEP_ALIVE_MAX_NETWORKS )
+            {
+                pKeepAlive->intervalSec = pKeepAlive->networks[ index ].intervalSec;
+                pKeepAlive->goodSec = pKeepAlive->intervalSec;
+                pKeepAlive->badSec = 0U;
+                pKeepAlive->settled = true;
+                LogInfo( ( "Saved keep-alive of network %s: %u s.",
+                           pKeepAlive->networkId, ( unsigned int ) pKeepAlive->intervalSec ) );
+            }
+            else
+            {
+                pKeepAlive->intervalSec = MQTT_KEEP_ALIVE_INITIAL_SECONDS;
+                pKeepAlive->goodSec = 0U;
+                pKeepAlive->badSec = 0U;
+                pKeepAlive->settled = false;
+                LogInfo( ( "No saved keep-alive for network %s. Probing from %u s.",
+                           pKeepAlive->networkId, ( unsigned int ) pKeepAlive->intervalSec ) );
+            }
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    uint16_t MQTTKeepAlive_GetConnectSeconds( const MQTTKeepAlive_t * pKeepAlive )
+    {
+        uint32_t limitSec = 0U;
+        uint32_t seconds = 0U;
+
+        configASSERT( pKeepAlive != NULL );
+
+        /* While searching, the broker must tolerate the next interval that
+         * the search may try: one below the shortest idle time that failed,
+         * or the double of the current one. Later steps wait for the next
+         * connection, as setInterval() never exceeds the keep-alive of the
+         * CONNECT packet. */
+        if( pKeepAlive->settled == true )
+        {
+            limitSec = pKeepAlive->intervalSec;
+        }
+        else if( pKeepAlive->badSec != 0U )
+        {
+            limitSec = pKeepAlive->badSec;
+        }
+        else
+        {
+            limitSec = ( uint32_t ) pKeepAlive->intervalSec * 2U;
+        }
+
+        seconds = limitSec + ( ( limitSec * MQTT_KEEP_ALIVE_CONNECT_MARGIN_PERCENT ) / 100U );
+
+        if( seconds > MQTT_KEEP_ALIVE_MAX_SECONDS )
+        {
+            seconds = MQTT_KEEP_ALIVE_MAX_SECONDS;
+        }
+
+        return ( uint16_t ) seconds;
+    }
+
+/*-----------------------------------------------------------*/
+
+    void MQTTKeepAlive_Start( MQTTKeepAlive_t * pKeepAlive )
+    {
+        configASSERT( pKeepAlive != NULL );
+
+        /* MQTT_Connect() set the keep-alive of the CONNECT packet. */
+        pKeepAlive->connectSec = pKeepAlive->pContext->keepAliveIntervalSec;
+        pKeepAlive->probing = false;
+        pKeepAlive->lastPingReqMs = pKeepAlive->pContext->pingReqSendTimeMs;
+        pKeepAlive->longestGapMs = 0U;
+
+        if( pKeepAlive->connectSec < pKeepAlive->intervalSec )
+        {
+            LogWarn( ( "The keep-alive of the CONNECT packet, %u s, is shorter than the interval.",
+                       ( unsigned int ) pKeepAlive->connectSec ) );
+        }
+
+        setInterval( pKeepAlive, pKeepAlive->intervalSec );
+    }
+
+/*-----------------------------------------------------------*/
+
+    void MQTTKeepAlive_RecordActivity( MQTTKeepAlive_t * pKeepAlive )
+    {
+        uint32_t nowMs;
+        uint32_t gapMs;
+
+        configASSERT( pKeepAlive != NULL );
+
+        nowMs = pKeepAlive->pContext->getTime();
+        gapMs = nowMs - pKeepAlive->lastActivityMs;
+
+        if( gapMs > pKeepAlive->longestGapMs )
+        {
+            pKeepAlive->longestGapMs = gapMs;
+        }
+
+        if( gapMs >= MQTT_KEEP_ALIVE_RADIO_TAIL_MS )
+        {
+            pKeepAlive->stats.radioWakeups++;
+        }
+
+        pKeepAlive->lastActivityMs = nowMs;
+    }
+
+/*-----------------------------------------------------------*/
+
+    void MQTTKeepAlive_Process( MQTTKeepAlive_t * pKeepAlive )
+    {
+        configASSERT( pKeepAlive != NULL );
+
+        detectPingRequest( pKeepAlive );
+
+        if( ( pKeepAlive->probing == true ) && ( pKeepAlive->pContext->waitingForPingResp == false ) )
+        {
+            pKeepAlive->probing = false;
+            pKeepAlive->stats.pings++;
+            LogDebug( ( "PINGRESP after %u s idle.", ( unsigned int ) pKeepAlive->probeSec ) );
+            probeSucceeded( pKeepAlive, pKeepAlive->probeSec );
+        }
+
+        pKeepAlive->longestGapMs = 0U;
+    }
+
+/*-----------------------------------------------------------*/
+
+    void MQTTKeepAlive_ConnectionLost( MQTTKeepAlive_t * pKeepAlive )
+    {
+        configASSERT( pKeepAlive != NULL );
+
+        detectPingRequest( pKeepAlive );
+
+        if( pKeepAlive->probing == true )
+        {
+            pKeepAlive->probing = false;
+            pKeepAlive->stats.pingFailures++;
+            LogWarn( ( "Connection lost waiting for a PINGRESP after %u s idle.",
+                       ( unsigned int ) pKeepAlive->probeSec ) );
+            probeFailed( pKeepAlive, pKeepAlive->probeSec );
+        }
+
+        pKeepAlive->longestGapMs = 0U;
+    }
+
+/*-----------------------------------------------------------*/
+
+    void MQTTKeepAlive_GetStats( const MQTTKeepAlive_t * pKeepAlive,
+                                 MQTTKeepAliveStats_t * pStats )
+    {
+        configASSERT( pKeepAlive != NULL );
+        configASSERT( pStats != NULL );
+
+        *pStats = pKeepAlive->stats;
+        pStats->elapsedMs = pKeepAlive->pContext->getTime() - pKeepAlive->startMs;
+    }
+
+/*-----------------------------------------------------------*/
+
+    void MQTTKeepAlive_LogStats( const MQTTKeepAlive_t * pKeepAlive )
+    {
+        MQTTKeepAliveStats_t stats;
+        uint32_t wakeupsPerHour = 0U;
+
+        MQTTKeepAlive_GetStats( pKeepAlive, &stats );
+
+        if( stats.elapsedMs > 0U )
+        {
+            wakeupsPerHour = ( uint32_t ) ( ( ( uint64_t ) stats.radioWakeups * 3600000U ) / stats.elapsedMs );
+        }
+
+        LogInfo( ( "Keep-alive %u s on network %s (%s). %u PINGREQs answered, %u failed. "
+                   "%u radio wakeups, %u per hour.",
+                   ( unsigned int ) pKeepAlive->intervalSec,
+                   pKeepAlive->networkId,
+                   ( pKeepAlive->settled == true ) ? "settled" : "probing",
+                   ( unsigned int ) stats.pings,
+                   ( unsigned int ) stats.pingFailures,
+                   ( unsigned int ) stats.radioWakeups,
+                   ( unsigned int ) wakeupsPerHour ) );
+    }
+
+#endif /* ifdef MQTT_ADAPTIVE_KEEP_ALIVE */
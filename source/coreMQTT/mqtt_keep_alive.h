@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/**
+ * @file mqtt_keep_alive.h
+ * @brief Keep-alive interval learned from the NAT of the network.
+ *
+ * Built when MQTT_ADAPTIVE_KEEP_ALIVE is defined in core_mqtt_config.h.
+ *
+ * A carrier NAT drops the binding of a TCP connection that stays idle for
+ * longer than its timeout, after which the connection is dead without either
+ * end being told. A fixed keep-alive is either shorter than needed, and
+ * wakes the radio for nothing, or longer than the timeout of some networks.
+ *
+ * The client sends its PINGREQs at an interval that it learns, and connects
+ * with a keep-alive #MQTT_KEEP_ALIVE_CONNECT_MARGIN_PERCENT above the longest
+ * interval it may use on the connection, so that the broker notices a dead
+ * client within one and a half times that. While it searches, that is the
+ * next interval the search may try. Once the interval of the network is
+ * settled, it is that interval. Each PINGREQ after an idle period is a probe
+ * of that idle time: a PINGRESP proves that the NAT kept the binding, and a
+ * connection lost while waiting for the PINGRESP shows that it did not. The
+ * interval grows from #MQTT_KEEP_ALIVE_INITIAL_SECONDS until a probe fails,
+ * then bisects between the longest idle time that worked and the shortest
+ * that failed. Once they are within #MQTT_KEEP_ALIVE_RESOLUTION_SECONDS, it
+ * settles #MQTT_KEEP_ALIVE_MARGIN_PERCENT below the longest one that worked,
+ * and the value is saved to a file under the identifier of the network.
+ *
+ * After a failed probe, the interval falls back to the longest idle time
+ * that worked, or halves if none did. If the settled interval fails, the
+ * network has changed its timeout: the value is forgotten and the search
+ * starts again from half the interval.
+ *
+ * Probes only happen while the connection is idle: a client that publishes
+ * more often than its keep-alive never sends a PINGREQ.
+ *
+ * The radio wakeups are estimated from the transport traffic: a send or
+ * receive after #MQTT_KEEP_ALIVE_RADIO_TAIL_MS without traffic counts as
+ * one.
+ *
+ * This module depends on coreMQTT v1 only. coreMQTT has no call to change
+ * the keep-alive of a connection, so the interval is applied by writing the
+ * keepAliveIntervalSec field of the MQTT context, and PINGREQs are detected
+ * from its pingReqSendTimeMs and waitingForPingResp fields. These are
+ * internal to coreMQTT: v1 reads keepAliveIntervalSec again at each
+ * MQTT_ProcessLoop(), which other versions are not bound to do. The module
+ * stops the build on coreMQTT v2; check the fields again before porting it.
+ */
+
+#ifndef MQTT_KEEP_ALIVE_H
+#define MQTT_KEEP_ALIVE_H
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+
+/* MQTT library includes. */
+#include "core_mqtt.h"
+
+/**
+ * @brief Longest keep-alive of the CONNECT packet, and longest interval the
+ * client may learn. AWS IoT Core accepts up to 1200 seconds.
+ */
+#ifndef MQTT_KEEP_ALIVE_MAX_SECONDS
+    #define MQTT_KEEP_ALIVE_MAX_SECONDS    ( 1200U )
+#endif
+
+/**
+ * @brief How far above the settled interval the keep-alive of the CONNECT
+ * packet is, so that a PINGREQ that the process loop sends late is still in
+ * time.
+ */
+#ifndef MQTT_KEEP_ALIVE_CONNECT_MARGIN_PERCENT
+    #define MQTT_KEEP_ALIVE_CONNECT_MARGIN_PERCENT    ( 25U )
+#endif
+
+/**
+ * @brief Shortest interval. A network whose NAT drops bindings sooner keeps
+ * this one.
+ */
+#ifndef MQTT_KEEP_ALIVE_MIN_SECONDS
+    #define MQTT_KEEP_ALIVE_MIN_SECONDS    ( 20U )
+#endif
+
+/**
+ * @brief First interval on a network without a saved value.
+ */
+#ifndef MQTT_KEEP_ALIVE_INITIAL_SECONDS
+    #define MQTT_KEEP_ALIVE_INITIAL_SECONDS    ( 60U )
+#endif
+
+/**
+ * @brief The search stops once the longest idle time that worked and the
+ * shortest that failed are this close.
+ */
+#ifndef MQTT_KEEP_ALIVE_RESOLUTION_SECONDS
+    #define MQTT_KEEP_ALIVE_RESOLUTION_SECONDS    ( 15U )
+#endif
+
+/**
+ * @brief How far below the longest idle time that worked the interval
+ * settles, to absorb the jitter of the NAT and of the PINGREQ timing.
+ */
+#ifndef MQTT_KEEP_ALIVE_MARGIN_PERCENT
+    #define MQTT_KEEP_ALIVE_MARGIN_PERCENT    ( 10U )
+#endif
+
+/**
+ * @brief Idle time after which the radio is assumed to be asleep, about the
+ * inactivity timer of LTE.
+ */
+#ifndef MQTT_KEEP_ALIVE_RADIO_TAIL_MS
+    #define MQTT_KEEP_ALIVE_RADIO_TAIL_MS    ( 10000U )
+#endif
+
+/**
+ * @brief Number of networks whose interval is saved. The least recently
+ * used one is forgotten first.
+ */
+#ifndef MQTT_KEEP_ALIVE_MAX_NETWORKS
+    #define MQTT_KEEP_ALIVE_MAX_NETWORKS    ( 8U )
+#endif
+
+/**
+ * @brief Longest identifier of a network, for example "310-410" for an MCC
+ * and MNC.
+ */
+#define MQTT_KEEP_ALIVE_NETWORK_ID_LENGTH    ( 15U )
+
+/**
+ * @brief Interval saved for a network.
+ */
+typedef struct MQTTKeepAliveNetwork
+{
+    char id[ MQTT_KEEP_ALIVE_NETWORK_ID_LENGTH + 1U ]; /**< @brief Identifier of the network, or empty. */
+    uint16_t intervalSec;                              /**< @brief Settled interval. */
+} MQTTKeepAliveNetwork_t;
+
+/**
+ * @brief Counters since MQTTKeepAlive_Init().
+ */
+typedef struct MQTTKeepAliveStats
+{
+    uint32_t pings;        /**< @brief PINGREQs answered. */
+    uint32_t pingFailures; /**< @brief Connections lost while waiting for a PINGRESP. */
+    uint32_t radioWakeups; /**< @brief Estimated radio wakeups. */
+    uint32_t elapsedMs;    /**< @brief Time since MQTTKeepAlive_Init(). */
+} MQTTKeepAliveStats_t;
+
+/**
+ * @brief Adaptive keep-alive. Its fields are private.
+ */
+typedef struct MQTTKeepAlive
+{
+    MQTTContext_t * pContext;                                        /**< @brief The MQTT context. */
+    const char * pPath;                                              /**< @brief File of the saved intervals, or NULL. */
+    MQTTKeepAliveNetwork_t networks[ MQTT_KEEP_ALIVE_MAX_NETWORKS ]; /**< @brief Saved intervals, most recently used first. */
+    char networkId[ MQTT_KEEP_ALIVE_NETWORK_ID_LENGTH + 1U ];        /**< @brief Identifier of the current network. */
+    uint16_t intervalSec;                                            /**< @brief Interval of the PINGREQs. */
+    uint16_t connectSec;                                             /**< @brief Keep-alive of the CONNECT packet. */
+    uint16_t goodSec;                                                /**< @brief Longest idle time that kept the connection, or 0. */
+    uint16_t badSec;                                                 /**< @brief Shortest idle time that lost it, or 0. */
+    bool settled;                                                    /**< @brief Whether the search is over. */
+    bool probing;                                                    /**< @brief Whether a PINGREQ waits for its PINGRESP. */
+    uint16_t probeSec;                                               /**< @brief Idle time before that PINGREQ. */
+    uint32_t lastPingReqMs;                                          /**< @brief Send time of the last PINGREQ seen. */
+    uint32_t lastActivityMs;                                         /**< @brief Time of the last send or receive. */
+    uint32_t longestGapMs;                                           /**< @brief Longest idle time since the last MQTTKeepAlive_Process(). */
+    uint32_t startMs;                                                /**< @brief Time of MQTTKeepAlive_Init(). */
+    MQTTKeepAliveStats_t stats;                                      /**< @brief Counters. */
+} MQTTKeepAlive_t;
+
+/**
+ * @brief Set up the adaptive keep-alive of a connection, and load the saved
+ * intervals.
+ *
+ * @param[out] pKeepAlive The adaptive keep-alive.
+ * @param[in] pContext MQTT context, initialized with MQTT_Init(). It may be
+ * reconnected while the keep-alive is in use.
+ * @param[in] pPath File of the saved intervals, or NULL not to save them.
+ *
+ * @return #MQTTSuccess, or #MQTTBadParameter.
+ */
+MQTTStatus_t MQTTKeepAlive_Init( MQTTKeepAlive_t * pKeepAlive,
+                                 MQTTContext_t * pContext,
+                                 const char * pPath );
+
+/**
+ * @brief Select the network of the next connection. Its saved interval is
+ * used if there is one, otherwise the search starts.
+ *
+ * @param[in] pKeepAlive The adaptive keep-alive.
+ * @param[in] pNetworkId Identifier of the network, truncated to
+ * #MQTT_KEEP_ALIVE_NETWORK_ID_LENGTH characters.
+ */
+void MQTTKeepAlive_SelectNetwork( MQTTKeepAlive_t * pKeepAlive,
+                                  const char * pNetworkId );
+
+/**
+ * @brief Get the keep-alive to put in the CONNECT packet, after
+ * MQTTKeepAlive_SelectNetwork().
+ *
+ * @param[in] pKeepAlive The adaptive keep-alive.
+ *
+ * @return The settled interval, or while the interval is searched, the next
+ * one the search may try, plus #MQTT_KEEP_ALIVE_CONNECT_MARGIN_PERCENT and at
+ * most #MQTT_KEEP_ALIVE_MAX_SECONDS.
+ */
+uint16_t MQTTKeepAlive_GetConnectSeconds( const MQTTKeepAlive_t * pKeepAlive );
+
+/**
+ * @brief Apply the interval to a connection, once MQTT_Connect() has
+ * succeeded with the keep-alive of MQTTKeepAlive_GetConnectSeconds().
+ *
+ * If the settled interval fails during the connection, the search starts
+ * again below it. Intervals longer than the keep-alive of the CONNECT packet
+ * are only tried on the next connection, which advertises a longer one.
+ *
+ * @param[in] pKeepAlive The adaptive keep-alive.
+ */
+void MQTTKeepAlive_Start( MQTTKeepAlive_t * pKeepAlive );
+
+/**
+ * @brief Record a send or a receive of the transport, for the idle time of
+ * the probes and the count of radio wakeups. Call it from the transport
+ * send and receive functions given to MQTT_Init(), when they moved data.
+ *
+ * @param[in] pKeepAlive The adaptive keep-alive.
+ */
+void MQTTKeepAlive_RecordActivity( MQTTKeepAlive_t * pKeepAlive );
+
+/**
+ * @brief Look for PINGREQs sent and answered, and adjust the interval. Call
+ * it after each MQTT_ProcessLoop(), or each call that runs one.
+ *
+ * @param[in] pKeepAlive The adaptive keep-alive.
+ */
+void MQTTKeepAlive_Process( MQTTKeepAlive_t * pKeepAlive );
+
+/**
+ * @brief Record the loss of the connection. If a PINGREQ was waiting for its
+ * PINGRESP, the probe failed and the interval falls back.
+ *
+ * @param[in] pKeepAlive The adaptive keep-alive.
+ */
+void MQTTKeepAlive_ConnectionLost( MQTTKeepAlive_t * pKeepAlive );
+
+/**
+ * @brief Copy the counters.
+ *
+ * @param[in] pKeepAlive The adaptive keep-alive.
+ * @param[out] pStats Where to write the counters.
+ */
+void MQTTKeepAlive_GetStats( const MQTTKeepAlive_t * pKeepAlive,
+                             MQTTKeepAliveStats_t * pStats );
+
+/**
+ * @brief Log the interval and the radio wakeups per hour.
+ *
+ * @param[in] pKeepAlive The adaptive keep-alive.
+ */
+void MQTTKeepAlive_LogStats( const MQTTKeepAlive_t * pKeepAlive );
+
+#endif /* ifndef MQTT_KEEP_ALIVE_H */
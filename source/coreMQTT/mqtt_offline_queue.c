@@ -0,0 +1,1074 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file mqtt_offline_queue.c
+ * @brief Durable store-and-forward queue of QoS1 publishes.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/* Configure logs for the functions in this file, before core_mqtt_config.h
+ * sets those of coreMQTT. */
+#include "logging_levels.h"
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "OfflineQueue"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_INFO
+#endif
+#include "logging_stack.h"
+
+#include "mqtt_offline_queue.h"
+
+#ifdef MQTT_OFFLINE_QUEUE
+
+/**
+ * @brief Size of the record header.
+ *
+ * Bytes 0 and 1 hold a magic number, byte 2 the state and byte 3 is
+ * reserved. Then come the sequence number, the topic length and the payload
+ * length, and the CRC-32 of those three fields, the topic and the payload.
+ * Numbers are little endian.
+ */
+    #define RECORD_HEADER_SIZE       ( 16U )
+
+/**
+ * @brief Offset of the state byte in the header. It is not covered by the
+ * CRC, so that removing a record does not invalidate it.
+ */
+    #define RECORD_STATE_OFFSET      ( 2U )
+
+/**
+ * @brief State of a record in the queue, as written on erased flash.
+ */
+    #define RECORD_STATE_QUEUED      ( 0xFFU )
+
+/**
+ * @brief State of a removed record, reachable from 0xFF without an erase.
+ */
+    #define RECORD_STATE_REMOVED     ( 0x00U )
+
+/**
+ * @brief First two bytes of every record.
+ */
+    #define RECORD_MAGIC_0           ( 0x5AU )
+    #define RECORD_MAGIC_1           ( 0xA5U )
+
+/**
+ * @brief Records start on multiples of this, which is also the step of the
+ * scan for records at start.
+ */
+    #define RECORD_ALIGNMENT         ( 4U )
+
+/**
+ * @brief Round @p x up to a multiple of @p a.
+ */
+    #define ROUND_UP( x, a )         ( ( ( ( x ) + ( a ) - 1U ) / ( a ) ) * ( a ) )
+
+/**
+ * @brief Chunk of 0xFF written to fill a new file.
+ */
+    #define FILE_FILL_CHUNK_SIZE     ( 64U )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Decoded record header.
+ */
+    typedef struct RecordHeader
+    {
+        uint8_t state;          /**< @brief #RECORD_STATE_QUEUED or #RECORD_STATE_REMOVED. */
+        uint32_t sequence;      /**< @brief Sequence number, one more than the record before. */
+        uint16_t topicLength;   /**< @brief Length of the topic. */
+        uint16_t payloadLength; /**< @brief Length of the payload. */
+        uint32_t crc;           /**< @brief CRC-32 of the record. */
+    } RecordHeader_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Update a CRC-32 (IEEE 802.3, reflected) with bytes.
+ *
+ * @param[in] crc CRC so far, starting at 0.
+ * @param[in] pData The bytes.
+ * @param[in] length Number of bytes.
+ *
+ * @return The updated CRC.
+ */
+    static uint32_t crc32Update( uint32_t crc,
+                                 const uint8_t * pData,
+                                 size_t length );
+
+/**
+ * @brief CRC-32 of a record.
+ *
+ * @param[in] pHeader Header of the record.
+ * @param[in] pTopic Topic of the record.
+ * @param[in] pPayload Payload of the record.
+ *
+ * @return The CRC.
+ */
+    static uint32_t recordCrc( const RecordHeader_t * pHeader,
+                               const uint8_t * pTopic,
+                               const uint8_t * pPayload );
+
+/**
+ * @brief Space taken by a record in the storage.
+ *
+ * @param[in] pHeader Header of the record.
+ *
+ * @return Size in bytes, a multiple of #RECORD_ALIGNMENT.
+ */
+    static size_t recordSize( const RecordHeader_t * pHeader );
+
+/**
+ * @brief Read and decode the header at an offset.
+ *
+ * @param[in] pQueue The queue.
+ * @param[in] offset Offset of the header.
+ * @param[out] pHeader The decoded header.
+ * @param[out] pValid Whether the magic number is present and the record fits
+ * in the storage and in the batch buffer.
+ *
+ * @return #MQTT_OFFLINE_QUEUE_SUCCESS or #MQTT_OFFLINE_QUEUE_STORAGE_ERROR.
+ */
+    static MQTTOfflineQueueStatus_t readHeader( const MQTTOfflineQueue_t * pQueue,
+                                                size_t offset,
+                                                RecordHeader_t * pHeader,
+                                                bool * pValid );
+
+/**
+ * @brief Read the topic and payload of a record and check its CRC.
+ *
+ * @param[in] pQueue The queue.
+ * @param[in] offset Offset of the record.
+ * @param[in] pHeader Header of the record.
+ * @param[out] pData Where to write the topic followed by the payload.
+ * @param[out] pValid Whether the CRC matches.
+ *
+ * @return #MQTT_OFFLINE_QUEUE_SUCCESS or #MQTT_OFFLINE_QUEUE_STORAGE_ERROR.
+ */
+    static MQTTOfflineQueueStatus_t readBody( const MQTTOfflineQueue_t * pQueue,
+                                              size_t offset,
+                                              const RecordHeader_t * pHeader,
+                                              uint8_t * pData,
+                                              bool * pValid );
+
+/**
+ * @brief Find the record that follows another one.
+ *
+ * It starts right after the other record, or at the next sector when the
+ * writer skipped the rest of a sector after a reset, or at offset 0 when the
+ * writer wrapped around.
+ *
+ * @param[in] pQueue The queue.
+ * @param[in] endOffset End of the other record.
+ * @param[in] sequence Sequence number of the other record.
+ * @param[out] pNextOffset Offset of the next record.
+ * @param[out] pFound Whether the next record was found.
+ *
+ * @return #MQTT_OFFLINE_QUEUE_SUCCESS or #MQTT_OFFLINE_QUEUE_STORAGE_ERROR.
+ */
+    static MQTTOfflineQueueStatus_t findNext( const MQTTOfflineQueue_t * pQueue,
+                                              size_t endOffset,
+                                              uint32_t sequence,
+                                              size_t * pNextOffset,
+                                              bool * pFound );
+
+/**
+ * @brief Bytes from the head up to the oldest record.
+ *
+ * @param[in] pQueue The queue.
+ *
+ * @return Free bytes, the whole storage if the queue is empty.
+ */
+    static size_t freeSpace( const MQTTOfflineQueue_t * pQueue );
+
+/**
+ * @brief Mark the oldest record as removed and move the tail to the next one.
+ *
+ * @param[in] pQueue The queue.
+ *
+ * @return #MQTT_OFFLINE_QUEUE_SUCCESS or #MQTT_OFFLINE_QUEUE_STORAGE_ERROR.
+ */
+    static MQTTOfflineQueueStatus_t removeTail( MQTTOfflineQueue_t * pQueue );
+
+/**
+ * @brief Scan the storage for the records left by an earlier run.
+ *
+ * @param[in] pQueue The queue.
+ *
+ * @return #MQTT_OFFLINE_QUEUE_SUCCESS or #MQTT_OFFLINE_QUEUE_STORAGE_ERROR.
+ */
+    static MQTTOfflineQueueStatus_t recover( MQTTOfflineQueue_t * pQueue );
+
+/**
+ * @brief Read function of the file storage.
+ */
+    static int32_t fileRead( void * pContext,
+                             size_t offset,
+                             void * pBuffer,
+                             size_t length );
+
+/**
+ * @brief Write function of the file storage. Flushes every write.
+ */
+    static int32_t fileWrite( void * pContext,
+                              size_t offset,
+                              const void * pBuffer,
+                              size_t length );
+
+/*-----------------------------------------------------------*/
+
+    static uint32_t crc32Update( uint32_t crc,
+                                 const uint8_t * pData,
+                                 size_t length )
+    {
+        size_t i;
+        uint32_t bit;
+
+        /* Bitwise rather than with a table, to save 1 KB of flash. The records
+         * are small and written at most every few seconds. */
+        crc = ~crc;
+
+        for( i = 0U; i < length; i++ )
+        {
+            crc ^= pData[ i ];
+
+            for( bit = 0U; bit < 8U; bit++ )
+            {
+                crc = ( crc >> 1 ) ^ ( 0xEDB88320U & ( 0U - ( crc & 1U ) ) );
+            }
+        }
+
+        return ~crc;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static uint32_t recordCrc( const RecordHeader_t * pHeader,
+                               const uint8_t * pTopic,
+                               const uint8_t * pPayload )
+    {
+        uint8_t fields[ 8 ];
+        uint32_t crc;
+
+        fields[ 0 ] = ( uint8_t ) pHeader->sequence;
+        fields[ 1 ] = ( uint8_t ) ( pHeader->sequence >> 8 );
+        fields[ 2 ] = ( uint8_t ) ( pHeader->sequence >> 16 );
+        fields[ 3 ] = ( uint8_t ) ( pHeader->sequence >> 24 );
+        fields[ 4 ] = ( uint8_t ) pHeader->topicLength;
+        fields[ 5 ] = ( uint8_t ) ( pHeader->topicLength >> 8 );
+        fields[ 6 ] = ( uint8_t ) pHeader->payloadLength;
+        fields[ 7 ] = ( uint8_t ) ( pHeader->payloadLength >> 8 );
+
+        crc = crc32Update( 0U, fields, sizeof( fields ) );
+        crc = crc32Update( crc, pTopic, pHeader->topicLength );
+        crc = crc32Update( crc, pPayload, pHeader->payloadLength );
+
+        return crc;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static size_t recordSize( const RecordHeader_t * pHeader )
+    {
+        return ROUND_UP( RECORD_HEADER_SIZE + ( size_t ) pHeader->topicLength + ( size_t ) pHeader->payloadLength,
+                         RECORD_ALIGNMENT );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static MQTTOfflineQueueStatus_t readHeader( const MQTTOfflineQueue_t * pQueue,
+                                                size_t offset,
+                                                RecordHeader_t * pHeader,
+                                                bool * pValid )
+    {
+        MQTTOfflineQueueStatus_t status = MQTT_OFFLINE_QUEUE_SUCCESS;
+        uint8_t bytes[ RECORD_HEADER_SIZE ];
+        size_t dataLength;
+
+        *pValid = false;
+
+        if( ( offset + RECORD_HEADER_SIZE ) <= pQueue->storage.size )
+        {
+            if( pQueue->storage.read( pQueue->storage.pContext, offset, bytes, sizeof( bytes ) ) != 0 )
+            {
+                LogError( ( "Failed to read the record header at offset %u.", ( unsigned int ) offset ) );
+                status = MQTT_OFFLINE_QUEUE_STORAGE_ERROR;
+            }
+            else if( ( bytes[ 0 ] == RECORD_MAGIC_0 ) && ( bytes[ 1 ] == RECORD_MAGIC_1 ) )
+            {
+                pHeader->state = bytes[ RECORD_STATE_OFFSET ];
+                pHeader->sequence = ( uint32_t ) bytes[ 4 ] | ( ( uint32_t ) bytes[ 5 ] << 8 ) |
+                                    ( ( uint32_t ) bytes[ 6 ] << 16 ) | ( ( uint32_t ) bytes[ 7 ] << 24 );
+                pHeader->topicLength = ( uint16_t ) ( bytes[ 8 ] | ( bytes[ 9 ] << 8 ) );
+                pHeader->payloadLength = ( uint16_t ) ( bytes[ 10 ] | ( bytes[ 11 ] << 8 ) );
+                pHeader->crc = ( uint32_t ) bytes[ 12 ] | ( ( uint32_t ) bytes[ 13 ] << 8 ) |
+                               ( ( uint32_t ) bytes[ 14 ] << 16 ) | ( ( uint32_t ) bytes[ 15 ] << 24 );
+
+                dataLength = ( size_t ) pHeader->topicLength + ( size_t ) pHeader->payloadLength;
+
+                /* The magic number may also occur in the topic or payload of a
+                 * record, so check that the lengths make sense. */
+                *pValid = ( ( dataLength <= MQTT_OFFLINE_QUEUE_BUFFER_SIZE ) &&
+                            ( ( offset + recordSize( pHeader ) ) <= pQueue->storage.size ) );
+            }
+            else
+            {
+                /* Empty else MISRA 15.7 */
+            }
+        }
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static MQTTOfflineQueueStatus_t readBody( const MQTTOfflineQueue_t * pQueue,
+                                              size_t offset,
+                                              const RecordHeader_t * pHeader,
+                                              uint8_t * pData,
+                                              bool * pValid )
+    {
+        MQTTOfflineQueueStatus_t status = MQTT_OFFLINE_QUEUE_SUCCESS;
+        size_t dataLength = ( size_t ) pHeader->topicLength + ( size_t ) pHeader->payloadLength;
+
+        *pValid = false;
+
+        if( ( dataLength > 0U ) &&
+            ( pQueue->storage.read( pQueue->storage.pContext, offset + RECORD_HEADER_SIZE, pData, dataLength ) != 0 ) )
+        {
+            LogError( ( "Failed to read the record at offset %u.", ( unsigned int ) offset ) );
+            status = MQTT_OFFLINE_QUEUE_STORAGE_ERROR;
+        }
+        else
+        {
+            *pValid = ( recordCrc( pHeader, pData, &( pData[ pHeader->topicLength ] ) ) == pHeader->crc );
+        }
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static MQTTOfflineQueueStatus_t findNext( const MQTTOfflineQueue_t * pQueue,
+                                              size_t endOffset,
+                                              uint32_t sequence,
+                                              size_t * pNextOffset,
+                                              bool * pFound )
+    {
+        MQTTOfflineQueueStatus_t status = MQTT_OFFLINE_QUEUE_SUCCESS;
+        size_t candidates[ 3 ];
+        size_t i;
+        RecordHeader_t header;
+        bool valid = false;
+
+        candidates[ 0 ] = endOffset;
+        candidates[ 1 ] = ( pQueue->storage.sectorSize > 0U ) ?
+                          ROUND_UP( endOffset, pQueue->storage.sectorSize ) : endOffset;
+        candidates[ 2 ] = 0U;
+
+        *pFound = false;
+
+        /* Stale records of the previous lap of the ring have older sequence
+         * numbers, so only the expected number is accepted. */
+        for( i = 0U; ( i < 3U ) && ( *pFound == false ) && ( status == MQTT_OFFLINE_QUEUE_SUCCESS ); i++ )
+        {
+            status = readHeader( pQueue, candidates[ i ], &header, &valid );
+
+            if( ( status == MQTT_OFFLINE_QUEUE_SUCCESS ) && ( valid == true ) &&
+                ( header.sequence == ( sequence + 1U ) ) )
+            {
+                *pNextOffset = candidates[ i ];
+                *pFound = true;
+            }
+        }
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static size_t freeSpace( const MQTTOfflineQueue_t * pQueue )
+    {
+        size_t available;
+
+        if( pQueue->count == 0U )
+        {
+            available = pQueue->storage.size;
+        }
+        else if( pQueue->tail > pQueue->head )
+        {
+            available = pQueue->tail - pQueue->head;
+        }
+        else
+        {
+            /* Up to the end, then from the start. Zero if the last record ends
+             * right at the oldest one. */
+            available = ( pQueue->storage.size - pQueue->head ) + pQueue->tail;
+
+            if( pQueue->tail == pQueue->head )
+            {
+                available = 0U;
+            }
+        }
+
+        return available;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static MQTTOfflineQueueStatus_t removeTail( MQTTOfflineQueue_t * pQueue )
+    {
+        MQTTOfflineQueueStatus_t status = MQTT_OFFLINE_QUEUE_SUCCESS;
+        const uint8_t removed = RECORD_STATE_REMOVED;
+        RecordHeader_t header;
+        bool valid = false;
+        bool found = false;
+        size_t nextOffset = 0U;
+
+        configASSERT( pQueue->count > 0U );
+
+        status = readHeader( pQueue, pQueue->tail, &header, &valid );
+
+        if( ( status == MQTT_OFFLINE_QUEUE_SUCCESS ) &&
+            ( pQueue->storage.write( pQueue->storage.pContext,
+                                     pQueue->tail + RECORD_STATE_OFFSET,
+                                     &removed,
+                                     sizeof( removed ) ) != 0 ) )
+        {
+            LogError( ( "Failed to remove the record at offset %u.", ( unsigned int ) pQueue->tail ) );
+            status = MQTT_OFFLINE_QUEUE_STORAGE_ERROR;
+        }
+
+        if( status == MQTT_OFFLINE_QUEUE_SUCCESS )
+        {
+            pQueue->count--;
+
+            if( pQueue->count > 0U )
+            {
+                if( valid == true )
+                {
+                    status = findNext( pQueue, pQueue->tail + recordSize( &header ), pQueue->tailSequence,
+                                       &nextOffset, &found );
+                }
+
+                if( found == true )
+                {
+                    pQueue->tail = nextOffset;
+                    pQueue->tailSequence++;
+                }
+                else
+                {
+                    LogError( ( "Lost %u records after a damaged record at offset %u.",
+                                ( unsigned int ) pQueue->count,
+                                ( unsigned int ) pQueue->tail ) );
+                    pQueue->stats.corrupted += ( uint32_t ) pQueue->count;
+                    pQueue->count = 0U;
+                }
+            }
+
+            if( pQueue->count == 0U )
+            {
+                pQueue->tail = pQueue->head;
+                pQueue->tailSequence = pQueue->nextSequence;
+            }
+        }
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static MQTTOfflineQueueStatus_t recover( MQTTOfflineQueue_t * pQueue )
+    {
+        MQTTOfflineQueueStatus_t status = MQTT_OFFLINE_QUEUE_SUCCESS;
+        RecordHeader_t header;
+        bool valid = false;
+        bool anyRecord = false;
+        size_t offset = 0U;
+
+        while( ( status == MQTT_OFFLINE_QUEUE_SUCCESS ) &&
+               ( ( offset + RECORD_HEADER_SIZE ) <= pQueue->storage.size ) )
+        {
+            status = readHeader( pQueue, offset, &header, &valid );
+
+            if( ( status == MQTT_OFFLINE_QUEUE_SUCCESS ) && ( valid == true ) )
+            {
+                status = readBody( pQueue, offset, &header, pQueue->buffer, &valid );
+            }
+
+            if( ( status == MQTT_OFFLINE_QUEUE_SUCCESS ) && ( valid == true ) )
+            {
+                /* The newest record ends where the next one goes. */
+                if( ( anyRecord == false ) || ( header.sequence >= pQueue->nextSequence ) )
+                {
+                    pQueue->nextSequence = header.sequence + 1U;
+                    pQueue->head = offset + recordSize( &header );
+                }
+
+                /* The oldest record not removed is the tail. */
+                if( header.state == RECORD_STATE_QUEUED )
+                {
+                    if( ( pQueue->count == 0U ) || ( header.sequence < pQueue->tailSequence ) )
+                    {
+                        pQueue->tail = offset;
+                        pQueue->tailSequence = header.sequence;
+                    }
+
+                    pQueue->count++;
+                }
+
+                anyRecord = true;
+                offset += recordSize( &header );
+            }
+            else
+            {
+                offset += RECORD_ALIGNMENT;
+            }
+        }
+
+        if( pQueue->head >= pQueue->storage.size )
+        {
+            pQueue->head = 0U;
+        }
+
+        if( pQueue->count == 0U )
+        {
+            pQueue->tail = pQueue->head;
+            pQueue->tailSequence = pQueue->nextSequence;
+        }
+
+        /* The rest of the sector of the head may hold a torn record, so it is not
+         * known to be erased. */
+        pQueue->erasedEnd = pQueue->head;
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static int32_t fileRead( void * pContext,
+                             size_t offset,
+                             void * pBuffer,
+                             size_t length )
+    {
+        FILE * pFile = ( ( MQTTOfflineFileStorage_t * ) pContext )->pFile;
+        int32_t result = 0;
+
+        if( ( fseek( pFile, ( long ) offset, SEEK_SET ) != 0 ) ||
+            ( fread( pBuffer, 1U, length, pFile ) != length ) )
+        {
+            result = -1;
+        }
+
+        return result;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static int32_t fileWrite( void * pContext,
+                              size_t offset,
+                              const void * pBuffer,
+                              size_t length )
+    {
+        FILE * pFile = ( ( MQTTOfflineFileStorage_t * ) pContext )->pFile;
+        int32_t result = 0;
+
+        if( ( fseek( pFile, ( long ) offset, SEEK_SET ) != 0 ) ||
+            ( fwrite( pBuffer, 1U, length, pFile ) != length ) ||
+            ( fflush( pFile ) != 0 ) )
+        {
+            result = -1;
+        }
+
+        return result;
+    }
+
+/*-----------------------------------------------------------*/
+
+    MQTTOfflineQueueStatus_t MQTTOfflineQueue_OpenFile( MQTTOfflineFileStorage_t * pFileStorage,
+                                                        const char * pPath,
+                                                        size_t size,
+                                                        MQTTOfflineStorage_t * pStorage )
+    {
+        MQTTOfflineQueueStatus_t status = MQTT_OFFLINE_QUEUE_SUCCESS;
+        uint8_t fill[ FILE_FILL_CHUNK_SIZE ];
+        long fileSize = 0;
+        size_t chunk;
+
+        if( ( pFileStorage == NULL ) || ( pPath == NULL ) || ( pStorage == NULL ) ||
+            ( size < RECORD_HEADER_SIZE ) || ( ( size % RECORD_ALIGNMENT ) != 0U ) )
+        {
+            LogError( ( "Invalid parameter: pFileStorage=%p, pPath=%p, size=%u, pStorage=%p.",
+                        ( void * ) pFileStorage,
+                        ( const void * ) pPath,
+                        ( unsigned int ) size,
+                        ( void * ) pStorage ) );
+            status = MQTT_OFFLINE_QUEUE_INVALID_PARAMETER;
+        }
+        else
+        {
+            pFileStorage->pFile = fopen( pPath, "r+b" );
+
+            if( pFileStorage->pFile == NULL )
+            {
+                pFileStorage->pFile = fopen( pPath, "w+b" );
+            }
+
+            if( ( pFileStorage->pFile != NULL ) && ( fseek( pFileStorage->pFile, 0, SEEK_END ) == 0 ) )
+            {
+                fileSize = ftell( pFileStorage->pFile );
+            }
+
+            if( ( pFileStorage->pFile == NULL ) || ( fileSize < 0 ) )
+            {
+                LogError( ( "Failed to open %s.", pPath ) );
+                status = MQTT_OFFLINE_QUEUE_STORAGE_ERROR;
+            }
+        }
+
+        /* Fill a new or shorter file with 0xFF, the state of queued records. */
+        ( void ) memset( fill, 0xFF, sizeof( fill ) );
+
+        while( ( status == MQTT_OFFLINE_QUEUE_SUCCESS ) && ( ( size_t ) fileSize < size ) )
+        {
+            chunk = size - ( size_t ) fileSize;
+
+            if( chunk > sizeof( fill ) )
+            {
+                chunk = sizeof( fill );
+            }
+
+            if( fwrite( fill, 1U, chunk, pFileStorage->pFile ) != chunk )
+            {
+                LogError( ( "Failed to extend %s to %u bytes.", pPath, ( unsigned int ) size ) );
+                status = MQTT_OFFLINE_QUEUE_STORAGE_ERROR;
+            }
+
+            fileSize += ( long ) chunk;
+        }
+
+        if( ( status == MQTT_OFFLINE_QUEUE_SUCCESS ) && ( fflush( pFileStorage->pFile ) != 0 ) )
+        {
+            status = MQTT_OFFLINE_QUEUE_STORAGE_ERROR;
+        }
+
+        if( status == MQTT_OFFLINE_QUEUE_SUCCESS )
+        {
+            ( void ) memset( pStorage, 0, sizeof( MQTTOfflineStorage_t ) );
+            pStorage->pContext = pFileStorage;
+            pStorage->size = size;
+            pStorage->sectorSize = 0U;
+            pStorage->read = fileRead;
+            pStorage->write = fileWrite;
+            pStorage->erase = NULL;
+        }
+        else if( ( pFileStorage != NULL ) && ( pFileStorage->pFile != NULL ) )
+        {
+            ( void ) fclose( pFileStorage->pFile );
+            pFileStorage->pFile = NULL;
+        }
+        else
+        {
+            /* Empty else MISRA 15.7 */
+        }
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+    MQTTOfflineQueueStatus_t MQTTOfflineQueue_Init( MQTTOfflineQueue_t * pQueue,
+                                                    const MQTTOfflineStorage_t * pStorage,
+                                                    MQTTOfflineQueuePolicy_t policy )
+    {
+        MQTTOfflineQueueStatus_t status = MQTT_OFFLINE_QUEUE_SUCCESS;
+
+        if( ( pQueue == NULL ) || ( pStorage == NULL ) ||
+            ( pStorage->read == NULL ) || ( pStorage->write == NULL ) ||
+            ( pStorage->size < RECORD_HEADER_SIZE ) || ( ( pStorage->size % RECORD_ALIGNMENT ) != 0U ) ||
+            ( ( pStorage->sectorSize > 0U ) &&
+              ( ( pStorage->erase == NULL ) || ( ( pStorage->size % pStorage->sectorSize ) != 0U ) ) ) )
+        {
+            LogError( ( "Invalid parameter: pQueue=%p, pStorage=%p.",
+                        ( void * ) pQueue,
+                        ( const void * ) pStorage ) );
+            status = MQTT_OFFLINE_QUEUE_INVALID_PARAMETER;
+        }
+        else
+        {
+            ( void ) memset( pQueue, 0, sizeof( MQTTOfflineQueue_t ) );
+            pQueue->storage = *pStorage;
+            pQueue->policy = policy;
+
+            status = recover( pQueue );
+        }
+
+        if( status == MQTT_OFFLINE_QUEUE_SUCCESS )
+        {
+            LogInfo( ( "Recovered %u queued messages.", ( unsigned int ) pQueue->count ) );
+        }
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+    MQTTOfflineQueueStatus_t MQTTOfflineQueue_Append( MQTTOfflineQueue_t * pQueue,
+                                                      const char * pTopic,
+                                                      uint16_t topicLength,
+                                                      const void * pPayload,
+                                                      size_t payloadLength )
+    {
+        MQTTOfflineQueueStatus_t status = MQTT_OFFLINE_QUEUE_SUCCESS;
+        const MQTTOfflineStorage_t * pStorage;
+        RecordHeader_t header = { 0 };
+        uint8_t headerBytes[ RECORD_HEADER_SIZE ];
+        size_t size = 0U;
+        size_t start = 0U;
+        size_t claimEnd = 0U;
+        size_t eraseFrom = 0U;
+        size_t required = 0U;
+        bool wrapped = false;
+
+        if( ( pQueue == NULL ) || ( pTopic == NULL ) || ( ( pPayload == NULL ) && ( payloadLength > 0U ) ) ||
+            ( ( ( size_t ) topicLength + payloadLength ) > MQTT_OFFLINE_QUEUE_BUFFER_SIZE ) ||
+            ( payloadLength > UINT16_MAX ) )
+        {
+            LogError( ( "Invalid parameter: pQueue=%p, pTopic=%p, topicLength=%u, payloadLength=%u.",
+                        ( void * ) pQueue,
+                        ( const void * ) pTopic,
+                        ( unsigned int ) topicLength,
+                        ( unsigned int ) payloadLength ) );
+            status = MQTT_OFFLINE_QUEUE_INVALID_PARAMETER;
+        }
+        else
+        {
+            pStorage = &( pQueue->storage );
+            header.state = RECORD_STATE_QUEUED;
+            header.topicLength = topicLength;
+            header.payloadLength = ( uint16_t ) payloadLength;
+            size = recordSize( &header );
+
+            /* After a reset, the rest of the sector of the head is not known to
+             * be erased, so start at the next sector. */
+            start = pQueue->head;
+
+            if( ( pStorage->sectorSize > 0U ) && ( pQueue->erasedEnd <= start ) &&
+                ( ( start % pStorage->sectorSize ) != 0U ) )
+            {
+                start = ROUND_UP( start, pStorage->sectorSize );
+            }
+
+            /* A record does not straddle the end of the storage. */
+            if( ( start + size ) > pStorage->size )
+            {
+                start = 0U;
+            }
+
+            wrapped = ( start < pQueue->head );
+            claimEnd = start + size;
+
+            /* On flash, claim whole sectors, which are erased before the write. */
+            if( pStorage->sectorSize > 0U )
+            {
+                eraseFrom = ( ( wrapped == true ) || ( pQueue->erasedEnd <= start ) ) ?
+                            ( ( start / pStorage->sectorSize ) * pStorage->sectorSize ) : pQueue->erasedEnd;
+
+                if( claimEnd > eraseFrom )
+                {
+                    claimEnd = ROUND_UP( claimEnd, pStorage->sectorSize );
+                }
+            }
+
+            required = ( wrapped == true ) ? ( ( pStorage->size - pQueue->head ) + claimEnd ) : ( claimEnd - pQueue->head );
+
+            if( size > pStorage->size )
+            {
+                LogError( ( "A record of %u bytes does not fit in the storage.", ( unsigned int ) size ) );
+                status = MQTT_OFFLINE_QUEUE_INVALID_PARAMETER;
+            }
+        }
+
+        /* Make room, as long as there are records in the way. */
+        while( ( status == MQTT_OFFLINE_QUEUE_SUCCESS ) && ( pQueue->count > 0U ) &&
+               ( freeSpace( pQueue ) < required ) )
+        {
+            if( pQueue->policy == MQTT_OFFLINE_QUEUE_DROP_NEWEST )
+            {
+                LogWarn( ( "Queue full with %u messages. Dropping the new one.", ( unsigned int ) pQueue->count ) );
+                pQueue->stats.droppedNewest++;
+                status = MQTT_OFFLINE_QUEUE_FULL;
+            }
+            else
+            {
+                status = removeTail( pQueue );
+                pQueue->stats.droppedOldest++;
+            }
+        }
+
+        if( ( status == MQTT_OFFLINE_QUEUE_SUCCESS ) && ( pStorage->sectorSize > 0U ) && ( claimEnd > eraseFrom ) )
+        {
+            if( pStorage->erase( pStorage->pContext, eraseFrom, claimEnd - eraseFrom ) != 0 )
+            {
+                LogError( ( "Failed to erase %u bytes at offset %u.",
+                            ( unsigned int ) ( claimEnd - eraseFrom ),
+                            ( unsigned int ) eraseFrom ) );
+                status = MQTT_OFFLINE_QUEUE_STORAGE_ERROR;
+            }
+            else
+            {
+                pQueue->erasedEnd = claimEnd;
+            }
+        }
+
+        if( status == MQTT_OFFLINE_QUEUE_SUCCESS )
+        {
+            header.sequence = pQueue->nextSequence;
+            header.crc = recordCrc( &header, ( const uint8_t * ) pTopic, ( const uint8_t * ) pPayload );
+
+            headerBytes[ 0 ] = RECORD_MAGIC_0;
+            headerBytes[ 1 ] = RECORD_MAGIC_1;
+            headerBytes[ 2 ] = RECORD_STATE_QUEUED;
+            headerBytes[ 3 ] = 0xFFU;
+            headerBytes[ 4 ] = ( uint8_t ) header.sequence;
+            headerBytes[ 5 ] = ( uint8_t ) ( header.sequence >> 8 );
+            headerBytes[ 6 ] = ( uint8_t ) ( header.sequence >> 16 );
+            headerBytes[ 7 ] = ( uint8_t ) ( header.sequence >> 24 );
+            headerBytes[ 8 ] = ( uint8_t ) header.topicLength;
+            headerBytes[ 9 ] = ( uint8_t ) ( header.topicLength >> 8 );
+            headerBytes[ 10 ] = ( uint8_t ) header.payloadLength;
+            headerBytes[ 11 ] = ( uint8_t ) ( header.payloadLength >> 8 );
+            headerBytes[ 12 ] = ( uint8_t ) header.crc;
+            headerBytes[ 13 ] = ( uint8_t ) ( header.crc >> 8 );
+            headerBytes[ 14 ] = ( uint8_t ) ( header.crc >> 16 );
+            headerBytes[ 15 ] = ( uint8_t ) ( header.crc >> 24 );
+
+            /* A reset between the writes leaves a record that fails its CRC. */
+            if( ( pStorage->write( pStorage->pContext, start, headerBytes, sizeof( headerBytes ) ) != 0 ) ||
+                ( ( topicLength > 0U ) &&
+                  ( pStorage->write( pStorage->pContext, start + RECORD_HEADER_SIZE, pTopic, topicLength ) != 0 ) ) ||
+                ( ( payloadLength > 0U ) &&
+                  ( pStorage->write( pStorage->pContext, start + RECORD_HEADER_SIZE + topicLength, pPayload, payloadLength ) != 0 ) ) )
+            {
+                LogError( ( "Failed to write the record at offset %u.", ( unsigned int ) start ) );
+                status = MQTT_OFFLINE_QUEUE_STORAGE_ERROR;
+            }
+        }
+
+        if( status == MQTT_OFFLINE_QUEUE_SUCCESS )
+        {
+            if( pQueue->count == 0U )
+            {
+                pQueue->tail = start;
+                pQueue->tailSequence = header.sequence;
+            }
+
+            pQueue->head = start + size;
+
+            if( pQueue->head >= pStorage->size )
+            {
+                pQueue->head = 0U;
+                pQueue->erasedEnd = 0U;
+            }
+
+            pQueue->nextSequence++;
+            pQueue->count++;
+            pQueue->stats.stored++;
+        }
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+    MQTTOfflineQueueStatus_t MQTTOfflineQueue_Drain( MQTTOfflineQueue_t * pQueue,
+                                                     MQTTPublishWindow_t * pWindow,
+                                                     uint32_t batchTimeoutMs )
+    {
+        MQTTOfflineQueueStatus_t status = MQTT_OFFLINE_QUEUE_SUCCESS;
+        MQTTStatus_t mqttStatus = MQTTSuccess;
+        MQTTPublishInfo_t publishInfo;
+        RecordHeader_t header;
+        bool valid = false;
+        bool found = false;
+        size_t cursor = 0U;
+        uint32_t sequence = 0U;
+        size_t used = 0U;
+        size_t batchCount = 0U;
+        size_t i;
+        uint32_t startTimeMs = 0U;
+        uint32_t messages = 0U;
+        uint32_t bytes = 0U;
+        uint32_t elapsedMs = 0U;
+
+        if( ( pQueue == NULL ) || ( pWindow == NULL ) || ( pWindow->pMqttContext == NULL ) )
+        {
+            LogError( ( "Invalid parameter: pQueue=%p, pWindow=%p.",
+                        ( void * ) pQueue,
+                        ( void * ) pWindow ) );
+            status = MQTT_OFFLINE_QUEUE_INVALID_PARAMETER;
+        }
+        else
+        {
+            startTimeMs = pWindow->pMqttContext->getTime();
+        }
+
+        while( ( status == MQTT_OFFLINE_QUEUE_SUCCESS ) && ( pQueue->count > 0U ) )
+        {
+            /* Messages of an earlier batch may point into the buffer. */
+            mqttStatus = MQTTPublishWindow_Drain( pWindow, batchTimeoutMs );
+
+            cursor = pQueue->tail;
+            sequence = pQueue->tailSequence;
+            used = 0U;
+            batchCount = 0U;
+            found = true;
+
+            /* Fill the window, as far as the buffer allows. */
+            while( ( mqttStatus == MQTTSuccess ) && ( status == MQTT_OFFLINE_QUEUE_SUCCESS ) && ( found == true ) &&
+                   ( batchCount < pQueue->count ) && ( batchCount < pWindow->maxInFlight ) )
+            {
+                status = readHeader( pQueue, cursor, &header, &valid );
+
+                if( ( status == MQTT_OFFLINE_QUEUE_SUCCESS ) && ( valid == true ) &&
+                    ( ( used + header.topicLength + header.payloadLength ) <= MQTT_OFFLINE_QUEUE_BUFFER_SIZE ) )
+                {
+                    status = readBody( pQueue, cursor, &header, &( pQueue->buffer[ used ] ), &valid );
+
+                    if( ( status == MQTT_OFFLINE_QUEUE_SUCCESS ) && ( valid == true ) )
+                    {
+                        ( void ) memset( &publishInfo, 0, sizeof( publishInfo ) );
+                        publishInfo.qos = MQTTQoS1;
+                        publishInfo.pTopicName = ( const char * ) &( pQueue->buffer[ used ] );
+                        publishInfo.topicNameLength = header.topicLength;
+                        publishInfo.pPayload = &( pQueue->buffer[ used + header.topicLength ] );
+                        publishInfo.payloadLength = header.payloadLength;
+
+                        mqttStatus = MQTTPublishWindow_Publish( pWindow, &publishInfo, NULL );
+
+                        if( mqttStatus == MQTTSuccess )
+                        {
+                            messages++;
+                            bytes += ( uint32_t ) header.topicLength + header.payloadLength;
+                        }
+                    }
+                    else if( status == MQTT_OFFLINE_QUEUE_SUCCESS )
+                    {
+                        /* Removed with the batch, without being published. */
+                        LogWarn( ( "Skipping the damaged record at offset %u.", ( unsigned int ) cursor ) );
+                        pQueue->stats.corrupted++;
+                    }
+                    else
+                    {
+                        /* Empty else MISRA 15.7 */
+                    }
+
+                    used += ( size_t ) header.topicLength + header.payloadLength;
+                    batchCount++;
+
+                    if( ( status == MQTT_OFFLINE_QUEUE_SUCCESS ) && ( batchCount < pQueue->count ) )
+                    {
+                        status = findNext( pQueue, cursor + recordSize( &header ), sequence, &cursor, &found );
+                        sequence++;
+                    }
+                }
+                else
+                {
+                    /* The buffer is full, or the header is damaged, which
+                     * removeTail() handles once the batch is done. */
+                    found = false;
+                }
+            }
+
+            /* A damaged header at the tail itself. */
+            if( ( status == MQTT_OFFLINE_QUEUE_SUCCESS ) && ( mqttStatus == MQTTSuccess ) && ( batchCount == 0U ) )
+            {
+                batchCount = 1U;
+            }
+
+            if( mqttStatus == MQTTSuccess )
+            {
+                mqttStatus = MQTTPublishWindow_Drain( pWindow, batchTimeoutMs );
+            }
+
+            if( mqttStatus != MQTTSuccess )
+            {
+                LogWarn( ( "Draining stopped with %u messages queued: %s.",
+                           ( unsigned int ) pQueue->count,
+                           MQTT_Status_strerror( mqttStatus ) ) );
+                status = MQTT_OFFLINE_QUEUE_PUBLISH_FAILED;
+            }
+
+            /* The whole batch is acknowledged. */
+            for( i = 0U; ( i < batchCount ) && ( status == MQTT_OFFLINE_QUEUE_SUCCESS ) && ( pQueue->count > 0U ); i++ )
+            {
+                status = removeTail( pQueue );
+            }
+        }
+
+        if( ( pQueue != NULL ) && ( pWindow != NULL ) && ( messages > 0U ) )
+        {
+            elapsedMs = pWindow->pMqttContext->getTime() - startTimeMs;
+            pQueue->stats.drained += messages;
+            pQueue->stats.lastDrainMessages = messages;
+            pQueue->stats.lastDrainBytes = bytes;
+            pQueue->stats.lastDrainMs = elapsedMs;
+
+            LogInfo( ( "Drained %u messages, %u bytes in %u ms: %u messages/s, %u bytes/s.",
+                       ( unsigned int ) messages,
+                       ( unsigned int ) bytes,
+                       ( unsigned int ) elapsedMs,
+                       ( unsigned int ) ( ( ( uint64_t ) messages * 1000U ) / ( ( elapsedMs > 0U ) ? elapsedMs : 1U ) ),
+                       ( unsigned int ) ( ( ( uint64_t ) bytes * 1000U ) / ( ( elapsedMs > 0U ) ? elapsedMs : 1U ) ) ) );
+        }
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+    size_t MQTTOfflineQueue_Count( const MQTTOfflineQueue_t * pQueue )
+    {
+        configASSERT( pQueue != NULL );
+
+        return pQueue->count;
+    }
+
+/*-----------------------------------------------------------*/
+
+    void MQTTOfflineQueue_GetStats( const MQTTOfflineQueue_t * pQueue,
+                                    MQTTOfflineQueueStats_t * pStats )
+    {
+        configASSERT( ( pQueue != NULL ) && ( pStats != NULL ) );
+
+        *pStats = pQueue->stats;
+    }
+
+#endif /* ifdef MQTT_OFFLINE_QUEUE */
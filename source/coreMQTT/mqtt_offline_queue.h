@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file mqtt_offline_queue.h
+ * @brief Durable store-and-forward queue of QoS1 publishes.
+ *
+ * Built when MQTT_OFFLINE_QUEUE is defined in core_mqtt_config.h.
+ *
+ * While the connection is down, the application appends its messages to the
+ * queue. Once it is back, MQTTOfflineQueue_Drain() publishes them in order,
+ * in batches of up to the size of the publish window, and removes each batch
+ * once the broker has acknowledged all of it.
+ *
+ * The queue is a ring log on a storage area. Each record holds a sequence
+ * number, the topic and the payload, protected by a CRC-32. A record is
+ * removed by clearing one byte of its header, which flash can do without an
+ * erase. At start, MQTTOfflineQueue_Init() scans the storage for valid
+ * records and carries on from the oldest one not removed, so the queue
+ * survives a reset. A record torn by a reset fails its CRC and is skipped.
+ *
+ * The storage is either a file, with MQTTOfflineQueue_OpenFile(), or a flash
+ * partition behind the read, write and erase functions of
+ * #MQTTOfflineStorage_t. The queue is not thread safe: use it from the task
+ * that owns the MQTT connection.
+ */
+
+#ifndef MQTT_OFFLINE_QUEUE_H
+#define MQTT_OFFLINE_QUEUE_H
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* MQTT library includes. */
+#include "core_mqtt.h"
+
+/* Publish window used to drain the queue. */
+#include "mqtt_publish_window.h"
+
+/**
+ * @brief Size of the buffer that holds the records of a batch while they are
+ * in flight. It also bounds the size of a record, its topic and payload plus
+ * a 16-byte header.
+ */
+#ifndef MQTT_OFFLINE_QUEUE_BUFFER_SIZE
+    #define MQTT_OFFLINE_QUEUE_BUFFER_SIZE    ( 1024U )
+#endif
+
+/**
+ * @brief Status codes of the offline queue.
+ */
+typedef enum MQTTOfflineQueueStatus
+{
+    MQTT_OFFLINE_QUEUE_SUCCESS = 0,     /**< @brief Function successfully completed. */
+    MQTT_OFFLINE_QUEUE_INVALID_PARAMETER, /**< @brief At least one parameter was invalid. */
+    MQTT_OFFLINE_QUEUE_FULL,            /**< @brief The message was dropped by #MQTT_OFFLINE_QUEUE_DROP_NEWEST. */
+    MQTT_OFFLINE_QUEUE_STORAGE_ERROR,   /**< @brief The storage failed to read, write or erase. */
+    MQTT_OFFLINE_QUEUE_PUBLISH_FAILED   /**< @brief The connection failed while draining. */
+} MQTTOfflineQueueStatus_t;
+
+/**
+ * @brief What to do with a message that does not fit in the queue.
+ */
+typedef enum MQTTOfflineQueuePolicy
+{
+    MQTT_OFFLINE_QUEUE_DROP_OLDEST, /**< @brief Remove the oldest messages to make room. */
+    MQTT_OFFLINE_QUEUE_DROP_NEWEST  /**< @brief Keep the queue and drop the new message. */
+} MQTTOfflineQueuePolicy_t;
+
+/**
+ * @brief Storage of the ring log: a file, or a flash partition.
+ *
+ * Offsets are relative to the start of the storage. Functions return 0 on
+ * success. On flash, write() is only called on erased bytes, or to clear the
+ * state byte of a record to 0, and the queue erases each sector before its
+ * first write in a lap of the ring.
+ */
+typedef struct MQTTOfflineStorage
+{
+    void * pContext; /**< @brief Passed to the functions, for example a partition handle. */
+    size_t size;       /**< @brief Size of the storage, a multiple of 4 bytes. */
+    size_t sectorSize; /**< @brief Erase unit of the flash, or 0 if the storage needs no erase. */
+    int32_t ( * read )( void * pContext,
+                        size_t offset,
+                        void * pBuffer,
+                        size_t length );  /**< @brief Read bytes. */
+    int32_t ( * write )( void * pContext,
+                         size_t offset,
+                         const void * pBuffer,
+                         size_t length ); /**< @brief Write bytes. */
+    int32_t ( * erase )( void * pContext,
+                         size_t offset,
+                         size_t length ); /**< @brief Erase whole sectors to 0xFF. Unused if sectorSize is 0. */
+} MQTTOfflineStorage_t;
+
+/**
+ * @brief Counters of the queue since MQTTOfflineQueue_Init().
+ */
+typedef struct MQTTOfflineQueueStats
+{
+    uint32_t stored;            /**< @brief Messages appended. */
+    uint32_t droppedOldest;     /**< @brief Messages removed to make room. */
+    uint32_t droppedNewest;     /**< @brief Messages refused because the queue was full. */
+    uint32_t corrupted;         /**< @brief Records skipped because of a bad CRC. */
+    uint32_t drained;           /**< @brief Messages published and acknowledged. */
+    uint32_t lastDrainMessages; /**< @brief Messages of the last drain. */
+    uint32_t lastDrainBytes;    /**< @brief Topic and payload bytes of the last drain. */
+    uint32_t lastDrainMs;       /**< @brief Duration of the last drain. */
+} MQTTOfflineQueueStats_t;
+
+/**
+ * @brief Offline queue. Its fields are private.
+ */
+typedef struct MQTTOfflineQueue
+{
+    MQTTOfflineStorage_t storage;                        /**< @brief The storage. */
+    MQTTOfflineQueuePolicy_t policy;                     /**< @brief Policy when full. */
+    size_t head;                                         /**< @brief Offset of the next record. */
+    size_t tail;                                         /**< @brief Offset of the oldest record. */
+    size_t erasedEnd;                                    /**< @brief End of the erased bytes from head, on flash. */
+    size_t count;                                        /**< @brief Number of records. */
+    uint32_t tailSequence;                               /**< @brief Sequence number of the oldest record. */
+    uint32_t nextSequence;                               /**< @brief Sequence number of the next record. */
+    MQTTOfflineQueueStats_t stats;                       /**< @brief Counters. */
+    uint8_t buffer[ MQTT_OFFLINE_QUEUE_BUFFER_SIZE ];    /**< @brief Records of the batch in flight. */
+} MQTTOfflineQueue_t;
+
+/**
+ * @brief File storage of the queue.
+ */
+typedef struct MQTTOfflineFileStorage
+{
+    FILE * pFile; /**< @brief The open file. */
+} MQTTOfflineFileStorage_t;
+
+/**
+ * @brief Open or create the file that stores the queue.
+ *
+ * @param[out] pFileStorage File storage, which must outlive the queue.
+ * @param[in] pPath Path of the file. A new file is filled with 0xFF.
+ * @param[in] size Size of the ring log, a multiple of 4 bytes.
+ * @param[out] pStorage Storage to pass to MQTTOfflineQueue_Init().
+ *
+ * @return #MQTT_OFFLINE_QUEUE_SUCCESS, #MQTT_OFFLINE_QUEUE_INVALID_PARAMETER,
+ * or #MQTT_OFFLINE_QUEUE_STORAGE_ERROR.
+ */
+MQTTOfflineQueueStatus_t MQTTOfflineQueue_OpenFile( MQTTOfflineFileStorage_t * pFileStorage,
+                                                    const char * pPath,
+                                                    size_t size,
+                                                    MQTTOfflineStorage_t * pStorage );
+
+/**
+ * @brief Set up the queue on a storage, and recover the records it holds.
+ *
+ * @param[out] pQueue The queue.
+ * @param[in] pStorage The storage.
+ * @param[in] policy What to do with a message that does not fit.
+ *
+ * @return #MQTT_OFFLINE_QUEUE_SUCCESS, #MQTT_OFFLINE_QUEUE_INVALID_PARAMETER,
+ * or #MQTT_OFFLINE_QUEUE_STORAGE_ERROR.
+ */
+MQTTOfflineQueueStatus_t MQTTOfflineQueue_Init( MQTTOfflineQueue_t * pQueue,
+                                                const MQTTOfflineStorage_t * pStorage,
+                                                MQTTOfflineQueuePolicy_t policy );
+
+/**
+ * @brief Append a message to the queue.
+ *
+ * @param[in] pQueue The queue.
+ * @param[in] pTopic Topic of the message.
+ * @param[in] topicLength Length of the topic.
+ * @param[in] pPayload Payload of the message.
+ * @param[in] payloadLength Length of the payload.
+ *
+ * @return #MQTT_OFFLINE_QUEUE_SUCCESS, #MQTT_OFFLINE_QUEUE_FULL,
+ * #MQTT_OFFLINE_QUEUE_INVALID_PARAMETER if the record does not fit in
+ * #MQTT_OFFLINE_QUEUE_BUFFER_SIZE, or #MQTT_OFFLINE_QUEUE_STORAGE_ERROR.
+ */
+MQTTOfflineQueueStatus_t MQTTOfflineQueue_Append( MQTTOfflineQueue_t * pQueue,
+                                                  const char * pTopic,
+                                                  uint16_t topicLength,
+                                                  const void * pPayload,
+                                                  size_t payloadLength );
+
+/**
+ * @brief Publish the queued messages in order, in batches, and remove each
+ * batch once it is acknowledged. Logs the drain rate.
+ *
+ * The function first waits for the messages already in the window, since a
+ * batch reuses the buffer of the one before. If the connection fails, the
+ * batch in flight stays in the queue, and is published again by the next
+ * drain.
+ *
+ * @param[in] pQueue The queue.
+ * @param[in] pWindow Publish window of the connection.
+ * @param[in] batchTimeoutMs Longest wait for the PUBACKs of a batch.
+ *
+ * @return #MQTT_OFFLINE_QUEUE_SUCCESS once the queue is empty,
+ * #MQTT_OFFLINE_QUEUE_PUBLISH_FAILED, or #MQTT_OFFLINE_QUEUE_STORAGE_ERROR.
+ */
+MQTTOfflineQueueStatus_t MQTTOfflineQueue_Drain( MQTTOfflineQueue_t * pQueue,
+                                                 MQTTPublishWindow_t * pWindow,
+                                                 uint32_t batchTimeoutMs );
+
+/**
+ * @brief Number of messages in the queue.
+ *
+ * @param[in] pQueue The queue.
+ *
+ * @return Number of messages.
+ */
+size_t MQTTOfflineQueue_Count( const MQTTOfflineQueue_t * pQueue );
+
+/**
+ * @brief Copy the counters of the queue.
+ *
+ * @param[in] pQueue The queue.
+ * @param[out] pStats Where to write the counters.
+ */
+void MQTTOfflineQueue_GetStats( const MQTTOfflineQueue_t * pQueue,
+                                MQTTOfflineQueueStats_t * pStats );
+
+#endif /* ifndef MQTT_OFFLINE_QUEUE_H */
@@ -0,0 +1,546 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file mqtt_publish_benchmark.c
+ * @brief Throughput benchmark of the QoS1 publish window.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Configure logs for the functions in this file, before core_mqtt_config.h
+ * sets those of coreMQTT. */
+#include "logging_levels.h"
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "PublishBenchmark"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_INFO
+#endif
+#include "logging_stack.h"
+
+#include "mqtt_publish_benchmark.h"
+#include "mqtt_publish_window.h"
+
+#ifdef MQTT_PUBLISH_BENCHMARK
+
+/**
+ * @brief Largest number of responses the broker stand-in holds back at once:
+ * a PUBACK for each message of the window, plus CONNACK and PINGRESP.
+ */
+    #define BENCHMARK_MAX_RESPONSES    ( MQTT_PUBLISH_WINDOW_SIZE + 2U )
+
+/**
+ * @brief Longest response of the broker stand-in, a CONNACK or PUBACK.
+ */
+    #define BENCHMARK_RESPONSE_SIZE    ( 4U )
+
+/**
+ * @brief Size of the network buffer of the MQTT context.
+ */
+    #define BENCHMARK_BUFFER_SIZE      ( 128U )
+
+/**
+ * @brief Topic the benchmark publishes to.
+ */
+    #define BENCHMARK_TOPIC            "benchmark/topic"
+
+/**
+ * @brief Payload of each message, about the size of a telemetry report.
+ */
+    #define BENCHMARK_PAYLOAD          "{\"temperature\":21.5,\"humidity\":40}"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief States of the parser of the packets sent to the broker stand-in.
+ */
+    typedef enum BrokerParserState
+    {
+        BROKER_PARSER_TYPE,   /**< @brief Expecting the first byte of a packet. */
+        BROKER_PARSER_LENGTH, /**< @brief Reading the remaining length. */
+        BROKER_PARSER_BODY    /**< @brief Reading the rest of the packet. */
+    } BrokerParserState_t;
+
+/**
+ * @brief A response of the broker stand-in, held back for a round trip.
+ */
+    typedef struct BrokerResponse
+    {
+        uint8_t bytes[ BENCHMARK_RESPONSE_SIZE ]; /**< @brief The packet. */
+        size_t length;                            /**< @brief Length of the packet. */
+        uint32_t dueTimeMs;                       /**< @brief Time from which the client may receive it. */
+    } BrokerResponse_t;
+
+/**
+ * @brief Broker stand-in. It reads the packets sent by coreMQTT, which may
+ * arrive in several sends, and queues the response to each.
+ */
+    struct NetworkContext
+    {
+        BrokerParserState_t state;                           /**< @brief Parser state. */
+        uint8_t packetType;                                  /**< @brief First byte of the packet being read. */
+        uint32_t remainingLength;                            /**< @brief Remaining length of the packet. */
+        uint32_t lengthShift;                                /**< @brief Shift of the next byte of the remaining length. */
+        uint32_t bodyOffset;                                 /**< @brief Bytes of the packet read after its remaining length. */
+        uint16_t topicLength;                                /**< @brief Topic length of a PUBLISH. */
+        uint16_t packetId;                                   /**< @brief Packet ID of a PUBLISH. */
+        BrokerResponse_t responses[ BENCHMARK_MAX_RESPONSES ]; /**< @brief Ring of held back responses. */
+        size_t responseHead;                                 /**< @brief Index of the next response to receive. */
+        size_t responseCount;                                /**< @brief Number of queued responses. */
+        size_t responseOffset;                               /**< @brief Bytes of the head response already received. */
+        uint32_t roundTripMs;                                /**< @brief Delay of every response. */
+    };
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Broker stand-in of the benchmark.
+ */
+    static NetworkContext_t broker;
+
+/**
+ * @brief Publish window of the run in progress, for the event callback.
+ */
+    static MQTTPublishWindow_t benchmarkWindow;
+
+/**
+ * @brief Network buffer of the MQTT context.
+ */
+    static uint8_t benchmarkBuffer[ BENCHMARK_BUFFER_SIZE ];
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Time since the scheduler started, for coreMQTT.
+ *
+ * @return Time in milliseconds.
+ */
+    static uint32_t getTimeMs( void );
+
+/**
+ * @brief Queue a response of the broker stand-in.
+ *
+ * @param[in] pBroker The broker stand-in.
+ * @param[in] pBytes The packet.
+ * @param[in] length Length of the packet.
+ */
+    static void queueResponse( NetworkContext_t * pBroker,
+                               const uint8_t * pBytes,
+                               size_t length );
+
+/**
+ * @brief Answer a packet that the broker stand-in has read in full.
+ *
+ * @param[in] pBroker The broker stand-in.
+ */
+    static void completePacket( NetworkContext_t * pBroker );
+
+/**
+ * @brief Feed one byte sent by the client to the broker stand-in.
+ *
+ * @param[in] pBroker The broker stand-in.
+ * @param[in] byte The byte.
+ */
+    static void parseByte( NetworkContext_t * pBroker,
+                           uint8_t byte );
+
+/**
+ * @brief Transport send function of the broker stand-in.
+ *
+ * @param[in] pNetworkContext The broker stand-in.
+ * @param[in] pBuffer Data sent by coreMQTT.
+ * @param[in] bytesToSend Length of the data.
+ *
+ * @return @p bytesToSend.
+ */
+    static int32_t brokerSend( NetworkContext_t * pNetworkContext,
+                               const void * pBuffer,
+                               size_t bytesToSend );
+
+/**
+ * @brief Transport receive function of the broker stand-in. Returns the
+ * responses whose round trip has elapsed, otherwise waits a tick and
+ * returns 0, as a transport does when its receive times out.
+ *
+ * @param[in] pNetworkContext The broker stand-in.
+ * @param[out] pBuffer Buffer to receive into.
+ * @param[in] bytesToRecv Size of the buffer.
+ *
+ * @return Number of bytes received.
+ */
+    static int32_t brokerRecv( NetworkContext_t * pNetworkContext,
+                               void * pBuffer,
+                               size_t bytesToRecv );
+
+/**
+ * @brief MQTT event callback of the benchmark, which passes every PUBACK to
+ * the publish window.
+ *
+ * @param[in] pMqttContext MQTT context.
+ * @param[in] pPacketInfo The incoming packet.
+ * @param[in] pDeserializedInfo Packet ID of the incoming packet.
+ */
+    static void eventCallback( MQTTContext_t * pMqttContext,
+                               MQTTPacketInfo_t * pPacketInfo,
+                               MQTTDeserializedInfo_t * pDeserializedInfo );
+
+/**
+ * @brief Connect to the broker stand-in, publish the messages through a
+ * window and wait for the last PUBACK.
+ *
+ * @param[in] maxInFlight Size of the window.
+ * @param[in] messages Number of messages.
+ * @param[in] roundTripMs Delay of every response.
+ * @param[out] pElapsedMs Time from the first publish to the last PUBACK.
+ *
+ * @return #MQTTSuccess, or the first error of coreMQTT.
+ */
+    static MQTTStatus_t runPublishes( size_t maxInFlight,
+                                      uint32_t messages,
+                                      uint32_t roundTripMs,
+                                      uint32_t * pElapsedMs );
+
+/*-----------------------------------------------------------*/
+
+    static uint32_t getTimeMs( void )
+    {
+        return ( uint32_t ) ( ( ( uint64_t ) xTaskGetTickCount() * 1000U ) / configTICK_RATE_HZ );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void queueResponse( NetworkContext_t * pBroker,
+                               const uint8_t * pBytes,
+                               size_t length )
+    {
+        BrokerResponse_t * pResponse;
+
+        /* coreMQTT never has more requests outstanding than the ring holds. */
+        configASSERT( pBroker->responseCount < BENCHMARK_MAX_RESPONSES );
+        configASSERT( length <= BENCHMARK_RESPONSE_SIZE );
+
+        pResponse = &( pBroker->responses[ ( pBroker->responseHead + pBroker->responseCount ) % BENCHMARK_MAX_RESPONSES ] );
+        ( void ) memcpy( pResponse->bytes, pBytes, length );
+        pResponse->length = length;
+        pResponse->dueTimeMs = getTimeMs() + pBroker->roundTripMs;
+        pBroker->responseCount++;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void completePacket( NetworkContext_t * pBroker )
+    {
+        static const uint8_t connack[] = { MQTT_PACKET_TYPE_CONNACK, 0x02U, 0x00U, 0x00U };
+        static const uint8_t pingresp[] = { MQTT_PACKET_TYPE_PINGRESP, 0x00U };
+        uint8_t puback[] = { MQTT_PACKET_TYPE_PUBACK, 0x02U, 0x00U, 0x00U };
+
+        switch( pBroker->packetType & 0xF0U )
+        {
+            case MQTT_PACKET_TYPE_CONNECT:
+                queueResponse( pBroker, connack, sizeof( connack ) );
+                break;
+
+            case MQTT_PACKET_TYPE_PUBLISH:
+
+                /* Bits 1 and 2 of the first byte hold the QoS. */
+                if( ( pBroker->packetType & 0x06U ) == 0x02U )
+                {
+                    puback[ 2 ] = ( uint8_t ) ( pBroker->packetId >> 8 );
+                    puback[ 3 ] = ( uint8_t ) ( pBroker->packetId & 0xFFU );
+                    queueResponse( pBroker, puback, sizeof( puback ) );
+                }
+
+                break;
+
+            case MQTT_PACKET_TYPE_PINGREQ:
+                queueResponse( pBroker, pingresp, sizeof( pingresp ) );
+                break;
+
+            default:
+                /* DISCONNECT needs no response. */
+                break;
+        }
+
+        pBroker->state = BROKER_PARSER_TYPE;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void parseByte( NetworkContext_t * pBroker,
+                           uint8_t byte )
+    {
+        switch( pBroker->state )
+        {
+            case BROKER_PARSER_TYPE:
+                pBroker->packetType = byte;
+                pBroker->remainingLength = 0U;
+                pBroker->lengthShift = 0U;
+                pBroker->bodyOffset = 0U;
+                pBroker->topicLength = 0U;
+                pBroker->packetId = 0U;
+                pBroker->state = BROKER_PARSER_LENGTH;
+                break;
+
+            case BROKER_PARSER_LENGTH:
+                pBroker->remainingLength |= ( ( uint32_t ) byte & 0x7FU ) << pBroker->lengthShift;
+                pBroker->lengthShift += 7U;
+
+                if( ( byte & 0x80U ) == 0U )
+                {
+                    if( pBroker->remainingLength == 0U )
+                    {
+                        completePacket( pBroker );
+                    }
+                    else
+                    {
+                        pBroker->state = BROKER_PARSER_BODY;
+                    }
+                }
+
+                break;
+
+            case BROKER_PARSER_BODY:
+            default:
+
+                /* A PUBLISH starts with the topic length, the topic and the
+                 * packet ID. Only the packet ID is needed. */
+                if( ( pBroker->packetType & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH )
+                {
+                    if( pBroker->bodyOffset < 2U )
+                    {
+                        pBroker->topicLength = ( uint16_t ) ( ( pBroker->topicLength << 8 ) | byte );
+                    }
+                    else if( ( pBroker->bodyOffset - 2U - pBroker->topicLength ) < 2U )
+                    {
+                        pBroker->packetId = ( uint16_t ) ( ( pBroker->packetId << 8 ) | byte );
+                    }
+                    else
+                    {
+                        /* Empty else MISRA 15.7 */
+                    }
+                }
+
+                pBroker->bodyOffset++;
+
+                if( pBroker->bodyOffset == pBroker->remainingLength )
+                {
+                    completePacket( pBroker );
+                }
+
+                break;
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    static int32_t brokerSend( NetworkContext_t * pNetworkContext,
+                               const void * pBuffer,
+                               size_t bytesToSend )
+    {
+        const uint8_t * pBytes = ( const uint8_t * ) pBuffer;
+        size_t i;
+
+        for( i = 0U; i < bytesToSend; i++ )
+        {
+            parseByte( pNetworkContext, pBytes[ i ] );
+        }
+
+        return ( int32_t ) bytesToSend;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static int32_t brokerRecv( NetworkContext_t * pNetworkContext,
+                               void * pBuffer,
+                               size_t bytesToRecv )
+    {
+        BrokerResponse_t * pResponse = &( pNetworkContext->responses[ pNetworkContext->responseHead ] );
+        size_t bytesReceived = 0U;
+
+        /* Unsigned subtraction handles the wrap of the clock. */
+        if( ( pNetworkContext->responseCount > 0U ) &&
+            ( ( int32_t ) ( getTimeMs() - pResponse->dueTimeMs ) >= 0 ) )
+        {
+            bytesReceived = pResponse->length - pNetworkContext->responseOffset;
+
+            if( bytesReceived > bytesToRecv )
+            {
+                bytesReceived = bytesToRecv;
+            }
+
+            ( void ) memcpy( pBuffer, &( pResponse->bytes[ pNetworkContext->responseOffset ] ), bytesReceived );
+            pNetworkContext->responseOffset += bytesReceived;
+
+            if( pNetworkContext->responseOffset == pResponse->length )
+            {
+                pNetworkContext->responseHead = ( pNetworkContext->responseHead + 1U ) % BENCHMARK_MAX_RESPONSES;
+                pNetworkContext->responseCount--;
+                pNetworkContext->responseOffset = 0U;
+            }
+        }
+        else
+        {
+            vTaskDelay( 1U );
+        }
+
+        return ( int32_t ) bytesReceived;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void eventCallback( MQTTContext_t * pMqttContext,
+                               MQTTPacketInfo_t * pPacketInfo,
+                               MQTTDeserializedInfo_t * pDeserializedInfo )
+    {
+        ( void ) pMqttContext;
+
+        if( pPacketInfo->type == MQTT_PACKET_TYPE_PUBACK )
+        {
+            ( void ) MQTTPublishWindow_Ack( &benchmarkWindow, pDeserializedInfo->packetIdentifier );
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    static MQTTStatus_t runPublishes( size_t maxInFlight,
+                                      uint32_t messages,
+                                      uint32_t roundTripMs,
+                                      uint32_t * pElapsedMs )
+    {
+        MQTTContext_t mqttContext = { 0 };
+        TransportInterface_t transport = { 0 };
+        MQTTFixedBuffer_t fixedBuffer = { 0 };
+        MQTTConnectInfo_t connectInfo = { 0 };
+        MQTTPublishInfo_t publishInfo = { 0 };
+        MQTTStatus_t status;
+        bool sessionPresent = false;
+        uint32_t startTimeMs = 0U;
+        uint32_t message = 0U;
+
+        ( void ) memset( &broker, 0, sizeof( broker ) );
+        broker.roundTripMs = roundTripMs;
+
+        transport.pNetworkContext = &broker;
+        transport.send = brokerSend;
+        transport.recv = brokerRecv;
+        fixedBuffer.pBuffer = benchmarkBuffer;
+        fixedBuffer.size = sizeof( benchmarkBuffer );
+
+        status = MQTT_Init( &mqttContext, &transport, getTimeMs, eventCallback, &fixedBuffer );
+
+        if( status == MQTTSuccess )
+        {
+            connectInfo.cleanSession = true;
+            connectInfo.pClientIdentifier = "benchmark";
+            connectInfo.clientIdentifierLength = ( uint16_t ) ( sizeof( "benchmark" ) - 1U );
+            connectInfo.keepAliveSeconds = 60U;
+
+            status = MQTT_Connect( &mqttContext, &connectInfo, NULL, roundTripMs + 1000U, &sessionPresent );
+        }
+
+        if( status == MQTTSuccess )
+        {
+            status = MQTTPublishWindow_Init( &benchmarkWindow, &mqttContext, maxInFlight, MQTT_PUBLISH_WINDOW_RETRY_MS );
+        }
+
+        if( status == MQTTSuccess )
+        {
+            publishInfo.pTopicName = BENCHMARK_TOPIC;
+            publishInfo.topicNameLength = ( uint16_t ) ( sizeof( BENCHMARK_TOPIC ) - 1U );
+            publishInfo.pPayload = BENCHMARK_PAYLOAD;
+            publishInfo.payloadLength = sizeof( BENCHMARK_PAYLOAD ) - 1U;
+
+            startTimeMs = getTimeMs();
+
+            for( message = 0U; ( message < messages ) && ( status == MQTTSuccess ); message++ )
+            {
+                status = MQTTPublishWindow_Publish( &benchmarkWindow, &publishInfo, NULL );
+            }
+        }
+
+        if( status == MQTTSuccess )
+        {
+            /* Every PUBACK is due one round trip after its PUBLISH. */
+            status = MQTTPublishWindow_Drain( &benchmarkWindow, roundTripMs + MQTT_PUBLISH_WINDOW_RETRY_MS );
+            *pElapsedMs = getTimeMs() - startTimeMs;
+        }
+
+        if( status == MQTTSuccess )
+        {
+            status = MQTT_Disconnect( &mqttContext );
+        }
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+    MQTTStatus_t MQTTPublishBenchmark_Run( uint32_t messages,
+                                           uint32_t roundTripMs,
+                                           MQTTPublishBenchmark_t * pResult )
+    {
+        MQTTPublishBenchmark_t result = { 0 };
+        MQTTStatus_t status;
+
+        configASSERT( messages > 0U );
+
+        status = runPublishes( 1U, messages, roundTripMs, &( result.stopAndWaitMs ) );
+
+        if( status == MQTTSuccess )
+        {
+            status = runPublishes( MQTT_PUBLISH_WINDOW_SIZE, messages, roundTripMs, &( result.windowedMs ) );
+        }
+
+        if( status == MQTTSuccess )
+        {
+            /* Rates in thousandths of a message per second, as a cellular
+             * round trip allows only a few messages per second. */
+            LogInfo( ( "%lu QoS1 messages with a round trip of %lu ms:",
+                       ( unsigned long ) messages,
+                       ( unsigned long ) roundTripMs ) );
+            LogInfo( ( "Window of 1: %lu ms, %lu mmsg/s. Window of %u: %lu ms, %lu mmsg/s.",
+                       ( unsigned long ) result.stopAndWaitMs,
+                       ( unsigned long ) ( ( ( uint64_t ) messages * 1000000U ) / ( result.stopAndWaitMs + 1U ) ),
+                       ( unsigned int ) MQTT_PUBLISH_WINDOW_SIZE,
+                       ( unsigned long ) result.windowedMs,
+                       ( unsigned long ) ( ( ( uint64_t ) messages * 1000000U ) / ( result.windowedMs + 1U ) ) ) );
+        }
+        else
+        {
+            LogError( ( "Publish benchmark failed: %s.", MQTT_Status_strerror( status ) ) );
+        }
+
+        if( pResult != NULL )
+        {
+            *pResult = result;
+        }
+
+        return status;
+    }
+
+#endif /* ifdef MQTT_PUBLISH_BENCHMARK */
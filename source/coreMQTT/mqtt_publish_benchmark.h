@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file mqtt_publish_benchmark.h
+ * @brief Throughput benchmark of the QoS1 publish window.
+ *
+ * Built when MQTT_PUBLISH_BENCHMARK is defined in core_mqtt_config.h. The
+ * benchmark publishes through coreMQTT to a broker stand-in, a transport that
+ * answers CONNECT, PUBLISH and PINGREQ one simulated round trip after it
+ * receives them, without any network. It runs once with a window of one
+ * message, which waits for every PUBACK, and once with the full window.
+ */
+
+#ifndef MQTT_PUBLISH_BENCHMARK_H
+#define MQTT_PUBLISH_BENCHMARK_H
+
+/* Standard includes. */
+#include <stdint.h>
+
+/* MQTT library includes. */
+#include "core_mqtt.h"
+
+/**
+ * @brief Time taken to publish the messages of the benchmark.
+ */
+typedef struct MQTTPublishBenchmark
+{
+    uint32_t stopAndWaitMs; /**< @brief With a window of one message. */
+    uint32_t windowedMs;    /**< @brief With a window of #MQTT_PUBLISH_WINDOW_SIZE messages. */
+} MQTTPublishBenchmark_t;
+
+/**
+ * @brief Publish messages to the broker stand-in with both windows and log
+ * the messages per second.
+ *
+ * @param[in] messages Number of messages published by each run.
+ * @param[in] roundTripMs Time between a packet and its acknowledgment, for
+ * example the round trip time of the cellular link.
+ * @param[out] pResult Where to write the results. May be NULL.
+ *
+ * @return #MQTTSuccess, or the first error of coreMQTT.
+ */
+MQTTStatus_t MQTTPublishBenchmark_Run( uint32_t messages,
+                                       uint32_t roundTripMs,
+                                       MQTTPublishBenchmark_t * pResult );
+
+#endif /* ifndef MQTT_PUBLISH_BENCHMARK_H */
@@ -0,0 +1,463 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file mqtt_publish_window.c
+ * @brief QoS1 publisher that keeps several messages in flight.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/* Configure logs for the functions in this file, before core_mqtt_config.h
+ * sets those of coreMQTT. */
+#include "logging_levels.h"
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "PublishWindow"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_INFO
+#endif
+#include "logging_stack.h"
+
+#include "mqtt_publish_window.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Send a message in flight again, with the DUP flag and its packet ID.
+ *
+ * @param[in] pWindow The window.
+ * @param[in] pEntry The message.
+ *
+ * @return The status of the send function of the window.
+ */
+static MQTTStatus_t resendEntry( MQTTPublishWindow_t * pWindow,
+                                 MQTTPublishWindowEntry_t * pEntry );
+
+/**
+ * @brief Send again the messages in flight whose retry timeout has expired.
+ *
+ * @param[in] pWindow The window.
+ *
+ * @return #MQTTSuccess, or the first error of the send function of the window.
+ */
+static MQTTStatus_t resendExpired( MQTTPublishWindow_t * pWindow );
+
+/**
+ * @brief Forget that a second PUBACK may arrive for a packet ID.
+ *
+ * @param[in] pWindow The window.
+ * @param[in] packetId The packet ID.
+ *
+ * @return true if a second PUBACK was expected for the packet ID, otherwise
+ * false.
+ */
+static bool takeDuplicateAck( MQTTPublishWindow_t * pWindow,
+                              uint16_t packetId );
+
+/**
+ * @brief Whether the #MQTTBadResponse of MQTT_ProcessLoop() was the second
+ * PUBACK of a resent message.
+ *
+ * @param[in] pWindow The window.
+ *
+ * @return true if the last packet received was a PUBACK whose packet ID
+ * expected a second PUBACK, otherwise false.
+ */
+static bool isDuplicateAck( MQTTPublishWindow_t * pWindow );
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t resendEntry( MQTTPublishWindow_t * pWindow,
+                                 MQTTPublishWindowEntry_t * pEntry )
+{
+    MQTTStatus_t status;
+
+    /* coreMQTT still holds the outgoing record of the packet ID, and accepts
+     * the collision because of the DUP flag. */
+    pEntry->publishInfo.dup = true;
+    status = pWindow->send( pWindow->pMqttContext, &( pEntry->publishInfo ), pEntry->packetId );
+
+    if( status == MQTTSuccess )
+    {
+        pEntry->sentTimeMs = pWindow->pMqttContext->getTime();
+        pEntry->resent = true;
+        pWindow->retransmissions++;
+        LogDebug( ( "Resent packet ID %u.", ( unsigned int ) pEntry->packetId ) );
+    }
+    else
+    {
+        LogError( ( "Failed to resend packet ID %u: %s.",
+                    ( unsigned int ) pEntry->packetId,
+                    MQTT_Status_strerror( status ) ) );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t resendExpired( MQTTPublishWindow_t * pWindow )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    uint32_t nowMs = pWindow->pMqttContext->getTime();
+    size_t i;
+
+    for( i = 0U; ( i < MQTT_PUBLISH_WINDOW_SIZE ) && ( status == MQTTSuccess ); i++ )
+    {
+        MQTTPublishWindowEntry_t * pEntry = &( pWindow->entries[ i ] );
+
+        /* Unsigned subtraction handles the wrap of the clock. */
+        if( ( pEntry->packetId != 0U ) &&
+            ( ( nowMs - pEntry->sentTimeMs ) >= pWindow->retryTimeoutMs ) )
+        {
+            status = resendEntry( pWindow, pEntry );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool takeDuplicateAck( MQTTPublishWindow_t * pWindow,
+                              uint16_t packetId )
+{
+    bool found = false;
+    size_t i;
+
+    for( i = 0U; ( i < MQTT_PUBLISH_WINDOW_SIZE ) && ( found == false ); i++ )
+    {
+        if( ( packetId != 0U ) && ( pWindow->duplicateAcks[ i ] == packetId ) )
+        {
+            pWindow->duplicateAcks[ i ] = 0U;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool isDuplicateAck( MQTTPublishWindow_t * pWindow )
+{
+    MQTTPacketInfo_t packetInfo = { 0 };
+    uint16_t packetId = 0U;
+    bool duplicate = false;
+
+    /* coreMQTT v1 receives the packet after its fixed header at the start of
+     * the network buffer, where it stays until the next packet. A PUBACK is
+     * only its packet ID. */
+    packetInfo.type = MQTT_PACKET_TYPE_PUBACK;
+    packetInfo.pRemainingData = pWindow->pMqttContext->networkBuffer.pBuffer;
+    packetInfo.remainingLength = sizeof( uint16_t );
+
+    if( MQTT_DeserializeAck( &packetInfo, &packetId, NULL ) == MQTTSuccess )
+    {
+        duplicate = takeDuplicateAck( pWindow, packetId );
+    }
+
+    if( duplicate == true )
+    {
+        LogDebug( ( "Ignored the duplicate PUBACK of packet ID %u.",
+                    ( unsigned int ) packetId ) );
+    }
+    else
+    {
+        /* Empty else for MISRA 15.7 compliance. */
+    }
+
+    return duplicate;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTPublishWindow_Init( MQTTPublishWindow_t * pWindow,
+                                     MQTTContext_t * pMqttContext,
+                                     size_t maxInFlight,
+                                     uint32_t retryTimeoutMs )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( ( pWindow == NULL ) || ( pMqttContext == NULL ) ||
+        ( maxInFlight == 0U ) || ( maxInFlight > MQTT_PUBLISH_WINDOW_SIZE ) )
+    {
+        LogError( ( "Invalid parameter: pWindow=%p, pMqttContext=%p, maxInFlight=%u.",
+                    ( void * ) pWindow,
+                    ( void * ) pMqttContext,
+                    ( unsigned int ) maxInFlight ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        ( void ) memset( pWindow, 0, sizeof( MQTTPublishWindow_t ) );
+        pWindow->pMqttContext = pMqttContext;
+        pWindow->send = MQTT_Publish;
+        pWindow->maxInFlight = maxInFlight;
+        pWindow->retryTimeoutMs = retryTimeoutMs;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+void MQTTPublishWindow_SetSend( MQTTPublishWindow_t * pWindow,
+                                MQTTPublishWindowSendFunc_t send )
+{
+    configASSERT( pWindow != NULL );
+
+    pWindow->send = ( send != NULL ) ? send : MQTT_Publish;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTPublishWindow_Publish( MQTTPublishWindow_t * pWindow,
+                                        const MQTTPublishInfo_t * pPublishInfo,
+                                        uint16_t * pPacketId )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTPublishWindowEntry_t * pEntry = NULL;
+    size_t i;
+
+    if( ( pWindow == NULL ) || ( pWindow->pMqttContext == NULL ) || ( pPublishInfo == NULL ) )
+    {
+        LogError( ( "Invalid parameter: pWindow=%p, pPublishInfo=%p.",
+                    ( void * ) pWindow,
+                    ( void * ) pPublishInfo ) );
+        status = MQTTBadParameter;
+    }
+
+    /* Handle incoming PUBACKs until one frees an entry. */
+    while( ( status == MQTTSuccess ) && ( pWindow->inFlight >= pWindow->maxInFlight ) )
+    {
+        status = MQTTPublishWindow_Process( pWindow, MQTT_PUBLISH_WINDOW_POLL_MS );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        for( i = 0U; ( i < MQTT_PUBLISH_WINDOW_SIZE ) && ( pEntry == NULL ); i++ )
+        {
+            if( pWindow->entries[ i ].packetId == 0U )
+            {
+                pEntry = &( pWindow->entries[ i ] );
+            }
+        }
+
+        /* inFlight counts the used entries, so one is free. */
+        configASSERT( pEntry != NULL );
+
+        pEntry->publishInfo = *pPublishInfo;
+        pEntry->publishInfo.qos = MQTTQoS1;
+        pEntry->publishInfo.dup = false;
+        pEntry->packetId = MQTT_GetPacketId( pWindow->pMqttContext );
+        pEntry->resent = false;
+
+        /* Once the packet ID is reused, a late PUBACK for it acknowledges the
+         * new message, so it is no longer a duplicate. */
+        ( void ) takeDuplicateAck( pWindow, pEntry->packetId );
+
+        status = pWindow->send( pWindow->pMqttContext, &( pEntry->publishInfo ), pEntry->packetId );
+
+        /* A failed send leaves the outgoing record of coreMQTT in place, so
+         * the message is kept for MQTTPublishWindow_ResendAll() after the
+         * reconnect. */
+        if( ( status == MQTTSuccess ) || ( status == MQTTSendFailed ) )
+        {
+            pEntry->sentTimeMs = pWindow->pMqttContext->getTime();
+            pWindow->inFlight++;
+
+            if( pPacketId != NULL )
+            {
+                *pPacketId = pEntry->packetId;
+            }
+        }
+        else
+        {
+            pEntry->packetId = 0U;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+bool MQTTPublishWindow_Ack( MQTTPublishWindow_t * pWindow,
+                            uint16_t packetId )
+{
+    bool found = false;
+    size_t i;
+
+    configASSERT( pWindow != NULL );
+
+    for( i = 0U; ( i < MQTT_PUBLISH_WINDOW_SIZE ) && ( found == false ); i++ )
+    {
+        MQTTPublishWindowEntry_t * pEntry = &( pWindow->entries[ i ] );
+
+        if( ( packetId != 0U ) && ( pEntry->packetId == packetId ) )
+        {
+            /* The broker may acknowledge the other copy as well. */
+            if( pEntry->resent == true )
+            {
+                pWindow->duplicateAcks[ pWindow->nextDuplicateAck ] = packetId;
+                pWindow->nextDuplicateAck = ( pWindow->nextDuplicateAck + 1U ) % MQTT_PUBLISH_WINDOW_SIZE;
+            }
+
+            pEntry->packetId = 0U;
+            pWindow->inFlight--;
+            pWindow->acked++;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+/*-----------------------------------------------------------*/
+
+bool MQTTPublishWindow_IsInFlight( const MQTTPublishWindow_t * pWindow,
+                                   uint16_t packetId )
+{
+    bool found = false;
+    size_t i;
+
+    configASSERT( pWindow != NULL );
+
+    for( i = 0U; ( i < MQTT_PUBLISH_WINDOW_SIZE ) && ( found == false ); i++ )
+    {
+        if( ( packetId != 0U ) && ( pWindow->entries[ i ].packetId == packetId ) )
+        {
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTPublishWindow_Process( MQTTPublishWindow_t * pWindow,
+                                        uint32_t timeoutMs )
+{
+    MQTTStatus_t status;
+
+    configASSERT( pWindow != NULL );
+
+    status = resendExpired( pWindow );
+
+    if( status == MQTTSuccess )
+    {
+        status = MQTT_ProcessLoop( pWindow->pMqttContext, timeoutMs );
+
+        /* coreMQTT has no record left for the second PUBACK of a resent
+         * message. The packet has been read in full, so the connection is
+         * still in step. Any other bad response is still an error. */
+        if( ( status == MQTTBadResponse ) && ( isDuplicateAck( pWindow ) == true ) )
+        {
+            status = MQTTSuccess;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTPublishWindow_Drain( MQTTPublishWindow_t * pWindow,
+                                      uint32_t timeoutMs )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    uint32_t startTimeMs;
+    uint32_t elapsedMs = 0U;
+
+    configASSERT( pWindow != NULL );
+
+    startTimeMs = pWindow->pMqttContext->getTime();
+
+    while( ( status == MQTTSuccess ) && ( pWindow->inFlight > 0U ) )
+    {
+        if( elapsedMs >= timeoutMs )
+        {
+            LogWarn( ( "%u messages still in flight after %u ms.",
+                       ( unsigned int ) pWindow->inFlight,
+                       ( unsigned int ) timeoutMs ) );
+            status = MQTTNoDataAvailable;
+        }
+        else
+        {
+            status = MQTTPublishWindow_Process( pWindow,
+                                                ( ( timeoutMs - elapsedMs ) < MQTT_PUBLISH_WINDOW_POLL_MS ) ?
+                                                ( timeoutMs - elapsedMs ) : MQTT_PUBLISH_WINDOW_POLL_MS );
+            elapsedMs = pWindow->pMqttContext->getTime() - startTimeMs;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTPublishWindow_ResendAll( MQTTPublishWindow_t * pWindow )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t i;
+
+    configASSERT( pWindow != NULL );
+
+    /* Acknowledgments from the old connection are not coming any more. */
+    ( void ) memset( pWindow->duplicateAcks, 0, sizeof( pWindow->duplicateAcks ) );
+
+    for( i = 0U; ( i < MQTT_PUBLISH_WINDOW_SIZE ) && ( status == MQTTSuccess ); i++ )
+    {
+        if( pWindow->entries[ i ].packetId != 0U )
+        {
+            status = resendEntry( pWindow, &( pWindow->entries[ i ] ) );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+void MQTTPublishWindow_DropAll( MQTTPublishWindow_t * pWindow )
+{
+    size_t i;
+
+    configASSERT( pWindow != NULL );
+
+    for( i = 0U; i < MQTT_PUBLISH_WINDOW_SIZE; i++ )
+    {
+        pWindow->entries[ i ].packetId = 0U;
+    }
+
+    pWindow->inFlight = 0U;
+    ( void ) memset( pWindow->duplicateAcks, 0, sizeof( pWindow->duplicateAcks ) );
+}
+
+/*-----------------------------------------------------------*/
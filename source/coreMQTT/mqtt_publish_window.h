@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file mqtt_publish_window.h
+ * @brief QoS1 publisher that keeps several messages in flight.
+ *
+ * Instead of waiting for the PUBACK of each message, which caps throughput at
+ * one message per round trip, the window sends up to its size of QoS1
+ * messages and matches each PUBACK to its message by packet ID. A message
+ * that is not acknowledged within the retry timeout is sent again with the
+ * DUP flag and the same packet ID.
+ *
+ * MQTT 3.1.1 brokers acknowledge both copies of a retransmitted message, and
+ * coreMQTT reports the second PUBACK as #MQTTBadResponse. The window keeps
+ * the packet IDs of those PUBACKs and hides the error for them only, but keep
+ * the retry timeout well above the round trip time so that retransmissions
+ * are rare. It reads the packet ID from the network buffer, where coreMQTT v1
+ * leaves the last packet it received.
+ *
+ * The window does not copy topics or payloads: they must stay valid until
+ * the message is acknowledged, as for MQTT_Publish(). The application passes
+ * every PUBACK it receives in its MQTT event callback to
+ * MQTTPublishWindow_Ack().
+ */
+
+#ifndef MQTT_PUBLISH_WINDOW_H
+#define MQTT_PUBLISH_WINDOW_H
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+
+/* MQTT library includes. */
+#include "core_mqtt.h"
+
+/**
+ * @brief Largest number of QoS1 messages in flight. coreMQTT tracks each one
+ * in its outgoing publish records, so the window cannot be larger than
+ * MQTT_STATE_ARRAY_MAX_COUNT.
+ */
+#ifndef MQTT_PUBLISH_WINDOW_SIZE
+    #define MQTT_PUBLISH_WINDOW_SIZE    MQTT_STATE_ARRAY_MAX_COUNT
+#endif
+
+#if MQTT_PUBLISH_WINDOW_SIZE > MQTT_STATE_ARRAY_MAX_COUNT
+    #error "MQTT_PUBLISH_WINDOW_SIZE must not exceed MQTT_STATE_ARRAY_MAX_COUNT."
+#endif
+
+/**
+ * @brief Time a message waits for its PUBACK before it is sent again.
+ */
+#ifndef MQTT_PUBLISH_WINDOW_RETRY_MS
+    #define MQTT_PUBLISH_WINDOW_RETRY_MS    ( 10000U )
+#endif
+
+/**
+ * @brief Longest time MQTTPublishWindow_Publish() and
+ * MQTTPublishWindow_Drain() spend in one call of MQTT_ProcessLoop(), so that
+ * retransmissions are not delayed by much more than this.
+ */
+#ifndef MQTT_PUBLISH_WINDOW_POLL_MS
+    #define MQTT_PUBLISH_WINDOW_POLL_MS    ( 100U )
+#endif
+
+/**
+ * @brief Function that sends a PUBLISH and records it in the state of
+ * coreMQTT, with the parameters and return value of MQTT_Publish().
+ */
+typedef MQTTStatus_t ( * MQTTPublishWindowSendFunc_t )( MQTTContext_t * pMqttContext,
+                                                        const MQTTPublishInfo_t * pPublishInfo,
+                                                        uint16_t packetId );
+
+/**
+ * @brief A message in flight.
+ */
+typedef struct MQTTPublishWindowEntry
+{
+    MQTTPublishInfo_t publishInfo; /**< @brief The message, which points at the caller's topic and payload. */
+    uint16_t packetId;             /**< @brief Packet ID of the message, or 0 if the entry is free. */
+    uint32_t sentTimeMs;           /**< @brief Time of the last send, from the MQTT context's clock. */
+    bool resent;                   /**< @brief Whether the message was sent more than once. */
+} MQTTPublishWindowEntry_t;
+
+/**
+ * @brief Publish window of an MQTT connection.
+ */
+typedef struct MQTTPublishWindow
+{
+    MQTTContext_t * pMqttContext;                                 /**< @brief The connection. */
+    MQTTPublishWindowSendFunc_t send;                             /**< @brief Sends each message, MQTT_Publish() unless set with MQTTPublishWindow_SetSend(). */
+    MQTTPublishWindowEntry_t entries[ MQTT_PUBLISH_WINDOW_SIZE ]; /**< @brief Messages in flight. */
+    size_t maxInFlight;                                           /**< @brief Size of the window, at most #MQTT_PUBLISH_WINDOW_SIZE. */
+    size_t inFlight;                                              /**< @brief Number of used entries. */
+    uint32_t retryTimeoutMs;                                      /**< @brief Time before a message is sent again. */
+    uint32_t acked;                                               /**< @brief Messages acknowledged since MQTTPublishWindow_Init(). */
+    uint32_t retransmissions;                                     /**< @brief Messages sent again since MQTTPublishWindow_Init(). */
+    uint16_t duplicateAcks[ MQTT_PUBLISH_WINDOW_SIZE ];           /**< @brief Packet IDs of second PUBACKs that may still arrive for resent messages, 0 if unused. */
+    size_t nextDuplicateAck;                                      /**< @brief Entry of duplicateAcks written next, over the oldest one. */
+} MQTTPublishWindow_t;
+
+/**
+ * @brief Set up an empty window on an MQTT context.
+ *
+ * @param[out] pWindow The window.
+ * @param[in] pMqttContext Initialized MQTT context.
+ * @param[in] maxInFlight Size of the window, from 1 to #MQTT_PUBLISH_WINDOW_SIZE.
+ * A size of 1 waits for each PUBACK, as a plain QoS1 publisher does.
+ * @param[in] retryTimeoutMs Time before a message is sent again.
+ *
+ * @return #MQTTSuccess, or #MQTTBadParameter.
+ */
+MQTTStatus_t MQTTPublishWindow_Init( MQTTPublishWindow_t * pWindow,
+                                     MQTTContext_t * pMqttContext,
+                                     size_t maxInFlight,
+                                     uint32_t retryTimeoutMs );
+
+/**
+ * @brief Send the messages of the window with another function than
+ * MQTT_Publish(), for example one that hands the header and payload of each
+ * PUBLISH to the transport in one call.
+ *
+ * @param[in] pWindow The window.
+ * @param[in] send The function, or NULL for MQTT_Publish().
+ */
+void MQTTPublishWindow_SetSend( MQTTPublishWindow_t * pWindow,
+                                MQTTPublishWindowSendFunc_t send );
+
+/**
+ * @brief Send a QoS1 message, after waiting for a free entry if the window is
+ * full.
+ *
+ * While it waits, the function runs MQTTPublishWindow_Process(), so incoming
+ * packets are handled as by MQTT_ProcessLoop().
+ *
+ * @param[in] pWindow The window.
+ * @param[in] pPublishInfo The message. Its QoS is set to 1 and its DUP flag
+ * cleared.
+ * @param[out] pPacketId Packet ID given to the message. May be NULL.
+ *
+ * @return #MQTTSuccess, #MQTTBadParameter, or the first error of coreMQTT.
+ */
+MQTTStatus_t MQTTPublishWindow_Publish( MQTTPublishWindow_t * pWindow,
+                                        const MQTTPublishInfo_t * pPublishInfo,
+                                        uint16_t * pPacketId );
+
+/**
+ * @brief Release the entry of an acknowledged message. Call it with the packet
+ * ID of every PUBACK received by the MQTT event callback.
+ *
+ * @param[in] pWindow The window.
+ * @param[in] packetId Packet ID of the PUBACK.
+ *
+ * @return true if the packet ID was in flight, otherwise false.
+ */
+bool MQTTPublishWindow_Ack( MQTTPublishWindow_t * pWindow,
+                            uint16_t packetId );
+
+/**
+ * @brief Whether a message is still waiting for its PUBACK. Its topic and
+ * payload must stay valid until it is not.
+ *
+ * @param[in] pWindow The window.
+ * @param[in] packetId Packet ID given by MQTTPublishWindow_Publish().
+ *
+ * @return true if the message is in flight, otherwise false.
+ */
+bool MQTTPublishWindow_IsInFlight( const MQTTPublishWindow_t * pWindow,
+                                   uint16_t packetId );
+
+/**
+ * @brief Send again the messages whose retry timeout has expired, then
+ * receive for up to @p timeoutMs with MQTT_ProcessLoop().
+ *
+ * @param[in] pWindow The window.
+ * @param[in] timeoutMs Timeout of MQTT_ProcessLoop().
+ *
+ * @return #MQTTSuccess, or the first error of coreMQTT.
+ */
+MQTTStatus_t MQTTPublishWindow_Process( MQTTPublishWindow_t * pWindow,
+                                        uint32_t timeoutMs );
+
+/**
+ * @brief Process the connection until every message in flight is
+ * acknowledged.
+ *
+ * @param[in] pWindow The window.
+ * @param[in] timeoutMs Longest time to wait.
+ *
+ * @return #MQTTSuccess, #MQTTNoDataAvailable if messages are still in flight
+ * after @p timeoutMs, or the first error of coreMQTT.
+ */
+MQTTStatus_t MQTTPublishWindow_Drain( MQTTPublishWindow_t * pWindow,
+                                      uint32_t timeoutMs );
+
+/**
+ * @brief Send every message in flight again, with the DUP flag. Call it after
+ * reconnecting to a broker that resumed the session. If the broker did not,
+ * coreMQTT has dropped its records of the messages: call
+ * MQTTPublishWindow_DropAll() instead.
+ *
+ * @param[in] pWindow The window.
+ *
+ * @return #MQTTSuccess, or the first error of coreMQTT.
+ */
+MQTTStatus_t MQTTPublishWindow_ResendAll( MQTTPublishWindow_t * pWindow );
+
+/**
+ * @brief Forget every message in flight, and keep the settings and counters
+ * of the window. Call it after reconnecting to a broker that did not resume
+ * the session.
+ *
+ * @param[in] pWindow The window.
+ */
+void MQTTPublishWindow_DropAll( MQTTPublishWindow_t * pWindow );
+
+#endif /* ifndef MQTT_PUBLISH_WINDOW_H */
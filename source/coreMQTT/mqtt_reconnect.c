@@ -0,0 +1,470 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/**
+ * @file mqtt_reconnect.c
+ * @brief Recovery of the transport of an MQTT connection, escalating through
+ * tiers.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Configure logs for the functions in this file, before core_mqtt_config.h
+ * sets those of coreMQTT. */
+#include "logging_levels.h"
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "Reconnect"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_INFO
+#endif
+#include "logging_stack.h"
+
+#include "mqtt_reconnect.h"
+
+#if MQTT_RECONNECT_TIER_HISTORY_LENGTH > MQTT_RECONNECT_HISTORY_LENGTH
+    #error "MQTT_RECONNECT_TIER_HISTORY_LENGTH cannot exceed MQTT_RECONNECT_HISTORY_LENGTH."
+#endif
+
+/**
+ * @brief Attempts of a tier, and the backoff between them.
+ */
+typedef struct TierPolicy
+{
+    uint32_t attempts; /**< @brief Connections attempted before the next tier. */
+    uint32_t baseMs;   /**< @brief Shortest backoff. */
+    uint32_t capMs;    /**< @brief Longest backoff. */
+} TierPolicy_t;
+
+/**
+ * @brief Policies of the tiers. The more disruptive the tier, the fewer its
+ * attempts and the longer its backoff, as it takes longer to settle.
+ */
+static const TierPolicy_t tierPolicies[ MQTT_RECONNECT_TIER_COUNT ] =
+{
+    { 3U, 500U,   5000U   }, /* Socket. */
+    { 2U, 2000U,  10000U  }, /* PDN. */
+    { 2U, 5000U,  60000U  }, /* Registration. */
+    { 2U, 10000U, 120000U }  /* Modem. */
+};
+
+/**
+ * @brief Names of the tiers, for the logs.
+ */
+static const char * const tierNames[ MQTT_RECONNECT_TIER_COUNT ] =
+{
+    "socket",
+    "PDN",
+    "registration",
+    "modem"
+};
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Decorrelated-jitter backoff: a random time between the base of the
+ * tier and three times the previous backoff, up to the cap of the tier.
+ * Clients that failed together drift apart, without the long tail of full
+ * exponential backoff.
+ *
+ * @param[in] pReconnect The reconnect manager.
+ * @param[in] pPolicy Policy of the tier.
+ * @param[in] previousMs Previous backoff, or the base of the tier.
+ *
+ * @return The backoff.
+ */
+static uint32_t nextBackoff( const MQTTReconnect_t * pReconnect,
+                             const TierPolicy_t * pPolicy,
+                             uint32_t previousMs );
+
+/**
+ * @brief Make the attempts of one tier, each after its recovery.
+ *
+ * @param[in] pReconnect The reconnect manager.
+ * @param[in] tier The tier.
+ *
+ * @return Whether the transport connected.
+ */
+static bool runTier( MQTTReconnect_t * pReconnect,
+                     MQTTReconnectTier_t tier );
+
+/**
+ * @brief Choose the tier to start the recovery of a failure at: the one
+ * with the shortest median recovery time for its class, from the class up.
+ *
+ * @param[in] pReconnect The reconnect manager.
+ * @param[in] failureClass Lowest tier that can fix the failure.
+ *
+ * @return The tier.
+ */
+static MQTTReconnectTier_t selectStartTier( MQTTReconnect_t * pReconnect,
+                                            MQTTReconnectTier_t failureClass );
+
+/**
+ * @brief Add a recovery time to a history.
+ *
+ * @param[in] pHistory The history.
+ * @param[in] timeMs The recovery time.
+ */
+static void historyAdd( MQTTReconnectHistory_t * pHistory,
+                        uint32_t timeMs );
+
+/**
+ * @brief Median of a set of times.
+ *
+ * @param[in] pTimesMs The times, in any order.
+ * @param[in] count Number of times, at most #MQTT_RECONNECT_HISTORY_LENGTH.
+ *
+ * @return The median, or 0 for an empty set.
+ */
+static uint32_t median( const uint32_t * pTimesMs,
+                        size_t count );
+
+/*-----------------------------------------------------------*/
+
+static uint32_t nextBackoff( const MQTTReconnect_t * pReconnect,
+                             const TierPolicy_t * pPolicy,
+                             uint32_t previousMs )
+{
+    uint32_t rangeMs = ( previousMs * 3U ) - pPolicy->baseMs + 1U;
+    uint32_t backoffMs = pPolicy->baseMs + ( ( uint32_t ) pReconnect->interface.getRandom() % rangeMs );
+
+    return ( backoffMs < pPolicy->capMs ) ? backoffMs : pPolicy->capMs;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool runTier( MQTTReconnect_t * pReconnect,
+                     MQTTReconnectTier_t tier )
+{
+    const TierPolicy_t * pPolicy = &( tierPolicies[ tier ] );
+    const MQTTReconnectInterface_t * pInterface = &( pReconnect->interface );
+    uint32_t attempt;
+    uint32_t backoffMs = pPolicy->baseMs;
+    bool connected = false;
+
+    for( attempt = 0U; ( attempt < pPolicy->attempts ) && ( connected == false ); attempt++ )
+    {
+        if( attempt > 0U )
+        {
+            backoffMs = nextBackoff( pReconnect, pPolicy, backoffMs );
+            LogWarn( ( "Retrying the %s tier in %u ms.",
+                       tierNames[ tier ],
+                       ( unsigned int ) backoffMs ) );
+            vTaskDelay( pdMS_TO_TICKS( backoffMs ) );
+        }
+
+        /* The recovery runs again on each attempt, as the network may have
+         * undone the previous one. */
+        if( tier == MQTTReconnectTierSocket )
+        {
+            connected = true;
+        }
+        else
+        {
+            LogInfo( ( "Running the recovery of the %s tier.", tierNames[ tier ] ) );
+            connected = pInterface->recover( pInterface->pContext, tier );
+        }
+
+        if( connected == true )
+        {
+            pReconnect->stats.attempts++;
+            connected = pInterface->connect( pInterface->pContext );
+        }
+    }
+
+    return connected;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTReconnectTier_t selectStartTier( MQTTReconnect_t * pReconnect,
+                                            MQTTReconnectTier_t failureClass )
+{
+    const MQTTReconnectHistory_t * pHistory = pReconnect->history[ failureClass ];
+    MQTTReconnectTier_t startTier = failureClass;
+    uint32_t bestMs;
+    uint32_t medianMs;
+    uint32_t tier;
+
+    /* A tier without history is not skipped, so that it gets some. After
+     * a run of skips, the lowest tier is tried again, in case the network
+     * has changed. */
+    if( ( pHistory[ failureClass ].count > 0U ) &&
+        ( pReconnect->skips[ failureClass ] < MQTT_RECONNECT_TIER_HISTORY_LENGTH ) )
+    {
+        bestMs = median( pHistory[ failureClass ].timesMs, pHistory[ failureClass ].count );
+
+        for( tier = ( uint32_t ) failureClass + 1U; tier < MQTT_RECONNECT_TIER_COUNT; tier++ )
+        {
+            if( pHistory[ tier ].count > 0U )
+            {
+                medianMs = median( pHistory[ tier ].timesMs, pHistory[ tier ].count );
+
+                if( medianMs < bestMs )
+                {
+                    bestMs = medianMs;
+                    startTier = ( MQTTReconnectTier_t ) tier;
+                }
+            }
+        }
+    }
+
+    if( startTier == failureClass )
+    {
+        pReconnect->skips[ failureClass ] = 0U;
+    }
+    else
+    {
+        pReconnect->skips[ failureClass ]++;
+    }
+
+    return startTier;
+}
+
+/*-----------------------------------------------------------*/
+
+static void historyAdd( MQTTReconnectHistory_t * pHistory,
+                        uint32_t timeMs )
+{
+    pHistory->timesMs[ pHistory->next ] = timeMs;
+    pHistory->next = ( uint8_t ) ( ( pHistory->next + 1U ) % MQTT_RECONNECT_TIER_HISTORY_LENGTH );
+
+    if( pHistory->count < MQTT_RECONNECT_TIER_HISTORY_LENGTH )
+    {
+        pHistory->count++;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t median( const uint32_t * pTimesMs,
+                        size_t count )
+{
+    uint32_t sorted[ MQTT_RECONNECT_HISTORY_LENGTH ];
+    uint32_t value;
+    uint32_t result = 0U;
+    size_t i;
+    size_t j;
+
+    configASSERT( count <= MQTT_RECONNECT_HISTORY_LENGTH );
+
+    /* Insertion sort, as there are few times. */
+    for( i = 0U; i < count; i++ )
+    {
+        value = pTimesMs[ i ];
+
+        for( j = i; ( j > 0U ) && ( sorted[ j - 1U ] > value ); j-- )
+        {
+            sorted[ j ] = sorted[ j - 1U ];
+        }
+
+        sorted[ j ] = value;
+    }
+
+    if( count > 0U )
+    {
+        result = ( ( count % 2U ) == 1U ) ? sorted[ count / 2U ] :
+                 ( uint32_t ) ( ( ( uint64_t ) sorted[ ( count / 2U ) - 1U ] + sorted[ count / 2U ] ) / 2U );
+    }
+
+    return result;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTReconnect_Init( MQTTReconnect_t * pReconnect,
+                                 const MQTTReconnectInterface_t * pInterface )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( ( pReconnect == NULL ) || ( pInterface == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pReconnect=%p, pInterface=%p.",
+                    ( void * ) pReconnect,
+                    ( void * ) pInterface ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pInterface->connect == NULL ) || ( pInterface->classify == NULL ) ||
+             ( pInterface->recover == NULL ) || ( pInterface->getTime == NULL ) ||
+             ( pInterface->getRandom == NULL ) )
+    {
+        LogError( ( "All the functions of the interface are required." ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        ( void ) memset( pReconnect, 0x00, sizeof( MQTTReconnect_t ) );
+        pReconnect->interface = *pInterface;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+bool MQTTReconnect_Connect( MQTTReconnect_t * pReconnect )
+{
+    const MQTTReconnectInterface_t * pInterface;
+    uint32_t startMs;
+    uint32_t endMs;
+    uint32_t elapsedMs;
+    uint32_t tierStartMs[ MQTT_RECONNECT_TIER_COUNT ] = { 0U };
+    bool tierRun[ MQTT_RECONNECT_TIER_COUNT ] = { false };
+    MQTTReconnectTier_t failureClass;
+    MQTTReconnectTier_t tier;
+    MQTTReconnectTier_t lowestTier;
+    bool connected = false;
+    uint32_t i;
+
+    configASSERT( pReconnect != NULL );
+
+    pInterface = &( pReconnect->interface );
+    startMs = pInterface->getTime();
+
+    failureClass = pInterface->classify( pInterface->pContext );
+
+    if( ( uint32_t ) failureClass >= MQTT_RECONNECT_TIER_COUNT )
+    {
+        failureClass = MQTTReconnectTierModem;
+    }
+
+    tier = selectStartTier( pReconnect, failureClass );
+
+    if( tier != failureClass )
+    {
+        LogInfo( ( "Failure of the %s tier. Starting at the %s tier, which has recovered faster.",
+                   tierNames[ failureClass ],
+                   tierNames[ tier ] ) );
+    }
+
+    for( ; ; )
+    {
+        tierStartMs[ tier ] = pInterface->getTime();
+        tierRun[ tier ] = true;
+        connected = runTier( pReconnect, tier );
+
+        if( ( connected == true ) || ( tier == MQTTReconnectTierModem ) )
+        {
+            break;
+        }
+
+        /* Escalate to the next tier, or further if the failure has spread
+         * to a lower layer in the meantime. */
+        lowestTier = pInterface->classify( pInterface->pContext );
+
+        if( ( ( uint32_t ) lowestTier > ( uint32_t ) tier ) &&
+            ( ( uint32_t ) lowestTier < MQTT_RECONNECT_TIER_COUNT ) )
+        {
+            tier = lowestTier;
+        }
+        else
+        {
+            tier = ( MQTTReconnectTier_t ) ( ( uint32_t ) tier + 1U );
+        }
+    }
+
+    endMs = pInterface->getTime();
+    elapsedMs = endMs - startMs;
+
+    if( connected == true )
+    {
+        /* Each tier that ran would have recovered in the time from its start,
+         * whether it connected itself or escalated. */
+        for( i = 0U; i < MQTT_RECONNECT_TIER_COUNT; i++ )
+        {
+            if( tierRun[ i ] == true )
+            {
+                historyAdd( &( pReconnect->history[ failureClass ][ i ] ),
+                            endMs - tierStartMs[ i ] );
+            }
+        }
+
+        pReconnect->reconnectMs[ pReconnect->reconnectNext ] = elapsedMs;
+        pReconnect->reconnectNext = ( pReconnect->reconnectNext + 1U ) % MQTT_RECONNECT_HISTORY_LENGTH;
+
+        if( pReconnect->reconnectCount < MQTT_RECONNECT_HISTORY_LENGTH )
+        {
+            pReconnect->reconnectCount++;
+        }
+
+        pReconnect->stats.recoveries++;
+        pReconnect->stats.recoveredAt[ tier ]++;
+
+        if( elapsedMs > pReconnect->stats.maxMs )
+        {
+            pReconnect->stats.maxMs = elapsedMs;
+        }
+
+        LogInfo( ( "Connected by the %s tier in %u ms.",
+                   tierNames[ tier ],
+                   ( unsigned int ) elapsedMs ) );
+    }
+    else
+    {
+        pReconnect->stats.failures++;
+        LogError( ( "Failed to connect through all the tiers in %u ms.",
+                    ( unsigned int ) elapsedMs ) );
+    }
+
+    return connected;
+}
+
+/*-----------------------------------------------------------*/
+
+void MQTTReconnect_GetStats( const MQTTReconnect_t * pReconnect,
+                             MQTTReconnectStats_t * pStats )
+{
+    configASSERT( pReconnect != NULL );
+    configASSERT( pStats != NULL );
+
+    *pStats = pReconnect->stats;
+    pStats->medianMs = median( pReconnect->reconnectMs, pReconnect->reconnectCount );
+}
+
+/*-----------------------------------------------------------*/
+
+void MQTTReconnect_LogStats( const MQTTReconnect_t * pReconnect )
+{
+    MQTTReconnectStats_t stats;
+
+    MQTTReconnect_GetStats( pReconnect, &stats );
+
+    LogInfo( ( "Reconnects: %u connected, %u failed, %u connection attempts. "
+               "Connected by tier: socket %u, PDN %u, registration %u, modem %u. "
+               "Time-to-reconnect %u ms median, %u ms maximum.",
+               ( unsigned int ) stats.recoveries,
+               ( unsigned int ) stats.failures,
+               ( unsigned int ) stats.attempts,
+               ( unsigned int ) stats.recoveredAt[ MQTTReconnectTierSocket ],
+               ( unsigned int ) stats.recoveredAt[ MQTTReconnectTierPdn ],
+               ( unsigned int ) stats.recoveredAt[ MQTTReconnectTierRegistration ],
+               ( unsigned int ) stats.recoveredAt[ MQTTReconnectTierModem ],
+               ( unsigned int ) stats.medianMs,
+               ( unsigned int ) stats.maxMs ) );
+}
+
+/*-----------------------------------------------------------*/
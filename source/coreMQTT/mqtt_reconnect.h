@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/**
+ * @file mqtt_reconnect.h
+ * @brief Recovery of the transport of an MQTT connection, escalating through
+ * tiers.
+ *
+ * A lost connection has causes that a new TCP connection does not fix: the
+ * PDN may have been deactivated, the modem may have lost its registration,
+ * or the modem itself may have stopped answering. Each tier recovers one
+ * more layer before it connects again:
+ *
+ * - #MQTTReconnectTierSocket only connects again.
+ * - #MQTTReconnectTierPdn re-activates the PDN first.
+ * - #MQTTReconnectTierRegistration registers on the network again.
+ * - #MQTTReconnectTierModem resets the modem.
+ *
+ * The failure is first classified into the lowest tier that can fix it.
+ * Each tier then makes a few attempts, with decorrelated-jitter backoff in
+ * between, before the next tier takes over.
+ *
+ * For each class of failure, the time from the start of each tier to the
+ * reconnection is kept. Recovery starts at the tier with the shortest median,
+ * so a network on which the PDN always has to be re-activated stops spending
+ * time on new sockets first. The time-to-reconnect of the recoveries is also
+ * kept, for its median.
+ */
+
+#ifndef MQTT_RECONNECT_H
+#define MQTT_RECONNECT_H
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/* MQTT library includes. */
+#include "core_mqtt.h"
+
+/**
+ * @brief Number of recovery times kept for each class of failure and tier.
+ */
+#ifndef MQTT_RECONNECT_TIER_HISTORY_LENGTH
+    #define MQTT_RECONNECT_TIER_HISTORY_LENGTH    ( 8U )
+#endif
+
+/**
+ * @brief Number of times-to-reconnect kept for the median.
+ */
+#ifndef MQTT_RECONNECT_HISTORY_LENGTH
+    #define MQTT_RECONNECT_HISTORY_LENGTH    ( 32U )
+#endif
+
+/**
+ * @brief Recovery tiers, from the cheapest to the most disruptive.
+ */
+typedef enum MQTTReconnectTier
+{
+    MQTTReconnectTierSocket = 0,   /**< @brief Connect again. */
+    MQTTReconnectTierPdn,          /**< @brief Re-activate the PDN. */
+    MQTTReconnectTierRegistration, /**< @brief Register on the network again. */
+    MQTTReconnectTierModem         /**< @brief Reset the modem. */
+} MQTTReconnectTier_t;
+
+/**
+ * @brief Number of tiers of #MQTTReconnectTier_t.
+ */
+#define MQTT_RECONNECT_TIER_COUNT    ( 4U )
+
+/**
+ * @brief Functions of the transport and of the modem.
+ */
+typedef struct MQTTReconnectInterface
+{
+    /**
+     * @brief Attempt one connection of the transport.
+     *
+     * @param[in] pContext #MQTTReconnectInterface_t.pContext.
+     *
+     * @return Whether the transport is connected.
+     */
+    bool ( * connect )( void * pContext );
+
+    /**
+     * @brief Find the lowest tier that can fix the current failure, for
+     * example from the registration and PDN status of the modem.
+     *
+     * @param[in] pContext #MQTTReconnectInterface_t.pContext.
+     *
+     * @return The tier.
+     */
+    MQTTReconnectTier_t ( * classify )( void * pContext );
+
+    /**
+     * @brief Run the recovery of a tier above #MQTTReconnectTierSocket.
+     *
+     * @param[in] pContext #MQTTReconnectInterface_t.pContext.
+     * @param[in] tier The tier.
+     *
+     * @return Whether the recovery succeeded, and a connection can follow.
+     */
+    bool ( * recover )( void * pContext,
+                        MQTTReconnectTier_t tier );
+
+    MQTTGetCurrentTimeFunc_t getTime;    /**< @brief Time in milliseconds. */
+    UBaseType_t ( * getRandom )( void ); /**< @brief Random number for the jitter. */
+    void * pContext;                     /**< @brief Context of the functions. */
+} MQTTReconnectInterface_t;
+
+/**
+ * @brief Counters since MQTTReconnect_Init().
+ */
+typedef struct MQTTReconnectStats
+{
+    uint32_t recoveries;                               /**< @brief Calls to MQTTReconnect_Connect() that connected. */
+    uint32_t failures;                                 /**< @brief Calls that went through all tiers without connecting. */
+    uint32_t attempts;                                 /**< @brief Connections attempted. */
+    uint32_t recoveredAt[ MQTT_RECONNECT_TIER_COUNT ]; /**< @brief Recoveries by the tier that connected. */
+    uint32_t medianMs;                                 /**< @brief Median of the kept times-to-reconnect. */
+    uint32_t maxMs;                                    /**< @brief Longest time-to-reconnect. */
+} MQTTReconnectStats_t;
+
+/**
+ * @brief Times from the start of a tier to the reconnection, as a ring.
+ */
+typedef struct MQTTReconnectHistory
+{
+    uint32_t timesMs[ MQTT_RECONNECT_TIER_HISTORY_LENGTH ]; /**< @brief Recovery times. */
+    uint8_t count;                                          /**< @brief Number of valid entries. */
+    uint8_t next;                                           /**< @brief Entry overwritten next. */
+} MQTTReconnectHistory_t;
+
+/**
+ * @brief Reconnect manager. Its fields are private.
+ */
+typedef struct MQTTReconnect
+{
+    MQTTReconnectInterface_t interface;                                                       /**< @brief Functions of the transport and of the modem. */
+    MQTTReconnectHistory_t history[ MQTT_RECONNECT_TIER_COUNT ][ MQTT_RECONNECT_TIER_COUNT ]; /**< @brief Recovery times, by class of failure and tier. */
+    uint32_t reconnectMs[ MQTT_RECONNECT_HISTORY_LENGTH ];                                    /**< @brief Times-to-reconnect, as a ring. */
+    uint32_t reconnectCount;                                                                  /**< @brief Number of valid entries of reconnectMs. */
+    uint32_t reconnectNext;                                                                   /**< @brief Entry of reconnectMs overwritten next. */
+    uint8_t skips[ MQTT_RECONNECT_TIER_COUNT ];                                               /**< @brief Consecutive recoveries of each class of failure that skipped tiers. */
+    MQTTReconnectStats_t stats;                                                               /**< @brief Counters. */
+} MQTTReconnect_t;
+
+/**
+ * @brief Set up a reconnect manager.
+ *
+ * @param[out] pReconnect The reconnect manager.
+ * @param[in] pInterface Functions of the transport and of the modem. All are
+ * required.
+ *
+ * @return #MQTTSuccess, or #MQTTBadParameter.
+ */
+MQTTStatus_t MQTTReconnect_Init( MQTTReconnect_t * pReconnect,
+                                 const MQTTReconnectInterface_t * pInterface );
+
+/**
+ * @brief Connect the transport, escalating through the tiers until it
+ * connects or the last tier has run out of attempts.
+ *
+ * @param[in] pReconnect The reconnect manager.
+ *
+ * @return Whether the transport is connected.
+ */
+bool MQTTReconnect_Connect( MQTTReconnect_t * pReconnect );
+
+/**
+ * @brief Copy the counters, with the median of the kept times-to-reconnect.
+ *
+ * @param[in] pReconnect The reconnect manager.
+ * @param[out] pStats Where to write the counters.
+ */
+void MQTTReconnect_GetStats( const MQTTReconnect_t * pReconnect,
+                             MQTTReconnectStats_t * pStats );
+
+/**
+ * @brief Log the recoveries by tier and the median time-to-reconnect.
+ *
+ * @param[in] pReconnect The reconnect manager.
+ */
+void MQTTReconnect_LogStats( const MQTTReconnect_t * pReconnect );
+
+#endif /* ifndef MQTT_RECONNECT_H */
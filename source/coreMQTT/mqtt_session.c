@@ -0,0 +1,419 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file mqtt_session.c
+ * @brief Persistent MQTT session that outlives the connections of its
+ * transport.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Configure logs for the functions in this file, before core_mqtt_config.h
+ * sets those of coreMQTT. */
+#include "logging_levels.h"
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "Session"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_INFO
+#endif
+#include "logging_stack.h"
+
+#include "mqtt_session.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Connect the transport. Each time connect() gives up, wait for the
+ * recovery backoff, filling the offline queue meanwhile, and try again.
+ *
+ * @param[in] pSession The session.
+ */
+static void connectTransport( MQTTSession_t * pSession );
+
+/**
+ * @brief Wait for the recovery backoff, with its jitter.
+ *
+ * @param[in] pSession The session.
+ */
+static void waitRecoveryBackoff( MQTTSession_t * pSession );
+
+/**
+ * @brief Send CONNECT, subscribe unless the broker resumed the session, and
+ * bring the publish window and the offline queue up to date.
+ *
+ * @param[in] pSession The session.
+ * @param[out] pSessionPresent Whether the broker resumed the session.
+ *
+ * @return #MQTTSuccess, or the error that failed the connection.
+ */
+static MQTTStatus_t startSession( MQTTSession_t * pSession,
+                                  bool * pSessionPresent );
+
+/**
+ * @brief Publish until the connection fails.
+ *
+ * @param[in] pSession The session.
+ *
+ * @return The error that ended the connection.
+ */
+static MQTTStatus_t publishLoop( MQTTSession_t * pSession );
+
+/**
+ * @brief Run the command agent, or the publish loop without one, until the
+ * connection fails.
+ *
+ * @param[in] pSession The session.
+ * @param[in] sessionPresent Whether the broker resumed the session.
+ *
+ * @return The error that ended the connection.
+ */
+static MQTTStatus_t runConnection( MQTTSession_t * pSession,
+                                   bool sessionPresent );
+
+/*-----------------------------------------------------------*/
+
+static void connectTransport( MQTTSession_t * pSession )
+{
+    const MQTTSessionInterface_t * pInterface = &( pSession->interface );
+
+    while( pInterface->connect( pInterface->pContext ) == false )
+    {
+        pSession->stats.recoveryBackoffs++;
+        waitRecoveryBackoff( pSession );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static void waitRecoveryBackoff( MQTTSession_t * pSession )
+{
+    const MQTTSessionInterface_t * pInterface = &( pSession->interface );
+    const MQTTSessionConfig_t * pConfig = &( pSession->config );
+    uint32_t backoffMs = pConfig->recoveryBackoffMs;
+    uint32_t startMs = pInterface->getTime();
+    uint32_t elapsedMs;
+
+    if( pConfig->recoveryJitterMs > 0U )
+    {
+        backoffMs += ( uint32_t ) pInterface->getRandom() % pConfig->recoveryJitterMs;
+    }
+
+    LogError( ( "The connection could not be recovered. Starting over in %u s.",
+                ( unsigned int ) ( backoffMs / 1000U ) ) );
+
+    #ifdef MQTT_OFFLINE_QUEUE
+        if( pConfig->pOfflineQueue != NULL )
+        {
+            /* Keep producing messages while out of coverage. */
+            while( ( pInterface->getTime() - startMs ) < backoffMs )
+            {
+                pInterface->storeOffline( pInterface->pContext );
+                vTaskDelay( pdMS_TO_TICKS( pConfig->offlineIntervalMs ) );
+            }
+        }
+    #endif
+
+    elapsedMs = pInterface->getTime() - startMs;
+
+    if( elapsedMs < backoffMs )
+    {
+        vTaskDelay( pdMS_TO_TICKS( backoffMs - elapsedMs ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t startSession( MQTTSession_t * pSession,
+                                  bool * pSessionPresent )
+{
+    const MQTTSessionInterface_t * pInterface = &( pSession->interface );
+    const MQTTSessionConfig_t * pConfig = &( pSession->config );
+    MQTTStatus_t status;
+
+    *pSessionPresent = false;
+    status = pInterface->sendConnect( pInterface->pContext, pSessionPresent );
+
+    if( status != MQTTSuccess )
+    {
+        /* The transport is connected again, like after a failed publish. */
+    }
+    else if( *pSessionPresent == true )
+    {
+        LogInfo( ( "The broker resumed the session. Skipping SUBSCRIBE." ) );
+    }
+    else
+    {
+        status = pInterface->subscribe( pInterface->pContext );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        pSession->stats.connections++;
+
+        #ifdef MQTT_ADAPTIVE_KEEP_ALIVE
+            if( pConfig->pKeepAlive != NULL )
+            {
+                MQTTKeepAlive_Start( pConfig->pKeepAlive );
+            }
+        #endif
+
+        /* Messages without PUBACK may or may not have reached the broker;
+         * with the session resumed, send them again as duplicates. */
+        if( *pSessionPresent == true )
+        {
+            pSession->stats.resumed++;
+            status = MQTTPublishWindow_ResendAll( pConfig->pWindow );
+        }
+        else
+        {
+            if( pConfig->pWindow->inFlight > 0U )
+            {
+                LogWarn( ( "The broker lost the session. Dropping %u unacknowledged messages.",
+                           ( unsigned int ) pConfig->pWindow->inFlight ) );
+                pSession->stats.droppedInFlight += ( uint32_t ) pConfig->pWindow->inFlight;
+            }
+
+            MQTTPublishWindow_DropAll( pConfig->pWindow );
+        }
+    }
+
+    #ifdef MQTT_OFFLINE_QUEUE
+        /* Forward the backlog, oldest first, before any new message. */
+        if( ( status == MQTTSuccess ) && ( pConfig->pOfflineQueue != NULL ) &&
+            ( MQTTOfflineQueue_Drain( pConfig->pOfflineQueue, pConfig->pWindow,
+                                      pConfig->drainTimeoutMs ) != MQTT_OFFLINE_QUEUE_SUCCESS ) )
+        {
+            status = MQTTSendFailed;
+        }
+    #endif
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t publishLoop( MQTTSession_t * pSession )
+{
+    const MQTTSessionInterface_t * pInterface = &( pSession->interface );
+    const MQTTSessionConfig_t * pConfig = &( pSession->config );
+    MQTTStatus_t status = MQTTSuccess;
+
+    /* MQTT_ProcessLoop also sends PINGREQ when the connection has been idle
+     * for the keep-alive. */
+    while( status == MQTTSuccess )
+    {
+        status = pInterface->publish( pInterface->pContext );
+
+        if( status == MQTTSuccess )
+        {
+            status = MQTTPublishWindow_Process( pConfig->pWindow, pConfig->windowPollMs );
+        }
+
+        #ifdef MQTT_ADAPTIVE_KEEP_ALIVE
+            if( pConfig->pKeepAlive != NULL )
+            {
+                MQTTKeepAlive_Process( pConfig->pKeepAlive );
+            }
+        #endif
+
+        if( ( status == MQTTSuccess ) && ( pInterface->idle != NULL ) )
+        {
+            status = pInterface->idle( pInterface->pContext );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t runConnection( MQTTSession_t * pSession,
+                                   bool sessionPresent )
+{
+    MQTTStatus_t status;
+
+    #ifdef MQTT_COMMAND_AGENT
+        const MQTTSessionConfig_t * pConfig = &( pSession->config );
+
+        if( pConfig->pCommandAgent != NULL )
+        {
+            /* This task now only runs the agent, which returns once the
+             * connection fails. */
+            MQTTCommandAgent_Resume( pConfig->pCommandAgent, sessionPresent );
+            status = MQTTCommandAgent_Run( pConfig->pCommandAgent );
+        }
+        else
+        {
+            status = publishLoop( pSession );
+        }
+    #else
+        ( void ) sessionPresent;
+        status = publishLoop( pSession );
+    #endif /* ifdef MQTT_COMMAND_AGENT */
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTSession_Init( MQTTSession_t * pSession,
+                               const MQTTSessionInterface_t * pInterface,
+                               const MQTTSessionConfig_t * pConfig )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( ( pSession == NULL ) || ( pInterface == NULL ) || ( pConfig == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pSession=%p, pInterface=%p, pConfig=%p.",
+                    ( void * ) pSession,
+                    ( void * ) pInterface,
+                    ( void * ) pConfig ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pInterface->connect == NULL ) || ( pInterface->disconnect == NULL ) ||
+             ( pInterface->sendConnect == NULL ) || ( pInterface->subscribe == NULL ) ||
+             ( pInterface->getTime == NULL ) || ( pInterface->getRandom == NULL ) )
+    {
+        LogError( ( "connect, disconnect, sendConnect, subscribe, getTime and getRandom are required." ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pConfig->pMqttContext == NULL ) || ( pConfig->pWindow == NULL ) )
+    {
+        LogError( ( "The MQTT context and the publish window are required." ) );
+        status = MQTTBadParameter;
+    }
+
+    #ifdef MQTT_COMMAND_AGENT
+        else if( ( pConfig->pCommandAgent == NULL ) && ( pInterface->publish == NULL ) )
+        {
+            LogError( ( "publish is required without a command agent." ) );
+            status = MQTTBadParameter;
+        }
+    #else
+        else if( pInterface->publish == NULL )
+        {
+            LogError( ( "publish is required." ) );
+            status = MQTTBadParameter;
+        }
+    #endif /* ifdef MQTT_COMMAND_AGENT */
+
+    #ifdef MQTT_OFFLINE_QUEUE
+        else if( ( pConfig->pOfflineQueue != NULL ) &&
+                 ( ( pInterface->storeOffline == NULL ) || ( pConfig->offlineIntervalMs == 0U ) ) )
+        {
+            LogError( ( "storeOffline and offlineIntervalMs are required with an offline queue." ) );
+            status = MQTTBadParameter;
+        }
+    #endif
+    else
+    {
+        ( void ) memset( pSession, 0x00, sizeof( MQTTSession_t ) );
+        pSession->interface = *pInterface;
+        pSession->config = *pConfig;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+void MQTTSession_Run( MQTTSession_t * pSession )
+{
+    const MQTTSessionInterface_t * pInterface;
+    MQTTStatus_t status;
+    bool sessionPresent = false;
+
+    configASSERT( pSession != NULL );
+
+    pInterface = &( pSession->interface );
+
+    for( ; ; )
+    {
+        connectTransport( pSession );
+        status = startSession( pSession, &sessionPresent );
+
+        if( status == MQTTSuccess )
+        {
+            if( pInterface->ready != NULL )
+            {
+                pInterface->ready( pInterface->pContext );
+            }
+
+            status = runConnection( pSession, sessionPresent );
+        }
+
+        #ifdef MQTT_ADAPTIVE_KEEP_ALIVE
+            if( pSession->config.pKeepAlive != NULL )
+            {
+                /* A PINGREQ without PINGRESP shortens the interval. */
+                MQTTKeepAlive_ConnectionLost( pSession->config.pKeepAlive );
+            }
+        #endif
+
+        /* Only the transport is torn down. The next CONNECT resumes the
+         * session, so there is no MQTT DISCONNECT. */
+        LogWarn( ( "MQTT connection lost with status %s. Reconnecting the transport.",
+                   MQTT_Status_strerror( status ) ) );
+        pInterface->disconnect( pInterface->pContext );
+
+        if( pInterface->logStats != NULL )
+        {
+            pInterface->logStats( pInterface->pContext );
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void MQTTSession_GetStats( const MQTTSession_t * pSession,
+                           MQTTSessionStats_t * pStats )
+{
+    configASSERT( pSession != NULL );
+    configASSERT( pStats != NULL );
+
+    *pStats = pSession->stats;
+}
+
+/*-----------------------------------------------------------*/
+
+void MQTTSession_LogStats( const MQTTSession_t * pSession )
+{
+    MQTTSessionStats_t stats;
+
+    MQTTSession_GetStats( pSession, &stats );
+
+    LogInfo( ( "Session: %u connections, %u resumed by the broker, "
+               "%u unacknowledged messages dropped, %u recovery backoffs.",
+               ( unsigned int ) stats.connections,
+               ( unsigned int ) stats.resumed,
+               ( unsigned int ) stats.droppedInFlight,
+               ( unsigned int ) stats.recoveryBackoffs ) );
+}
+
+/*-----------------------------------------------------------*/
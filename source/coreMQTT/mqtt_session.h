@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file mqtt_session.h
+ * @brief Persistent MQTT session that outlives the connections of its
+ * transport.
+ *
+ * The session connects with a clean session flag of 0, so that the broker
+ * keeps the subscriptions and the QoS1 messages queued for the client while
+ * it is away. When the connection fails, only the transport is connected
+ * again: there is no MQTT DISCONNECT, and the MQTT context with its packet
+ * identifiers and messages in flight is kept. If the broker resumed the
+ * session, SUBSCRIBE is skipped and the messages without PUBACK are sent
+ * again as duplicates. Otherwise the session subscribes again and drops them.
+ *
+ * The transport is connected by a function of the application, typically
+ * MQTTReconnect_Connect(). When that function gives up, the session waits for
+ * a long backoff with jitter and starts it over, so that the device never
+ * stops trying.
+ *
+ * The session also drives the optional modules of the connection: it
+ * forwards the backlog of the offline queue once connected and fills it while
+ * the transport is down, runs the command agent instead of the publish loop,
+ * and reports the connections to the adaptive keep-alive. Each of them is
+ * only part of the session when its feature macro, MQTT_OFFLINE_QUEUE,
+ * MQTT_COMMAND_AGENT or MQTT_ADAPTIVE_KEEP_ALIVE, is defined in
+ * core_mqtt_config.h.
+ */
+
+#ifndef MQTT_SESSION_H
+#define MQTT_SESSION_H
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/* MQTT library includes. */
+#include "core_mqtt.h"
+
+/* Modules driven by the session. */
+#include "mqtt_publish_window.h"
+
+#ifdef MQTT_OFFLINE_QUEUE
+    #include "mqtt_offline_queue.h"
+#endif
+
+#ifdef MQTT_ADAPTIVE_KEEP_ALIVE
+    #include "mqtt_keep_alive.h"
+#endif
+
+#ifdef MQTT_COMMAND_AGENT
+    #include "mqtt_command_agent.h"
+#endif
+
+/**
+ * @brief Functions of the application.
+ */
+typedef struct MQTTSessionInterface
+{
+    /**
+     * @brief Connect the transport, recovering the network as needed, and
+     * prepare it for the MQTT connection.
+     *
+     * @param[in] pContext #MQTTSessionInterface_t.pContext.
+     *
+     * @return Whether the transport is connected. On false, the session
+     * calls the function again after its backoff.
+     */
+    bool ( * connect )( void * pContext );
+
+    /**
+     * @brief Close the transport after a failure of the connection.
+     *
+     * @param[in] pContext #MQTTSessionInterface_t.pContext.
+     */
+    void ( * disconnect )( void * pContext );
+
+    /**
+     * @brief Send CONNECT with a clean session flag of 0, and wait for
+     * CONNACK.
+     *
+     * @param[in] pContext #MQTTSessionInterface_t.pContext.
+     * @param[out] pSessionPresent Whether the broker resumed the session.
+     *
+     * @return #MQTTSuccess, or the error of coreMQTT.
+     */
+    MQTTStatus_t ( * sendConnect )( void * pContext,
+                                    bool * pSessionPresent );
+
+    /**
+     * @brief Subscribe to the topics of the application, when the broker
+     * did not resume the session.
+     *
+     * @param[in] pContext #MQTTSessionInterface_t.pContext.
+     *
+     * @return #MQTTSuccess, or the error that failed the subscription.
+     */
+    MQTTStatus_t ( * subscribe )( void * pContext );
+
+    /**
+     * @brief Optional. Called once the session is up, before the first
+     * publish, for example to shorten the receive timeout of the transport.
+     *
+     * @param[in] pContext #MQTTSessionInterface_t.pContext.
+     */
+    void ( * ready )( void * pContext );
+
+    /**
+     * @brief Publish the next messages through the publish window. Required
+     * without a command agent.
+     *
+     * @param[in] pContext #MQTTSessionInterface_t.pContext.
+     *
+     * @return #MQTTSuccess, or the error of coreMQTT.
+     */
+    MQTTStatus_t ( * publish )( void * pContext );
+
+    /**
+     * @brief Optional. Process the connection until the next publish is
+     * due. Without it, publish() sets the pace.
+     *
+     * @param[in] pContext #MQTTSessionInterface_t.pContext.
+     *
+     * @return #MQTTSuccess, or the error of coreMQTT.
+     */
+    MQTTStatus_t ( * idle )( void * pContext );
+
+    #ifdef MQTT_OFFLINE_QUEUE
+
+        /**
+         * @brief Store the message that would have been published in the
+         * offline queue. Required with an offline queue.
+         *
+         * @param[in] pContext #MQTTSessionInterface_t.pContext.
+         */
+        void ( * storeOffline )( void * pContext );
+    #endif
+
+    /**
+     * @brief Optional. Log the statistics of the application after each
+     * connection.
+     *
+     * @param[in] pContext #MQTTSessionInterface_t.pContext.
+     */
+    void ( * logStats )( void * pContext );
+
+    MQTTGetCurrentTimeFunc_t getTime;    /**< @brief Time in milliseconds. */
+    UBaseType_t ( * getRandom )( void ); /**< @brief Random number for the jitter. */
+    void * pContext;                     /**< @brief Context of the functions. */
+} MQTTSessionInterface_t;
+
+/**
+ * @brief Modules and timings of the session.
+ */
+typedef struct MQTTSessionConfig
+{
+    MQTTContext_t * pMqttContext;  /**< @brief Initialized MQTT context, kept across connections. */
+    MQTTPublishWindow_t * pWindow; /**< @brief Publish window of the MQTT context. */
+    uint32_t windowPollMs;         /**< @brief Time MQTTPublishWindow_Process() waits for acks after each publish, or 0 if idle() reads them. */
+    uint32_t recoveryBackoffMs;    /**< @brief Wait before connect() is called again once it has given up. */
+    uint32_t recoveryJitterMs;     /**< @brief Largest random time added to recoveryBackoffMs. */
+
+    #ifdef MQTT_OFFLINE_QUEUE
+        MQTTOfflineQueue_t * pOfflineQueue; /**< @brief Initialized offline queue, or NULL. */
+        uint32_t drainTimeoutMs;            /**< @brief Longest wait for the acks of each batch of the offline queue. */
+        uint32_t offlineIntervalMs;         /**< @brief Interval between two calls of storeOffline() while the transport is down. */
+    #endif
+
+    #ifdef MQTT_ADAPTIVE_KEEP_ALIVE
+        MQTTKeepAlive_t * pKeepAlive; /**< @brief Initialized adaptive keep-alive, or NULL. */
+    #endif
+
+    #ifdef MQTT_COMMAND_AGENT
+        MQTTCommandAgent_t * pCommandAgent; /**< @brief Initialized command agent, which publishes instead of publish(), or NULL. */
+    #endif
+} MQTTSessionConfig_t;
+
+/**
+ * @brief Counters since MQTTSession_Init().
+ */
+typedef struct MQTTSessionStats
+{
+    uint32_t connections;      /**< @brief Connections on which CONNECT succeeded. */
+    uint32_t resumed;          /**< @brief Connections on which the broker resumed the session. */
+    uint32_t droppedInFlight;  /**< @brief Messages without PUBACK dropped because the broker lost the session. */
+    uint32_t recoveryBackoffs; /**< @brief Backoffs after connect() gave up. */
+} MQTTSessionStats_t;
+
+/**
+ * @brief Persistent session. Its fields are private.
+ */
+typedef struct MQTTSession
+{
+    MQTTSessionInterface_t interface; /**< @brief Functions of the application. */
+    MQTTSessionConfig_t config;       /**< @brief Modules and timings. */
+    MQTTSessionStats_t stats;         /**< @brief Counters. */
+} MQTTSession_t;
+
+/**
+ * @brief Set up a persistent session.
+ *
+ * @param[out] pSession The session.
+ * @param[in] pInterface Functions of the application. connect(),
+ * disconnect(), sendConnect(), subscribe(), getTime() and getRandom() are
+ * required.
+ * @param[in] pConfig Modules and timings. The MQTT context and the publish
+ * window are required.
+ *
+ * @return #MQTTSuccess, or #MQTTBadParameter.
+ */
+MQTTStatus_t MQTTSession_Init( MQTTSession_t * pSession,
+                               const MQTTSessionInterface_t * pInterface,
+                               const MQTTSessionConfig_t * pConfig );
+
+/**
+ * @brief Run the session: connect, publish until the connection fails, and
+ * connect again. Does not return.
+ *
+ * @param[in] pSession The session.
+ */
+void MQTTSession_Run( MQTTSession_t * pSession );
+
+/**
+ * @brief Copy the counters.
+ *
+ * @param[in] pSession The session.
+ * @param[out] pStats Where to write the counters.
+ */
+void MQTTSession_GetStats( const MQTTSession_t * pSession,
+                           MQTTSessionStats_t * pStats );
+
+/**
+ * @brief Log the connections and how many of them resumed the session.
+ *
+ * @param[in] pSession The session.
+ */
+void MQTTSession_LogStats( const MQTTSession_t * pSession );
+
+#endif /* ifndef MQTT_SESSION_H */
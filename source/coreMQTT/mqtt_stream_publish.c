@@ -0,0 +1,314 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file mqtt_stream_publish.c
+ * @brief Publish of payloads larger than the network buffer.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Configure logs for the functions in this file, before core_mqtt_config.h
+ * sets those of coreMQTT. */
+#include "logging_levels.h"
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "StreamPublish"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_INFO
+#endif
+#include "logging_stack.h"
+
+#include "mqtt_stream_publish.h"
+
+/* Outgoing publish records of coreMQTT. */
+#include "core_mqtt_state.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Get a part of a payload in memory.
+ *
+ * @param[in] pContext The payload.
+ * @param[in] offset Offset of the part.
+ * @param[in] maxLength Length of the part.
+ * @param[out] ppData Where the part is.
+ *
+ * @return @p maxLength.
+ */
+static int32_t memoryRead( void * pContext,
+                           size_t offset,
+                           size_t maxLength,
+                           const uint8_t ** ppData );
+
+/**
+ * @brief Read a part of a payload from a file.
+ *
+ * @param[in] pContext The #MQTTStreamFileSource_t.
+ * @param[in] offset Offset of the part.
+ * @param[in] maxLength Largest length of the part.
+ * @param[out] ppData The buffer of the source.
+ *
+ * @return Bytes read, or -1 on a read error or the end of the file.
+ */
+static int32_t fileRead( void * pContext,
+                         size_t offset,
+                         size_t maxLength,
+                         const uint8_t ** ppData );
+
+/**
+ * @brief Send bytes until the transport has taken all of them.
+ *
+ * @param[in] pMqttContext The MQTT context.
+ * @param[in] pData The bytes.
+ * @param[in] length Number of bytes.
+ *
+ * @return #MQTTSuccess, or #MQTTSendFailed on a transport error, or if the
+ * transport accepted nothing for #MQTT_STREAM_SEND_TIMEOUT_MS.
+ */
+static MQTTStatus_t sendAll( MQTTContext_t * pMqttContext,
+                             const uint8_t * pData,
+                             size_t length );
+
+/*-----------------------------------------------------------*/
+
+static int32_t memoryRead( void * pContext,
+                           size_t offset,
+                           size_t maxLength,
+                           const uint8_t ** ppData )
+{
+    *ppData = &( ( ( const uint8_t * ) pContext )[ offset ] );
+
+    return ( int32_t ) maxLength;
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t fileRead( void * pContext,
+                         size_t offset,
+                         size_t maxLength,
+                         const uint8_t ** ppData )
+{
+    MQTTStreamFileSource_t * pFileSource = ( MQTTStreamFileSource_t * ) pContext;
+    int32_t result = -1;
+    size_t bytesRead;
+
+    /* The offset is absolute, so a publish can be started again from the
+     * beginning. */
+    if( fseek( pFileSource->pFile, pFileSource->startOffset + ( long ) offset, SEEK_SET ) == 0 )
+    {
+        bytesRead = fread( pFileSource->buffer, 1U, maxLength, pFileSource->pFile );
+
+        if( bytesRead > 0U )
+        {
+            *ppData = pFileSource->buffer;
+            result = ( int32_t ) bytesRead;
+        }
+    }
+
+    return result;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t sendAll( MQTTContext_t * pMqttContext,
+                             const uint8_t * pData,
+                             size_t length )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t sent = 0U;
+    int32_t bytesSent;
+    uint32_t lastProgressMs = pMqttContext->getTime();
+
+    while( ( status == MQTTSuccess ) && ( sent < length ) )
+    {
+        bytesSent = pMqttContext->transportInterface.send( pMqttContext->transportInterface.pNetworkContext,
+                                                           &( pData[ sent ] ),
+                                                           length - sent );
+
+        if( bytesSent < 0 )
+        {
+            LogError( ( "Transport send failed with %d.", ( int ) bytesSent ) );
+            status = MQTTSendFailed;
+        }
+        else if( bytesSent > 0 )
+        {
+            sent += ( size_t ) bytesSent;
+            lastProgressMs = pMqttContext->getTime();
+        }
+        else if( ( pMqttContext->getTime() - lastProgressMs ) >= MQTT_STREAM_SEND_TIMEOUT_MS )
+        {
+            LogError( ( "Transport took no data for %u ms.", ( unsigned int ) MQTT_STREAM_SEND_TIMEOUT_MS ) );
+            status = MQTTSendFailed;
+        }
+        else
+        {
+            /* The transport has no room for now. Yield instead of spinning,
+             * so that the task that drains it can run. */
+            vTaskDelay( 1U );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+void MQTTStream_MemorySource( const void * pPayload,
+                              MQTTStreamSource_t * pSource )
+{
+    configASSERT( pSource != NULL );
+
+    pSource->read = memoryRead;
+    pSource->pContext = ( void * ) pPayload;
+}
+
+/*-----------------------------------------------------------*/
+
+void MQTTStream_FileSource( MQTTStreamFileSource_t * pFileSource,
+                            FILE * pFile,
+                            MQTTStreamSource_t * pSource )
+{
+    configASSERT( pFileSource != NULL );
+    configASSERT( pFile != NULL );
+    configASSERT( pSource != NULL );
+
+    pFileSource->pFile = pFile;
+    pFileSource->startOffset = ftell( pFile );
+    pSource->read = fileRead;
+    pSource->pContext = pFileSource;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTStream_Publish( MQTTContext_t * pMqttContext,
+                                 const MQTTPublishInfo_t * pPublishInfo,
+                                 uint16_t packetId,
+                                 const MQTTStreamSource_t * pSource )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTPublishInfo_t publishInfo;
+    MQTTPublishState_t publishState = MQTTStateNull;
+    size_t remainingLength = 0U;
+    size_t packetSize = 0U;
+    size_t headerSize = 0U;
+    size_t offset = 0U;
+    size_t chunkLength;
+    int32_t partLength;
+    const uint8_t * pPart = NULL;
+    uint32_t startTimeMs = 0U;
+
+    if( ( pMqttContext == NULL ) || ( pPublishInfo == NULL ) || ( pSource == NULL ) ||
+        ( pSource->read == NULL ) || ( ( pPublishInfo->qos != MQTTQoS0 ) && ( packetId == 0U ) ) )
+    {
+        LogError( ( "Invalid parameter: pMqttContext=%p, pPublishInfo=%p, pSource=%p, packetId=%u.",
+                    ( void * ) pMqttContext,
+                    ( const void * ) pPublishInfo,
+                    ( const void * ) pSource,
+                    ( unsigned int ) packetId ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        publishInfo = *pPublishInfo;
+        publishInfo.pPayload = NULL;
+        status = MQTT_GetPublishPacketSize( &publishInfo, &remainingLength, &packetSize );
+    }
+
+    /* Only the header goes through the network buffer. */
+    if( status == MQTTSuccess )
+    {
+        status = MQTT_SerializePublishHeader( &publishInfo, packetId, remainingLength,
+                                              &( pMqttContext->networkBuffer ), &headerSize );
+    }
+
+    if( ( status == MQTTSuccess ) && ( publishInfo.qos != MQTTQoS0 ) )
+    {
+        status = MQTT_ReserveState( pMqttContext, packetId, publishInfo.qos );
+
+        /* A retransmission reuses the record of the first send, as with
+         * MQTT_Publish(). */
+        if( ( status == MQTTStateCollision ) && ( publishInfo.dup == true ) )
+        {
+            status = MQTTSuccess;
+        }
+    }
+
+    if( status == MQTTSuccess )
+    {
+        startTimeMs = pMqttContext->getTime();
+        status = sendAll( pMqttContext, pMqttContext->networkBuffer.pBuffer, headerSize );
+    }
+
+    while( ( status == MQTTSuccess ) && ( offset < publishInfo.payloadLength ) )
+    {
+        chunkLength = publishInfo.payloadLength - offset;
+
+        if( chunkLength > MQTT_STREAM_CHUNK_SIZE )
+        {
+            chunkLength = MQTT_STREAM_CHUNK_SIZE;
+        }
+
+        partLength = pSource->read( pSource->pContext, offset, chunkLength, &pPart );
+
+        if( ( partLength <= 0 ) || ( ( size_t ) partLength > chunkLength ) )
+        {
+            /* The header announced the full length, so the connection cannot
+             * carry on with a shorter packet. */
+            LogError( ( "Payload source failed at offset %u of %u.",
+                        ( unsigned int ) offset,
+                        ( unsigned int ) publishInfo.payloadLength ) );
+            status = MQTTSendFailed;
+        }
+        else
+        {
+            status = sendAll( pMqttContext, pPart, ( size_t ) partLength );
+            offset += ( size_t ) partLength;
+        }
+    }
+
+    if( status == MQTTSuccess )
+    {
+        /* The transport was busy, which counts as activity for keep-alive. */
+        pMqttContext->lastPacketTime = pMqttContext->getTime();
+
+        LogInfo( ( "Streamed a PUBLISH of %u bytes in %u ms.",
+                   ( unsigned int ) packetSize,
+                   ( unsigned int ) ( pMqttContext->lastPacketTime - startTimeMs ) ) );
+
+        if( publishInfo.qos != MQTTQoS0 )
+        {
+            status = MQTT_UpdateStatePublish( pMqttContext, packetId, MQTT_SEND,
+                                              publishInfo.qos, &publishState );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
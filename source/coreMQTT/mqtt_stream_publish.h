@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file mqtt_stream_publish.h
+ * @brief Publish of payloads larger than the network buffer.
+ *
+ * MQTTStream_Publish() serializes only the fixed header, topic and packet ID
+ * of the PUBLISH into the network buffer of the MQTT context. It then sends
+ * the payload from a source, chunk by chunk, straight to the transport. A
+ * memory source hands out pointers into the caller's memory, so nothing is
+ * copied. A file source reads one chunk at a time into its own buffer, so a
+ * log of several hundred kilobytes needs one chunk of RAM.
+ *
+ * QoS1 messages are recorded in the state of coreMQTT, as by MQTT_Publish(),
+ * so the PUBACK is handled by MQTT_ProcessLoop(). The publish window cannot
+ * send them again: after a reconnect with the session resumed, the
+ * application publishes again with the DUP flag and the same packet ID.
+ *
+ * The broker must accept the message size: AWS IoT Core, for example, caps
+ * messages at 128 KB. The payload must not be echoed back to the client,
+ * since incoming packets are still limited by the network buffer.
+ */
+
+#ifndef MQTT_STREAM_PUBLISH_H
+#define MQTT_STREAM_PUBLISH_H
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stdio.h>
+
+/* MQTT library includes. */
+#include "core_mqtt.h"
+
+/**
+ * @brief Largest chunk of payload per send. Matching the TLS maximum
+ * fragment length keeps one record per chunk. It is also the size of the
+ * buffer of a file source.
+ */
+#ifndef MQTT_STREAM_CHUNK_SIZE
+    #define MQTT_STREAM_CHUNK_SIZE    ( 1024U )
+#endif
+
+/**
+ * @brief Longest time the transport may go without accepting a byte before
+ * the publish fails.
+ */
+#ifndef MQTT_STREAM_SEND_TIMEOUT_MS
+    #define MQTT_STREAM_SEND_TIMEOUT_MS    ( 20000U )
+#endif
+
+/**
+ * @brief Get the next part of the payload.
+ *
+ * @param[in] pContext Context of the source.
+ * @param[in] offset Offset of the part in the payload.
+ * @param[in] maxLength Largest length of the part, at most
+ * #MQTT_STREAM_CHUNK_SIZE.
+ * @param[out] ppData Where the part is, valid until the next call.
+ *
+ * @return Length of the part, from 1 to @p maxLength, or a negative value
+ * on error.
+ */
+typedef int32_t ( * MQTTStreamRead_t )( void * pContext,
+                                        size_t offset,
+                                        size_t maxLength,
+                                        const uint8_t ** ppData );
+
+/**
+ * @brief Source of a streamed payload.
+ */
+typedef struct MQTTStreamSource
+{
+    MQTTStreamRead_t read; /**< @brief Get the next part of the payload. */
+    void * pContext;       /**< @brief Passed to read. */
+} MQTTStreamSource_t;
+
+/**
+ * @brief Context of a file source.
+ */
+typedef struct MQTTStreamFileSource
+{
+    FILE * pFile;                             /**< @brief The open file. */
+    long startOffset;                         /**< @brief Offset of the payload in the file. */
+    uint8_t buffer[ MQTT_STREAM_CHUNK_SIZE ]; /**< @brief Chunk read from the file. */
+} MQTTStreamFileSource_t;
+
+/**
+ * @brief Set up a source on a payload in memory, which is sent without a
+ * copy.
+ *
+ * @param[in] pPayload The payload, valid until the publish returns.
+ * @param[out] pSource The source.
+ */
+void MQTTStream_MemorySource( const void * pPayload,
+                              MQTTStreamSource_t * pSource );
+
+/**
+ * @brief Set up a source on a file, read from its current position.
+ *
+ * @param[out] pFileSource Context of the source, valid until the publish
+ * returns.
+ * @param[in] pFile File opened for reading in binary mode.
+ * @param[out] pSource The source.
+ */
+void MQTTStream_FileSource( MQTTStreamFileSource_t * pFileSource,
+                            FILE * pFile,
+                            MQTTStreamSource_t * pSource );
+
+/**
+ * @brief Publish a message whose payload comes from a source.
+ *
+ * @param[in] pMqttContext Connected MQTT context.
+ * @param[in] pPublishInfo The message. Its payloadLength is the length of
+ * the payload, and its pPayload is not used.
+ * @param[in] packetId Packet ID from MQTT_GetPacketId(), or 0 for QoS0.
+ * @param[in] pSource Source of the payload.
+ *
+ * @return #MQTTSuccess, #MQTTBadParameter, #MQTTNoMemory if the header does
+ * not fit in the network buffer, #MQTTSendFailed, or the error of the state
+ * of coreMQTT.
+ */
+MQTTStatus_t MQTTStream_Publish( MQTTContext_t * pMqttContext,
+                                 const MQTTPublishInfo_t * pPublishInfo,
+                                 uint16_t packetId,
+                                 const MQTTStreamSource_t * pSource );
+
+#endif /* ifndef MQTT_STREAM_PUBLISH_H */
@@ -0,0 +1,413 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file mqtt_telemetry.c
+ * @brief Aggregation of telemetry samples into compact QoS1 publishes.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Configure logs for the functions in this file, before core_mqtt_config.h
+ * sets those of coreMQTT. */
+#include "logging_levels.h"
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "Telemetry"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_INFO
+#endif
+#include "logging_stack.h"
+
+#include "mqtt_telemetry.h"
+
+/**
+ * @brief Largest encoded sample: the sensor ID and two 5-byte varints.
+ */
+#define SAMPLE_MAX_SIZE    ( 11U )
+
+#if MQTT_TELEMETRY_PAYLOAD_SIZE < ( MQTT_TELEMETRY_HEADER_SIZE + SAMPLE_MAX_SIZE )
+    #error "MQTT_TELEMETRY_PAYLOAD_SIZE is too small for one sample."
+#endif
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Write a signed number as a zigzag varint.
+ *
+ * @param[out] pBuffer Where to write, with room for 5 bytes.
+ * @param[in] value The number.
+ *
+ * @return Number of bytes written.
+ */
+static size_t encodeZigzag( uint8_t * pBuffer,
+                            int32_t value );
+
+/**
+ * @brief Estimate the bytes on air of a QoS1 message: the PUBLISH and its
+ * PUBACK, each in its own TLS record.
+ *
+ * @param[in] pTelemetry The aggregator, for the topic.
+ * @param[in] payloadLength Length of the payload.
+ *
+ * @return The estimate, or 0 if coreMQTT cannot serialize the message.
+ */
+static uint32_t estimateAirBytes( const MQTTTelemetry_t * pTelemetry,
+                                  size_t payloadLength );
+
+/**
+ * @brief Process the publish window until the current payload buffer is no
+ * longer in flight.
+ *
+ * @param[in] pTelemetry The aggregator.
+ *
+ * @return #MQTTSuccess, or the first error of the publish window.
+ */
+static MQTTStatus_t waitForPayload( MQTTTelemetry_t * pTelemetry );
+
+/**
+ * @brief Encode a sample at the end of the current payload.
+ *
+ * @param[in] pTelemetry The aggregator.
+ * @param[in] pSample The sample.
+ */
+static void appendSample( MQTTTelemetry_t * pTelemetry,
+                          const MQTTTelemetrySample_t * pSample );
+
+/*-----------------------------------------------------------*/
+
+static size_t encodeZigzag( uint8_t * pBuffer,
+                            int32_t value )
+{
+    /* Small numbers of either sign get small codes. */
+    uint32_t zigzag = ( ( uint32_t ) value << 1 ) ^ ( uint32_t ) ( ( value < 0 ) ? UINT32_MAX : 0U );
+    size_t length = 0U;
+
+    while( zigzag >= 0x80U )
+    {
+        pBuffer[ length ] = ( uint8_t ) ( ( zigzag & 0x7FU ) | 0x80U );
+        zigzag >>= 7;
+        length++;
+    }
+
+    pBuffer[ length ] = ( uint8_t ) zigzag;
+    length++;
+
+    return length;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t estimateAirBytes( const MQTTTelemetry_t * pTelemetry,
+                                  size_t payloadLength )
+{
+    MQTTPublishInfo_t publishInfo;
+    size_t remainingLength = 0U;
+    size_t packetSize = 0U;
+    uint32_t airBytes = 0U;
+
+    ( void ) memset( &publishInfo, 0, sizeof( publishInfo ) );
+    publishInfo.qos = MQTTQoS1;
+    publishInfo.pTopicName = pTelemetry->pTopic;
+    publishInfo.topicNameLength = pTelemetry->topicLength;
+    publishInfo.payloadLength = payloadLength;
+
+    if( MQTT_GetPublishPacketSize( &publishInfo, &remainingLength, &packetSize ) == MQTTSuccess )
+    {
+        airBytes = ( uint32_t ) ( packetSize + MQTT_PUBLISH_ACK_PACKET_SIZE +
+                                  ( 2U * MQTT_TELEMETRY_TLS_RECORD_OVERHEAD ) );
+    }
+
+    return airBytes;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t waitForPayload( MQTTTelemetry_t * pTelemetry )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTTelemetryPayload_t * pPayload = &( pTelemetry->payloads[ pTelemetry->current ] );
+
+    while( ( status == MQTTSuccess ) &&
+           ( MQTTPublishWindow_IsInFlight( pTelemetry->pWindow, pPayload->packetId ) == true ) )
+    {
+        status = MQTTPublishWindow_Process( pTelemetry->pWindow, MQTT_PUBLISH_WINDOW_POLL_MS );
+    }
+
+    if( status == MQTTSuccess )
+    {
+        /* Forget the packet ID, which coreMQTT will give to other messages. */
+        pPayload->packetId = 0U;
+        pPayload->length = MQTT_TELEMETRY_HEADER_SIZE;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static void appendSample( MQTTTelemetry_t * pTelemetry,
+                          const MQTTTelemetrySample_t * pSample )
+{
+    MQTTTelemetryPayload_t * pPayload = &( pTelemetry->payloads[ pTelemetry->current ] );
+    uint8_t alone[ SAMPLE_MAX_SIZE ];
+    size_t aloneLength;
+
+    if( pTelemetry->count == 0U )
+    {
+        pTelemetry->baseTimestampMs = pSample->timestampMs;
+        pTelemetry->lastTimestampMs = pSample->timestampMs;
+    }
+
+    pPayload->data[ pPayload->length ] = pSample->sensorId;
+    pPayload->length++;
+
+    /* Producers timestamp their samples before queuing them, so the order
+     * of the queue may step back in time: the delta is signed. */
+    pPayload->length += encodeZigzag( &( pPayload->data[ pPayload->length ] ),
+                                      ( int32_t ) ( pSample->timestampMs - pTelemetry->lastTimestampMs ) );
+    pPayload->length += encodeZigzag( &( pPayload->data[ pPayload->length ] ), pSample->value );
+    pTelemetry->lastTimestampMs = pSample->timestampMs;
+    pTelemetry->count++;
+    pTelemetry->stats.samples++;
+
+    /* The same sample alone in a payload, with a delta of 0. */
+    alone[ 0 ] = pSample->sensorId;
+    alone[ 1 ] = 0U;
+    aloneLength = 2U + encodeZigzag( &( alone[ 2 ] ), pSample->value );
+    pTelemetry->pendingUnaggregatedAirBytes += estimateAirBytes( pTelemetry,
+                                                                 MQTT_TELEMETRY_HEADER_SIZE + aloneLength );
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTTelemetry_Init( MQTTTelemetry_t * pTelemetry,
+                                 MQTTPublishWindow_t * pWindow,
+                                 const char * pTopic,
+                                 uint16_t topicLength,
+                                 uint32_t flushIntervalMs )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t i;
+
+    if( ( pTelemetry == NULL ) || ( pWindow == NULL ) ||
+        ( pTopic == NULL ) || ( topicLength == 0U ) )
+    {
+        LogError( ( "Invalid parameter: pTelemetry=%p, pWindow=%p, pTopic=%p, topicLength=%u.",
+                    ( void * ) pTelemetry,
+                    ( void * ) pWindow,
+                    ( const void * ) pTopic,
+                    ( unsigned int ) topicLength ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        ( void ) memset( pTelemetry, 0, sizeof( MQTTTelemetry_t ) );
+        pTelemetry->pWindow = pWindow;
+        pTelemetry->pTopic = pTopic;
+        pTelemetry->topicLength = topicLength;
+        pTelemetry->flushIntervalMs = flushIntervalMs;
+
+        for( i = 0U; i < MQTT_TELEMETRY_PAYLOAD_COUNT; i++ )
+        {
+            pTelemetry->payloads[ i ].length = MQTT_TELEMETRY_HEADER_SIZE;
+        }
+
+        pTelemetry->queue = xQueueCreateStatic( MQTT_TELEMETRY_QUEUE_LENGTH,
+                                                sizeof( MQTTTelemetrySample_t ),
+                                                pTelemetry->queueStorage,
+                                                &( pTelemetry->queueStruct ) );
+        configASSERT( pTelemetry->queue != NULL );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+bool MQTTTelemetry_AddSample( MQTTTelemetry_t * pTelemetry,
+                              uint8_t sensorId,
+                              int32_t value )
+{
+    MQTTTelemetrySample_t sample;
+    bool queued = true;
+
+    configASSERT( pTelemetry != NULL );
+
+    sample.timestampMs = ( uint32_t ) ( xTaskGetTickCount() * portTICK_PERIOD_MS );
+    sample.value = value;
+    sample.sensorId = sensorId;
+
+    if( xQueueSend( pTelemetry->queue, &sample, 0U ) != pdTRUE )
+    {
+        /* Producers run in other tasks than the one that reads the counters. */
+        taskENTER_CRITICAL();
+        pTelemetry->stats.dropped++;
+        taskEXIT_CRITICAL();
+        queued = false;
+    }
+
+    return queued;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTTelemetry_Process( MQTTTelemetry_t * pTelemetry )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTTelemetrySample_t sample;
+    uint32_t nowMs;
+
+    configASSERT( pTelemetry != NULL );
+
+    while( ( status == MQTTSuccess ) && ( uxQueueMessagesWaiting( pTelemetry->queue ) > 0U ) )
+    {
+        if( pTelemetry->count == 0U )
+        {
+            status = waitForPayload( pTelemetry );
+        }
+
+        if( ( status == MQTTSuccess ) && ( xQueueReceive( pTelemetry->queue, &sample, 0U ) == pdTRUE ) )
+        {
+            appendSample( pTelemetry, &sample );
+
+            if( ( ( pTelemetry->payloads[ pTelemetry->current ].length + SAMPLE_MAX_SIZE ) > MQTT_TELEMETRY_PAYLOAD_SIZE ) ||
+                ( pTelemetry->count == UINT16_MAX ) )
+            {
+                status = MQTTTelemetry_Flush( pTelemetry );
+            }
+        }
+    }
+
+    nowMs = ( uint32_t ) ( xTaskGetTickCount() * portTICK_PERIOD_MS );
+
+    if( ( status == MQTTSuccess ) && ( pTelemetry->count > 0U ) &&
+        ( ( nowMs - pTelemetry->baseTimestampMs ) >= pTelemetry->flushIntervalMs ) )
+    {
+        status = MQTTTelemetry_Flush( pTelemetry );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTTelemetry_Flush( MQTTTelemetry_t * pTelemetry )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTTelemetryPayload_t * pPayload;
+    MQTTPublishInfo_t publishInfo;
+    uint16_t packetId = 0U;
+
+    configASSERT( pTelemetry != NULL );
+
+    pPayload = &( pTelemetry->payloads[ pTelemetry->current ] );
+
+    if( pTelemetry->count > 0U )
+    {
+        pPayload->data[ 0 ] = MQTT_TELEMETRY_FORMAT_VERSION;
+        pPayload->data[ 1 ] = ( uint8_t ) pTelemetry->count;
+        pPayload->data[ 2 ] = ( uint8_t ) ( pTelemetry->count >> 8 );
+        pPayload->data[ 3 ] = ( uint8_t ) pTelemetry->baseTimestampMs;
+        pPayload->data[ 4 ] = ( uint8_t ) ( pTelemetry->baseTimestampMs >> 8 );
+        pPayload->data[ 5 ] = ( uint8_t ) ( pTelemetry->baseTimestampMs >> 16 );
+        pPayload->data[ 6 ] = ( uint8_t ) ( pTelemetry->baseTimestampMs >> 24 );
+
+        ( void ) memset( &publishInfo, 0, sizeof( publishInfo ) );
+        publishInfo.qos = MQTTQoS1;
+        publishInfo.pTopicName = pTelemetry->pTopic;
+        publishInfo.topicNameLength = pTelemetry->topicLength;
+        publishInfo.pPayload = pPayload->data;
+        publishInfo.payloadLength = pPayload->length;
+
+        status = MQTTPublishWindow_Publish( pTelemetry->pWindow, &publishInfo, &packetId );
+
+        /* With a packet ID, the window holds the payload, even if the send
+         * failed. */
+        if( packetId != 0U )
+        {
+            LogDebug( ( "Published %u samples in %u bytes with packet ID %u.",
+                        ( unsigned int ) pTelemetry->count,
+                        ( unsigned int ) pPayload->length,
+                        ( unsigned int ) packetId ) );
+
+            pPayload->packetId = packetId;
+            pTelemetry->stats.published += pTelemetry->count;
+            pTelemetry->stats.messages++;
+            pTelemetry->stats.payloadBytes += ( uint32_t ) pPayload->length;
+            pTelemetry->stats.airBytes += estimateAirBytes( pTelemetry, pPayload->length );
+            pTelemetry->stats.unaggregatedAirBytes += pTelemetry->pendingUnaggregatedAirBytes;
+
+            pTelemetry->pendingUnaggregatedAirBytes = 0U;
+            pTelemetry->count = 0U;
+            pTelemetry->current = ( pTelemetry->current + 1U ) % MQTT_TELEMETRY_PAYLOAD_COUNT;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+void MQTTTelemetry_GetStats( MQTTTelemetry_t * pTelemetry,
+                             MQTTTelemetryStats_t * pStats )
+{
+    configASSERT( pTelemetry != NULL );
+    configASSERT( pStats != NULL );
+
+    taskENTER_CRITICAL();
+    *pStats = pTelemetry->stats;
+    taskEXIT_CRITICAL();
+}
+
+/*-----------------------------------------------------------*/
+
+void MQTTTelemetry_LogStats( MQTTTelemetry_t * pTelemetry )
+{
+    MQTTTelemetryStats_t stats;
+
+    MQTTTelemetry_GetStats( pTelemetry, &stats );
+
+    if( stats.published > 0U )
+    {
+        LogInfo( ( "%u samples in %u messages: %u bytes on air per sample, "
+                   "%u with one sample per message. %u samples dropped.",
+                   ( unsigned int ) stats.published,
+                   ( unsigned int ) stats.messages,
+                   ( unsigned int ) ( stats.airBytes / stats.published ),
+                   ( unsigned int ) ( stats.unaggregatedAirBytes / stats.published ),
+                   ( unsigned int ) stats.dropped ) );
+    }
+    else
+    {
+        LogInfo( ( "No sample published yet. %u samples dropped.",
+                   ( unsigned int ) stats.dropped ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file mqtt_telemetry.h
+ * @brief Aggregation of telemetry samples into compact QoS1 publishes.
+ *
+ * On a cellular link, the MQTT and TLS framing of a message, and the PUBACK
+ * that answers it, cost more than a small payload. Instead of one message per
+ * sample, producer tasks add samples to a queue, and the task that owns the
+ * MQTT connection encodes them into one binary payload. The payload is
+ * published through the publish window once it is full, or once its oldest
+ * sample has waited for the flush interval.
+ *
+ * The payload has a fixed schema, little endian:
+ * - 1 byte: #MQTT_TELEMETRY_FORMAT_VERSION.
+ * - 2 bytes: number of samples.
+ * - 4 bytes: timestamp of the first sample, in milliseconds.
+ * - For each sample: 1 byte of sensor ID, then the time since the previous
+ *   sample and the value, both as zigzag varints (7 bits per byte, low bits
+ *   first, high bit set on all bytes but the last).
+ *
+ * The statistics compare the estimated bytes on air per sample, PUBLISH,
+ * PUBACK and TLS records included, with those of one message per sample.
+ */
+
+#ifndef MQTT_TELEMETRY_H
+#define MQTT_TELEMETRY_H
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "queue.h"
+
+/* MQTT library includes. */
+#include "core_mqtt.h"
+
+/* Publish window that sends the payloads. */
+#include "mqtt_publish_window.h"
+
+/**
+ * @brief Largest payload. A payload is published once the next sample may
+ * not fit.
+ */
+#ifndef MQTT_TELEMETRY_PAYLOAD_SIZE
+    #define MQTT_TELEMETRY_PAYLOAD_SIZE    ( 256U )
+#endif
+
+/**
+ * @brief Number of payload buffers. A buffer is reused once its message is
+ * acknowledged, so more buffers keep more payloads in flight.
+ */
+#ifndef MQTT_TELEMETRY_PAYLOAD_COUNT
+    #define MQTT_TELEMETRY_PAYLOAD_COUNT    ( 2U )
+#endif
+
+/**
+ * @brief Number of samples the producers can add before the MQTT task
+ * encodes them. Further samples are dropped.
+ */
+#ifndef MQTT_TELEMETRY_QUEUE_LENGTH
+    #define MQTT_TELEMETRY_QUEUE_LENGTH    ( 32U )
+#endif
+
+/**
+ * @brief Bytes added by TLS to each record, used by the estimate of the bytes
+ * on air: a 5-byte header, and the 8-byte explicit nonce and 16-byte tag of
+ * AES-GCM.
+ */
+#ifndef MQTT_TELEMETRY_TLS_RECORD_OVERHEAD
+    #define MQTT_TELEMETRY_TLS_RECORD_OVERHEAD    ( 29U )
+#endif
+
+/**
+ * @brief Version byte at the start of each payload.
+ */
+#define MQTT_TELEMETRY_FORMAT_VERSION    ( 1U )
+
+/**
+ * @brief Size of the header of a payload.
+ */
+#define MQTT_TELEMETRY_HEADER_SIZE       ( 7U )
+
+/**
+ * @brief A sample, as queued by MQTTTelemetry_AddSample().
+ */
+typedef struct MQTTTelemetrySample
+{
+    uint32_t timestampMs; /**< @brief Time of the sample, from the tick count. */
+    int32_t value;        /**< @brief Value of the sample. */
+    uint8_t sensorId;     /**< @brief Sensor of the sample. */
+} MQTTTelemetrySample_t;
+
+/**
+ * @brief A payload being encoded or in flight.
+ */
+typedef struct MQTTTelemetryPayload
+{
+    uint8_t data[ MQTT_TELEMETRY_PAYLOAD_SIZE ]; /**< @brief The encoded payload. */
+    size_t length;                               /**< @brief Bytes used in data. */
+    uint16_t packetId;                           /**< @brief Packet ID of the message, or 0 if the buffer is not in flight. */
+} MQTTTelemetryPayload_t;
+
+/**
+ * @brief Counters since MQTTTelemetry_Init().
+ */
+typedef struct MQTTTelemetryStats
+{
+    uint32_t samples;              /**< @brief Samples encoded. */
+    uint32_t dropped;              /**< @brief Samples dropped because the queue was full. */
+    uint32_t published;            /**< @brief Samples in published messages. */
+    uint32_t messages;             /**< @brief Messages published. */
+    uint32_t payloadBytes;         /**< @brief Payload bytes published. */
+    uint32_t airBytes;             /**< @brief Estimated bytes on air of the published messages. */
+    uint32_t unaggregatedAirBytes; /**< @brief Estimated bytes on air of the same samples, one per message. */
+} MQTTTelemetryStats_t;
+
+/**
+ * @brief Telemetry aggregator. Its fields are private.
+ */
+typedef struct MQTTTelemetry
+{
+    MQTTPublishWindow_t * pWindow;                                                         /**< @brief Window that publishes the payloads. */
+    const char * pTopic;                                                                   /**< @brief Topic of the payloads. */
+    uint16_t topicLength;                                                                  /**< @brief Length of the topic. */
+    uint32_t flushIntervalMs;                                                              /**< @brief Longest wait of a sample before it is published. */
+    QueueHandle_t queue;                                                                   /**< @brief Samples from the producers. */
+    StaticQueue_t queueStruct;                                                             /**< @brief Storage of the queue. */
+    uint8_t queueStorage[ MQTT_TELEMETRY_QUEUE_LENGTH * sizeof( MQTTTelemetrySample_t ) ]; /**< @brief Storage of the queued samples. */
+    MQTTTelemetryPayload_t payloads[ MQTT_TELEMETRY_PAYLOAD_COUNT ];                       /**< @brief Payload buffers. */
+    size_t current;                                                                        /**< @brief Index of the payload being encoded. */
+    uint16_t count;                                                                        /**< @brief Samples in the current payload. */
+    uint32_t baseTimestampMs;                                                              /**< @brief Timestamp of the first sample of the current payload. */
+    uint32_t lastTimestampMs;                                                              /**< @brief Timestamp of the last sample of the current payload. */
+    uint32_t pendingUnaggregatedAirBytes;                                                  /**< @brief Bytes on air of the current samples, one per message. */
+    MQTTTelemetryStats_t stats;                                                            /**< @brief Counters. */
+} MQTTTelemetry_t;
+
+/**
+ * @brief Set up an aggregator that publishes through a window.
+ *
+ * @param[out] pTelemetry The aggregator.
+ * @param[in] pWindow Publish window of the connection. It may be initialized
+ * again, after a reconnect, while the aggregator is in use.
+ * @param[in] pTopic Topic of the payloads, valid as long as the aggregator.
+ * @param[in] topicLength Length of the topic.
+ * @param[in] flushIntervalMs Longest time a sample waits for a payload to
+ * fill before it is published.
+ *
+ * @return #MQTTSuccess, or #MQTTBadParameter.
+ */
+MQTTStatus_t MQTTTelemetry_Init( MQTTTelemetry_t * pTelemetry,
+                                 MQTTPublishWindow_t * pWindow,
+                                 const char * pTopic,
+                                 uint16_t topicLength,
+                                 uint32_t flushIntervalMs );
+
+/**
+ * @brief Add a sample, timestamped now. Can be called from any task.
+ *
+ * @param[in] pTelemetry The aggregator.
+ * @param[in] sensorId Sensor of the sample.
+ * @param[in] value Value of the sample.
+ *
+ * @return true if the sample was queued, or false if the queue was full.
+ */
+bool MQTTTelemetry_AddSample( MQTTTelemetry_t * pTelemetry,
+                              uint8_t sensorId,
+                              int32_t value );
+
+/**
+ * @brief Encode the queued samples, and publish the payloads that are full or
+ * due. Call it from the task that owns the MQTT connection, as often as the
+ * publish window is processed.
+ *
+ * A sample is only taken from the queue once a payload buffer is free, so a
+ * failed connection loses no sample. A payload whose send failed stays in the
+ * window, for MQTTPublishWindow_ResendAll() after the reconnect.
+ *
+ * @param[in] pTelemetry The aggregator.
+ *
+ * @return #MQTTSuccess, or the first error of the publish window.
+ */
+MQTTStatus_t MQTTTelemetry_Process( MQTTTelemetry_t * pTelemetry );
+
+/**
+ * @brief Publish the current payload now, if it holds any sample.
+ *
+ * @param[in] pTelemetry The aggregator.
+ *
+ * @return #MQTTSuccess, or the first error of the publish window.
+ */
+MQTTStatus_t MQTTTelemetry_Flush( MQTTTelemetry_t * pTelemetry );
+
+/**
+ * @brief Copy the counters of the aggregator.
+ *
+ * @param[in] pTelemetry The aggregator.
+ * @param[out] pStats Where to write the counters.
+ */
+void MQTTTelemetry_GetStats( MQTTTelemetry_t * pTelemetry,
+                             MQTTTelemetryStats_t * pStats );
+
+/**
+ * @brief Log the bytes on air per sample, aggregated and one sample per
+ * message.
+ *
+ * @param[in] pTelemetry The aggregator.
+ */
+void MQTTTelemetry_LogStats( MQTTTelemetry_t * pTelemetry );
+
+#endif /* ifndef MQTT_TELEMETRY_H */
@@ -0,0 +1,540 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/**
+ * @file mqtt_topic_router.c
+ * @brief Dispatch of incoming publishes to per-filter callbacks.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+/* Configure logs for the functions in this file, before core_mqtt_config.h
+ * sets those of coreMQTT. */
+#include "logging_levels.h"
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "TopicRouter"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_INFO
+#endif
+#include "logging_stack.h"
+
+#include "mqtt_topic_router.h"
+
+#if ( ( MQTT_TOPIC_ROUTER_HASH_SIZE & ( MQTT_TOPIC_ROUTER_HASH_SIZE - 1U ) ) != 0U ) || \
+    ( MQTT_TOPIC_ROUTER_HASH_SIZE <= MQTT_TOPIC_ROUTER_MAX_NODES )
+    #error "MQTT_TOPIC_ROUTER_HASH_SIZE must be a power of two larger than MQTT_TOPIC_ROUTER_MAX_NODES."
+#endif
+
+#if MQTT_TOPIC_ROUTER_MAX_NODES > 65535U
+    #error "MQTT_TOPIC_ROUTER_MAX_NODES must fit the 16-bit node indexes."
+#endif
+
+/**
+ * @brief Index of the root node, which is also the "no node" value of the
+ * links since no node has the root as child.
+ */
+#define ROOT_NODE    ( 0U )
+
+/**
+ * @brief A node of the trie to visit, and the offset in the topic of the
+ * level after it.
+ */
+typedef struct DispatchFrame
+{
+    uint16_t node;   /**< @brief Index of the node. */
+    uint32_t offset; /**< @brief Offset of the next level, or the topic length plus one once all levels are matched. */
+} DispatchFrame_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Find the end of the level that starts at an offset.
+ *
+ * @param[in] pTopic Topic name or filter.
+ * @param[in] length Length of the topic.
+ * @param[in] offset Start of the level.
+ *
+ * @return Offset of the '/' after the level, or the length.
+ */
+static uint32_t levelEnd( const char * pTopic,
+                          uint32_t length,
+                          uint32_t offset );
+
+/**
+ * @brief Check that a filter is valid: not empty, '+' and '#' each alone in
+ * their level, '#' only as the last level, and not too many levels.
+ *
+ * @param[in] pFilter The topic filter.
+ * @param[in] filterLength Length of the filter.
+ *
+ * @return true if the filter is valid.
+ */
+static bool isValidFilter( const char * pFilter,
+                           uint16_t filterLength );
+
+/**
+ * @brief Hash a literal level and the index of its parent.
+ *
+ * @param[in] parent Index of the parent node.
+ * @param[in] pLevel The level.
+ * @param[in] levelLength Length of the level.
+ *
+ * @return The hash.
+ */
+static uint32_t hashLevel( uint16_t parent,
+                           const char * pLevel,
+                           uint32_t levelLength );
+
+/**
+ * @brief Find the literal child of a node.
+ *
+ * @param[in] pRouter The router.
+ * @param[in] parent Index of the parent node.
+ * @param[in] pLevel The level.
+ * @param[in] levelLength Length of the level.
+ *
+ * @return Index of the child, or 0.
+ */
+static uint16_t findChild( const MQTTTopicRouter_t * pRouter,
+                           uint16_t parent,
+                           const char * pLevel,
+                           uint32_t levelLength );
+
+/**
+ * @brief Find or add the child of a node for a level of a filter.
+ *
+ * @param[in] pRouter The router.
+ * @param[in] parent Index of the parent node.
+ * @param[in] pLevel The level.
+ * @param[in] levelLength Length of the level.
+ * @param[in] create Whether to add the child if it is missing.
+ *
+ * @return Index of the child, or 0 if it is missing, or if the nodes ran out.
+ */
+static uint16_t getChild( MQTTTopicRouter_t * pRouter,
+                          uint16_t parent,
+                          const char * pLevel,
+                          uint32_t levelLength,
+                          bool create );
+
+/**
+ * @brief Find the node where a filter ends.
+ *
+ * @param[in] pRouter The router.
+ * @param[in] pFilter The topic filter, already validated.
+ * @param[in] filterLength Length of the filter.
+ * @param[in] create Whether to add the missing nodes.
+ *
+ * @return Index of the node, or 0 if it is missing, or if the nodes ran out.
+ */
+static uint16_t findFilter( MQTTTopicRouter_t * pRouter,
+                            const char * pFilter,
+                            uint16_t filterLength,
+                            bool create );
+
+/**
+ * @brief Call the callback of a node, if it has one.
+ *
+ * @param[in] pNode The node.
+ * @param[in] pPublishInfo The incoming publish.
+ *
+ * @return 1 if the callback was called, else 0.
+ */
+static size_t invokeCallback( const MQTTTopicRouterNode_t * pNode,
+                              MQTTPublishInfo_t * pPublishInfo );
+
+/*-----------------------------------------------------------*/
+
+static uint32_t levelEnd( const char * pTopic,
+                          uint32_t length,
+                          uint32_t offset )
+{
+    uint32_t end = offset;
+
+    while( ( end < length ) && ( pTopic[ end ] != '/' ) )
+    {
+        end++;
+    }
+
+    return end;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool isValidFilter( const char * pFilter,
+                           uint16_t filterLength )
+{
+    bool valid = ( filterLength > 0U );
+    uint32_t offset = 0U;
+    uint32_t end;
+    uint32_t index;
+    uint32_t levels = 0U;
+
+    while( ( valid == true ) && ( offset <= filterLength ) )
+    {
+        end = levelEnd( pFilter, filterLength, offset );
+        levels++;
+
+        for( index = offset; index < end; index++ )
+        {
+            if( ( pFilter[ index ] == '+' ) || ( pFilter[ index ] == '#' ) )
+            {
+                /* A wildcard is a whole level, and '#' is the last one. */
+                if( ( ( end - offset ) != 1U ) ||
+                    ( ( pFilter[ index ] == '#' ) && ( end != filterLength ) ) )
+                {
+                    valid = false;
+                }
+            }
+        }
+
+        offset = end + 1U;
+    }
+
+    if( levels > MQTT_TOPIC_ROUTER_MAX_LEVELS )
+    {
+        valid = false;
+    }
+
+    return valid;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint32_t hashLevel( uint16_t parent,
+                           const char * pLevel,
+                           uint32_t levelLength )
+{
+    /* 32-bit FNV-1a of the level, then of the parent. */
+    uint32_t hash = 2166136261U;
+    uint32_t index;
+
+    for( index = 0U; index < levelLength; index++ )
+    {
+        hash ^= ( uint8_t ) pLevel[ index ];
+        hash *= 16777619U;
+    }
+
+    hash ^= ( uint32_t ) parent;
+    hash *= 16777619U;
+
+    return hash;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint16_t findChild( const MQTTTopicRouter_t * pRouter,
+                           uint16_t parent,
+                           const char * pLevel,
+                           uint32_t levelLength )
+{
+    uint32_t slot = hashLevel( parent, pLevel, levelLength ) & ( MQTT_TOPIC_ROUTER_HASH_SIZE - 1U );
+    uint16_t child = ROOT_NODE;
+    const MQTTTopicRouterNode_t * pNode;
+
+    /* Linear probing. The table is never full, so an empty slot ends it. */
+    while( ( child == ROOT_NODE ) && ( pRouter->table[ slot ] != ROOT_NODE ) )
+    {
+        pNode = &( pRouter->nodes[ pRouter->table[ slot ] ] );
+
+        if( ( pNode->parent == parent ) &&
+            ( pNode->levelLength == levelLength ) &&
+            ( memcmp( pNode->pLevel, pLevel, levelLength ) == 0 ) )
+        {
+            child = pRouter->table[ slot ];
+        }
+        else
+        {
+            slot = ( slot + 1U ) & ( MQTT_TOPIC_ROUTER_HASH_SIZE - 1U );
+        }
+    }
+
+    return child;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint16_t getChild( MQTTTopicRouter_t * pRouter,
+                          uint16_t parent,
+                          const char * pLevel,
+                          uint32_t levelLength,
+                          bool create )
+{
+    uint16_t * pLink = NULL;
+    uint16_t child;
+    uint32_t slot;
+    MQTTTopicRouterNode_t * pNode;
+
+    if( ( levelLength == 1U ) && ( pLevel[ 0 ] == '+' ) )
+    {
+        pLink = &( pRouter->nodes[ parent ].plusChild );
+        child = *pLink;
+    }
+    else if( ( levelLength == 1U ) && ( pLevel[ 0 ] == '#' ) )
+    {
+        pLink = &( pRouter->nodes[ parent ].hashChild );
+        child = *pLink;
+    }
+    else
+    {
+        child = findChild( pRouter, parent, pLevel, levelLength );
+    }
+
+    if( ( child == ROOT_NODE ) && ( create == true ) &&
+        ( pRouter->nodeCount < MQTT_TOPIC_ROUTER_MAX_NODES ) )
+    {
+        child = pRouter->nodeCount;
+        pRouter->nodeCount++;
+
+        pNode = &( pRouter->nodes[ child ] );
+        pNode->pLevel = pLevel;
+        pNode->levelLength = ( uint16_t ) levelLength;
+        pNode->parent = parent;
+
+        if( pLink != NULL )
+        {
+            *pLink = child;
+        }
+        else
+        {
+            slot = hashLevel( parent, pLevel, levelLength ) & ( MQTT_TOPIC_ROUTER_HASH_SIZE - 1U );
+
+            while( pRouter->table[ slot ] != ROOT_NODE )
+            {
+                slot = ( slot + 1U ) & ( MQTT_TOPIC_ROUTER_HASH_SIZE - 1U );
+            }
+
+            pRouter->table[ slot ] = child;
+        }
+    }
+
+    return child;
+}
+
+/*-----------------------------------------------------------*/
+
+static uint16_t findFilter( MQTTTopicRouter_t * pRouter,
+                            const char * pFilter,
+                            uint16_t filterLength,
+                            bool create )
+{
+    uint16_t node = ROOT_NODE;
+    uint32_t offset = 0U;
+    uint32_t end;
+    bool found = true;
+
+    while( ( found == true ) && ( offset <= filterLength ) )
+    {
+        end = levelEnd( pFilter, filterLength, offset );
+        node = getChild( pRouter, node, &( pFilter[ offset ] ), end - offset, create );
+        found = ( node != ROOT_NODE );
+        offset = end + 1U;
+    }
+
+    return node;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t invokeCallback( const MQTTTopicRouterNode_t * pNode,
+                              MQTTPublishInfo_t * pPublishInfo )
+{
+    size_t called = 0U;
+
+    if( pNode->callback != NULL )
+    {
+        pNode->callback( pNode->pCallbackContext, pPublishInfo );
+        called = 1U;
+    }
+
+    return called;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTTopicRouter_Init( MQTTTopicRouter_t * pRouter )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( pRouter == NULL )
+    {
+        LogError( ( "Argument cannot be NULL: pRouter=%p.", ( void * ) pRouter ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        ( void ) memset( pRouter, 0x00, sizeof( MQTTTopicRouter_t ) );
+        pRouter->nodeCount = 1U;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTTTopicRouter_Register( MQTTTopicRouter_t * pRouter,
+                                       const char * pFilter,
+                                       uint16_t filterLength,
+                                       MQTTTopicRouterCallback_t callback,
+                                       void * pContext )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    uint16_t node;
+
+    if( ( pRouter == NULL ) || ( pFilter == NULL ) || ( callback == NULL ) )
+    {
+        LogError( ( "Arguments cannot be NULL: pRouter=%p, pFilter=%p.",
+                    ( void * ) pRouter,
+                    ( const void * ) pFilter ) );
+        status = MQTTBadParameter;
+    }
+    else if( isValidFilter( pFilter, filterLength ) == false )
+    {
+        LogError( ( "Invalid topic filter %.*s.", ( int ) filterLength, pFilter ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        /* Nodes added before the nodes run out stay, without callback. */
+        node = findFilter( pRouter, pFilter, filterLength, true );
+
+        if( node == ROOT_NODE )
+        {
+            LogError( ( "No node left for topic filter %.*s. Increase MQTT_TOPIC_ROUTER_MAX_NODES.",
+                        ( int ) filterLength, pFilter ) );
+            status = MQTTNoMemory;
+        }
+        else
+        {
+            pRouter->nodes[ node ].callback = callback;
+            pRouter->nodes[ node ].pCallbackContext = pContext;
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+bool MQTTTopicRouter_Unregister( MQTTTopicRouter_t * pRouter,
+                                 const char * pFilter,
+                                 uint16_t filterLength )
+{
+    bool removed = false;
+    uint16_t node;
+
+    configASSERT( pRouter != NULL );
+    configASSERT( pFilter != NULL );
+
+    if( isValidFilter( pFilter, filterLength ) == true )
+    {
+        node = findFilter( pRouter, pFilter, filterLength, false );
+
+        if( ( node != ROOT_NODE ) && ( pRouter->nodes[ node ].callback != NULL ) )
+        {
+            pRouter->nodes[ node ].callback = NULL;
+            pRouter->nodes[ node ].pCallbackContext = NULL;
+            removed = true;
+        }
+    }
+
+    return removed;
+}
+
+/*-----------------------------------------------------------*/
+
+size_t MQTTTopicRouter_Dispatch( const MQTTTopicRouter_t * pRouter,
+                                 MQTTPublishInfo_t * pPublishInfo )
+{
+    /* Each level pushes at most a literal and a '+' child, and one of them
+     * is popped at once, so the frames never exceed the levels plus one. */
+    DispatchFrame_t stack[ MQTT_TOPIC_ROUTER_MAX_LEVELS + 1U ];
+    size_t top = 0U;
+    size_t called = 0U;
+    const char * pTopic;
+    uint32_t topicLength;
+    uint32_t offset;
+    uint32_t end;
+    uint16_t child;
+    const MQTTTopicRouterNode_t * pNode;
+    bool wildcards;
+
+    configASSERT( pRouter != NULL );
+    configASSERT( pPublishInfo != NULL );
+
+    pTopic = pPublishInfo->pTopicName;
+    topicLength = pPublishInfo->topicNameLength;
+
+    stack[ 0 ].node = ROOT_NODE;
+    stack[ 0 ].offset = 0U;
+    top = 1U;
+
+    while( top > 0U )
+    {
+        top--;
+        pNode = &( pRouter->nodes[ stack[ top ].node ] );
+        offset = stack[ top ].offset;
+
+        /* Wildcards in the first level do not match topics such as $SYS. */
+        wildcards = ( stack[ top ].node != ROOT_NODE ) || ( topicLength == 0U ) || ( pTopic[ 0 ] != '$' );
+
+        /* '#' matches the level of its parent and all the levels below. */
+        if( ( pNode->hashChild != ROOT_NODE ) && ( wildcards == true ) )
+        {
+            called += invokeCallback( &( pRouter->nodes[ pNode->hashChild ] ), pPublishInfo );
+        }
+
+        if( offset > topicLength )
+        {
+            called += invokeCallback( pNode, pPublishInfo );
+        }
+        else
+        {
+            end = levelEnd( pTopic, topicLength, offset );
+            child = findChild( pRouter, stack[ top ].node, &( pTopic[ offset ] ), end - offset );
+
+            if( child != ROOT_NODE )
+            {
+                configASSERT( top < ( MQTT_TOPIC_ROUTER_MAX_LEVELS + 1U ) );
+                stack[ top ].node = child;
+                stack[ top ].offset = end + 1U;
+                top++;
+            }
+
+            if( ( pNode->plusChild != ROOT_NODE ) && ( wildcards == true ) )
+            {
+                configASSERT( top < ( MQTT_TOPIC_ROUTER_MAX_LEVELS + 1U ) );
+                stack[ top ].node = pNode->plusChild;
+                stack[ top ].offset = end + 1U;
+                top++;
+            }
+        }
+    }
+
+    return called;
+}
+
+/*-----------------------------------------------------------*/
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/**
+ * @file mqtt_topic_router.h
+ * @brief Dispatch of incoming publishes to per-filter callbacks.
+ *
+ * The topic filters are stored in a trie with one node per level. The
+ * literal children of all the nodes are found through one hash table keyed
+ * by the parent and the level, and each node links directly to its '+' and
+ * '#' children. Dispatching a topic thus costs one hash lookup per level
+ * and per matching '+' branch, whatever the number of filters, instead of a
+ * comparison with each filter.
+ *
+ * The nodes point into the filter strings, which must stay valid as long as
+ * the router. All the storage is in #MQTTTopicRouter_t, sized by
+ * #MQTT_TOPIC_ROUTER_MAX_NODES. Nodes are never freed:
+ * MQTTTopicRouter_Unregister() only removes the callback, and registering
+ * the filter again reuses its nodes. The router is not thread safe: register
+ * the filters before dispatching, from the task that owns the connection.
+ */
+
+#ifndef MQTT_TOPIC_ROUTER_H
+#define MQTT_TOPIC_ROUTER_H
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* MQTT library includes. */
+#include "core_mqtt.h"
+
+/**
+ * @brief Number of nodes of the trie: one per distinct level of a filter,
+ * where filters with the same first levels share the nodes of those levels.
+ */
+#ifndef MQTT_TOPIC_ROUTER_MAX_NODES
+    #define MQTT_TOPIC_ROUTER_MAX_NODES    ( 256U )
+#endif
+
+/**
+ * @brief Number of slots of the hash table of the literal levels, a power
+ * of two larger than #MQTT_TOPIC_ROUTER_MAX_NODES.
+ */
+#ifndef MQTT_TOPIC_ROUTER_HASH_SIZE
+    #define MQTT_TOPIC_ROUTER_HASH_SIZE    ( 512U )
+#endif
+
+/**
+ * @brief Largest number of levels of a filter.
+ */
+#ifndef MQTT_TOPIC_ROUTER_MAX_LEVELS
+    #define MQTT_TOPIC_ROUTER_MAX_LEVELS    ( 8U )
+#endif
+
+/**
+ * @brief Function called with the publishes whose topic matches a filter.
+ *
+ * @param[in] pContext Context given to MQTTTopicRouter_Register().
+ * @param[in] pPublishInfo The incoming publish.
+ */
+typedef void ( * MQTTTopicRouterCallback_t )( void * pContext,
+                                              MQTTPublishInfo_t * pPublishInfo );
+
+/**
+ * @brief Node of the trie, for one level of one or more filters.
+ */
+typedef struct MQTTTopicRouterNode
+{
+    const char * pLevel;                /**< @brief The level, in the filter that created the node. */
+    uint16_t levelLength;               /**< @brief Length of the level. */
+    uint16_t parent;                    /**< @brief Index of the parent node. */
+    uint16_t plusChild;                 /**< @brief Index of the '+' child, or 0. */
+    uint16_t hashChild;                 /**< @brief Index of the '#' child, or 0. */
+    MQTTTopicRouterCallback_t callback; /**< @brief Callback of the filter that ends here, or NULL. */
+    void * pCallbackContext;            /**< @brief Context of the callback. */
+} MQTTTopicRouterNode_t;
+
+/**
+ * @brief Topic router. Its fields are private.
+ */
+typedef struct MQTTTopicRouter
+{
+    MQTTTopicRouterNode_t nodes[ MQTT_TOPIC_ROUTER_MAX_NODES ]; /**< @brief The nodes. Node 0 is the root. */
+    uint16_t nodeCount;                                         /**< @brief Nodes in use. */
+    uint16_t table[ MQTT_TOPIC_ROUTER_HASH_SIZE ];              /**< @brief Literal children by parent and level, or 0. */
+} MQTTTopicRouter_t;
+
+/**
+ * @brief Set up an empty router.
+ *
+ * @param[out] pRouter The router.
+ *
+ * @return #MQTTSuccess, or #MQTTBadParameter.
+ */
+MQTTStatus_t MQTTTopicRouter_Init( MQTTTopicRouter_t * pRouter );
+
+/**
+ * @brief Call a function with the publishes whose topic matches a filter.
+ * A filter registered again gets the new callback.
+ *
+ * @param[in] pRouter The router.
+ * @param[in] pFilter The topic filter, valid as long as the router.
+ * @param[in] filterLength Length of the filter.
+ * @param[in] callback Function to call.
+ * @param[in] pContext Passed to the function.
+ *
+ * @return #MQTTSuccess, #MQTTBadParameter if the filter is not valid or has
+ * more than #MQTT_TOPIC_ROUTER_MAX_LEVELS levels, or #MQTTNoMemory if the
+ * nodes ran out.
+ */
+MQTTStatus_t MQTTTopicRouter_Register( MQTTTopicRouter_t * pRouter,
+                                       const char * pFilter,
+                                       uint16_t filterLength,
+                                       MQTTTopicRouterCallback_t callback,
+                                       void * pContext );
+
+/**
+ * @brief Stop calling the function of a filter.
+ *
+ * @param[in] pRouter The router.
+ * @param[in] pFilter The topic filter.
+ * @param[in] filterLength Length of the filter.
+ *
+ * @return true if the filter was registered.
+ */
+bool MQTTTopicRouter_Unregister( MQTTTopicRouter_t * pRouter,
+                                 const char * pFilter,
+                                 uint16_t filterLength );
+
+/**
+ * @brief Call the function of every filter that matches the topic of a
+ * publish, in no particular order. The functions must not register or
+ * unregister filters.
+ *
+ * As required by MQTT, a topic starting with '$' matches no filter starting
+ * with a wildcard.
+ *
+ * @param[in] pRouter The router.
+ * @param[in] pPublishInfo The incoming publish.
+ *
+ * @return The number of functions called.
+ */
+size_t MQTTTopicRouter_Dispatch( const MQTTTopicRouter_t * pRouter,
+                                 MQTTPublishInfo_t * pPublishInfo );
+
+#endif /* ifndef MQTT_TOPIC_ROUTER_H */
@@ -0,0 +1,370 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/**
+ * @file mqtt_topic_router_benchmark.c
+ * @brief Microbenchmark of the dispatch of incoming publishes.
+ */
+
+/* Standard includes. */
+#include <stdio.h>
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Configure logs for the functions in this file, before core_mqtt_config.h
+ * sets those of coreMQTT. */
+#include "logging_levels.h"
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "RouterBenchmark"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_INFO
+#endif
+#include "logging_stack.h"
+
+#include "mqtt_topic_router_benchmark.h"
+#include "mqtt_topic_router.h"
+
+#ifdef MQTT_TOPIC_ROUTER_BENCHMARK
+
+/**
+ * @brief Number of command filters, devices/bench/commands/cmd<n>.
+ */
+    #define BENCHMARK_COMMAND_FILTERS    ( 160U )
+
+/**
+ * @brief Number of configuration filters, devices/+/config/cfg<n>.
+ */
+    #define BENCHMARK_CONFIG_FILTERS     ( 60U )
+
+/**
+ * @brief Number of filters: the commands, the configurations, and
+ * devices/bench/jobs/# and $aws/things/bench/shadow/+/accepted.
+ */
+    #define BENCHMARK_FILTERS            ( BENCHMARK_COMMAND_FILTERS + BENCHMARK_CONFIG_FILTERS + 2U )
+
+/**
+ * @brief Size of the storage of each filter.
+ */
+    #define BENCHMARK_FILTER_SIZE        ( 40U )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The filters, valid as long as the router.
+ */
+    static char benchmarkFilters[ BENCHMARK_FILTERS ][ BENCHMARK_FILTER_SIZE ];
+
+/**
+ * @brief Lengths of the filters.
+ */
+    static uint16_t benchmarkFilterLengths[ BENCHMARK_FILTERS ];
+
+/**
+ * @brief Router of the benchmark, too large for the stack.
+ */
+    static MQTTTopicRouter_t benchmarkRouter;
+
+/**
+ * @brief Topics dispatched in turn: a command, a configuration of another
+ * device, a job under '#', a shadow response, and a topic without filter.
+ */
+    static const char * const benchmarkTopics[] =
+    {
+        "devices/bench/commands/cmd137",
+        "devices/other/config/cfg42",
+        "devices/bench/jobs/job7/notify",
+        "$aws/things/bench/shadow/update/accepted",
+        "devices/bench/telemetry"
+    };
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Get the time from the tick count.
+ *
+ * @return Time in milliseconds.
+ */
+    static uint32_t getTimeMs( void );
+
+/**
+ * @brief Count a call. The callback of all the filters.
+ *
+ * @param[in] pContext Counter of calls.
+ * @param[in] pPublishInfo The incoming publish.
+ */
+    static void countCall( void * pContext,
+                           MQTTPublishInfo_t * pPublishInfo );
+
+/**
+ * @brief Compare a topic with a filter, level by level.
+ *
+ * @param[in] pFilter The topic filter.
+ * @param[in] filterLength Length of the filter.
+ * @param[in] pTopic The topic name.
+ * @param[in] topicLength Length of the topic.
+ *
+ * @return true if the topic matches the filter.
+ */
+    static bool matchFilter( const char * pFilter,
+                             uint16_t filterLength,
+                             const char * pTopic,
+                             uint16_t topicLength );
+
+/**
+ * @brief Build the filters and register them with the router.
+ *
+ * @param[in] pCalls Counter of calls, the context of the callbacks.
+ *
+ * @return #MQTTSuccess, or the first error of the router.
+ */
+    static MQTTStatus_t registerFilters( uint32_t * pCalls );
+
+/*-----------------------------------------------------------*/
+
+    static uint32_t getTimeMs( void )
+    {
+        return ( uint32_t ) ( ( ( uint64_t ) xTaskGetTickCount() * 1000U ) / configTICK_RATE_HZ );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void countCall( void * pContext,
+                           MQTTPublishInfo_t * pPublishInfo )
+    {
+        ( void ) pPublishInfo;
+
+        ( *( ( uint32_t * ) pContext ) )++;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static bool matchFilter( const char * pFilter,
+                             uint16_t filterLength,
+                             const char * pTopic,
+                             uint16_t topicLength )
+    {
+        bool match = true;
+        bool done = false;
+        uint16_t filterIndex = 0U;
+        uint16_t topicIndex = 0U;
+
+        if( ( topicLength > 0U ) && ( pTopic[ 0 ] == '$' ) &&
+            ( ( pFilter[ 0 ] == '+' ) || ( pFilter[ 0 ] == '#' ) ) )
+        {
+            match = false;
+            done = true;
+        }
+
+        while( done == false )
+        {
+            if( ( filterIndex < filterLength ) && ( pFilter[ filterIndex ] == '#' ) )
+            {
+                done = true;
+            }
+            else if( ( filterIndex < filterLength ) && ( pFilter[ filterIndex ] == '+' ) )
+            {
+                /* Skip the level of the topic. */
+                while( ( topicIndex < topicLength ) && ( pTopic[ topicIndex ] != '/' ) )
+                {
+                    topicIndex++;
+                }
+
+                filterIndex++;
+            }
+            else
+            {
+                while( ( filterIndex < filterLength ) && ( topicIndex < topicLength ) &&
+                       ( pFilter[ filterIndex ] != '/' ) && ( pFilter[ filterIndex ] == pTopic[ topicIndex ] ) )
+                {
+                    filterIndex++;
+                    topicIndex++;
+                }
+            }
+
+            if( done == true )
+            {
+                /* Matched by '#'. */
+            }
+            else if( ( filterIndex == filterLength ) || ( topicIndex == topicLength ) )
+            {
+                /* Both must end together, except that "a/#" also matches "a". */
+                match = ( ( filterIndex == filterLength ) && ( topicIndex == topicLength ) ) ||
+                        ( ( topicIndex == topicLength ) && ( ( filterLength - filterIndex ) == 2U ) &&
+                          ( pFilter[ filterIndex ] == '/' ) && ( pFilter[ filterIndex + 1U ] == '#' ) );
+                done = true;
+            }
+            else if( ( pFilter[ filterIndex ] == '/' ) && ( pTopic[ topicIndex ] == '/' ) )
+            {
+                filterIndex++;
+                topicIndex++;
+            }
+            else
+            {
+                match = false;
+                done = true;
+            }
+        }
+
+        return match;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static MQTTStatus_t registerFilters( uint32_t * pCalls )
+    {
+        MQTTStatus_t status;
+        uint32_t filter;
+        int length;
+
+        for( filter = 0U; filter < BENCHMARK_FILTERS; filter++ )
+        {
+            if( filter < BENCHMARK_COMMAND_FILTERS )
+            {
+                length = snprintf( benchmarkFilters[ filter ], BENCHMARK_FILTER_SIZE,
+                                   "devices/bench/commands/cmd%u", ( unsigned int ) filter );
+            }
+            else if( filter < ( BENCHMARK_COMMAND_FILTERS + BENCHMARK_CONFIG_FILTERS ) )
+            {
+                length = snprintf( benchmarkFilters[ filter ], BENCHMARK_FILTER_SIZE,
+                                   "devices/+/config/cfg%u", ( unsigned int ) ( filter - BENCHMARK_COMMAND_FILTERS ) );
+            }
+            else if( filter == ( BENCHMARK_FILTERS - 2U ) )
+            {
+                length = snprintf( benchmarkFilters[ filter ], BENCHMARK_FILTER_SIZE, "devices/bench/jobs/#" );
+            }
+            else
+            {
+                length = snprintf( benchmarkFilters[ filter ], BENCHMARK_FILTER_SIZE,
+                                   "$aws/things/bench/shadow/+/accepted" );
+            }
+
+            configASSERT( ( length > 0 ) && ( length < ( int ) BENCHMARK_FILTER_SIZE ) );
+            benchmarkFilterLengths[ filter ] = ( uint16_t ) length;
+        }
+
+        status = MQTTTopicRouter_Init( &benchmarkRouter );
+
+        for( filter = 0U; ( filter < BENCHMARK_FILTERS ) && ( status == MQTTSuccess ); filter++ )
+        {
+            status = MQTTTopicRouter_Register( &benchmarkRouter,
+                                               benchmarkFilters[ filter ],
+                                               benchmarkFilterLengths[ filter ],
+                                               countCall,
+                                               pCalls );
+        }
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+    MQTTStatus_t MQTTTopicRouterBenchmark_Run( uint32_t dispatches,
+                                               MQTTTopicRouterBenchmark_t * pResult )
+    {
+        MQTTTopicRouterBenchmark_t result = { 0 };
+        MQTTPublishInfo_t publishInfo;
+        MQTTStatus_t status;
+        uint32_t linearCalls = 0U;
+        uint32_t routerCalls = 0U;
+        uint32_t dispatch;
+        uint32_t filter;
+        uint32_t startTimeMs;
+        const size_t topicCount = sizeof( benchmarkTopics ) / sizeof( benchmarkTopics[ 0 ] );
+
+        configASSERT( dispatches > 0U );
+
+        ( void ) memset( &publishInfo, 0x00, sizeof( publishInfo ) );
+        result.filters = BENCHMARK_FILTERS;
+        status = registerFilters( &routerCalls );
+
+        if( status == MQTTSuccess )
+        {
+            /* One comparison with each subscription per publish. */
+            startTimeMs = getTimeMs();
+
+            for( dispatch = 0U; dispatch < dispatches; dispatch++ )
+            {
+                publishInfo.pTopicName = benchmarkTopics[ dispatch % topicCount ];
+                publishInfo.topicNameLength = ( uint16_t ) strlen( publishInfo.pTopicName );
+
+                for( filter = 0U; filter < BENCHMARK_FILTERS; filter++ )
+                {
+                    if( matchFilter( benchmarkFilters[ filter ], benchmarkFilterLengths[ filter ],
+                                     publishInfo.pTopicName, publishInfo.topicNameLength ) == true )
+                    {
+                        countCall( &linearCalls, &publishInfo );
+                    }
+                }
+            }
+
+            result.linearMs = getTimeMs() - startTimeMs;
+
+            startTimeMs = getTimeMs();
+
+            for( dispatch = 0U; dispatch < dispatches; dispatch++ )
+            {
+                publishInfo.pTopicName = benchmarkTopics[ dispatch % topicCount ];
+                publishInfo.topicNameLength = ( uint16_t ) strlen( publishInfo.pTopicName );
+                ( void ) MQTTTopicRouter_Dispatch( &benchmarkRouter, &publishInfo );
+            }
+
+            result.routerMs = getTimeMs() - startTimeMs;
+
+            if( linearCalls != routerCalls )
+            {
+                LogError( ( "The router called %lu callbacks, the linear scan %lu.",
+                            ( unsigned long ) routerCalls,
+                            ( unsigned long ) linearCalls ) );
+                status = MQTTIllegalState;
+            }
+        }
+
+        if( status == MQTTSuccess )
+        {
+            /* Times in nanoseconds per dispatch, from the tick count. */
+            LogInfo( ( "%lu dispatches to %lu topic filters, %lu callbacks:",
+                       ( unsigned long ) dispatches,
+                       ( unsigned long ) result.filters,
+                       ( unsigned long ) routerCalls ) );
+            LogInfo( ( "Linear scan: %lu ms, %lu ns per dispatch. Topic router: %lu ms, %lu ns per dispatch.",
+                       ( unsigned long ) result.linearMs,
+                       ( unsigned long ) ( ( ( uint64_t ) result.linearMs * 1000000U ) / dispatches ),
+                       ( unsigned long ) result.routerMs,
+                       ( unsigned long ) ( ( ( uint64_t ) result.routerMs * 1000000U ) / dispatches ) ) );
+        }
+        else
+        {
+            LogError( ( "Topic router benchmark failed: %s.", MQTT_Status_strerror( status ) ) );
+        }
+
+        if( pResult != NULL )
+        {
+            *pResult = result;
+        }
+
+        return status;
+    }
+
+#endif /* ifdef MQTT_TOPIC_ROUTER_BENCHMARK */
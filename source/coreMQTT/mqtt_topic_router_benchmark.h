@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/**
+ * @file mqtt_topic_router_benchmark.h
+ * @brief Microbenchmark of the dispatch of incoming publishes.
+ *
+ * Built when MQTT_TOPIC_ROUTER_BENCHMARK is defined in core_mqtt_config.h.
+ * The benchmark registers a few hundred command and configuration filters,
+ * some with '+' and '#', and dispatches a mix of topics to them, once with
+ * the topic router and once by comparing the topic with each filter in turn.
+ */
+
+#ifndef MQTT_TOPIC_ROUTER_BENCHMARK_H
+#define MQTT_TOPIC_ROUTER_BENCHMARK_H
+
+/* Standard includes. */
+#include <stdint.h>
+
+/* MQTT library includes. */
+#include "core_mqtt.h"
+
+/**
+ * @brief Time taken to dispatch the topics of the benchmark.
+ */
+typedef struct MQTTTopicRouterBenchmark
+{
+    uint32_t filters;  /**< @brief Number of filters registered. */
+    uint32_t linearMs; /**< @brief Comparing each topic with every filter. */
+    uint32_t routerMs; /**< @brief With the topic router. */
+} MQTTTopicRouterBenchmark_t;
+
+/**
+ * @brief Dispatch topics both ways and log the time per dispatch.
+ *
+ * @param[in] dispatches Number of topics dispatched by each run.
+ * @param[out] pResult Where to write the results. May be NULL.
+ *
+ * @return #MQTTSuccess, #MQTTNoMemory if the filters do not fit in the
+ * router, or #MQTTIllegalState if both ways did not call the same number of
+ * callbacks.
+ */
+MQTTStatus_t MQTTTopicRouterBenchmark_Run( uint32_t dispatches,
+                                           MQTTTopicRouterBenchmark_t * pResult );
+
+#endif /* ifndef MQTT_TOPIC_ROUTER_BENCHMARK_H */
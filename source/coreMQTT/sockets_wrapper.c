@@ -110,8 +110,14 @@ typedef struct xSOCKET
 
     TickType_t receiveTimeout;
     TickType_t sendTimeout;
+    BaseType_t nonBlocking;
 
     EventGroupHandle_t socketEventGroupHandle;
+
+    SocketsDataReadyCallback_t dataReadyCallback;
+    void * pDataReadyContext;
+
+    uint32_t atTransactions;
 } cellularSocketWrapper_t;
 
 /*-----------------------------------------------------------*/
@@ -139,7 +145,7 @@ static uint64_t getTimeMs( void );
  * @return Positive value indicate the number of bytes received. Otherwise, error code defined
  * in sockets_wrapper.h is returned.
  */
-static BaseType_t prvNetworkRecvCellular( const cellularSocketWrapper_t * pCellularSocketContext,
+static BaseType_t prvNetworkRecvCellular( cellularSocketWrapper_t * pCellularSocketContext,
                                           uint8_t * buf,
                                           size_t len );
 /**
@@ -231,6 +237,27 @@ static bool _calculateElapsedTime( uint64_t entryTimeMs,
                                    uint32_t timeoutValueMs,
                                    uint64_t * pElapsedTimeMs );
 
+/**
+ * @brief Create a cellular socket and connect it to a server.
+ *
+ * @param[out] pSocket The output parameter to return the created socket descriptor.
+ * @param[in] pHostName Server hostname to connect to.
+ * @param[in] port Server port to connect to.
+ * @param[in] receiveTimeoutMs Timeout (in milliseconds) for transport receive.
+ * @param[in] sendTimeoutMs Timeout (in milliseconds) for transport send.
+ * @param[in] socketType CELLULAR_SOCKET_TYPE_STREAM or CELLULAR_SOCKET_TYPE_DGRAM.
+ * @param[in] socketProtocol CELLULAR_SOCKET_PROTOCOL_TCP or CELLULAR_SOCKET_PROTOCOL_UDP.
+ *
+ * @return Non-zero value on error, 0 on success.
+ */
+static BaseType_t prvSocketsConnect( Socket_t * pSocket,
+                                     const char * pHostName,
+                                     uint16_t port,
+                                     uint32_t receiveTimeoutMs,
+                                     uint32_t sendTimeoutMs,
+                                     CellularSocketType_t socketType,
+                                     CellularSocketProtocol_t socketProtocol );
+
 /*-----------------------------------------------------------*/
 
 static uint64_t getTimeMs( void )
@@ -256,7 +283,7 @@ static uint64_t getTimeMs( void )
 
 /*-----------------------------------------------------------*/
 
-static BaseType_t prvNetworkRecvCellular( const cellularSocketWrapper_t * pCellularSocketContext,
+static BaseType_t prvNetworkRecvCellular( cellularSocketWrapper_t * pCellularSocketContext,
                                           uint8_t * buf,
                                           size_t len )
 {
@@ -270,7 +297,11 @@ static BaseType_t prvNetworkRecvCellular( const cellularSocketWrapper_t * pCellu
 
     cellularSocketHandle = pCellularSocketContext->cellularSocketHandle;
 
-    if( pCellularSocketContext->receiveTimeout >= portMAX_DELAY )
+    if( pCellularSocketContext->nonBlocking == pdTRUE )
+    {
+        recvTimeout = 0;
+    }
+    else if( pCellularSocketContext->receiveTimeout >= portMAX_DELAY )
     {
         recvTimeout = portMAX_DELAY;
     }
@@ -284,6 +315,7 @@ static BaseType_t prvNetworkRecvCellular( const cellularSocketWrapper_t * pCellu
     ( void ) xEventGroupClearBits( pCellularSocketContext->socketEventGroupHandle,
                                    SOCKET_DATA_RECEIVED_CALLBACK_BIT );
     socketStatus = Cellular_SocketRecv( CellularHandle, cellularSocketHandle, buf, len, &recvLength );
+    pCellularSocketContext->atTransactions++;
 
     /* Calculate remain recvTimeout. */
     if( recvTimeout != portMAX_DELAY )
@@ -314,6 +346,7 @@ static BaseType_t prvNetworkRecvCellular( const cellularSocketWrapper_t * pCellu
         else if( ( waitEventBits & SOCKET_DATA_RECEIVED_CALLBACK_BIT ) != 0U )
         {
             socketStatus = Cellular_SocketRecv( CellularHandle, cellularSocketHandle, buf, len, &recvLength );
+            pCellularSocketContext->atTransactions++;
         }
         else
         {
@@ -383,6 +416,15 @@ static void prvCellularSocketDataReadyCallback( CellularSocketHandle_t socketHan
     if( pCellularSocketContext != NULL )
     {
         IotLogDebug( "Data ready on Socket %p", pCellularSocketContext );
+
+        /* The callback runs first, so that it sees the data arrive before a
+         * blocked reader can take it. */
+        if( pCellularSocketContext->dataReadyCallback != NULL )
+        {
+            pCellularSocketContext->dataReadyCallback( pCellularSocketContext,
+                                                       pCellularSocketContext->pDataReadyContext );
+        }
+
         ( void ) xEventGroupSetBits( pCellularSocketContext->socketEventGroupHandle,
                                      SOCKET_DATA_RECEIVED_CALLBACK_BIT );
     }
@@ -584,11 +626,13 @@ static bool _calculateElapsedTime( uint64_t entryTimeMs,
 
 /*-----------------------------------------------------------*/
 
-BaseType_t Sockets_Connect( Socket_t * pTcpSocket,
-                            const char * pHostName,
-                            uint16_t port,
-                            uint32_t receiveTimeoutMs,
-                            uint32_t sendTimeoutMs )
+static BaseType_t prvSocketsConnect( Socket_t * pSocket,
+                                     const char * pHostName,
+                                     uint16_t port,
+                                     uint32_t receiveTimeoutMs,
+                                     uint32_t sendTimeoutMs,
+                                     CellularSocketType_t socketType,
+                                     CellularSocketProtocol_t socketProtocol )
 {
     CellularSocketHandle_t cellularSocketHandle = NULL;
     cellularSocketWrapper_t * pCellularSocketContext = NULL;
@@ -599,12 +643,12 @@ BaseType_t Sockets_Connect( Socket_t * pTcpSocket,
     BaseType_t retConnect = SOCKETS_ERROR_NONE;
     const uint32_t defaultReceiveTimeoutMs = CELLULAR_SOCKET_RECV_TIMEOUT_MS;
 
-    /* Create a new TCP socket. */
+    /* Create a new TCP or UDP socket. */
     cellularSocketStatus = Cellular_CreateSocket( CellularHandle,
                                                   CellularSocketPdnContextId,
                                                   CELLULAR_SOCKET_DOMAIN_AF_INET,
-                                                  CELLULAR_SOCKET_TYPE_STREAM,
-                                                  CELLULAR_SOCKET_PROTOCOL_TCP,
+                                                  socketType,
+                                                  socketProtocol,
                                                   &cellularSocketHandle );
 
     if( cellularSocketStatus != CELLULAR_SUCCESS )
@@ -745,13 +789,159 @@ BaseType_t Sockets_Connect( Socket_t * pTcpSocket,
         }
     }
 
-    *pTcpSocket = pCellularSocketContext;
+    *pSocket = pCellularSocketContext;
 
     return retConnect;
 }
 
 /*-----------------------------------------------------------*/
 
+BaseType_t Sockets_Connect( Socket_t * pTcpSocket,
+                            const char * pHostName,
+                            uint16_t port,
+                            uint32_t receiveTimeoutMs,
+                            uint32_t sendTimeoutMs )
+{
+    return prvSocketsConnect( pTcpSocket,
+                              pHostName,
+                              port,
+                              receiveTimeoutMs,
+                              sendTimeoutMs,
+                              CELLULAR_SOCKET_TYPE_STREAM,
+                              CELLULAR_SOCKET_PROTOCOL_TCP );
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_GetHostByName( const char * pHostName,
+                                  char * pAddress,
+                                  size_t addressLength )
+{
+    char resolvedAddress[ CELLULAR_IP_ADDRESS_MAX_SIZE + 1U ] = { 0 };
+    BaseType_t retResolve = SOCKETS_ERROR_NONE;
+    CellularError_t cellularStatus = CELLULAR_SUCCESS;
+
+    if( ( pHostName == NULL ) || ( pAddress == NULL ) || ( addressLength == 0U ) )
+    {
+        IotLogError( "Invalid parameter to resolve a host name." );
+        retResolve = SOCKETS_EINVAL;
+    }
+    else
+    {
+        cellularStatus = Cellular_GetHostByName( CellularHandle,
+                                                 CellularSocketPdnContextId,
+                                                 pHostName,
+                                                 resolvedAddress );
+
+        if( cellularStatus != CELLULAR_SUCCESS )
+        {
+            IotLogError( "Failed to resolve %s. Cellular status %d.", pHostName, cellularStatus );
+            retResolve = SOCKETS_SOCKET_ERROR;
+        }
+        else if( strlen( resolvedAddress ) >= addressLength )
+        {
+            IotLogError( "Address of %s does not fit in %u bytes.", pHostName, ( unsigned int ) addressLength );
+            retResolve = SOCKETS_EINVAL;
+        }
+        else
+        {
+            ( void ) strncpy( pAddress, resolvedAddress, addressLength );
+        }
+    }
+
+    return retResolve;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_ConnectUdp( Socket_t * pUdpSocket,
+                               const char * pHostName,
+                               uint16_t port,
+                               uint32_t receiveTimeoutMs,
+                               uint32_t sendTimeoutMs )
+{
+    return prvSocketsConnect( pUdpSocket,
+                              pHostName,
+                              port,
+                              receiveTimeoutMs,
+                              sendTimeoutMs,
+                              CELLULAR_SOCKET_TYPE_DGRAM,
+                              CELLULAR_SOCKET_PROTOCOL_UDP );
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_SetDataReadyCallback( Socket_t xSocket,
+                                         SocketsDataReadyCallback_t dataReadyCallback,
+                                         void * pvContext )
+{
+    cellularSocketWrapper_t * pCellularSocketContext = ( cellularSocketWrapper_t * ) xSocket;
+    BaseType_t retSetCallback = SOCKETS_ERROR_NONE;
+
+    /* coverity[misra_c_2012_rule_11_4_violation] */
+    if( ( pCellularSocketContext == NULL ) || ( xSocket == SOCKETS_INVALID_SOCKET ) )
+    {
+        IotLogError( "Invalid xSocket %p", pCellularSocketContext );
+        retSetCallback = SOCKETS_EINVAL;
+    }
+    else
+    {
+        /* Clear the callback first so that a data ready URC never sees the new
+         * callback with the old context. */
+        pCellularSocketContext->dataReadyCallback = NULL;
+        pCellularSocketContext->pDataReadyContext = pvContext;
+        pCellularSocketContext->dataReadyCallback = dataReadyCallback;
+    }
+
+    return retSetCallback;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_SetNonBlocking( Socket_t xSocket,
+                                   BaseType_t xNonBlocking )
+{
+    cellularSocketWrapper_t * pCellularSocketContext = ( cellularSocketWrapper_t * ) xSocket;
+    BaseType_t retSetNonBlocking = SOCKETS_ERROR_NONE;
+
+    /* coverity[misra_c_2012_rule_11_4_violation] */
+    if( ( pCellularSocketContext == NULL ) || ( xSocket == SOCKETS_INVALID_SOCKET ) )
+    {
+        IotLogError( "Invalid xSocket %p", pCellularSocketContext );
+        retSetNonBlocking = SOCKETS_EINVAL;
+    }
+    else
+    {
+        pCellularSocketContext->nonBlocking = ( xNonBlocking != pdFALSE ) ? pdTRUE : pdFALSE;
+    }
+
+    return retSetNonBlocking;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t Sockets_SetReceiveTimeout( Socket_t xSocket,
+                                      uint32_t receiveTimeoutMs )
+{
+    cellularSocketWrapper_t * pCellularSocketContext = ( cellularSocketWrapper_t * ) xSocket;
+    BaseType_t retSetTimeout = SOCKETS_ERROR_NONE;
+
+    /* coverity[misra_c_2012_rule_11_4_violation] */
+    if( ( pCellularSocketContext == NULL ) || ( xSocket == SOCKETS_INVALID_SOCKET ) )
+    {
+        IotLogError( "Invalid xSocket %p", pCellularSocketContext );
+        retSetTimeout = SOCKETS_EINVAL;
+    }
+    else
+    {
+        retSetTimeout = prvSetupSocketRecvTimeout( pCellularSocketContext, pdMS_TO_TICKS( receiveTimeoutMs ) );
+    }
+
+    return retSetTimeout;
+}
+
+/*-----------------------------------------------------------*/
+
 void Sockets_Disconnect( Socket_t xSocket )
 {
     int32_t retClose = SOCKETS_ERROR_NONE;
@@ -896,6 +1086,7 @@ int32_t Sockets_Send( Socket_t xSocket,
                                                 &buf[ retSendLength ],
                                                 bytesToSend,
                                                 &sentLength );
+            pCellularSocketContext->atTransactions++;
 
             if( socketStatus == CELLULAR_SUCCESS )
             {
@@ -928,3 +1119,19 @@ int32_t Sockets_Send( Socket_t xSocket,
 }
 
 /*-----------------------------------------------------------*/
+
+uint32_t Sockets_GetTransactionCount( Socket_t xSocket )
+{
+    const cellularSocketWrapper_t * pCellularSocketContext = ( const cellularSocketWrapper_t * ) xSocket;
+    uint32_t transactions = 0U;
+
+    /* coverity[misra_c_2012_rule_11_4_violation] */
+    if( ( pCellularSocketContext != NULL ) && ( xSocket != SOCKETS_INVALID_SOCKET ) )
+    {
+        transactions = pCellularSocketContext->atTransactions;
+    }
+
+    return transactions;
+}
+
+/*-----------------------------------------------------------*/
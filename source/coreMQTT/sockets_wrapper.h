@@ -66,9 +66,27 @@
 
 #define SOCKETS_INVALID_SOCKET      ( ( Socket_t ) ~0U )
 
+/**
+ * @brief Size of a buffer that holds an IP address in text form, with its
+ * terminating null byte.
+ */
+#define SOCKETS_IP_ADDRESS_LENGTH    ( 46U )
+
 struct xSOCKET;
 typedef struct xSOCKET * Socket_t; /**< @brief Socket handle data type. */
 
+/**
+ * @brief Callback invoked when data arrives on a socket.
+ *
+ * The callback runs in the context of the cellular URC handler, so it must not
+ * block. It would typically notify the task that owns the socket.
+ *
+ * @param[in] xSocket The socket on which data arrived.
+ * @param[in] pvContext The context registered with Sockets_SetDataReadyCallback().
+ */
+typedef void ( * SocketsDataReadyCallback_t )( Socket_t xSocket,
+                                               void * pvContext );
+
 /**
  * @brief Establish a connection to server.
  *
@@ -88,6 +106,84 @@ BaseType_t Sockets_Connect( Socket_t * pTcpSocket,
                             uint32_t receiveTimeoutMs,
                             uint32_t sendTimeoutMs );
 
+/**
+ * @brief Resolve a host name to an IP address.
+ *
+ * Sockets_Connect() accepts host names and leaves their resolution to the
+ * modem. Resolving the name first, and connecting to the address, lets a
+ * caller time the two apart.
+ *
+ * @param[in] pHostName Host name to resolve.
+ * @param[out] pAddress Buffer for the address in text form.
+ * @param[in] addressLength Size of pAddress, at least #SOCKETS_IP_ADDRESS_LENGTH.
+ *
+ * @return SOCKETS_ERROR_NONE on success, SOCKETS_EINVAL for invalid
+ * parameters, or SOCKETS_SOCKET_ERROR if the name could not be resolved.
+ */
+BaseType_t Sockets_GetHostByName( const char * pHostName,
+                                  char * pAddress,
+                                  size_t addressLength );
+
+/**
+ * @brief Open a UDP socket to a server.
+ *
+ * The socket only exchanges datagrams with that server, and is used with
+ * Sockets_Send(), Sockets_Recv() and Sockets_Disconnect() like a TCP socket.
+ * Each Sockets_Recv() returns at most one datagram.
+ *
+ * @param[out] pUdpSocket The output parameter to return the created socket descriptor.
+ * @param[in] pHostName Server hostname to send to.
+ * @param[in] port Server port to send to.
+ * @param[in] receiveTimeoutMs Timeout (in milliseconds) for transport receive.
+ * @param[in] sendTimeoutMs Timeout (in milliseconds) for transport send.
+ *
+ * @return Non-zero value on error, 0 on success.
+ */
+BaseType_t Sockets_ConnectUdp( Socket_t * pUdpSocket,
+                               const char * pHostName,
+                               uint16_t port,
+                               uint32_t receiveTimeoutMs,
+                               uint32_t sendTimeoutMs );
+
+/**
+ * @brief Register a callback to be invoked when data arrives on a socket.
+ *
+ * @param[in] xSocket The socket descriptor.
+ * @param[in] dataReadyCallback The callback, or NULL to remove it.
+ * @param[in] pvContext Context passed to the callback.
+ *
+ * @return SOCKETS_ERROR_NONE on success, SOCKETS_EINVAL otherwise.
+ */
+BaseType_t Sockets_SetDataReadyCallback( Socket_t xSocket,
+                                         SocketsDataReadyCallback_t dataReadyCallback,
+                                         void * pvContext );
+
+/**
+ * @brief Switch a socket between blocking and non-blocking receive.
+ *
+ * In non-blocking mode, Sockets_Recv() returns 0 at once when no data is
+ * buffered instead of waiting for the receive timeout.
+ *
+ * @param[in] xSocket The socket descriptor.
+ * @param[in] xNonBlocking pdTRUE for non-blocking receive, pdFALSE to restore
+ * the receive timeout.
+ *
+ * @return SOCKETS_ERROR_NONE on success, SOCKETS_EINVAL otherwise.
+ */
+BaseType_t Sockets_SetNonBlocking( Socket_t xSocket,
+                                   BaseType_t xNonBlocking );
+
+/**
+ * @brief Change the receive timeout set by Sockets_Connect().
+ *
+ * @param[in] xSocket The socket descriptor.
+ * @param[in] receiveTimeoutMs Timeout (in milliseconds) for transport receive.
+ *
+ * @return SOCKETS_ERROR_NONE on success, SOCKETS_EINVAL otherwise.
+ */
+BaseType_t Sockets_SetReceiveTimeout( Socket_t xSocket,
+                                      uint32_t receiveTimeoutMs );
+
 /**
  * @brief End connection to server.
  *
@@ -133,4 +229,17 @@ int32_t Sockets_Recv( Socket_t xSocket,
                       void * pvBuffer,
                       size_t xBufferLength );
 
+/**
+ * @brief Get the number of AT transactions of a socket.
+ *
+ * Each data command that Sockets_Send() or Sockets_Recv() issues to the modem
+ * counts as one transaction, so the difference between two calls gives the
+ * modem round trips spent in between. Sockets without a modem return 0.
+ *
+ * @param[in] xSocket The socket descriptor.
+ *
+ * @return The number of AT transactions since the socket was connected.
+ */
+uint32_t Sockets_GetTransactionCount( Socket_t xSocket );
+
 #endif /* ifndef SOCKETS_WRAPPER_H */
@@ -30,6 +30,7 @@
 
 /* FreeRTOS includes. */
 #include "FreeRTOS.h"
+#include "task.h"
 
 /* TLS transport header. */
 #include "using_mbedtls.h"
@@ -37,38 +38,276 @@
 /* mbedTLS util includes. */
 #include "mbedtls_error.h"
 
+/* mbedTLS version, for the API differences between 2.x and 3.x. */
+#include "mbedtls/version.h"
+
+/* mbedTLS ASN.1 parser, used to walk DER-encoded certificate chains. */
+#include "mbedtls/asn1.h"
+
+/* mbedTLS platform memory functions. */
+#include "mbedtls/platform.h"
+
+/* Size-class pools that serve the small mbed TLS allocations. */
+#ifdef MBEDTLS_FREERTOS_SLAB_ALLOC
+    #include "mbedtls_slab_alloc.h"
+#endif
+
+#ifdef MBEDTLS_FREERTOS_ECDHE_POOL
+    #include "mbedtls_ecdhe_pool.h"
+#endif
+
+/* PSA crypto is required by the TLS 1.3 implementation of mbed TLS 3.x. */
+#ifdef MBEDTLS_PSA_CRYPTO_C
+    #include "psa/crypto.h"
+#endif
+
+/* Message digest that identifies the credentials of a cached TLS session. */
+#ifdef TLS_TRANSPORT_SESSION_CACHE
+    #include "mbedtls/md.h"
+#endif
+
 /*-----------------------------------------------------------*/
 
+#ifndef MBEDTLS_ERROR_NUMERIC_ONLY
+
 /**
  * @brief Represents string to be logged when mbedTLS returned error
  * does not contain a high-level code.
  */
-static const char * pNoHighLevelMbedTlsCodeStr = "<No-High-Level-Code>";
+    static const char * pNoHighLevelMbedTlsCodeStr = "<No-High-Level-Code>";
 
 /**
  * @brief Represents string to be logged when mbedTLS returned error
  * does not contain a low-level code.
  */
-static const char * pNoLowLevelMbedTlsCodeStr = "<No-Low-Level-Code>";
+    static const char * pNoLowLevelMbedTlsCodeStr = "<No-Low-Level-Code>";
+#endif
 
 /**
- * @brief Utility for converting the high-level code in an mbedTLS error to string,
- * if the code-contains a high-level code; otherwise, using a default string.
+ * @brief Whether the mbed TLS mutex functions have been set.
+ *
+ * They are global to mbed TLS and shared by every connection, so they are set
+ * by the first connect and never cleared.
+ */
+static BaseType_t threadingInitialized = pdFALSE;
+
+/**
+ * @brief Format of an mbedTLS error in log messages. It is followed in the
+ * arguments by #tlsErrorArgs.
+ *
+ * The code is always logged in hex. With MBEDTLS_ERROR_NUMERIC_ONLY defined,
+ * mbedtls_error.c holds no strings and the code is all that is logged.
+ */
+#ifdef MBEDTLS_ERROR_NUMERIC_ONLY
+    #define TLS_ERROR_FORMAT                "-0x%04X"
+    #define tlsErrorArgs( mbedTlsCode )    ( unsigned int ) -( mbedTlsCode )
+#else
+    #define TLS_ERROR_FORMAT                "-0x%04X %s : %s"
+    #define tlsErrorArgs( mbedTlsCode )                               \
+    ( unsigned int ) -( mbedTlsCode ),                                \
+    mbedtlsHighLevelCodeOrDefault( mbedTlsCode ),                     \
+    mbedtlsLowLevelCodeOrDefault( mbedTlsCode )
+#endif
+
+/**
+ * @brief Maximum fragment length requested when #NetworkCredentials.maxFragmentLength
+ * is left at 0.
+ */
+#ifdef TLS_TRANSPORT_LEAN_PROFILE
+    #define DEFAULT_MAX_FRAGMENT_LENGTH    MBEDTLS_SSL_MAX_FRAG_LEN_1024
+#else
+    #define DEFAULT_MAX_FRAGMENT_LENGTH    MBEDTLS_SSL_MAX_FRAG_LEN_4096
+#endif
+
+/* Over TLS 1.3, the lean profile relies on the record size limit extension,
+ * which the mbed TLS client only sends from 3.6 on. */
+#if defined( TLS_TRANSPORT_LEAN_PROFILE ) && defined( MBEDTLS_SSL_PROTO_TLS1_3 ) && \
+    ( MBEDTLS_VERSION_NUMBER < 0x03060000 )
+    #error "TLS_TRANSPORT_LEAN_PROFILE with MBEDTLS_SSL_PROTO_TLS1_3 requires mbed TLS 3.6 or later."
+#endif
+
+/**
+ * @brief Basic ECC operations after which a restartable handshake returns.
+ * Smaller values give shorter slices and more overhead.
+ */
+#ifndef TLS_TRANSPORT_ECP_MAX_OPS
+    #define TLS_TRANSPORT_ECP_MAX_OPS    1000U
+#endif
+
+/**
+ * @brief Whether an mbed TLS handshake returned in the middle of a restartable
+ * ECC operation, to be resumed by calling it again.
+ */
+#ifdef MBEDTLS_ECP_RESTARTABLE
+    #define eccInProgress( mbedtlsError )    ( ( mbedtlsError ) == MBEDTLS_ERR_SSL_CRYPTO_IN_PROGRESS )
+#else
+    #define eccInProgress( mbedtlsError )    ( 0 )
+#endif
+
+/**
+ * @brief Convert a tick count to milliseconds.
+ */
+#define ticksToMs( ticks )    ( ( uint32_t ) ( ( ( uint64_t ) ( ticks ) * 1000U ) / configTICK_RATE_HZ ) )
+
+/**
+ * @brief Handshake state of an mbed TLS context, which mbed TLS 3.x made private.
+ */
+#ifdef MBEDTLS_PRIVATE
+    #define sslHandshakeState( pSsl )    ( ( int32_t ) ( pSsl )->MBEDTLS_PRIVATE( state ) )
+#else
+    #define sslHandshakeState( pSsl )    ( ( int32_t ) ( pSsl )->state )
+#endif
+
+#ifdef TLS_TRANSPORT_SESSION_CACHE
+
+/**
+ * @brief Number of TLS sessions remembered across connections. The oldest is
+ * replaced when all are in use.
+ */
+    #ifndef TLS_TRANSPORT_SESSION_CACHE_ENTRIES
+        #define TLS_TRANSPORT_SESSION_CACHE_ENTRIES    2U
+    #endif
+
+/**
+ * @brief Time after which a session is no longer offered, so that the next
+ * handshake verifies the server chain again. Keep it well below the tick
+ * counter period.
+ */
+    #ifndef TLS_TRANSPORT_SESSION_CACHE_TTL_MS
+        #define TLS_TRANSPORT_SESSION_CACHE_TTL_MS    ( 60U * 60U * 1000U )
+    #endif
+
+/**
+ * @brief Length of the SHA-256 digest that identifies the credentials of a
+ * session.
+ */
+    #define SESSION_KEY_LENGTH    32U
+
+/**
+ * @brief Host name set on an mbed TLS context, which mbed TLS 3.x made private.
+ */
+    #ifdef MBEDTLS_PRIVATE
+        #define sslHostName( pSsl )    ( ( pSsl )->MBEDTLS_PRIVATE( hostname ) )
+    #else
+        #define sslHostName( pSsl )    ( ( pSsl )->hostname )
+    #endif
+
+/**
+ * @brief A TLS session established by a full handshake.
+ */
+    typedef struct CachedSession
+    {
+        uint8_t key[ SESSION_KEY_LENGTH ]; /**< @brief Digest of the host name, trusted roots and client certificate. */
+        mbedtls_ssl_session session;       /**< @brief Session to offer to the server. */
+        TickType_t savedTicks;             /**< @brief Tick count at which the full handshake ended. */
+        uint32_t handshakeMs;              /**< @brief Time the full handshake took. */
+        BaseType_t inUse;                  /**< @brief Whether the entry holds a session. */
+    } CachedSession_t;
+
+/**
+ * @brief Sessions of earlier connections. Shared by every connection and
+ * accessed with sessionCacheMutex held.
+ */
+    static CachedSession_t cachedSessions[ TLS_TRANSPORT_SESSION_CACHE_ENTRIES ];
+
+/**
+ * @brief Mutex of cachedSessions and sessionCacheSavedMs, created by
+ * TLS_FreeRTOS_InitThreading().
+ */
+    static mbedtls_threading_mutex_t sessionCacheMutex;
+
+/**
+ * @brief Handshake time saved by resumed sessions since boot.
+ */
+    static uint32_t sessionCacheSavedMs = 0U;
+#endif /* ifdef TLS_TRANSPORT_SESSION_CACHE */
+
+/*-----------------------------------------------------------*/
+
+#ifdef TLS_TRANSPORT_LEAN_PROFILE
+
+/**
+ * @brief Ciphersuites offered by the lean profile, in order of preference.
+ */
+    static const int leanCiphersuites[] =
+    {
+        #ifdef MBEDTLS_SSL_PROTO_TLS1_3
+            MBEDTLS_TLS1_3_AES_128_GCM_SHA256,
+        #endif
+        MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+        0
+    };
+
+/**
+ * @brief Signature algorithms offered by the lean profile.
+ */
+    #ifdef MBEDTLS_SSL_PROTO_TLS1_3
+        static const uint16_t leanSignatureAlgorithms[] =
+        {
+            MBEDTLS_TLS1_3_SIG_ECDSA_SECP256R1_SHA256,
+            MBEDTLS_TLS1_3_SIG_NONE
+        };
+    #else
+        static const int leanSignatureHashes[] =
+        {
+            MBEDTLS_MD_SHA256,
+            MBEDTLS_MD_NONE
+        };
+    #endif
+#endif /* ifdef TLS_TRANSPORT_LEAN_PROFILE */
+
+#ifdef MBEDTLS_KEY_EXCHANGE_PSK_ENABLED
+
+/**
+ * @brief Ciphersuites offered with a plain pre-shared key, in order of
+ * preference. They need no public key operation at all.
  */
-#define mbedtlsHighLevelCodeOrDefault( mbedTlsCode )        \
-    ( mbedtls_strerror_highlevel( mbedTlsCode ) != NULL ) ? \
-    mbedtls_strerror_highlevel( mbedTlsCode ) : pNoHighLevelMbedTlsCodeStr
+    static const int pskCiphersuites[] =
+    {
+        MBEDTLS_TLS_PSK_WITH_AES_128_GCM_SHA256,
+        MBEDTLS_TLS_PSK_WITH_AES_128_CBC_SHA256,
+        0
+    };
+#endif
+
+#ifdef MBEDTLS_KEY_EXCHANGE_ECDHE_PSK_ENABLED
 
 /**
- * @brief Utility for converting the level-level code in an mbedTLS error to string,
- * if the code-contains a level-level code; otherwise, using a default string.
+ * @brief Ciphersuites offered with ECDHE-PSK. mbed TLS 2.28 has no GCM
+ * ciphersuite for this key exchange.
  */
-#define mbedtlsLowLevelCodeOrDefault( mbedTlsCode )        \
-    ( mbedtls_strerror_lowlevel( mbedTlsCode ) != NULL ) ? \
-    mbedtls_strerror_lowlevel( mbedTlsCode ) : pNoLowLevelMbedTlsCodeStr
+    static const int ecdhePskCiphersuites[] =
+    {
+        MBEDTLS_TLS_ECDHE_PSK_WITH_AES_128_CBC_SHA256,
+        0
+    };
+#endif
 
 /*-----------------------------------------------------------*/
 
+#ifndef MBEDTLS_ERROR_NUMERIC_ONLY
+
+/**
+ * @brief Utility for converting the high-level code in an mbedTLS error to string,
+ * if the code-contains a high-level code; otherwise, using a default string.
+ *
+ * @param[in] mbedTlsCode The mbedTLS error.
+ *
+ * @return The string. It is looked up once per call.
+ */
+    static const char * mbedtlsHighLevelCodeOrDefault( int32_t mbedTlsCode );
+
+/**
+ * @brief Utility for converting the low-level code in an mbedTLS error to string,
+ * if the code-contains a low-level code; otherwise, using a default string.
+ *
+ * @param[in] mbedTlsCode The mbedTLS error.
+ *
+ * @return The string. It is looked up once per call.
+ */
+    static const char * mbedtlsLowLevelCodeOrDefault( int32_t mbedTlsCode );
+#endif
+
 /**
  * @brief Initialize the mbed TLS structures in a network connection.
  *
@@ -83,6 +322,24 @@ static void sslContextInit( SSLContext_t * pSslContext );
  */
 static void sslContextFree( SSLContext_t * pSslContext );
 
+/**
+ * @brief Parse one or more X509 certificates into a certificate chain.
+ *
+ * DER input is detected by its leading ASN.1 SEQUENCE tag and is parsed in
+ * place without copying or base64 decoding, so the buffer must remain valid
+ * for the lifetime of the chain. Any other input is treated as a
+ * NULL-terminated PEM string, which requires MBEDTLS_PEM_PARSE_C.
+ *
+ * @param[out] pCertChain Certificate chain to which the certificates are added.
+ * @param[in] pCert DER-encoded certificate(s) or PEM-encoded string.
+ * @param[in] certSize Size of the certificate(s).
+ *
+ * @return 0 on success; otherwise, failure;
+ */
+static int32_t parseCertificates( mbedtls_x509_crt * pCertChain,
+                                  const uint8_t * pCert,
+                                  size_t certSize );
+
 /**
  * @brief Add X509 certificate to the trusted list of root certificates.
  *
@@ -91,7 +348,7 @@ static void sslContextFree( SSLContext_t * pSslContext );
  * root certificate.
  *
  * @param[out] pSslContext SSL context to which the trusted server root CA is to be added.
- * @param[in] pRootCa PEM-encoded string of the trusted server root CA.
+ * @param[in] pRootCa PEM-encoded string or DER-encoded blob of the trusted server root CA.
  * @param[in] rootCaSize Size of the trusted server root CA.
  *
  * @return 0 on success; otherwise, failure;
@@ -104,7 +361,7 @@ static int32_t setRootCa( SSLContext_t * pSslContext,
  * @brief Set X509 certificate as client certificate for the server to authenticate.
  *
  * @param[out] pSslContext SSL context to which the client certificate is to be set.
- * @param[in] pClientCert PEM-encoded string of the client certificate.
+ * @param[in] pClientCert PEM-encoded string or DER-encoded blob of the client certificate.
  * @param[in] clientCertSize Size of the client certificate.
  *
  * @return 0 on success; otherwise, failure;
@@ -117,7 +374,7 @@ static int32_t setClientCertificate( SSLContext_t * pSslContext,
  * @brief Set private key for the client's certificate.
  *
  * @param[out] pSslContext SSL context to which the private key is to be set.
- * @param[in] pPrivateKey PEM-encoded string of the client private key.
+ * @param[in] pPrivateKey PEM-encoded string or DER-encoded blob of the client private key.
  * @param[in] privateKeySize Size of the client private key.
  *
  * @return 0 on success; otherwise, failure;
@@ -141,6 +398,18 @@ static int32_t setPrivateKey( SSLContext_t * pSslContext,
 static int32_t setCredentials( SSLContext_t * pSslContext,
                                const NetworkCredentials_t * pNetworkCredentials );
 
+/**
+ * @brief Configure the pre-shared key and limit the offered ciphersuites to
+ * the PSK or ECDHE-PSK ones.
+ *
+ * @param[out] pSslContext SSL context to which the key is to be imported.
+ * @param[in] pNetworkCredentials Credentials with pPsk set.
+ *
+ * @return 0 on success; otherwise, failure;
+ */
+static int32_t setPskCredentials( SSLContext_t * pSslContext,
+                                  const NetworkCredentials_t * pNetworkCredentials );
+
 /**
  * @brief Set optional configurations for the TLS connection.
  *
@@ -154,19 +423,47 @@ static void setOptionalConfigurations( SSLContext_t * pSslContext,
                                        const char * pHostName,
                                        const NetworkCredentials_t * pNetworkCredentials );
 
+#ifdef TLS_TRANSPORT_LEAN_PROFILE
+
+/**
+ * @brief Restrict the handshake to the smallest set of parameters that the
+ * broker needs.
+ *
+ * Offers a single ECDHE-ECDSA AES-128-GCM ciphersuite with SHA-256 signatures
+ * and leaves out the encrypt-then-MAC extension, which AEAD ciphersuites do
+ * not use.
+ *
+ * @param[in] pSslContext SSL context to which the profile is to be applied.
+ */
+    static void setLeanProfile( SSLContext_t * pSslContext );
+#endif
+
 /**
  * @brief Setup TLS by initializing contexts and setting configurations.
  *
  * @param[in] pNetworkContext Network context.
  * @param[in] pHostName Remote host name, used for server name indication.
  * @param[in] pNetworkCredentials TLS setup parameters.
+ * @param[in] transport MBEDTLS_SSL_TRANSPORT_STREAM or MBEDTLS_SSL_TRANSPORT_DATAGRAM.
  *
  * @return #TLS_TRANSPORT_SUCCESS, #TLS_TRANSPORT_INSUFFICIENT_MEMORY, #TLS_TRANSPORT_INVALID_CREDENTIALS,
  * or #TLS_TRANSPORT_INTERNAL_ERROR.
  */
 static TlsTransportStatus_t tlsSetup( NetworkContext_t * pNetworkContext,
                                       const char * pHostName,
-                                      const NetworkCredentials_t * pNetworkCredentials );
+                                      const NetworkCredentials_t * pNetworkCredentials,
+                                      int32_t transport );
+
+/**
+ * @brief Bind the SSL context to its configuration and to the TCP socket.
+ *
+ * @param[in] pNetworkContext Network context.
+ * @param[in] pRecv Function used by mbed TLS to receive from the socket.
+ *
+ * @return #TLS_TRANSPORT_SUCCESS, or #TLS_TRANSPORT_INTERNAL_ERROR.
+ */
+static TlsTransportStatus_t tlsSessionSetup( NetworkContext_t * pNetworkContext,
+                                             mbedtls_ssl_recv_t * pRecv );
 
 /**
  * @brief Perform the TLS handshake on a TCP connection.
@@ -179,6 +476,120 @@ static TlsTransportStatus_t tlsSetup( NetworkContext_t * pNetworkContext,
 static TlsTransportStatus_t tlsHandshake( NetworkContext_t * pNetworkContext,
                                           const NetworkCredentials_t * pNetworkCredentials );
 
+#ifdef TLS_TRANSPORT_HANDSHAKE_PROFILE
+
+/**
+ * @brief Send callback used by mbed TLS while the handshake is profiled.
+ *
+ * @param[in] pContext The network context.
+ * @param[in] pBuffer Buffer containing the bytes to send.
+ * @param[in] bufferLength Number of bytes to send.
+ *
+ * @return Number of bytes sent; else a negative value.
+ */
+    static int profileSend( void * pContext,
+                            const unsigned char * pBuffer,
+                            size_t bufferLength );
+
+/**
+ * @brief Receive callback used by mbed TLS while the handshake is profiled.
+ *
+ * @param[in] pContext The network context.
+ * @param[out] pBuffer Buffer to receive bytes into.
+ * @param[in] bufferLength Number of bytes to receive.
+ *
+ * @return Number of bytes received; else 0 or a negative value.
+ */
+    static int profileRecv( void * pContext,
+                            unsigned char * pBuffer,
+                            size_t bufferLength );
+
+/**
+ * @brief Run the handshake one state at a time, recording each state in the
+ * handshake profile.
+ *
+ * @param[in] pNetworkContext Network context.
+ *
+ * @return The return value of the last mbedtls_ssl_handshake_step call.
+ */
+    static int32_t profileHandshake( NetworkContext_t * pNetworkContext );
+
+/**
+ * @brief Log the handshake profile by flight.
+ *
+ * A flight is a run of states that send, or a run of states that receive.
+ * States without traffic count to the flight in which they run.
+ *
+ * @param[in] pNetworkContext Network context.
+ */
+    static void logHandshakeFlights( const NetworkContext_t * pNetworkContext );
+
+/**
+ * @brief Log the handshake profile of a network context.
+ *
+ * @param[in] pNetworkContext Network context.
+ */
+    static void logHandshakeProfile( const NetworkContext_t * pNetworkContext );
+#endif /* ifdef TLS_TRANSPORT_HANDSHAKE_PROFILE */
+
+/**
+ * @brief Write out the gather buffer of TLS_FreeRTOS_writev().
+ *
+ * @param[in] pNetworkContext The network context.
+ * @param[in] bufferedBytes Number of bytes in the gather buffer.
+ * @param[in,out] pBytesSent Running count of bytes sent, updated with the bytes
+ * written.
+ *
+ * @return The return value of TLS_FreeRTOS_send().
+ */
+static int32_t writevFlush( NetworkContext_t * pNetworkContext,
+                            size_t bufferedBytes,
+                            int32_t * pBytesSent );
+
+/**
+ * @brief Receive callback used by mbed TLS during a non-blocking handshake.
+ *
+ * Reports an empty socket as MBEDTLS_ERR_SSL_WANT_READ so that the handshake
+ * returns to the caller instead of treating it as end of stream.
+ *
+ * @param[in] pContext The socket handle.
+ * @param[out] pBuffer Buffer to receive bytes into.
+ * @param[in] bufferLength Number of bytes to receive.
+ *
+ * @return Number of bytes received, MBEDTLS_ERR_SSL_WANT_READ, or a negative
+ * value on error.
+ */
+static int recvNonBlocking( void * pContext,
+                            unsigned char * pBuffer,
+                            size_t bufferLength );
+
+/**
+ * @brief Connect the TCP socket and prepare the TLS contexts for a handshake.
+ *
+ * @param[out] pNetworkContext Network context.
+ * @param[in] pHostName The hostname of the remote endpoint.
+ * @param[in] port The destination port.
+ * @param[in] pNetworkCredentials Credentials for the TLS connection.
+ * @param[in] receiveTimeoutMs Receive socket timeout.
+ * @param[in] sendTimeoutMs Send socket timeout.
+ *
+ * @return #TLS_TRANSPORT_SUCCESS, #TLS_TRANSPORT_INVALID_PARAMETER, #TLS_TRANSPORT_INSUFFICIENT_MEMORY,
+ * #TLS_TRANSPORT_INVALID_CREDENTIALS, #TLS_TRANSPORT_INTERNAL_ERROR, or #TLS_TRANSPORT_CONNECT_FAILURE.
+ */
+static TlsTransportStatus_t tlsConnect( NetworkContext_t * pNetworkContext,
+                                        const char * pHostName,
+                                        uint16_t port,
+                                        const NetworkCredentials_t * pNetworkCredentials,
+                                        uint32_t receiveTimeoutMs,
+                                        uint32_t sendTimeoutMs );
+
+/**
+ * @brief Free the TLS contexts and close the socket of a failed connection.
+ *
+ * @param[in] pNetworkContext Network context.
+ */
+static void tlsCleanup( NetworkContext_t * pNetworkContext );
+
 /**
  * @brief Initialize mbedTLS.
  *
@@ -190,7 +601,65 @@ static TlsTransportStatus_t tlsHandshake( NetworkContext_t * pNetworkContext,
 static TlsTransportStatus_t initMbedtls( mbedtls_entropy_context * pEntropyContext,
                                          mbedtls_ctr_drbg_context * pCtrDrgbContext );
 
+#ifdef TLS_TRANSPORT_SESSION_CACHE
+
+/**
+ * @brief Compute the digest that identifies the credentials of a session.
+ *
+ * It covers the host name set on the SSL context, the DER of every trusted
+ * root and the DER of the client certificate, so a session is only offered
+ * to a server that authenticated against the same credentials.
+ *
+ * @param[in] pSslContext SSL context with its credentials set.
+ * @param[out] pKey Buffer of #SESSION_KEY_LENGTH bytes.
+ *
+ * @return 0 on success; otherwise, failure;
+ */
+    static int32_t sessionKey( const SSLContext_t * pSslContext,
+                               uint8_t * pKey );
+
+/**
+ * @brief Offer the unexpired session of an earlier connection with the same
+ * credentials, and start timing the handshake.
+ *
+ * The server decides whether to resume it. A server that does not runs a full
+ * handshake, in which mbed TLS verifies the chain as usual.
+ *
+ * @param[in] pSslContext SSL context after mbedtls_ssl_setup().
+ */
+    static void sessionCacheOffer( SSLContext_t * pSslContext );
+
+/**
+ * @brief Account for a successful handshake: log the time saved when a
+ * session was offered, or else remember the new session.
+ *
+ * An offered session keeps its entry and expiry, so that a chain is verified
+ * again at least every #TLS_TRANSPORT_SESSION_CACHE_TTL_MS.
+ *
+ * @param[in] pSslContext SSL context whose handshake is over.
+ */
+    static void sessionCacheUpdate( SSLContext_t * pSslContext );
+#endif /* ifdef TLS_TRANSPORT_SESSION_CACHE */
+
+/*-----------------------------------------------------------*/
+
+#ifndef MBEDTLS_ERROR_NUMERIC_ONLY
+    static const char * mbedtlsHighLevelCodeOrDefault( int32_t mbedTlsCode )
+    {
+        const char * pString = mbedtls_strerror_highlevel( mbedTlsCode );
+
+        return ( pString != NULL ) ? pString : pNoHighLevelMbedTlsCodeStr;
+    }
+/*-----------------------------------------------------------*/
+
+    static const char * mbedtlsLowLevelCodeOrDefault( int32_t mbedTlsCode )
+    {
+        const char * pString = mbedtls_strerror_lowlevel( mbedTlsCode );
+
+        return ( pString != NULL ) ? pString : pNoLowLevelMbedTlsCodeStr;
+    }
 /*-----------------------------------------------------------*/
+#endif /* ifndef MBEDTLS_ERROR_NUMERIC_ONLY */
 
 static void sslContextInit( SSLContext_t * pSslContext )
 {
@@ -201,6 +670,11 @@ static void sslContextInit( SSLContext_t * pSslContext )
     mbedtls_pk_init( &( pSslContext->privKey ) );
     mbedtls_x509_crt_init( &( pSslContext->clientCert ) );
     mbedtls_ssl_init( &( pSslContext->context ) );
+    pSslContext->pskMode = pdFALSE;
+
+    #ifdef TLS_TRANSPORT_SESSION_CACHE
+        pSslContext->sessionOffered = pdFALSE;
+    #endif
 }
 /*-----------------------------------------------------------*/
 
@@ -218,6 +692,66 @@ static void sslContextFree( SSLContext_t * pSslContext )
 }
 /*-----------------------------------------------------------*/
 
+static int32_t parseCertificates( mbedtls_x509_crt * pCertChain,
+                                  const uint8_t * pCert,
+                                  size_t certSize )
+{
+    int32_t mbedtlsError = -1;
+    unsigned char * pNext = ( unsigned char * ) pCert;
+    const unsigned char * pEnd = pCert + certSize;
+    const unsigned char * pCertStart = NULL;
+    size_t derLength = 0;
+
+    configASSERT( pCertChain != NULL );
+    configASSERT( pCert != NULL );
+
+    if( ( certSize > 0U ) &&
+        ( pCert[ 0 ] == ( MBEDTLS_ASN1_CONSTRUCTED | MBEDTLS_ASN1_SEQUENCE ) ) )
+    {
+        /* DER input may hold a chain of concatenated certificates. Each one is
+         * referenced in place rather than copied into the heap. Trailing
+         * bytes that are not a certificate, such as a NULL terminator, are
+         * ignored. */
+        while( ( pNext < pEnd ) &&
+               ( *pNext == ( MBEDTLS_ASN1_CONSTRUCTED | MBEDTLS_ASN1_SEQUENCE ) ) )
+        {
+            pCertStart = pNext;
+            mbedtlsError = mbedtls_asn1_get_tag( &pNext,
+                                                 pEnd,
+                                                 &derLength,
+                                                 MBEDTLS_ASN1_CONSTRUCTED | MBEDTLS_ASN1_SEQUENCE );
+
+            if( mbedtlsError == 0 )
+            {
+                pNext += derLength;
+                mbedtlsError = mbedtls_x509_crt_parse_der_nocopy( pCertChain,
+                                                                  pCertStart,
+                                                                  ( size_t ) ( pNext - pCertStart ) );
+            }
+
+            if( mbedtlsError != 0 )
+            {
+                break;
+            }
+        }
+    }
+    else
+    {
+        #ifdef MBEDTLS_PEM_PARSE_C
+            mbedtlsError = mbedtls_x509_crt_parse( pCertChain,
+                                                   pCert,
+                                                   certSize );
+        #else
+            LogError( ( "PEM certificate supplied but MBEDTLS_PEM_PARSE_C is disabled. "
+                        "Convert the certificate to DER." ) );
+            mbedtlsError = MBEDTLS_ERR_X509_FEATURE_UNAVAILABLE;
+        #endif
+    }
+
+    return mbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
 static int32_t setRootCa( SSLContext_t * pSslContext,
                           const uint8_t * pRootCa,
                           size_t rootCaSize )
@@ -228,15 +762,14 @@ static int32_t setRootCa( SSLContext_t * pSslContext,
     configASSERT( pRootCa != NULL );
 
     /* Parse the server root CA certificate into the SSL context. */
-    mbedtlsError = mbedtls_x509_crt_parse( &( pSslContext->rootCa ),
-                                           pRootCa,
-                                           rootCaSize );
+    mbedtlsError = parseCertificates( &( pSslContext->rootCa ),
+                                      pRootCa,
+                                      rootCaSize );
 
     if( mbedtlsError != 0 )
     {
-        LogError( ( "Failed to parse server root CA certificate: mbedTLSError= %s : %s.",
-                    mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
-                    mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
+        LogError( ( "Failed to parse server root CA certificate: mbedTLSError= "TLS_ERROR_FORMAT ".",
+                    tlsErrorArgs( mbedtlsError ) ) );
     }
     else
     {
@@ -259,17 +792,27 @@ static int32_t setClientCertificate( SSLContext_t * pSslContext,
     configASSERT( pClientCert != NULL );
 
     /* Setup the client certificate. */
-    mbedtlsError = mbedtls_x509_crt_parse( &( pSslContext->clientCert ),
-                                           pClientCert,
-                                           clientCertSize );
+    mbedtlsError = parseCertificates( &( pSslContext->clientCert ),
+                                      pClientCert,
+                                      clientCertSize );
 
     if( mbedtlsError != 0 )
     {
-        LogError( ( "Failed to parse the client certificate: mbedTLSError= %s : %s.",
-                    mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
-                    mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
+        LogError( ( "Failed to parse the client certificate: mbedTLSError= "TLS_ERROR_FORMAT ".",
+                    tlsErrorArgs( mbedtlsError ) ) );
     }
 
+    #ifdef TLS_TRANSPORT_LEAN_PROFILE
+        /* Send only the leaf certificate. The broker must already hold the CA
+         * that issued it, so intermediates would only add to the handshake. */
+        if( ( mbedtlsError == 0 ) && ( pSslContext->clientCert.next != NULL ) )
+        {
+            mbedtls_x509_crt_free( pSslContext->clientCert.next );
+            mbedtls_free( pSslContext->clientCert.next );
+            pSslContext->clientCert.next = NULL;
+        }
+    #endif
+
     return mbedtlsError;
 }
 /*-----------------------------------------------------------*/
@@ -283,18 +826,29 @@ static int32_t setPrivateKey( SSLContext_t * pSslContext,
     configASSERT( pSslContext != NULL );
     configASSERT( pPrivateKeyPath != NULL );
 
-    /* Setup the client private key. */
-    mbedtlsError = mbedtls_pk_parse_key( &( pSslContext->privKey ),
-                                         pPrivateKeyPath,
-                                         privateKeySize,
-                                         NULL,
-                                         0 );
+    /* Setup the client private key. mbed TLS detects DER keys on its own, and
+     * only attempts PEM decoding for NULL-terminated input. mbed TLS 3.x also
+     * takes the RNG, which was seeded by initMbedtls(), for key blinding. */
+    #if MBEDTLS_VERSION_MAJOR >= 3
+        mbedtlsError = mbedtls_pk_parse_key( &( pSslContext->privKey ),
+                                             pPrivateKeyPath,
+                                             privateKeySize,
+                                             NULL,
+                                             0,
+                                             mbedtls_ctr_drbg_random,
+                                             &( pSslContext->ctrDrgbContext ) );
+    #else
+        mbedtlsError = mbedtls_pk_parse_key( &( pSslContext->privKey ),
+                                             pPrivateKeyPath,
+                                             privateKeySize,
+                                             NULL,
+                                             0 );
+    #endif
 
     if( mbedtlsError != 0 )
     {
-        LogError( ( "Failed to parse the client key: mbedTLSError= %s : %s.",
-                    mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
-                    mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
+        LogError( ( "Failed to parse the client key: mbedTLSError= "TLS_ERROR_FORMAT ".",
+                    tlsErrorArgs( mbedtlsError ) ) );
     }
 
     return mbedtlsError;
@@ -321,11 +875,21 @@ static int32_t setCredentials( SSLContext_t * pSslContext,
     mbedtls_ssl_conf_cert_profile( &( pSslContext->config ),
                                    &( pSslContext->certProfile ) );
 
-    mbedtlsError = setRootCa( pSslContext,
-                              pNetworkCredentials->pRootCa,
-                              pNetworkCredentials->rootCaSize );
+    if( pNetworkCredentials->pPsk != NULL )
+    {
+        /* No certificate is parsed in this mode. */
+        pSslContext->pskMode = pdTRUE;
+        mbedtlsError = setPskCredentials( pSslContext, pNetworkCredentials );
+    }
+    else
+    {
+        mbedtlsError = setRootCa( pSslContext,
+                                  pNetworkCredentials->pRootCa,
+                                  pNetworkCredentials->rootCaSize );
+    }
 
-    if( ( pNetworkCredentials->pClientCert != NULL ) &&
+    if( ( pSslContext->pskMode == pdFALSE ) &&
+        ( pNetworkCredentials->pClientCert != NULL ) &&
         ( pNetworkCredentials->pPrivateKey != NULL ) )
     {
         if( mbedtlsError == 0 )
@@ -354,6 +918,73 @@ static int32_t setCredentials( SSLContext_t * pSslContext,
 }
 /*-----------------------------------------------------------*/
 
+static int32_t setPskCredentials( SSLContext_t * pSslContext,
+                                  const NetworkCredentials_t * pNetworkCredentials )
+{
+    int32_t mbedtlsError = MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    const int * pCiphersuites = NULL;
+
+    configASSERT( pSslContext != NULL );
+    configASSERT( pNetworkCredentials != NULL );
+
+    #ifdef MBEDTLS_KEY_EXCHANGE_ECDHE_PSK_ENABLED
+        if( pNetworkCredentials->pskEcdhe != pdFALSE )
+        {
+            pCiphersuites = ecdhePskCiphersuites;
+        }
+    #endif
+
+    #ifdef MBEDTLS_KEY_EXCHANGE_PSK_ENABLED
+        if( pNetworkCredentials->pskEcdhe == pdFALSE )
+        {
+            pCiphersuites = pskCiphersuites;
+        }
+    #endif
+
+    if( pCiphersuites == NULL )
+    {
+        LogError( ( "The %s key exchange is not enabled in mbedtls_config.h.",
+                    ( pNetworkCredentials->pskEcdhe != pdFALSE ) ? "ECDHE-PSK" : "PSK" ) );
+    }
+    else if( ( pNetworkCredentials->pskSize == 0U ) ||
+             ( pNetworkCredentials->pPskIdentity == NULL ) ||
+             ( pNetworkCredentials->pskIdentitySize == 0U ) )
+    {
+        LogError( ( "A pre-shared key needs a non-empty key and identity." ) );
+    }
+    else
+    {
+        #ifdef MBEDTLS_KEY_EXCHANGE_SOME_PSK_ENABLED
+            mbedtlsError = mbedtls_ssl_conf_psk( &( pSslContext->config ),
+                                                 pNetworkCredentials->pPsk,
+                                                 pNetworkCredentials->pskSize,
+                                                 pNetworkCredentials->pPskIdentity,
+                                                 pNetworkCredentials->pskIdentitySize );
+        #endif
+
+        if( mbedtlsError != 0 )
+        {
+            LogError( ( "Failed to set the pre-shared key: mbedTLSError= "TLS_ERROR_FORMAT ".",
+                        tlsErrorArgs( mbedtlsError ) ) );
+        }
+        else
+        {
+            /* Replaces any list set by the lean profile. */
+            mbedtls_ssl_conf_ciphersuites( &( pSslContext->config ),
+                                           pCiphersuites );
+
+            /* The ciphersuites above are TLS 1.2 only. */
+            #ifdef MBEDTLS_SSL_PROTO_TLS1_3
+                mbedtls_ssl_conf_max_tls_version( &( pSslContext->config ),
+                                                  MBEDTLS_SSL_VERSION_TLS1_2 );
+            #endif
+        }
+    }
+
+    return mbedtlsError;
+}
+/*-----------------------------------------------------------*/
+
 static void setOptionalConfigurations( SSLContext_t * pSslContext,
                                        const char * pHostName,
                                        const NetworkCredentials_t * pNetworkCredentials )
@@ -373,9 +1004,8 @@ static void setOptionalConfigurations( SSLContext_t * pSslContext,
 
         if( mbedtlsError != 0 )
         {
-            LogError( ( "Failed to configure ALPN protocol in mbed TLS: mbedTLSError= %s : %s.",
-                        mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
-                        mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
+            LogError( ( "Failed to configure ALPN protocol in mbed TLS: mbedTLSError= "TLS_ERROR_FORMAT ".",
+                        tlsErrorArgs( mbedtlsError ) ) );
         }
     }
 
@@ -387,9 +1017,8 @@ static void setOptionalConfigurations( SSLContext_t * pSslContext,
 
         if( mbedtlsError != 0 )
         {
-            LogError( ( "Failed to set server name: mbedTLSError= %s : %s.",
-                        mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
-                        mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
+            LogError( ( "Failed to set server name: mbedTLSError= "TLS_ERROR_FORMAT ".",
+                        tlsErrorArgs( mbedtlsError ) ) );
         }
     }
 
@@ -401,48 +1030,94 @@ static void setOptionalConfigurations( SSLContext_t * pSslContext,
          *
          * Smaller values can be found in "mbedtls/include/ssl.h".
          */
-        mbedtlsError = mbedtls_ssl_conf_max_frag_len( &( pSslContext->config ), MBEDTLS_SSL_MAX_FRAG_LEN_4096 );
+        mbedtlsError = mbedtls_ssl_conf_max_frag_len( &( pSslContext->config ),
+                                                      ( pNetworkCredentials->maxFragmentLength != MBEDTLS_SSL_MAX_FRAG_LEN_NONE ) ?
+                                                      pNetworkCredentials->maxFragmentLength : DEFAULT_MAX_FRAGMENT_LENGTH );
 
         if( mbedtlsError != 0 )
         {
-            LogError( ( "Failed to maximum fragment length extension: mbedTLSError= %s : %s.",
-                        mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
-                        mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
+            LogError( ( "Failed to maximum fragment length extension: mbedTLSError= "TLS_ERROR_FORMAT ".",
+                        tlsErrorArgs( mbedtlsError ) ) );
         }
     #endif /* ifdef MBEDTLS_SSL_MAX_FRAGMENT_LENGTH */
 }
 /*-----------------------------------------------------------*/
 
-static TlsTransportStatus_t tlsSetup( NetworkContext_t * pNetworkContext,
-                                      const char * pHostName,
-                                      const NetworkCredentials_t * pNetworkCredentials )
-{
+#ifdef TLS_TRANSPORT_LEAN_PROFILE
+    static void setLeanProfile( SSLContext_t * pSslContext )
+    {
+        configASSERT( pSslContext != NULL );
+
+        mbedtls_ssl_conf_ciphersuites( &( pSslContext->config ),
+                                       leanCiphersuites );
+
+        #ifdef MBEDTLS_SSL_PROTO_TLS1_3
+            mbedtls_ssl_conf_sig_algs( &( pSslContext->config ),
+                                       leanSignatureAlgorithms );
+        #else
+            mbedtls_ssl_conf_sig_hashes( &( pSslContext->config ),
+                                         leanSignatureHashes );
+        #endif
+
+        #ifdef MBEDTLS_SSL_ENCRYPT_THEN_MAC
+            mbedtls_ssl_conf_encrypt_then_mac( &( pSslContext->config ),
+                                               MBEDTLS_SSL_ETM_DISABLED );
+        #endif
+    }
+/*-----------------------------------------------------------*/
+#endif /* ifdef TLS_TRANSPORT_LEAN_PROFILE */
+
+static TlsTransportStatus_t tlsSetup( NetworkContext_t * pNetworkContext,
+                                      const char * pHostName,
+                                      const NetworkCredentials_t * pNetworkCredentials,
+                                      int32_t transport )
+{
     TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
     int32_t mbedtlsError = 0;
 
     configASSERT( pNetworkContext != NULL );
     configASSERT( pHostName != NULL );
     configASSERT( pNetworkCredentials != NULL );
-    configASSERT( pNetworkCredentials->pRootCa != NULL );
+    configASSERT( ( pNetworkCredentials->pRootCa != NULL ) ||
+                  ( pNetworkCredentials->pPsk != NULL ) );
 
     /* Initialize the mbed TLS context structures. */
     sslContextInit( &( pNetworkContext->sslContext ) );
 
     mbedtlsError = mbedtls_ssl_config_defaults( &( pNetworkContext->sslContext.config ),
                                                 MBEDTLS_SSL_IS_CLIENT,
-                                                MBEDTLS_SSL_TRANSPORT_STREAM,
+                                                transport,
                                                 MBEDTLS_SSL_PRESET_DEFAULT );
 
     if( mbedtlsError != 0 )
     {
-        LogError( ( "Failed to set default SSL configuration: mbedTLSError= %s : %s.",
-                    mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
-                    mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
+        LogError( ( "Failed to set default SSL configuration: mbedTLSError= "TLS_ERROR_FORMAT ".",
+                    tlsErrorArgs( mbedtlsError ) ) );
 
         /* Per mbed TLS docs, mbedtls_ssl_config_defaults only fails on memory allocation. */
         returnStatus = TLS_TRANSPORT_INSUFFICIENT_MEMORY;
     }
 
+    #ifdef MBEDTLS_SSL_PROTO_TLS1_3
+        if( ( returnStatus == TLS_TRANSPORT_SUCCESS ) &&
+            ( transport == MBEDTLS_SSL_TRANSPORT_STREAM ) )
+        {
+            /* Offer TLS 1.3, which sends application data one round-trip
+             * earlier, while still accepting servers that select TLS 1.2. */
+            mbedtls_ssl_conf_min_tls_version( &( pNetworkContext->sslContext.config ),
+                                              MBEDTLS_SSL_VERSION_TLS1_2 );
+            mbedtls_ssl_conf_max_tls_version( &( pNetworkContext->sslContext.config ),
+                                              MBEDTLS_SSL_VERSION_TLS1_3 );
+        }
+    #endif /* ifdef MBEDTLS_SSL_PROTO_TLS1_3 */
+
+    #ifdef TLS_TRANSPORT_LEAN_PROFILE
+        if( returnStatus == TLS_TRANSPORT_SUCCESS )
+        {
+            setLeanProfile( &( pNetworkContext->sslContext ) );
+        }
+    #endif
+
     if( returnStatus == TLS_TRANSPORT_SUCCESS )
     {
         mbedtlsError = setCredentials( &( pNetworkContext->sslContext ),
@@ -465,14 +1140,14 @@ static TlsTransportStatus_t tlsSetup( NetworkContext_t * pNetworkContext,
 }
 /*-----------------------------------------------------------*/
 
-static TlsTransportStatus_t tlsHandshake( NetworkContext_t * pNetworkContext,
-                                          const NetworkCredentials_t * pNetworkCredentials )
+static TlsTransportStatus_t tlsSessionSetup( NetworkContext_t * pNetworkContext,
+                                             mbedtls_ssl_recv_t * pRecv )
 {
     TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
     int32_t mbedtlsError = 0;
 
     configASSERT( pNetworkContext != NULL );
-    configASSERT( pNetworkCredentials != NULL );
+    configASSERT( pRecv != NULL );
 
     /* Initialize the mbed TLS secured connection context. */
     mbedtlsError = mbedtls_ssl_setup( &( pNetworkContext->sslContext.context ),
@@ -480,9 +1155,8 @@ static TlsTransportStatus_t tlsHandshake( NetworkContext_t * pNetworkContext,
 
     if( mbedtlsError != 0 )
     {
-        LogError( ( "Failed to set up mbed TLS SSL context: mbedTLSError= %s : %s.",
-                    mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
-                    mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
+        LogError( ( "Failed to set up mbed TLS SSL context: mbedTLSError= "TLS_ERROR_FORMAT ".",
+                    tlsErrorArgs( mbedtlsError ) ) );
 
         returnStatus = TLS_TRANSPORT_INTERNAL_ERROR;
     }
@@ -498,31 +1172,95 @@ static TlsTransportStatus_t tlsHandshake( NetworkContext_t * pNetworkContext,
         mbedtls_ssl_set_bio( &( pNetworkContext->sslContext.context ),
                              ( void * ) pNetworkContext->tcpSocket,
                              mbedtls_platform_send,
-                             mbedtls_platform_recv,
+                             pRecv,
                              NULL );
+
+        #ifdef TLS_TRANSPORT_SESSION_CACHE
+            sessionCacheOffer( &( pNetworkContext->sslContext ) );
+        #endif
     }
 
+    return returnStatus;
+}
+/*-----------------------------------------------------------*/
+
+static TlsTransportStatus_t tlsHandshake( NetworkContext_t * pNetworkContext,
+                                          const NetworkCredentials_t * pNetworkCredentials )
+{
+    TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
+    int32_t mbedtlsError = 0;
+    TickType_t handshakeStartTicks = 0;
+
+    configASSERT( pNetworkContext != NULL );
+    configASSERT( pNetworkCredentials != NULL );
+
+    returnStatus = tlsSessionSetup( pNetworkContext, mbedtls_platform_recv );
+
+    #ifdef TLS_TRANSPORT_HANDSHAKE_PROFILE
+        if( returnStatus == TLS_TRANSPORT_SUCCESS )
+        {
+            /* Route the handshake traffic through the profiling callbacks. */
+            mbedtls_ssl_set_bio( &( pNetworkContext->sslContext.context ),
+                                 ( void * ) pNetworkContext,
+                                 profileSend,
+                                 profileRecv,
+                                 NULL );
+        }
+    #endif
+
     if( returnStatus == TLS_TRANSPORT_SUCCESS )
     {
         /* Perform the TLS handshake. */
+        handshakeStartTicks = xTaskGetTickCount();
+
         do
         {
-            mbedtlsError = mbedtls_ssl_handshake( &( pNetworkContext->sslContext.context ) );
+            #ifdef TLS_TRANSPORT_HANDSHAKE_PROFILE
+                mbedtlsError = profileHandshake( pNetworkContext );
+            #else
+                mbedtlsError = mbedtls_ssl_handshake( &( pNetworkContext->sslContext.context ) );
+            #endif
+
+            /* Let other tasks run between slices of an ECC operation. */
+            if( eccInProgress( mbedtlsError ) )
+            {
+                taskYIELD();
+            }
         } while( ( mbedtlsError == MBEDTLS_ERR_SSL_WANT_READ ) ||
-                 ( mbedtlsError == MBEDTLS_ERR_SSL_WANT_WRITE ) );
+                 ( mbedtlsError == MBEDTLS_ERR_SSL_WANT_WRITE ) ||
+                 eccInProgress( mbedtlsError ) );
+
+        #ifdef TLS_TRANSPORT_HANDSHAKE_PROFILE
+            pNetworkContext->handshakeProfile.handshakeMs = ticksToMs( xTaskGetTickCount() - handshakeStartTicks );
+            pNetworkContext->handshakeProfile.cpuMs = pNetworkContext->handshakeProfile.handshakeMs -
+                                                      pNetworkContext->handshakeProfile.ioMs;
+            logHandshakeProfile( pNetworkContext );
+
+            /* Application data does not need to be profiled. */
+            mbedtls_ssl_set_bio( &( pNetworkContext->sslContext.context ),
+                                 ( void * ) pNetworkContext->tcpSocket,
+                                 mbedtls_platform_send,
+                                 mbedtls_platform_recv,
+                                 NULL );
+        #endif
 
         if( mbedtlsError != 0 )
         {
-            LogError( ( "Failed to perform TLS handshake: mbedTLSError= %s : %s.",
-                        mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
-                        mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
+            LogError( ( "Failed to perform TLS handshake: mbedTLSError= "TLS_ERROR_FORMAT ".",
+                        tlsErrorArgs( mbedtlsError ) ) );
 
             returnStatus = TLS_TRANSPORT_HANDSHAKE_FAILED;
         }
         else
         {
-            LogInfo( ( "(Network connection %p) TLS handshake successful.",
-                       pNetworkContext ) );
+            LogInfo( ( "(Network connection %p) %s handshake successful in %u ms.",
+                       pNetworkContext,
+                       mbedtls_ssl_get_version( &( pNetworkContext->sslContext.context ) ),
+                       ( unsigned int ) ticksToMs( xTaskGetTickCount() - handshakeStartTicks ) ) );
+
+            #ifdef TLS_TRANSPORT_SESSION_CACHE
+                sessionCacheUpdate( &( pNetworkContext->sslContext ) );
+            #endif
         }
     }
 
@@ -530,35 +1268,76 @@ static TlsTransportStatus_t tlsHandshake( NetworkContext_t * pNetworkContext,
 }
 /*-----------------------------------------------------------*/
 
+void TLS_FreeRTOS_InitThreading( void )
+{
+    /* Suspend the scheduler so that two tasks connecting at the same time
+     * cannot both set the functions. Creating the static mutexes does not
+     * block, so it is allowed while the scheduler is suspended. */
+    vTaskSuspendAll();
+    {
+        if( threadingInitialized == pdFALSE )
+        {
+            mbedtls_threading_set_alt( mbedtls_platform_mutex_init,
+                                       mbedtls_platform_mutex_free,
+                                       mbedtls_platform_mutex_lock,
+                                       mbedtls_platform_mutex_unlock );
+
+            #ifdef TLS_TRANSPORT_SESSION_CACHE
+                mbedtls_platform_mutex_init( &sessionCacheMutex );
+            #endif
+            threadingInitialized = pdTRUE;
+        }
+    }
+    ( void ) xTaskResumeAll();
+}
+/*-----------------------------------------------------------*/
+
 static TlsTransportStatus_t initMbedtls( mbedtls_entropy_context * pEntropyContext,
                                          mbedtls_ctr_drbg_context * pCtrDrgbContext )
 {
     TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
     int32_t mbedtlsError = 0;
 
-    /* Set the mutex functions for mbed TLS thread safety. */
-    mbedtls_threading_set_alt( mbedtls_platform_mutex_init,
-                               mbedtls_platform_mutex_free,
-                               mbedtls_platform_mutex_lock,
-                               mbedtls_platform_mutex_unlock );
+    /* Set the mutex functions for mbed TLS thread safety. Everything else
+     * initialized here belongs to this connection. */
+    TLS_FreeRTOS_InitThreading();
 
-    /* Initialize contexts for random number generation. */
+    #ifdef MBEDTLS_ECP_RESTARTABLE
+        /* Split ECC operations into slices. The limit is global to mbed TLS,
+         * and every connection sets the same value. */
+        mbedtls_ecp_set_max_ops( TLS_TRANSPORT_ECP_MAX_OPS );
+    #endif
+
+    /* Initialize contexts for random number generation. They are freed with
+     * the connection, so they are initialized even if a later step fails. */
     mbedtls_entropy_init( pEntropyContext );
     mbedtls_ctr_drbg_init( pCtrDrgbContext );
 
-    /* Add a strong entropy source. At least one is required. */
-    mbedtlsError = mbedtls_entropy_add_source( pEntropyContext,
-                                               mbedtls_platform_entropy_poll,
-                                               NULL,
-                                               32,
-                                               MBEDTLS_ENTROPY_SOURCE_STRONG );
+    #ifdef MBEDTLS_PSA_CRYPTO_C
+        /* The TLS 1.3 key schedule of mbed TLS 3.x runs on PSA crypto. The call
+         * is idempotent, so it is safe to make on every connect. */
+        if( psa_crypto_init() != PSA_SUCCESS )
+        {
+            LogError( ( "Failed to initialize PSA crypto." ) );
+            returnStatus = TLS_TRANSPORT_INTERNAL_ERROR;
+        }
+    #endif
 
-    if( mbedtlsError != 0 )
+    if( returnStatus == TLS_TRANSPORT_SUCCESS )
     {
-        LogError( ( "Failed to add entropy source: mbedTLSError= %s : %s.",
-                    mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
-                    mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
-        returnStatus = TLS_TRANSPORT_INTERNAL_ERROR;
+        /* Add a strong entropy source. At least one is required. */
+        mbedtlsError = mbedtls_entropy_add_source( pEntropyContext,
+                                                   mbedtls_platform_entropy_poll,
+                                                   NULL,
+                                                   32,
+                                                   MBEDTLS_ENTROPY_SOURCE_STRONG );
+
+        if( mbedtlsError != 0 )
+        {
+            LogError( ( "Failed to add entropy source: mbedTLSError= "TLS_ERROR_FORMAT ".",
+                        tlsErrorArgs( mbedtlsError ) ) );
+            returnStatus = TLS_TRANSPORT_INTERNAL_ERROR;
+        }
     }
 
     if( returnStatus == TLS_TRANSPORT_SUCCESS )
@@ -572,9 +1351,8 @@ static TlsTransportStatus_t initMbedtls( mbedtls_entropy_context * pEntropyConte
 
         if( mbedtlsError != 0 )
         {
-            LogError( ( "Failed to seed PRNG: mbedTLSError= %s : %s.",
-                        mbedtlsHighLevelCodeOrDefault( mbedtlsError ),
-                        mbedtlsLowLevelCodeOrDefault( mbedtlsError ) ) );
+            LogError( ( "Failed to seed PRNG: mbedTLSError= "TLS_ERROR_FORMAT ".",
+                        tlsErrorArgs( mbedtlsError ) ) );
             returnStatus = TLS_TRANSPORT_INTERNAL_ERROR;
         }
     }
@@ -588,15 +1366,472 @@ static TlsTransportStatus_t initMbedtls( mbedtls_entropy_context * pEntropyConte
 }
 /*-----------------------------------------------------------*/
 
-TlsTransportStatus_t TLS_FreeRTOS_Connect( NetworkContext_t * pNetworkContext,
-                                           const char * pHostName,
-                                           uint16_t port,
-                                           const NetworkCredentials_t * pNetworkCredentials,
-                                           uint32_t receiveTimeoutMs,
-                                           uint32_t sendTimeoutMs )
+#ifdef TLS_TRANSPORT_SESSION_CACHE
+    static int32_t sessionKey( const SSLContext_t * pSslContext,
+                               uint8_t * pKey )
+    {
+        int32_t mbedtlsError = 0;
+        mbedtls_md_context_t mdContext;
+        const mbedtls_x509_crt * pCert = NULL;
+        const char * pHostName = NULL;
+
+        /* A zero byte, which cannot start a DER certificate, ends the host
+         * name and separates the trusted roots from the client certificate. */
+        static const uint8_t separator = 0U;
+
+        configASSERT( pSslContext != NULL );
+        configASSERT( pKey != NULL );
+
+        pHostName = sslHostName( &( pSslContext->context ) );
+
+        mbedtls_md_init( &mdContext );
+
+        mbedtlsError = mbedtls_md_setup( &mdContext,
+                                         mbedtls_md_info_from_type( MBEDTLS_MD_SHA256 ),
+                                         0 );
+
+        if( mbedtlsError == 0 )
+        {
+            mbedtlsError = mbedtls_md_starts( &mdContext );
+        }
+
+        if( ( mbedtlsError == 0 ) && ( pHostName != NULL ) )
+        {
+            mbedtlsError = mbedtls_md_update( &mdContext,
+                                              ( const unsigned char * ) pHostName,
+                                              strlen( pHostName ) );
+        }
+
+        if( mbedtlsError == 0 )
+        {
+            mbedtlsError = mbedtls_md_update( &mdContext, &separator, 1U );
+        }
+
+        for( pCert = &( pSslContext->rootCa );
+             ( mbedtlsError == 0 ) && ( pCert != NULL );
+             pCert = pCert->next )
+        {
+            mbedtlsError = mbedtls_md_update( &mdContext, pCert->raw.p, pCert->raw.len );
+        }
+
+        if( mbedtlsError == 0 )
+        {
+            mbedtlsError = mbedtls_md_update( &mdContext, &separator, 1U );
+        }
+
+        for( pCert = &( pSslContext->clientCert );
+             ( mbedtlsError == 0 ) && ( pCert != NULL );
+             pCert = pCert->next )
+        {
+            mbedtlsError = mbedtls_md_update( &mdContext, pCert->raw.p, pCert->raw.len );
+        }
+
+        if( mbedtlsError == 0 )
+        {
+            mbedtlsError = mbedtls_md_finish( &mdContext, pKey );
+        }
+
+        mbedtls_md_free( &mdContext );
+
+        return mbedtlsError;
+    }
+/*-----------------------------------------------------------*/
+
+    static void sessionCacheOffer( SSLContext_t * pSslContext )
+    {
+        uint8_t key[ SESSION_KEY_LENGTH ];
+        size_t index = 0U;
+        int32_t mbedtlsError = 0;
+        TickType_t nowTicks = xTaskGetTickCount();
+
+        configASSERT( pSslContext != NULL );
+
+        pSslContext->sessionOffered = pdFALSE;
+        pSslContext->handshakeStartTicks = nowTicks;
+
+        /* A pre-shared key authenticates every handshake by itself. */
+        if( ( pSslContext->pskMode == pdFALSE ) &&
+            ( sessionKey( pSslContext, key ) == 0 ) )
+        {
+            ( void ) mbedtls_platform_mutex_lock( &sessionCacheMutex );
+
+            for( index = 0U; ( index < TLS_TRANSPORT_SESSION_CACHE_ENTRIES ) && ( pSslContext->sessionOffered == pdFALSE ); index++ )
+            {
+                if( ( cachedSessions[ index ].inUse == pdTRUE ) &&
+                    ( ticksToMs( nowTicks - cachedSessions[ index ].savedTicks ) < TLS_TRANSPORT_SESSION_CACHE_TTL_MS ) &&
+                    ( memcmp( cachedSessions[ index ].key, key, SESSION_KEY_LENGTH ) == 0 ) )
+                {
+                    /* mbed TLS copies the session into the SSL context. */
+                    mbedtlsError = mbedtls_ssl_set_session( &( pSslContext->context ),
+                                                            &( cachedSessions[ index ].session ) );
+
+                    if( mbedtlsError == 0 )
+                    {
+                        pSslContext->sessionOffered = pdTRUE;
+                        pSslContext->fullHandshakeMs = cachedSessions[ index ].handshakeMs;
+                    }
+                    else
+                    {
+                        LogWarn( ( "Failed to offer a cached TLS session: mbedTLSError= "TLS_ERROR_FORMAT ".",
+                                   tlsErrorArgs( mbedtlsError ) ) );
+                    }
+                }
+            }
+
+            ( void ) mbedtls_platform_mutex_unlock( &sessionCacheMutex );
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    static void sessionCacheUpdate( SSLContext_t * pSslContext )
+    {
+        uint8_t key[ SESSION_KEY_LENGTH ];
+        size_t index = 0U;
+        size_t slot = 0U;
+        BaseType_t freeFound = pdFALSE;
+        int32_t mbedtlsError = 0;
+        uint32_t savedMs = 0U;
+        uint32_t totalSavedMs = 0U;
+        TickType_t age = 0U;
+        TickType_t oldestAge = 0U;
+        TickType_t nowTicks = xTaskGetTickCount();
+        uint32_t handshakeMs = 0U;
+
+        configASSERT( pSslContext != NULL );
+
+        handshakeMs = ticksToMs( nowTicks - pSslContext->handshakeStartTicks );
+
+        if( pSslContext->pskMode == pdTRUE )
+        {
+            /* Sessions are not cached. */
+        }
+        else if( pSslContext->sessionOffered == pdTRUE )
+        {
+            /* mbed TLS does not tell whether the server resumed the session.
+             * A server that declined it ran a full handshake, which shows as
+             * no saving. */
+            if( handshakeMs < pSslContext->fullHandshakeMs )
+            {
+                savedMs = pSslContext->fullHandshakeMs - handshakeMs;
+            }
+
+            ( void ) mbedtls_platform_mutex_lock( &sessionCacheMutex );
+            sessionCacheSavedMs += savedMs;
+            totalSavedMs = sessionCacheSavedMs;
+            ( void ) mbedtls_platform_mutex_unlock( &sessionCacheMutex );
+
+            LogInfo( ( "Handshake with a cached TLS session took %u ms, against %u ms for "
+                       "the full handshake. Saved %u ms since boot.",
+                       ( unsigned int ) handshakeMs,
+                       ( unsigned int ) pSslContext->fullHandshakeMs,
+                       ( unsigned int ) totalSavedMs ) );
+        }
+        else if( sessionKey( pSslContext, key ) == 0 )
+        {
+            ( void ) mbedtls_platform_mutex_lock( &sessionCacheMutex );
+
+            /* Take the first free entry, or else the one saved longest ago,
+             * which is also the first to expire. */
+            for( index = 0U; ( index < TLS_TRANSPORT_SESSION_CACHE_ENTRIES ) && ( freeFound == pdFALSE ); index++ )
+            {
+                age = nowTicks - cachedSessions[ index ].savedTicks;
+
+                if( cachedSessions[ index ].inUse == pdFALSE )
+                {
+                    slot = index;
+                    freeFound = pdTRUE;
+                }
+                else if( age > oldestAge )
+                {
+                    slot = index;
+                    oldestAge = age;
+                }
+                else
+                {
+                    /* Empty else for MISRA 15.7 compliance. */
+                }
+            }
+
+            if( cachedSessions[ slot ].inUse == pdTRUE )
+            {
+                mbedtls_ssl_session_free( &( cachedSessions[ slot ].session ) );
+                cachedSessions[ slot ].inUse = pdFALSE;
+            }
+
+            mbedtls_ssl_session_init( &( cachedSessions[ slot ].session ) );
+
+            /* With TLS 1.3, the server sends its tickets after the handshake,
+             * so there is no session to save yet. */
+            mbedtlsError = mbedtls_ssl_get_session( &( pSslContext->context ),
+                                                    &( cachedSessions[ slot ].session ) );
+
+            if( mbedtlsError == 0 )
+            {
+                ( void ) memcpy( cachedSessions[ slot ].key, key, SESSION_KEY_LENGTH );
+                cachedSessions[ slot ].savedTicks = nowTicks;
+                cachedSessions[ slot ].handshakeMs = handshakeMs;
+                cachedSessions[ slot ].inUse = pdTRUE;
+            }
+            else
+            {
+                mbedtls_ssl_session_free( &( cachedSessions[ slot ].session ) );
+                LogDebug( ( "TLS session not cached: mbedTLSError= "TLS_ERROR_FORMAT ".",
+                            tlsErrorArgs( mbedtlsError ) ) );
+            }
+
+            ( void ) mbedtls_platform_mutex_unlock( &sessionCacheMutex );
+        }
+        else
+        {
+            /* Empty else for MISRA 15.7 compliance. */
+        }
+    }
+/*-----------------------------------------------------------*/
+#endif /* ifdef TLS_TRANSPORT_SESSION_CACHE */
+
+#ifdef TLS_TRANSPORT_HANDSHAKE_PROFILE
+    static int profileSend( void * pContext,
+                            const unsigned char * pBuffer,
+                            size_t bufferLength )
+    {
+        NetworkContext_t * pNetworkContext = ( NetworkContext_t * ) pContext;
+        TlsHandshakeProfile_t * pProfile = &( pNetworkContext->handshakeProfile );
+        TlsHandshakeStepProfile_t * pStep = &( pProfile->steps[ pProfile->stepCount - 1U ] );
+        uint32_t startTransactions = Sockets_GetTransactionCount( pNetworkContext->tcpSocket );
+        TickType_t startTicks = xTaskGetTickCount();
+        int sendStatus = mbedtls_platform_send( pNetworkContext->tcpSocket, pBuffer, bufferLength );
+        uint32_t ioMs = ticksToMs( xTaskGetTickCount() - startTicks );
+
+        pStep->ioMs += ioMs;
+        pStep->sendCalls++;
+        pStep->atTransactions += ( uint16_t ) ( Sockets_GetTransactionCount( pNetworkContext->tcpSocket ) -
+                                                startTransactions );
+        pProfile->ioMs += ioMs;
+
+        if( sendStatus > 0 )
+        {
+            pStep->bytesSent += ( uint32_t ) sendStatus;
+        }
+
+        return sendStatus;
+    }
+/*-----------------------------------------------------------*/
+
+    static int profileRecv( void * pContext,
+                            unsigned char * pBuffer,
+                            size_t bufferLength )
+    {
+        NetworkContext_t * pNetworkContext = ( NetworkContext_t * ) pContext;
+        TlsHandshakeProfile_t * pProfile = &( pNetworkContext->handshakeProfile );
+        TlsHandshakeStepProfile_t * pStep = &( pProfile->steps[ pProfile->stepCount - 1U ] );
+        uint32_t startTransactions = Sockets_GetTransactionCount( pNetworkContext->tcpSocket );
+        TickType_t startTicks = xTaskGetTickCount();
+        int recvStatus = mbedtls_platform_recv( pNetworkContext->tcpSocket, pBuffer, bufferLength );
+        uint32_t ioMs = ticksToMs( xTaskGetTickCount() - startTicks );
+
+        pStep->ioMs += ioMs;
+        pStep->recvCalls++;
+        pStep->atTransactions += ( uint16_t ) ( Sockets_GetTransactionCount( pNetworkContext->tcpSocket ) -
+                                                startTransactions );
+        pProfile->ioMs += ioMs;
+
+        if( recvStatus > 0 )
+        {
+            pStep->bytesReceived += ( uint32_t ) recvStatus;
+        }
+
+        return recvStatus;
+    }
+/*-----------------------------------------------------------*/
+
+    static int32_t profileHandshake( NetworkContext_t * pNetworkContext )
+    {
+        TlsHandshakeProfile_t * pProfile = &( pNetworkContext->handshakeProfile );
+        mbedtls_ssl_context * pSsl = &( pNetworkContext->sslContext.context );
+        TlsHandshakeStepProfile_t * pStep = NULL;
+        TickType_t stepStartTicks = 0;
+        int32_t mbedtlsError = 0;
+
+        /* The first entry starts with the handshake. Later calls, after
+         * WANT_READ or WANT_WRITE, continue in the current entry. */
+        if( pProfile->stepCount == 0U )
+        {
+            pProfile->steps[ 0 ].state = sslHandshakeState( pSsl );
+            pProfile->stepCount = 1U;
+        }
+
+        while( ( mbedtlsError == 0 ) &&
+               ( sslHandshakeState( pSsl ) != MBEDTLS_SSL_HANDSHAKE_OVER ) )
+        {
+            pStep = &( pProfile->steps[ pProfile->stepCount - 1U ] );
+
+            /* Start a new entry on each state transition, keeping retries of
+             * the same state in one entry. */
+            if( ( pStep->state != sslHandshakeState( pSsl ) ) &&
+                ( pProfile->stepCount < TLS_HANDSHAKE_PROFILE_MAX_STEPS ) )
+            {
+                pProfile->stepCount++;
+                pStep++;
+                pStep->state = sslHandshakeState( pSsl );
+                pStep->startMs = pStep[ -1 ].startMs + pStep[ -1 ].durationMs;
+            }
+
+            stepStartTicks = xTaskGetTickCount();
+
+            mbedtlsError = ( int32_t ) mbedtls_ssl_handshake_step( pSsl );
+
+            pStep->durationMs += ticksToMs( xTaskGetTickCount() - stepStartTicks );
+        }
+
+        return mbedtlsError;
+    }
+/*-----------------------------------------------------------*/
+
+    static void logHandshakeFlights( const NetworkContext_t * pNetworkContext )
+    {
+        const TlsHandshakeProfile_t * pProfile = &( pNetworkContext->handshakeProfile );
+        const TlsHandshakeStepProfile_t * pStep = NULL;
+        BaseType_t flightSends = pdTRUE;
+        BaseType_t stepSends = pdTRUE;
+        uint32_t flightNumber = 1;
+        uint32_t flightBytes = 0;
+        uint32_t flightTransactions = 0;
+        uint32_t flightMs = 0;
+        size_t i = 0;
+
+        /* The pass after the last state logs the last flight. */
+        for( i = 0; i <= pProfile->stepCount; i++ )
+        {
+            if( i < pProfile->stepCount )
+            {
+                pStep = &( pProfile->steps[ i ] );
+
+                if( pStep->bytesSent > 0U )
+                {
+                    stepSends = pdTRUE;
+                }
+                else if( pStep->bytesReceived > 0U )
+                {
+                    stepSends = pdFALSE;
+                }
+                else
+                {
+                    stepSends = flightSends;
+                }
+            }
+
+            if( ( flightBytes > 0U ) &&
+                ( ( i == pProfile->stepCount ) || ( stepSends != flightSends ) ) )
+            {
+                LogInfo( ( "(Network connection %p) Handshake flight %u: %s %u B in %u ms, "
+                           "%u AT transactions.",
+                           pNetworkContext,
+                           ( unsigned int ) flightNumber,
+                           ( flightSends == pdTRUE ) ? "sent" : "received",
+                           ( unsigned int ) flightBytes,
+                           ( unsigned int ) flightMs,
+                           ( unsigned int ) flightTransactions ) );
+
+                flightNumber++;
+                flightBytes = 0;
+                flightTransactions = 0;
+                flightMs = 0;
+            }
+
+            if( i < pProfile->stepCount )
+            {
+                flightSends = stepSends;
+                flightBytes += pStep->bytesSent + pStep->bytesReceived;
+                flightTransactions += pStep->atTransactions;
+                flightMs += pStep->durationMs;
+            }
+        }
+    }
+/*-----------------------------------------------------------*/
+
+    static void logHandshakeProfile( const NetworkContext_t * pNetworkContext )
+    {
+        const TlsHandshakeProfile_t * pProfile = &( pNetworkContext->handshakeProfile );
+        const TlsHandshakeStepProfile_t * pStep = NULL;
+        uint32_t bytesSent = 0;
+        uint32_t bytesReceived = 0;
+        uint32_t socketCalls = 0;
+        uint32_t atTransactions = 0;
+        size_t i = 0;
+
+        for( i = 0; i < pProfile->stepCount; i++ )
+        {
+            pStep = &( pProfile->steps[ i ] );
+            bytesSent += pStep->bytesSent;
+            bytesReceived += pStep->bytesReceived;
+            socketCalls += ( uint32_t ) pStep->sendCalls + pStep->recvCalls;
+            atTransactions += pStep->atTransactions;
+
+            LogDebug( ( "(Network connection %p) Handshake state %d: start %u ms, %u ms "
+                        "(%u ms I/O), sent %u B in %u calls, received %u B in %u calls, "
+                        "%u AT transactions.",
+                        pNetworkContext,
+                        ( int ) pStep->state,
+                        ( unsigned int ) pStep->startMs,
+                        ( unsigned int ) pStep->durationMs,
+                        ( unsigned int ) pStep->ioMs,
+                        ( unsigned int ) pStep->bytesSent,
+                        ( unsigned int ) pStep->sendCalls,
+                        ( unsigned int ) pStep->bytesReceived,
+                        ( unsigned int ) pStep->recvCalls,
+                        ( unsigned int ) pStep->atTransactions ) );
+        }
+
+        logHandshakeFlights( pNetworkContext );
+
+        LogInfo( ( "(Network connection %p) Connect profile: DNS %u ms, socket %u ms, setup %u ms, "
+                   "handshake %u ms (I/O %u ms, derived CPU %u ms), sent %u B, received %u B, "
+                   "%u socket calls, %u AT transactions.",
+                   pNetworkContext,
+                   ( unsigned int ) pProfile->dnsMs,
+                   ( unsigned int ) pProfile->socketConnectMs,
+                   ( unsigned int ) pProfile->tlsSetupMs,
+                   ( unsigned int ) pProfile->handshakeMs,
+                   ( unsigned int ) pProfile->ioMs,
+                   ( unsigned int ) pProfile->cpuMs,
+                   ( unsigned int ) bytesSent,
+                   ( unsigned int ) bytesReceived,
+                   ( unsigned int ) socketCalls,
+                   ( unsigned int ) atTransactions ) );
+    }
+/*-----------------------------------------------------------*/
+#endif /* ifdef TLS_TRANSPORT_HANDSHAKE_PROFILE */
+
+static int recvNonBlocking( void * pContext,
+                            unsigned char * pBuffer,
+                            size_t bufferLength )
+{
+    int recvStatus = mbedtls_platform_recv( pContext, pBuffer, bufferLength );
+
+    if( recvStatus == 0 )
+    {
+        recvStatus = MBEDTLS_ERR_SSL_WANT_READ;
+    }
+
+    return recvStatus;
+}
+/*-----------------------------------------------------------*/
+
+static TlsTransportStatus_t tlsConnect( NetworkContext_t * pNetworkContext,
+                                        const char * pHostName,
+                                        uint16_t port,
+                                        const NetworkCredentials_t * pNetworkCredentials,
+                                        uint32_t receiveTimeoutMs,
+                                        uint32_t sendTimeoutMs )
 {
     TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
     BaseType_t socketStatus = 0;
+    const char * pSocketHost = pHostName;
+
+    #ifdef TLS_TRANSPORT_HANDSHAKE_PROFILE
+        TickType_t phaseStartTicks = 0;
+        char resolvedAddress[ SOCKETS_IP_ADDRESS_LENGTH ];
+    #endif
 
     if( ( pNetworkContext == NULL ) ||
         ( pHostName == NULL ) ||
@@ -609,9 +1844,10 @@ TlsTransportStatus_t TLS_FreeRTOS_Connect( NetworkContext_t * pNetworkContext,
                     pNetworkCredentials ) );
         returnStatus = TLS_TRANSPORT_INVALID_PARAMETER;
     }
-    else if( ( pNetworkCredentials->pRootCa == NULL ) )
+    else if( ( pNetworkCredentials->pRootCa == NULL ) &&
+             ( pNetworkCredentials->pPsk == NULL ) )
     {
-        LogError( ( "pRootCa cannot be NULL." ) );
+        LogError( ( "pRootCa and pPsk cannot both be NULL." ) );
         returnStatus = TLS_TRANSPORT_INVALID_PARAMETER;
     }
     else
@@ -622,8 +1858,31 @@ TlsTransportStatus_t TLS_FreeRTOS_Connect( NetworkContext_t * pNetworkContext,
     /* Establish a TCP connection with the server. */
     if( returnStatus == TLS_TRANSPORT_SUCCESS )
     {
+        #ifdef TLS_TRANSPORT_HANDSHAKE_PROFILE
+            ( void ) memset( &( pNetworkContext->handshakeProfile ), 0, sizeof( TlsHandshakeProfile_t ) );
+
+            /* Resolve the name first, so that the socket phase does not
+             * include the name resolution by the modem. The host name is
+             * still used for SNI and certificate verification. */
+            phaseStartTicks = xTaskGetTickCount();
+
+            if( Sockets_GetHostByName( pHostName, resolvedAddress, sizeof( resolvedAddress ) ) == SOCKETS_ERROR_NONE )
+            {
+                pSocketHost = resolvedAddress;
+            }
+            else
+            {
+                LogWarn( ( "Failed to resolve %s ahead of the connect. The socket phase "
+                           "includes name resolution.",
+                           pHostName ) );
+            }
+
+            pNetworkContext->handshakeProfile.dnsMs = ticksToMs( xTaskGetTickCount() - phaseStartTicks );
+            phaseStartTicks = xTaskGetTickCount();
+        #endif
+
         socketStatus = Sockets_Connect( &( pNetworkContext->tcpSocket ),
-                                        pHostName,
+                                        pSocketHost,
                                         port,
                                         receiveTimeoutMs,
                                         sendTimeoutMs );
@@ -635,6 +1894,11 @@ TlsTransportStatus_t TLS_FreeRTOS_Connect( NetworkContext_t * pNetworkContext,
                         socketStatus ) );
             returnStatus = TLS_TRANSPORT_CONNECT_FAILURE;
         }
+
+        #ifdef TLS_TRANSPORT_HANDSHAKE_PROFILE
+            pNetworkContext->handshakeProfile.socketConnectMs = ticksToMs( xTaskGetTickCount() - phaseStartTicks );
+            phaseStartTicks = xTaskGetTickCount();
+        #endif
     }
 
     /* Initialize mbedtls. */
@@ -647,9 +1911,51 @@ TlsTransportStatus_t TLS_FreeRTOS_Connect( NetworkContext_t * pNetworkContext,
     /* Initialize TLS contexts and set credentials. */
     if( returnStatus == TLS_TRANSPORT_SUCCESS )
     {
-        returnStatus = tlsSetup( pNetworkContext, pHostName, pNetworkCredentials );
+        returnStatus = tlsSetup( pNetworkContext,
+                                 pHostName,
+                                 pNetworkCredentials,
+                                 MBEDTLS_SSL_TRANSPORT_STREAM );
+
+        #ifdef TLS_TRANSPORT_HANDSHAKE_PROFILE
+            pNetworkContext->handshakeProfile.tlsSetupMs = ticksToMs( xTaskGetTickCount() - phaseStartTicks );
+        #endif
     }
 
+    return returnStatus;
+}
+/*-----------------------------------------------------------*/
+
+static void tlsCleanup( NetworkContext_t * pNetworkContext )
+{
+    configASSERT( pNetworkContext != NULL );
+
+    sslContextFree( &( pNetworkContext->sslContext ) );
+
+    if( pNetworkContext->tcpSocket != NULL )
+    {
+        ( void ) Sockets_Disconnect( pNetworkContext->tcpSocket );
+        pNetworkContext->tcpSocket = NULL;
+    }
+}
+/*-----------------------------------------------------------*/
+
+TlsTransportStatus_t TLS_FreeRTOS_Connect( NetworkContext_t * pNetworkContext,
+                                           const char * pHostName,
+                                           uint16_t port,
+                                           const NetworkCredentials_t * pNetworkCredentials,
+                                           uint32_t receiveTimeoutMs,
+                                           uint32_t sendTimeoutMs )
+{
+    TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
+    size_t freeHeapBeforeConnect = xPortGetFreeHeapSize();
+
+    returnStatus = tlsConnect( pNetworkContext,
+                               pHostName,
+                               port,
+                               pNetworkCredentials,
+                               receiveTimeoutMs,
+                               sendTimeoutMs );
+
     /* Perform TLS handshake. */
     if( returnStatus == TLS_TRANSPORT_SUCCESS )
     {
@@ -661,19 +1967,180 @@ TlsTransportStatus_t TLS_FreeRTOS_Connect( NetworkContext_t * pNetworkContext,
     {
         if( pNetworkContext != NULL )
         {
-            sslContextFree( &( pNetworkContext->sslContext ) );
+            tlsCleanup( pNetworkContext );
+        }
+    }
+    else
+    {
+        LogInfo( ( "(Network connection %p) Connection to %s established with %s authentication.",
+                   pNetworkContext,
+                   pHostName,
+                   ( pNetworkContext->sslContext.pskMode != pdFALSE ) ? "pre-shared key" : "certificate" ) );
+
+        #ifdef MBEDTLS_SSL_MAX_FRAGMENT_LENGTH
+            LogInfo( ( "(Network connection %p) Record fragment length: in %u, out %u bytes.",
+                       pNetworkContext,
+                       ( unsigned int ) mbedtls_ssl_get_input_max_frag_len( &( pNetworkContext->sslContext.context ) ),
+                       ( unsigned int ) mbedtls_ssl_get_output_max_frag_len( &( pNetworkContext->sslContext.context ) ) ) );
+        #endif
+
+        /* The heap held by the connection once its record buffers have been
+         * resized, and the heap low watermark, which bounds the handshake peak. */
+        LogInfo( ( "(Network connection %p) Heap used by connection: %u bytes. "
+                   "Minimum ever free heap: %u bytes.",
+                   pNetworkContext,
+                   ( unsigned int ) ( freeHeapBeforeConnect - xPortGetFreeHeapSize() ),
+                   ( unsigned int ) xPortGetMinimumEverFreeHeapSize() ) );
+
+        /* Blocks taken from the slab pools are not part of the heap figures. */
+        #ifdef MBEDTLS_FREERTOS_SLAB_ALLOC
+            mbedtls_platform_slab_log_stats();
+        #endif
+
+        #ifdef MBEDTLS_FREERTOS_ECDHE_POOL
+            mbedtls_platform_ecdhe_pool_log_stats();
+        #endif
+    }
+
+    return returnStatus;
+}
+/*-----------------------------------------------------------*/
+
+TlsTransportStatus_t TLS_FreeRTOS_ConnectAsync( NetworkContext_t * pNetworkContext,
+                                                const char * pHostName,
+                                                uint16_t port,
+                                                const NetworkCredentials_t * pNetworkCredentials,
+                                                uint32_t receiveTimeoutMs,
+                                                uint32_t sendTimeoutMs )
+{
+    TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
+
+    returnStatus = tlsConnect( pNetworkContext,
+                               pHostName,
+                               port,
+                               pNetworkCredentials,
+                               receiveTimeoutMs,
+                               sendTimeoutMs );
 
-            if( pNetworkContext->tcpSocket != NULL )
+    if( returnStatus == TLS_TRANSPORT_SUCCESS )
+    {
+        returnStatus = tlsSessionSetup( pNetworkContext, recvNonBlocking );
+    }
+
+    /* Reads return at once while the handshake is in progress, so that
+     * TLS_FreeRTOS_HandshakeStep never waits for the server. */
+    if( returnStatus == TLS_TRANSPORT_SUCCESS )
+    {
+        if( Sockets_SetNonBlocking( pNetworkContext->tcpSocket, pdTRUE ) != SOCKETS_ERROR_NONE )
+        {
+            LogError( ( "Failed to set the socket to non-blocking." ) );
+            returnStatus = TLS_TRANSPORT_INTERNAL_ERROR;
+        }
+    }
+
+    if( ( returnStatus != TLS_TRANSPORT_SUCCESS ) && ( pNetworkContext != NULL ) )
+    {
+        tlsCleanup( pNetworkContext );
+    }
+
+    return returnStatus;
+}
+/*-----------------------------------------------------------*/
+
+TlsTransportStatus_t TLS_FreeRTOS_HandshakeStep( NetworkContext_t * pNetworkContext )
+{
+    TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
+    int32_t mbedtlsError = 0;
+
+    if( pNetworkContext == NULL )
+    {
+        LogError( ( "Invalid input parameter: pNetworkContext cannot be NULL." ) );
+        returnStatus = TLS_TRANSPORT_INVALID_PARAMETER;
+    }
+    else
+    {
+        /* Run the handshake until it needs data from the server. Sends still
+         * block for up to the send timeout. */
+        do
+        {
+            mbedtlsError = mbedtls_ssl_handshake( &( pNetworkContext->sslContext.context ) );
+
+            /* Let other tasks run between slices of an ECC operation. */
+            if( eccInProgress( mbedtlsError ) )
             {
-                ( void ) Sockets_Disconnect( pNetworkContext->tcpSocket );
+                taskYIELD();
             }
+        } while( ( mbedtlsError == MBEDTLS_ERR_SSL_WANT_WRITE ) ||
+                 eccInProgress( mbedtlsError ) );
+
+        if( mbedtlsError == MBEDTLS_ERR_SSL_WANT_READ )
+        {
+            returnStatus = TLS_TRANSPORT_HANDSHAKE_IN_PROGRESS;
+        }
+        else if( mbedtlsError != 0 )
+        {
+            LogError( ( "Failed to perform TLS handshake: mbedTLSError= "TLS_ERROR_FORMAT ".",
+                        tlsErrorArgs( mbedtlsError ) ) );
+
+            tlsCleanup( pNetworkContext );
+            returnStatus = TLS_TRANSPORT_HANDSHAKE_FAILED;
+        }
+        else
+        {
+            /* Empty else for MISRA 15.7 compliance. */
+        }
+
+        if( returnStatus == TLS_TRANSPORT_SUCCESS )
+        {
+            /* Restore blocking reads, which TLS_FreeRTOS_recv expects. */
+            mbedtls_ssl_set_bio( &( pNetworkContext->sslContext.context ),
+                                 ( void * ) pNetworkContext->tcpSocket,
+                                 mbedtls_platform_send,
+                                 mbedtls_platform_recv,
+                                 NULL );
+            ( void ) Sockets_SetNonBlocking( pNetworkContext->tcpSocket, pdFALSE );
+
+            LogInfo( ( "(Network connection %p) %s handshake successful.",
+                       pNetworkContext,
+                       mbedtls_ssl_get_version( &( pNetworkContext->sslContext.context ) ) ) );
+
+            #ifdef TLS_TRANSPORT_SESSION_CACHE
+                sessionCacheUpdate( &( pNetworkContext->sslContext ) );
+            #endif
         }
     }
+
+    return returnStatus;
+}
+/*-----------------------------------------------------------*/
+
+TlsTransportStatus_t TLS_FreeRTOS_SetupContext( NetworkContext_t * pNetworkContext,
+                                                const char * pHostName,
+                                                const NetworkCredentials_t * pNetworkCredentials,
+                                                int32_t transport )
+{
+    TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
+
+    if( ( pNetworkContext == NULL ) ||
+        ( pHostName == NULL ) ||
+        ( pNetworkCredentials == NULL ) ||
+        ( ( pNetworkCredentials->pRootCa == NULL ) && ( pNetworkCredentials->pPsk == NULL ) ) )
+    {
+        LogError( ( "Invalid input parameter(s): Arguments cannot be NULL, and pRootCa or pPsk must be set." ) );
+        returnStatus = TLS_TRANSPORT_INVALID_PARAMETER;
+    }
     else
     {
-        LogInfo( ( "(Network connection %p) Connection to %s established.",
-                   pNetworkContext,
-                   pHostName ) );
+        returnStatus = initMbedtls( &( pNetworkContext->sslContext.entropyContext ),
+                                    &( pNetworkContext->sslContext.ctrDrgbContext ) );
+    }
+
+    if( returnStatus == TLS_TRANSPORT_SUCCESS )
+    {
+        returnStatus = tlsSetup( pNetworkContext,
+                                 pHostName,
+                                 pNetworkCredentials,
+                                 transport );
     }
 
     return returnStatus;
@@ -700,10 +2167,9 @@ void TLS_FreeRTOS_Disconnect( NetworkContext_t * pNetworkContext )
             }
             else
             {
-                LogError( ( "(Network connection %p) Failed to send TLS close-notify: mbedTLSError= %s : %s.",
+                LogError( ( "(Network connection %p) Failed to send TLS close-notify: mbedTLSError= "TLS_ERROR_FORMAT ".",
                             pNetworkContext,
-                            mbedtlsHighLevelCodeOrDefault( tlsStatus ),
-                            mbedtlsLowLevelCodeOrDefault( tlsStatus ) ) );
+                            tlsErrorArgs( tlsStatus ) ) );
             }
         }
         else
@@ -722,8 +2188,8 @@ void TLS_FreeRTOS_Disconnect( NetworkContext_t * pNetworkContext )
         sslContextFree( &( pNetworkContext->sslContext ) );
     }
 
-    /* Clear the mutex functions for mbed TLS thread safety. */
-    mbedtls_threading_free_alt();
+    /* The mbed TLS mutex functions are left set, as other connections may
+     * still be using them. */
 }
 /*-----------------------------------------------------------*/
 
@@ -737,14 +2203,22 @@ int32_t TLS_FreeRTOS_recv( NetworkContext_t * pNetworkContext,
                                               pBuffer,
                                               bytesToRecv );
 
+    #ifdef MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET
+        /* A TLS 1.3 server may send a NewSessionTicket after the handshake.
+         * It carries no application data, so report it as a timeout. */
+        if( tlsStatus == MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET )
+        {
+            tlsStatus = MBEDTLS_ERR_SSL_WANT_READ;
+        }
+    #endif
+
     if( ( tlsStatus == MBEDTLS_ERR_SSL_TIMEOUT ) ||
         ( tlsStatus == MBEDTLS_ERR_SSL_WANT_READ ) ||
         ( tlsStatus == MBEDTLS_ERR_SSL_WANT_WRITE ) )
     {
         LogDebug( ( "Failed to read data. However, a read can be retried on this error. "
-                    "mbedTLSError= %s : %s.",
-                    mbedtlsHighLevelCodeOrDefault( tlsStatus ),
-                    mbedtlsLowLevelCodeOrDefault( tlsStatus ) ) );
+                    "mbedTLSError= "TLS_ERROR_FORMAT ".",
+                    tlsErrorArgs( tlsStatus ) ) );
 
         /* Mark these set of errors as a timeout. The libraries may retry read
          * on these errors. */
@@ -752,9 +2226,8 @@ int32_t TLS_FreeRTOS_recv( NetworkContext_t * pNetworkContext,
     }
     else if( tlsStatus < 0 )
     {
-        LogError( ( "Failed to read data: mbedTLSError= %s : %s.",
-                    mbedtlsHighLevelCodeOrDefault( tlsStatus ),
-                    mbedtlsLowLevelCodeOrDefault( tlsStatus ) ) );
+        LogError( ( "Failed to read data: mbedTLSError= "TLS_ERROR_FORMAT ".",
+                    tlsErrorArgs( tlsStatus ) ) );
     }
     else
     {
@@ -780,9 +2253,8 @@ int32_t TLS_FreeRTOS_send( NetworkContext_t * pNetworkContext,
         ( tlsStatus == MBEDTLS_ERR_SSL_WANT_WRITE ) )
     {
         LogDebug( ( "Failed to send data. However, send can be retried on this error. "
-                    "mbedTLSError= %s : %s.",
-                    mbedtlsHighLevelCodeOrDefault( tlsStatus ),
-                    mbedtlsLowLevelCodeOrDefault( tlsStatus ) ) );
+                    "mbedTLSError= "TLS_ERROR_FORMAT ".",
+                    tlsErrorArgs( tlsStatus ) ) );
 
         /* Mark these set of errors as a timeout. The libraries may retry send
          * on these errors. */
@@ -790,9 +2262,8 @@ int32_t TLS_FreeRTOS_send( NetworkContext_t * pNetworkContext,
     }
     else if( tlsStatus < 0 )
     {
-        LogError( ( "Failed to send data:  mbedTLSError= %s : %s.",
-                    mbedtlsHighLevelCodeOrDefault( tlsStatus ),
-                    mbedtlsLowLevelCodeOrDefault( tlsStatus ) ) );
+        LogError( ( "Failed to send data:  mbedTLSError= "TLS_ERROR_FORMAT ".",
+                    tlsErrorArgs( tlsStatus ) ) );
     }
     else
     {
@@ -802,3 +2273,103 @@ int32_t TLS_FreeRTOS_send( NetworkContext_t * pNetworkContext,
     return tlsStatus;
 }
 /*-----------------------------------------------------------*/
+
+static int32_t writevFlush( NetworkContext_t * pNetworkContext,
+                            size_t bufferedBytes,
+                            int32_t * pBytesSent )
+{
+    int32_t tlsStatus = TLS_FreeRTOS_send( pNetworkContext,
+                                           pNetworkContext->writevBuffer,
+                                           bufferedBytes );
+
+    if( tlsStatus > 0 )
+    {
+        *pBytesSent += tlsStatus;
+    }
+
+    return tlsStatus;
+}
+/*-----------------------------------------------------------*/
+
+int32_t TLS_FreeRTOS_writev( NetworkContext_t * pNetworkContext,
+                             TransportOutVector_t * pIoVec,
+                             size_t ioVecCount )
+{
+    int32_t tlsStatus = 0;
+    int32_t bytesSent = 0;
+    size_t bufferedBytes = 0;
+    size_t vectorOffset = 0;
+    size_t copyLength = 0;
+    size_t i = 0;
+    BaseType_t writeComplete = pdTRUE;
+
+    configASSERT( pNetworkContext != NULL );
+    configASSERT( ( pIoVec != NULL ) || ( ioVecCount == 0U ) );
+
+    /* Copy the buffers into the gather buffer and write it out each time it
+     * fills, so that each write becomes one record. Stop at the first error or
+     * partial write. The caller then retries from the first unsent byte, which
+     * refills the buffer with the same bytes, as mbed TLS expects when it
+     * resumes a pending write. */
+    for( i = 0; ( i < ioVecCount ) && ( writeComplete == pdTRUE ); i++ )
+    {
+        vectorOffset = 0;
+
+        while( ( vectorOffset < pIoVec[ i ].iov_len ) && ( writeComplete == pdTRUE ) )
+        {
+            copyLength = pIoVec[ i ].iov_len - vectorOffset;
+
+            if( copyLength > ( sizeof( pNetworkContext->writevBuffer ) - bufferedBytes ) )
+            {
+                copyLength = sizeof( pNetworkContext->writevBuffer ) - bufferedBytes;
+            }
+
+            ( void ) memcpy( &( pNetworkContext->writevBuffer[ bufferedBytes ] ),
+                             &( ( ( const uint8_t * ) pIoVec[ i ].iov_base )[ vectorOffset ] ),
+                             copyLength );
+            bufferedBytes += copyLength;
+            vectorOffset += copyLength;
+
+            if( bufferedBytes == sizeof( pNetworkContext->writevBuffer ) )
+            {
+                tlsStatus = writevFlush( pNetworkContext, bufferedBytes, &bytesSent );
+                writeComplete = ( tlsStatus == ( int32_t ) bufferedBytes ) ? pdTRUE : pdFALSE;
+                bufferedBytes = 0;
+            }
+        }
+    }
+
+    if( ( bufferedBytes > 0U ) && ( writeComplete == pdTRUE ) )
+    {
+        tlsStatus = writevFlush( pNetworkContext, bufferedBytes, &bytesSent );
+    }
+
+    return ( bytesSent > 0 ) ? bytesSent : tlsStatus;
+}
+/*-----------------------------------------------------------*/
+
+TlsTransportStatus_t TLS_FreeRTOS_SetDataReadyCallback( NetworkContext_t * pNetworkContext,
+                                                        SocketsDataReadyCallback_t dataReadyCallback,
+                                                        void * pvContext )
+{
+    TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
+
+    if( pNetworkContext == NULL )
+    {
+        LogError( ( "Invalid input parameter: pNetworkContext cannot be NULL." ) );
+        returnStatus = TLS_TRANSPORT_INVALID_PARAMETER;
+    }
+    else if( Sockets_SetDataReadyCallback( pNetworkContext->tcpSocket,
+                                           dataReadyCallback,
+                                           pvContext ) != SOCKETS_ERROR_NONE )
+    {
+        returnStatus = TLS_TRANSPORT_INVALID_PARAMETER;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return returnStatus;
+}
+/*-----------------------------------------------------------*/
@@ -78,8 +78,95 @@ typedef struct SSLContext
     mbedtls_pk_context privKey;              /**< @brief Client private key context. */
     mbedtls_entropy_context entropyContext;  /**< @brief Entropy context for random number generation. */
     mbedtls_ctr_drbg_context ctrDrgbContext; /**< @brief CTR DRBG context for random number generation. */
+    BaseType_t pskMode;                      /**< @brief pdTRUE when the connection authenticates with a pre-shared key. */
+    #ifdef TLS_TRANSPORT_SESSION_CACHE
+        BaseType_t sessionOffered;           /**< @brief pdTRUE when the handshake offers a cached session. */
+        uint32_t fullHandshakeMs;            /**< @brief Time the full handshake of the offered session took. */
+        TickType_t handshakeStartTicks;      /**< @brief Tick count at which the handshake started. */
+    #endif
 } SSLContext_t;
 
+/**
+ * @brief Size of the buffer in which TLS_FreeRTOS_writev() gathers its input
+ * into records. Set it to the maximum fragment length for the fewest records.
+ */
+#ifndef TLS_TRANSPORT_WRITEV_BUFFER_SIZE
+    #define TLS_TRANSPORT_WRITEV_BUFFER_SIZE    ( 1024U )
+#endif
+
+#ifndef TLS_TRANSPORT_INTERFACE_WRITEV
+
+/**
+ * @brief One buffer of a vectored send, laid out as the TransportOutVector_t of
+ * coreMQTT v2, whose transport interface declares it instead.
+ */
+    typedef struct TransportOutVector
+    {
+        const void * iov_base; /**< @brief Start of the buffer. */
+        size_t iov_len;        /**< @brief Length of the buffer. */
+    } TransportOutVector_t;
+#endif
+
+#ifdef TLS_TRANSPORT_HANDSHAKE_PROFILE
+
+/**
+ * @brief Maximum number of handshake states recorded by the profiler. Later
+ * states are accumulated into the last entry.
+ */
+    #define TLS_HANDSHAKE_PROFILE_MAX_STEPS    ( 24U )
+
+/**
+ * @brief Time and traffic spent in one mbed TLS handshake state.
+ *
+ * The state is a value of mbedtls_ssl_states. Certificate verification runs
+ * in MBEDTLS_SSL_SERVER_CERTIFICATE, ECDHE in MBEDTLS_SSL_SERVER_KEY_EXCHANGE
+ * and MBEDTLS_SSL_CLIENT_KEY_EXCHANGE, and client signing in
+ * MBEDTLS_SSL_CERTIFICATE_VERIFY. On a cellular modem, a send or receive
+ * call may take several AT transactions, which are counted by the sockets
+ * wrapper.
+ */
+    typedef struct TlsHandshakeStepProfile
+    {
+        int32_t state;           /**< @brief mbed TLS handshake state. */
+        uint32_t startMs;        /**< @brief Start of the state, relative to the start of the handshake. */
+        uint32_t durationMs;     /**< @brief Time spent in the state. */
+        uint32_t ioMs;           /**< @brief Part of durationMs spent in socket calls. */
+        uint32_t bytesSent;      /**< @brief Bytes sent in the state. */
+        uint32_t bytesReceived;  /**< @brief Bytes received in the state. */
+        uint16_t sendCalls;      /**< @brief Socket send calls in the state. */
+        uint16_t recvCalls;      /**< @brief Socket receive calls in the state. */
+        uint16_t atTransactions; /**< @brief AT transactions of the socket calls in the state. */
+    } TlsHandshakeStepProfile_t;
+
+/**
+ * @brief Phase timings of the last TLS_FreeRTOS_Connect() on a network context.
+ */
+    typedef struct TlsHandshakeProfile
+    {
+        uint32_t dnsMs;           /**< @brief Name resolution by the modem. */
+        uint32_t socketConnectMs; /**< @brief Socket open to the resolved address. */
+        uint32_t tlsSetupMs;      /**< @brief RNG seeding and credential parsing. */
+        uint32_t handshakeMs;     /**< @brief The whole handshake. */
+        uint32_t ioMs;            /**< @brief Part of handshakeMs spent in socket calls. */
+        uint32_t cpuMs;           /**< @brief Derived as handshakeMs - ioMs, not measured, so it includes other tasks. */
+        size_t stepCount;         /**< @brief Number of valid entries in steps. */
+        TlsHandshakeStepProfile_t steps[ TLS_HANDSHAKE_PROFILE_MAX_STEPS ]; /**< @brief Per-state breakdown. */
+    } TlsHandshakeProfile_t;
+#endif /* ifdef TLS_TRANSPORT_HANDSHAKE_PROFILE */
+
+#ifdef MBEDTLS_SSL_PROTO_DTLS
+
+/**
+ * @brief Retransmission timer of a DTLS connection, run from the tick count.
+ */
+    typedef struct DtlsTimer
+    {
+        TickType_t startTicks;   /**< @brief Tick count at which the timer was set. */
+        uint32_t intermediateMs; /**< @brief Intermediate delay, after which mbed TLS may retransmit. */
+        uint32_t finalMs;        /**< @brief Final delay, or 0 when the timer is cancelled. */
+    } DtlsTimer_t;
+#endif
+
 /**
  * @brief Definition of the network context for the transport interface
  * implementation that uses mbedTLS and FreeRTOS+TLS sockets.
@@ -88,6 +175,13 @@ struct NetworkContext
 {
     Socket_t tcpSocket;
     SSLContext_t sslContext;
+    uint8_t writevBuffer[ TLS_TRANSPORT_WRITEV_BUFFER_SIZE ]; /**< @brief Gather buffer of TLS_FreeRTOS_writev(). */
+    #ifdef TLS_TRANSPORT_HANDSHAKE_PROFILE
+        TlsHandshakeProfile_t handshakeProfile; /**< @brief Profile of the last connect. */
+    #endif
+    #ifdef MBEDTLS_SSL_PROTO_DTLS
+        DtlsTimer_t dtlsTimer; /**< @brief Retransmission timer, used by DTLS_FreeRTOS_Connect(). */
+    #endif
 };
 
 /**
@@ -110,12 +204,50 @@ typedef struct NetworkCredentials
      */
     BaseType_t disableSni;
 
-    const uint8_t * pRootCa;     /**< @brief String representing a trusted server root certificate. */
+    /**
+     * @brief Maximum fragment length to request, as one of the
+     * MBEDTLS_SSL_MAX_FRAG_LEN_* values. 0 selects MBEDTLS_SSL_MAX_FRAG_LEN_4096,
+     * or MBEDTLS_SSL_MAX_FRAG_LEN_1024 with TLS_TRANSPORT_LEAN_PROFILE.
+     *
+     * Outgoing records never exceed this length. With
+     * MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH, the record buffers of the connection
+     * shrink to it after the handshake. The input buffer only shrinks if the
+     * server accepts the max_fragment_length extension.
+     */
+    uint8_t maxFragmentLength;
+
+    /*
+     * Each credential below may be either a NULL-terminated PEM string, with
+     * the size including the terminator, or a DER-encoded blob. DER input is
+     * detected by its leading ASN.1 SEQUENCE tag and needs neither base64
+     * decoding nor MBEDTLS_PEM_PARSE_C. DER certificates are referenced in
+     * place, so their buffers must outlive the connection.
+     */
+    const uint8_t * pRootCa;     /**< @brief Trusted server root certificate(s), PEM or DER. */
     size_t rootCaSize;           /**< @brief Size associated with #NetworkCredentials.pRootCa. */
-    const uint8_t * pClientCert; /**< @brief String representing the client certificate. */
+    const uint8_t * pClientCert; /**< @brief Client certificate, PEM or DER. */
     size_t clientCertSize;       /**< @brief Size associated with #NetworkCredentials.pClientCert. */
-    const uint8_t * pPrivateKey; /**< @brief String representing the client certificate's private key. */
+    const uint8_t * pPrivateKey; /**< @brief Client certificate's private key, PEM or DER. */
     size_t privateKeySize;       /**< @brief Size associated with #NetworkCredentials.pPrivateKey. */
+
+    /*
+     * Pre-shared key. When pPsk is set, both sides authenticate with the key
+     * alone: the certificates above are ignored and no X.509 or signature
+     * code runs. Needs MBEDTLS_KEY_EXCHANGE_PSK_ENABLED, or
+     * MBEDTLS_KEY_EXCHANGE_ECDHE_PSK_ENABLED for pskEcdhe. mbed TLS copies the
+     * key and identity.
+     */
+    const uint8_t * pPsk;         /**< @brief Pre-shared key, raw bytes. */
+    size_t pskSize;               /**< @brief Size associated with #NetworkCredentials.pPsk. */
+    const uint8_t * pPskIdentity; /**< @brief Identity under which the server knows the key. */
+    size_t pskIdentitySize;       /**< @brief Size associated with #NetworkCredentials.pPskIdentity. */
+
+    /**
+     * @brief pdTRUE to negotiate ECDHE-PSK instead of plain PSK. An ECDH key
+     * exchange on each side keeps past sessions secret if the key leaks, at
+     * the cost of two P-256 multiplications per handshake.
+     */
+    BaseType_t pskEcdhe;
 } NetworkCredentials_t;
 
 /**
@@ -129,17 +261,31 @@ typedef enum TlsTransportStatus
     TLS_TRANSPORT_INVALID_CREDENTIALS, /**< Provided credentials were invalid. */
     TLS_TRANSPORT_HANDSHAKE_FAILED,    /**< Performing TLS handshake with server failed. */
     TLS_TRANSPORT_INTERNAL_ERROR,      /**< A call to a system API resulted in an internal error. */
-    TLS_TRANSPORT_CONNECT_FAILURE      /**< Initial connection to the server failed. */
+    TLS_TRANSPORT_CONNECT_FAILURE,     /**< Initial connection to the server failed. */
+    TLS_TRANSPORT_HANDSHAKE_IN_PROGRESS /**< The handshake is waiting for data from the server. */
 } TlsTransportStatus_t;
 
 /**
  * @brief Create a TLS connection with FreeRTOS sockets.
  *
+ * Each network context holds all the state of its connection, so several
+ * tasks may connect and use their own contexts at the same time.
+ *
+ * With TLS_TRANSPORT_SESSION_CACHE defined, the session of an earlier
+ * connection with the same host name and credentials is offered to the
+ * server, until TLS_TRANSPORT_SESSION_CACHE_TTL_MS after the full handshake
+ * that established it. A server that resumes it skips the certificate
+ * exchange; otherwise mbed TLS verifies the server chain as usual.
+ *
+ * The handshake time and heap use are logged along with the authentication
+ * mode, so that a pre-shared key can be compared with certificates.
+ *
  * @param[out] pNetworkContext Pointer to a network context to contain the
  * initialized socket handle.
  * @param[in] pHostName The hostname of the remote endpoint.
  * @param[in] port The destination port.
- * @param[in] pNetworkCredentials Credentials for the TLS connection.
+ * @param[in] pNetworkCredentials Credentials for the TLS connection, with
+ * either pRootCa or pPsk set.
  * @param[in] receiveTimeoutMs Receive socket timeout.
  * @param[in] sendTimeoutMs Send socket timeout.
  *
@@ -153,9 +299,86 @@ TlsTransportStatus_t TLS_FreeRTOS_Connect( NetworkContext_t * pNetworkContext,
                                            uint32_t receiveTimeoutMs,
                                            uint32_t sendTimeoutMs );
 
+/**
+ * @brief Connect to the server and prepare a TLS handshake without running it.
+ *
+ * The handshake is then driven by TLS_FreeRTOS_HandshakeStep(), which returns
+ * whenever it waits for the server. Register a callback with
+ * Sockets_SetDataReadyCallback() on pNetworkContext->tcpSocket to learn when
+ * to call it again. The TCP connect itself still blocks.
+ *
+ * @param[out] pNetworkContext Pointer to a network context to contain the
+ * initialized socket handle.
+ * @param[in] pHostName The hostname of the remote endpoint.
+ * @param[in] port The destination port.
+ * @param[in] pNetworkCredentials Credentials for the TLS connection. Must stay
+ * valid until the handshake completes.
+ * @param[in] receiveTimeoutMs Receive socket timeout, used once the handshake
+ * completes.
+ * @param[in] sendTimeoutMs Send socket timeout.
+ *
+ * @return #TLS_TRANSPORT_SUCCESS, #TLS_TRANSPORT_INSUFFICIENT_MEMORY, #TLS_TRANSPORT_INVALID_CREDENTIALS,
+ * #TLS_TRANSPORT_INTERNAL_ERROR, or #TLS_TRANSPORT_CONNECT_FAILURE.
+ */
+TlsTransportStatus_t TLS_FreeRTOS_ConnectAsync( NetworkContext_t * pNetworkContext,
+                                                const char * pHostName,
+                                                uint16_t port,
+                                                const NetworkCredentials_t * pNetworkCredentials,
+                                                uint32_t receiveTimeoutMs,
+                                                uint32_t sendTimeoutMs );
+
+/**
+ * @brief Advance a handshake started with TLS_FreeRTOS_ConnectAsync().
+ *
+ * Runs the handshake until it needs more data from the server. On failure the
+ * connection is released and must not be passed to TLS_FreeRTOS_Disconnect().
+ *
+ * @param[in] pNetworkContext Network context.
+ *
+ * @return #TLS_TRANSPORT_SUCCESS once the connection is established,
+ * #TLS_TRANSPORT_HANDSHAKE_IN_PROGRESS to be called again when data arrives,
+ * #TLS_TRANSPORT_HANDSHAKE_FAILED, or #TLS_TRANSPORT_INVALID_PARAMETER.
+ */
+TlsTransportStatus_t TLS_FreeRTOS_HandshakeStep( NetworkContext_t * pNetworkContext );
+
+/**
+ * @brief Initialize the mbed TLS contexts of a network context and apply the
+ * credentials, without touching the socket or starting a handshake.
+ *
+ * Used by transports that open their own socket and drive their own
+ * handshake, such as the DTLS transport of using_mbedtls_dtls.h. Release the
+ * contexts with TLS_FreeRTOS_Disconnect(), also when this function fails.
+ *
+ * @param[in,out] pNetworkContext The network context.
+ * @param[in] pHostName The hostname of the remote endpoint.
+ * @param[in] pNetworkCredentials Credentials for the connection.
+ * @param[in] transport MBEDTLS_SSL_TRANSPORT_STREAM or MBEDTLS_SSL_TRANSPORT_DATAGRAM.
+ *
+ * @return #TLS_TRANSPORT_SUCCESS, #TLS_TRANSPORT_INVALID_PARAMETER, #TLS_TRANSPORT_INSUFFICIENT_MEMORY,
+ * #TLS_TRANSPORT_INVALID_CREDENTIALS, or #TLS_TRANSPORT_INTERNAL_ERROR.
+ */
+TlsTransportStatus_t TLS_FreeRTOS_SetupContext( NetworkContext_t * pNetworkContext,
+                                                const char * pHostName,
+                                                const NetworkCredentials_t * pNetworkCredentials,
+                                                int32_t transport );
+
+/**
+ * @brief Set the mbed TLS mutex functions if no connection has done so yet.
+ *
+ * Connecting calls this. Code that uses mbed TLS contexts from several tasks
+ * before the first connect, such as a server in a test, calls it before it
+ * initializes them. It also initializes the global mutexes of mbed TLS, so it
+ * must not be replaced with mbedtls_threading_set_alt() while another task
+ * may hold one of them.
+ */
+void TLS_FreeRTOS_InitThreading( void );
+
 /**
  * @brief Gracefully disconnect an established TLS connection.
  *
+ * Only the state of this connection is released, so other connections can
+ * stay open in other tasks.
+ *
  * @param[in] pNetworkContext Network context.
  */
 void TLS_FreeRTOS_Disconnect( NetworkContext_t * pNetworkContext );
@@ -196,4 +419,45 @@ int32_t TLS_FreeRTOS_send( NetworkContext_t * pNetworkContext,
                            const void * pBuffer,
                            size_t bytesToSend );
 
+/**
+ * @brief Sends several buffers over an established TLS connection, packing
+ * them into as few records as possible.
+ *
+ * This is the TLS version of the transport interface's #TransportWritev_t
+ * function. Without it, each buffer becomes a record of its own, with its own
+ * record overhead and its own modem send. coreMQTT v1 has no vectored send,
+ * so call it directly, as the demo does for the header and payload of each
+ * PUBLISH.
+ *
+ * @param[in] pNetworkContext The network context.
+ * @param[in] pIoVec Array of buffers to send, in order.
+ * @param[in] ioVecCount Number of buffers in pIoVec.
+ *
+ * @return Number of bytes (> 0) sent on success;
+ * 0 if the socket times out without sending any bytes;
+ * else a negative value to represent error.
+ */
+int32_t TLS_FreeRTOS_writev( NetworkContext_t * pNetworkContext,
+                             TransportOutVector_t * pIoVec,
+                             size_t ioVecCount );
+
+/**
+ * @brief Register a callback to be invoked when data arrives for an
+ * established TLS connection.
+ *
+ * The callback runs in the task of the cellular library before the data is
+ * read, so it should only wake the task that calls TLS_FreeRTOS_recv(). One
+ * callback may announce several records, and mbed TLS may keep part of a
+ * record, so read until TLS_FreeRTOS_recv() returns 0 after each callback.
+ *
+ * @param[in] pNetworkContext The network context.
+ * @param[in] dataReadyCallback The callback, or NULL to remove it.
+ * @param[in] pvContext Context passed to the callback.
+ *
+ * @return #TLS_TRANSPORT_SUCCESS, or #TLS_TRANSPORT_INVALID_PARAMETER.
+ */
+TlsTransportStatus_t TLS_FreeRTOS_SetDataReadyCallback( NetworkContext_t * pNetworkContext,
+                                                        SocketsDataReadyCallback_t dataReadyCallback,
+                                                        void * pvContext );
+
 #endif /* ifndef USING_MBEDTLS */
@@ -0,0 +1,434 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * @file using_mbedtls_dtls.c
+ * @brief DTLS 1.2 transport over cellular UDP sockets.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Configure logs for the functions in this file. */
+#include "logging_levels.h"
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "DtlsTransport"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_ERROR
+#endif
+#include "logging_stack.h"
+
+/* DTLS transport header. */
+#include "using_mbedtls_dtls.h"
+
+#ifdef MBEDTLS_SSL_PROTO_DTLS
+
+/**
+ * @brief Convert a tick count to milliseconds.
+ */
+    #define ticksToMs( ticks )    ( ( uint32_t ) ( ( ( uint64_t ) ( ticks ) * 1000U ) / configTICK_RATE_HZ ) )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Receive callback used by mbed TLS, which sets the time to wait.
+ *
+ * @param[in] pContext The socket handle.
+ * @param[out] pBuffer Buffer to receive a datagram into.
+ * @param[in] bufferLength Size of the buffer.
+ * @param[in] timeoutMs Time to wait for a datagram, or 0 to keep the receive
+ * timeout of the socket.
+ *
+ * @return Number of bytes received, MBEDTLS_ERR_SSL_TIMEOUT, or a negative
+ * value on error.
+ */
+    static int dtlsRecvTimeout( void * pContext,
+                                unsigned char * pBuffer,
+                                size_t bufferLength,
+                                uint32_t timeoutMs );
+
+/**
+ * @brief Set up the SSL context of a DTLS connection on its configuration and
+ * socket, and run the handshake.
+ *
+ * @param[in] pNetworkContext Network context with a connected UDP socket and
+ * an initialized configuration.
+ * @param[in] receiveTimeoutMs Receive timeout once the handshake is done.
+ *
+ * @return #TLS_TRANSPORT_SUCCESS, #TLS_TRANSPORT_HANDSHAKE_FAILED, or #TLS_TRANSPORT_INTERNAL_ERROR.
+ */
+    static TlsTransportStatus_t dtlsHandshake( NetworkContext_t * pNetworkContext,
+                                               uint32_t receiveTimeoutMs );
+
+/**
+ * @brief Whether the server gave the connection a non-empty connection ID.
+ *
+ * @param[in] pNetworkContext Network context after the handshake.
+ *
+ * @return pdTRUE if records carry a connection ID, pdFALSE otherwise.
+ */
+    static BaseType_t connectionIdInUse( NetworkContext_t * pNetworkContext );
+
+/*-----------------------------------------------------------*/
+
+    void DTLS_FreeRTOS_SetDelay( void * pContext,
+                                 uint32_t intermediateMs,
+                                 uint32_t finalMs )
+    {
+        DtlsTimer_t * pTimer = ( DtlsTimer_t * ) pContext;
+
+        configASSERT( pTimer != NULL );
+
+        pTimer->startTicks = xTaskGetTickCount();
+        pTimer->intermediateMs = intermediateMs;
+        pTimer->finalMs = finalMs;
+    }
+/*-----------------------------------------------------------*/
+
+    int DTLS_FreeRTOS_GetDelay( void * pContext )
+    {
+        const DtlsTimer_t * pTimer = ( const DtlsTimer_t * ) pContext;
+        uint32_t elapsedMs = 0U;
+        int delayState = 0;
+
+        configASSERT( pTimer != NULL );
+
+        if( pTimer->finalMs == 0U )
+        {
+            delayState = -1;
+        }
+        else
+        {
+            elapsedMs = ticksToMs( xTaskGetTickCount() - pTimer->startTicks );
+
+            if( elapsedMs >= pTimer->finalMs )
+            {
+                delayState = 2;
+            }
+            else if( elapsedMs >= pTimer->intermediateMs )
+            {
+                delayState = 1;
+            }
+            else
+            {
+                delayState = 0;
+            }
+        }
+
+        return delayState;
+    }
+/*-----------------------------------------------------------*/
+
+    static int dtlsRecvTimeout( void * pContext,
+                                unsigned char * pBuffer,
+                                size_t bufferLength,
+                                uint32_t timeoutMs )
+    {
+        int recvStatus = 0;
+
+        /* mbed TLS passes the time left on the retransmission timer during
+         * the handshake, and the read timeout afterwards. Setting it only
+         * updates the socket context. */
+        if( timeoutMs != 0U )
+        {
+            ( void ) Sockets_SetReceiveTimeout( ( Socket_t ) pContext, timeoutMs );
+        }
+
+        recvStatus = mbedtls_platform_recv( pContext, pBuffer, bufferLength );
+
+        if( recvStatus == 0 )
+        {
+            recvStatus = MBEDTLS_ERR_SSL_TIMEOUT;
+        }
+
+        return recvStatus;
+    }
+/*-----------------------------------------------------------*/
+
+    static TlsTransportStatus_t dtlsHandshake( NetworkContext_t * pNetworkContext,
+                                               uint32_t receiveTimeoutMs )
+    {
+        TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
+        int32_t mbedtlsError = 0;
+        TickType_t handshakeStartTicks = 0;
+
+        configASSERT( pNetworkContext != NULL );
+
+        /* Retransmit lost handshake flights on a slow link, and report an
+         * empty socket as a timeout once the connection is up. */
+        mbedtls_ssl_conf_handshake_timeout( &( pNetworkContext->sslContext.config ),
+                                            DTLS_TRANSPORT_HANDSHAKE_TIMEOUT_MIN_MS,
+                                            DTLS_TRANSPORT_HANDSHAKE_TIMEOUT_MAX_MS );
+        mbedtls_ssl_conf_read_timeout( &( pNetworkContext->sslContext.config ),
+                                       receiveTimeoutMs );
+
+        mbedtlsError = mbedtls_ssl_setup( &( pNetworkContext->sslContext.context ),
+                                          &( pNetworkContext->sslContext.config ) );
+
+        if( mbedtlsError != 0 )
+        {
+            LogError( ( "Failed to set up mbed TLS SSL context: mbedTLSError= -0x%04X.",
+                        ( unsigned int ) -mbedtlsError ) );
+            returnStatus = TLS_TRANSPORT_INTERNAL_ERROR;
+        }
+        else
+        {
+            /* MISRA Rule 11.2 flags the following line for casting the second
+             * parameter to void *. This rule is suppressed because
+             * #mbedtls_ssl_set_bio requires the second parameter as void *.
+             */
+            /* coverity[misra_c_2012_rule_11_2_violation] */
+            mbedtls_ssl_set_bio( &( pNetworkContext->sslContext.context ),
+                                 ( void * ) pNetworkContext->tcpSocket,
+                                 mbedtls_platform_send,
+                                 NULL,
+                                 dtlsRecvTimeout );
+            mbedtls_ssl_set_timer_cb( &( pNetworkContext->sslContext.context ),
+                                      &( pNetworkContext->dtlsTimer ),
+                                      DTLS_FreeRTOS_SetDelay,
+                                      DTLS_FreeRTOS_GetDelay );
+            mbedtls_ssl_set_mtu( &( pNetworkContext->sslContext.context ),
+                                 ( uint16_t ) DTLS_TRANSPORT_MTU );
+        }
+
+        #ifdef MBEDTLS_SSL_DTLS_CONNECTION_ID
+            if( returnStatus == TLS_TRANSPORT_SUCCESS )
+            {
+                /* Offer an empty connection ID of our own: the server address
+                 * does not change, so only the server needs an ID to find the
+                 * session. */
+                mbedtlsError = mbedtls_ssl_set_cid( &( pNetworkContext->sslContext.context ),
+                                                    MBEDTLS_SSL_CID_ENABLED,
+                                                    NULL,
+                                                    0U );
+
+                if( mbedtlsError != 0 )
+                {
+                    LogError( ( "Failed to enable the connection ID extension: mbedTLSError= -0x%04X.",
+                                ( unsigned int ) -mbedtlsError ) );
+                    returnStatus = TLS_TRANSPORT_INTERNAL_ERROR;
+                }
+            }
+        #endif /* ifdef MBEDTLS_SSL_DTLS_CONNECTION_ID */
+
+        if( returnStatus == TLS_TRANSPORT_SUCCESS )
+        {
+            handshakeStartTicks = xTaskGetTickCount();
+
+            /* Lost flights are retransmitted inside mbedtls_ssl_handshake,
+             * which fails with MBEDTLS_ERR_SSL_TIMEOUT once the handshake
+             * timeout is reached. */
+            do
+            {
+                mbedtlsError = mbedtls_ssl_handshake( &( pNetworkContext->sslContext.context ) );
+            } while( ( mbedtlsError == MBEDTLS_ERR_SSL_WANT_READ ) ||
+                     ( mbedtlsError == MBEDTLS_ERR_SSL_WANT_WRITE ) );
+
+            if( mbedtlsError != 0 )
+            {
+                LogError( ( "Failed to perform DTLS handshake: mbedTLSError= -0x%04X.",
+                            ( unsigned int ) -mbedtlsError ) );
+                returnStatus = TLS_TRANSPORT_HANDSHAKE_FAILED;
+            }
+            else
+            {
+                LogInfo( ( "(Network connection %p) %s handshake successful in %u ms.",
+                           pNetworkContext,
+                           mbedtls_ssl_get_version( &( pNetworkContext->sslContext.context ) ),
+                           ( unsigned int ) ticksToMs( xTaskGetTickCount() - handshakeStartTicks ) ) );
+            }
+        }
+
+        return returnStatus;
+    }
+/*-----------------------------------------------------------*/
+
+    static BaseType_t connectionIdInUse( NetworkContext_t * pNetworkContext )
+    {
+        BaseType_t inUse = pdFALSE;
+
+        #ifdef MBEDTLS_SSL_DTLS_CONNECTION_ID
+            int cidEnabled = MBEDTLS_SSL_CID_DISABLED;
+            unsigned char peerCid[ MBEDTLS_SSL_CID_OUT_LEN_MAX ];
+            size_t peerCidLength = 0U;
+
+            if( ( mbedtls_ssl_get_peer_cid( &( pNetworkContext->sslContext.context ),
+                                            &cidEnabled,
+                                            peerCid,
+                                            &peerCidLength ) == 0 ) &&
+                ( cidEnabled == MBEDTLS_SSL_CID_ENABLED ) &&
+                ( peerCidLength > 0U ) )
+            {
+                inUse = pdTRUE;
+            }
+        #else
+            ( void ) pNetworkContext;
+        #endif
+
+        return inUse;
+    }
+/*-----------------------------------------------------------*/
+
+    TlsTransportStatus_t DTLS_FreeRTOS_Connect( NetworkContext_t * pNetworkContext,
+                                                const char * pHostName,
+                                                uint16_t port,
+                                                const NetworkCredentials_t * pNetworkCredentials,
+                                                uint32_t receiveTimeoutMs,
+                                                uint32_t sendTimeoutMs )
+    {
+        TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
+        BaseType_t contextSetUp = pdFALSE;
+
+        if( ( pNetworkContext == NULL ) ||
+            ( pHostName == NULL ) ||
+            ( pNetworkCredentials == NULL ) ||
+            ( receiveTimeoutMs == 0U ) )
+        {
+            LogError( ( "Invalid input parameter(s): Arguments cannot be NULL or 0. pNetworkContext=%p, "
+                        "pHostName=%p, pNetworkCredentials=%p, receiveTimeoutMs=%u.",
+                        pNetworkContext,
+                        pHostName,
+                        pNetworkCredentials,
+                        ( unsigned int ) receiveTimeoutMs ) );
+            returnStatus = TLS_TRANSPORT_INVALID_PARAMETER;
+        }
+        else if( Sockets_ConnectUdp( &( pNetworkContext->tcpSocket ),
+                                     pHostName,
+                                     port,
+                                     receiveTimeoutMs,
+                                     sendTimeoutMs ) != 0 )
+        {
+            LogError( ( "Failed to open a UDP socket to %s:%u.",
+                        pHostName,
+                        ( unsigned int ) port ) );
+            returnStatus = TLS_TRANSPORT_CONNECT_FAILURE;
+        }
+        else
+        {
+            ( void ) memset( &( pNetworkContext->dtlsTimer ), 0, sizeof( DtlsTimer_t ) );
+
+            /* The contexts must be released even if this fails. */
+            contextSetUp = pdTRUE;
+            returnStatus = TLS_FreeRTOS_SetupContext( pNetworkContext,
+                                                      pHostName,
+                                                      pNetworkCredentials,
+                                                      MBEDTLS_SSL_TRANSPORT_DATAGRAM );
+        }
+
+        if( returnStatus == TLS_TRANSPORT_SUCCESS )
+        {
+            returnStatus = dtlsHandshake( pNetworkContext, receiveTimeoutMs );
+        }
+
+        if( returnStatus == TLS_TRANSPORT_SUCCESS )
+        {
+            if( connectionIdInUse( pNetworkContext ) == pdTRUE )
+            {
+                LogInfo( ( "(Network connection %p) DTLS connection to %s established with a connection ID.",
+                           pNetworkContext,
+                           pHostName ) );
+            }
+            else
+            {
+                LogWarn( ( "(Network connection %p) The server did not grant a connection ID. "
+                           "A change of address will need a new handshake.",
+                           pNetworkContext ) );
+            }
+        }
+        else if( contextSetUp == pdTRUE )
+        {
+            /* Frees the contexts and closes the socket. No close-notify is
+             * sent before the handshake is over. */
+            TLS_FreeRTOS_Disconnect( pNetworkContext );
+        }
+        else
+        {
+            /* Empty else for MISRA 15.7 compliance. */
+        }
+
+        return returnStatus;
+    }
+/*-----------------------------------------------------------*/
+
+    TlsTransportStatus_t DTLS_FreeRTOS_Rebind( NetworkContext_t * pNetworkContext,
+                                               const char * pHostName,
+                                               uint16_t port,
+                                               uint32_t receiveTimeoutMs,
+                                               uint32_t sendTimeoutMs )
+    {
+        TlsTransportStatus_t returnStatus = TLS_TRANSPORT_SUCCESS;
+        Socket_t newSocket = NULL;
+
+        if( ( pNetworkContext == NULL ) || ( pHostName == NULL ) )
+        {
+            LogError( ( "Invalid input parameter(s): Arguments cannot be NULL. pNetworkContext=%p, "
+                        "pHostName=%p.",
+                        pNetworkContext,
+                        pHostName ) );
+            returnStatus = TLS_TRANSPORT_INVALID_PARAMETER;
+        }
+        else if( connectionIdInUse( pNetworkContext ) == pdFALSE )
+        {
+            /* The server would drop records from the new address. */
+            LogError( ( "(Network connection %p) Cannot rebind a connection without a connection ID.",
+                        pNetworkContext ) );
+            returnStatus = TLS_TRANSPORT_INVALID_PARAMETER;
+        }
+        else if( Sockets_ConnectUdp( &newSocket,
+                                     pHostName,
+                                     port,
+                                     receiveTimeoutMs,
+                                     sendTimeoutMs ) != 0 )
+        {
+            LogError( ( "Failed to open a UDP socket to %s:%u.",
+                        pHostName,
+                        ( unsigned int ) port ) );
+            returnStatus = TLS_TRANSPORT_CONNECT_FAILURE;
+        }
+        else
+        {
+            Sockets_Disconnect( pNetworkContext->tcpSocket );
+            pNetworkContext->tcpSocket = newSocket;
+
+            /* The session keys, sequence numbers and connection ID carry
+             * over; only the socket under them changes. */
+            /* coverity[misra_c_2012_rule_11_2_violation] */
+            mbedtls_ssl_set_bio( &( pNetworkContext->sslContext.context ),
+                                 ( void * ) pNetworkContext->tcpSocket,
+                                 mbedtls_platform_send,
+                                 NULL,
+                                 dtlsRecvTimeout );
+
+            LogInfo( ( "(Network connection %p) DTLS session moved to a new socket.",
+                       pNetworkContext ) );
+        }
+
+        return returnStatus;
+    }
+/*-----------------------------------------------------------*/
+
+#endif /* ifdef MBEDTLS_SSL_PROTO_DTLS */
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * @file using_mbedtls_dtls.h
+ * @brief DTLS 1.2 transport over cellular UDP sockets.
+ *
+ * A DTLS connection uses the NetworkContext_t, credentials and status codes of
+ * the TLS transport, and is used and closed with TLS_FreeRTOS_send(),
+ * TLS_FreeRTOS_recv() and TLS_FreeRTOS_Disconnect(). It requires
+ * MBEDTLS_SSL_PROTO_DTLS in mbedtls_config.h.
+ *
+ * With MBEDTLS_SSL_DTLS_CONNECTION_ID, the client asks the server for a
+ * connection ID, which the client then puts in every record it sends. The
+ * server finds the session by that ID instead of by the client address, so
+ * the session survives a NAT rebinding, or a new socket opened with
+ * DTLS_FreeRTOS_Rebind(), without a new handshake.
+ *
+ * DTLS does not retransmit or reorder application data, but coreMQTT parses
+ * the connection as an ordered byte stream. coreMQTT over DTLS therefore
+ * desynchronizes on any lost record: the record cuts a packet short, and the
+ * bytes that follow are parsed from the wrong offset. This surfaces as a
+ * malformed packet or a missed keep-alive, after which the application must
+ * reconnect. Only use DTLS on links where a lost record is rare.
+ */
+
+#ifndef USING_MBEDTLS_DTLS_H
+#define USING_MBEDTLS_DTLS_H
+
+/* TLS transport header, which defines the network context. */
+#include "using_mbedtls.h"
+
+/**
+ * @brief Largest datagram the transport sends, including the record and UDP
+ * headers of mbed TLS. Handshake messages are fragmented to fit.
+ */
+#ifndef DTLS_TRANSPORT_MTU
+    #define DTLS_TRANSPORT_MTU    ( 1200U )
+#endif
+
+/**
+ * @brief First retransmission timeout of the handshake. It doubles on every
+ * retransmission, up to #DTLS_TRANSPORT_HANDSHAKE_TIMEOUT_MAX_MS.
+ */
+#ifndef DTLS_TRANSPORT_HANDSHAKE_TIMEOUT_MIN_MS
+    #define DTLS_TRANSPORT_HANDSHAKE_TIMEOUT_MIN_MS    ( 2000U )
+#endif
+
+/**
+ * @brief Time after which a handshake that gets no answer fails.
+ */
+#ifndef DTLS_TRANSPORT_HANDSHAKE_TIMEOUT_MAX_MS
+    #define DTLS_TRANSPORT_HANDSHAKE_TIMEOUT_MAX_MS    ( 60000U )
+#endif
+
+/**
+ * @brief Create a DTLS connection over a cellular UDP socket.
+ *
+ * @param[out] pNetworkContext Pointer to a network context to contain the
+ * initialized socket handle.
+ * @param[in] pHostName The hostname of the remote endpoint.
+ * @param[in] port The destination port.
+ * @param[in] pNetworkCredentials Credentials for the DTLS connection.
+ * @param[in] receiveTimeoutMs Receive timeout once the handshake is done. Must
+ * not be 0.
+ * @param[in] sendTimeoutMs Send socket timeout.
+ *
+ * @return #TLS_TRANSPORT_SUCCESS, #TLS_TRANSPORT_INVALID_PARAMETER, #TLS_TRANSPORT_INSUFFICIENT_MEMORY,
+ * #TLS_TRANSPORT_INVALID_CREDENTIALS, #TLS_TRANSPORT_HANDSHAKE_FAILED, #TLS_TRANSPORT_INTERNAL_ERROR,
+ * or #TLS_TRANSPORT_CONNECT_FAILURE.
+ */
+TlsTransportStatus_t DTLS_FreeRTOS_Connect( NetworkContext_t * pNetworkContext,
+                                            const char * pHostName,
+                                            uint16_t port,
+                                            const NetworkCredentials_t * pNetworkCredentials,
+                                            uint32_t receiveTimeoutMs,
+                                            uint32_t sendTimeoutMs );
+
+/**
+ * @brief Move a DTLS session to a new UDP socket without a new handshake.
+ *
+ * Use it when the socket was lost, for example after the modem reattached to
+ * the network and got a new address. It requires a connection ID from the
+ * server. Send a record, such as an MQTT PINGREQ, right after, so that the
+ * server learns the new address before it sends anything. On failure the old
+ * socket is kept.
+ *
+ * @param[in,out] pNetworkContext Network context of a DTLS connection.
+ * @param[in] pHostName The hostname of the remote endpoint.
+ * @param[in] port The destination port.
+ * @param[in] receiveTimeoutMs Receive socket timeout.
+ * @param[in] sendTimeoutMs Send socket timeout.
+ *
+ * @return #TLS_TRANSPORT_SUCCESS, #TLS_TRANSPORT_INVALID_PARAMETER, or
+ * #TLS_TRANSPORT_CONNECT_FAILURE.
+ */
+TlsTransportStatus_t DTLS_FreeRTOS_Rebind( NetworkContext_t * pNetworkContext,
+                                           const char * pHostName,
+                                           uint16_t port,
+                                           uint32_t receiveTimeoutMs,
+                                           uint32_t sendTimeoutMs );
+
+/**
+ * @brief Start or cancel the retransmission timer of a DTLS context, for
+ * mbed TLS.
+ *
+ * Pass it with #DTLS_FreeRTOS_GetDelay and a #DtlsTimer_t to
+ * mbedtls_ssl_set_timer_cb(). DTLS_FreeRTOS_Connect() does so for the client;
+ * a server in the same program, such as a test stand-in, can do the same.
+ *
+ * @param[in] pContext The #DtlsTimer_t of the connection.
+ * @param[in] intermediateMs Intermediate delay.
+ * @param[in] finalMs Final delay, or 0 to cancel the timer.
+ */
+void DTLS_FreeRTOS_SetDelay( void * pContext,
+                             uint32_t intermediateMs,
+                             uint32_t finalMs );
+
+/**
+ * @brief Report which delays of the retransmission timer of a DTLS context
+ * have passed, for mbed TLS.
+ *
+ * @param[in] pContext The #DtlsTimer_t of the connection.
+ *
+ * @return -1 if the timer is cancelled, 0 if no delay has passed, 1 if only
+ * the intermediate delay has passed, and 2 if the final delay has passed.
+ */
+int DTLS_FreeRTOS_GetDelay( void * pContext );
+
+#endif /* ifndef USING_MBEDTLS_DTLS_H */
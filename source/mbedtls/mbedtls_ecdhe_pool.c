@@ -0,0 +1,459 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file mbedtls_ecdhe_pool.c
+ * @brief Pool of P-256 key pairs precomputed for the ECDHE key exchange.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* mbed TLS includes. */
+#include "mbedtls_config.h"
+#include "mbedtls_ecdhe_pool.h"
+
+#ifdef MBEDTLS_FREERTOS_ECDHE_POOL
+
+    #include "mbedtls/ctr_drbg.h"
+    #include "mbedtls/ecdh.h"
+    #include "mbedtls/entropy.h"
+    #include "mbedtls/platform_util.h"
+
+/* Configure logs for the functions in this file. */
+    #include "logging_levels.h"
+    #ifndef LIBRARY_LOG_NAME
+        #define LIBRARY_LOG_NAME     "EcdhePool"
+    #endif
+    #ifndef LIBRARY_LOG_LEVEL
+        #define LIBRARY_LOG_LEVEL    LOG_INFO
+    #endif
+    #include "logging_stack.h"
+
+/* With restartable ECC, mbed TLS generates the ECDHE key pair without
+ * calling mbedtls_ecdh_gen_public, so the pool would never be used. */
+    #ifdef MBEDTLS_ECP_RESTARTABLE
+        #error "MBEDTLS_FREERTOS_ECDHE_POOL cannot be used with MBEDTLS_ECP_RESTARTABLE."
+    #endif
+
+/*-----------------------------------------------------------*/
+
+/* Number of key pairs kept ready. One covers a connect; a second covers a
+ * reconnect that follows soon after. Each takes 97 bytes. */
+    #ifndef MBEDTLS_FREERTOS_ECDHE_POOL_SIZE
+        #define MBEDTLS_FREERTOS_ECDHE_POOL_SIZE    2U
+    #endif
+
+/* Stack of the pool task, in words. It seeds a CTR_DRBG and runs P-256 key
+ * generation. */
+    #ifndef MBEDTLS_FREERTOS_ECDHE_POOL_STACK_WORDS
+        #define MBEDTLS_FREERTOS_ECDHE_POOL_STACK_WORDS    1024U
+    #endif
+
+/* Delay before the pool task tries again after a failed generation, which
+ * is most likely a full heap during a handshake. */
+    #ifndef MBEDTLS_FREERTOS_ECDHE_POOL_RETRY_MS
+        #define MBEDTLS_FREERTOS_ECDHE_POOL_RETRY_MS    1000U
+    #endif
+
+/**
+ * @brief Length of a P-256 private key.
+ */
+    #define ECDHE_PRIVATE_KEY_LENGTH    32U
+
+/**
+ * @brief Length of an uncompressed P-256 public key.
+ */
+    #define ECDHE_PUBLIC_KEY_LENGTH    ( 1U + ( 2U * ECDHE_PRIVATE_KEY_LENGTH ) )
+
+/**
+ * @brief A key pair of the pool, stored in binary so that no heap is held
+ * while it waits.
+ */
+    typedef struct EcdheKeyPair
+    {
+        uint8_t privateKey[ ECDHE_PRIVATE_KEY_LENGTH ]; /**< @brief Big-endian private scalar. */
+        uint8_t publicKey[ ECDHE_PUBLIC_KEY_LENGTH ];   /**< @brief Uncompressed public point. */
+        BaseType_t ready;                               /**< @brief pdTRUE once the pool task has filled the entry. */
+    } EcdheKeyPair_t;
+
+/**
+ * @brief State of the pool task. Static so that the entropy pool is not
+ * placed on the stack of the task.
+ */
+    typedef struct EcdhePoolContext
+    {
+        mbedtls_entropy_context entropy;
+        mbedtls_ctr_drbg_context ctrDrbg;
+        mbedtls_ecp_group group;
+        mbedtls_mpi privateKey;
+        mbedtls_ecp_point publicKey;
+    } EcdhePoolContext_t;
+
+/**
+ * @brief The pool. Entries are only filled by the pool task, and only taken
+ * and erased by mbedtls_ecdh_gen_public with the scheduler suspended.
+ */
+    static EcdheKeyPair_t keyPairs[ MBEDTLS_FREERTOS_ECDHE_POOL_SIZE ];
+
+/**
+ * @brief Counters, updated with the scheduler suspended.
+ */
+    static MbedtlsEcdhePoolStats_t poolStats;
+
+/**
+ * @brief Context of the pool task.
+ */
+    static EcdhePoolContext_t poolContext;
+
+/**
+ * @brief Handle of the pool task, notified when a key pair is taken.
+ */
+    static TaskHandle_t poolTask = NULL;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Seed the random number generator of the pool task and load P-256.
+ *
+ * @param[in] pContext Context of the pool task.
+ *
+ * @return 0 on success, otherwise an mbed TLS error.
+ */
+    static int32_t poolContextInit( EcdhePoolContext_t * pContext );
+
+/**
+ * @brief Generate one key pair into an empty entry of the pool.
+ *
+ * @param[in] pContext Context of the pool task.
+ * @param[out] pKeyPair The empty entry.
+ *
+ * @return 0 on success, otherwise an mbed TLS error.
+ */
+    static int32_t generateKeyPair( EcdhePoolContext_t * pContext,
+                                    EcdheKeyPair_t * pKeyPair );
+
+/**
+ * @brief Take a key pair out of the pool and erase its entry.
+ *
+ * @param[out] pKeyPair Where to copy the key pair.
+ *
+ * @return pdTRUE if a key pair was taken, pdFALSE if the pool is empty.
+ */
+    static BaseType_t takeKeyPair( EcdheKeyPair_t * pKeyPair );
+
+/**
+ * @brief Keep the pool full.
+ *
+ * @param[in] pvParameters Not used.
+ */
+    static void ecdhePoolTask( void * pvParameters );
+
+/*-----------------------------------------------------------*/
+
+    static int32_t poolContextInit( EcdhePoolContext_t * pContext )
+    {
+        int32_t mbedtlsError = 0;
+
+        mbedtls_entropy_init( &( pContext->entropy ) );
+        mbedtls_ctr_drbg_init( &( pContext->ctrDrbg ) );
+        mbedtls_ecp_group_init( &( pContext->group ) );
+        mbedtls_mpi_init( &( pContext->privateKey ) );
+        mbedtls_ecp_point_init( &( pContext->publicKey ) );
+
+        mbedtlsError = mbedtls_entropy_add_source( &( pContext->entropy ),
+                                                   mbedtls_platform_entropy_poll,
+                                                   NULL,
+                                                   32,
+                                                   MBEDTLS_ENTROPY_SOURCE_STRONG );
+
+        if( mbedtlsError == 0 )
+        {
+            mbedtlsError = mbedtls_ctr_drbg_seed( &( pContext->ctrDrbg ),
+                                                  mbedtls_entropy_func,
+                                                  &( pContext->entropy ),
+                                                  NULL,
+                                                  0 );
+        }
+
+        if( mbedtlsError == 0 )
+        {
+            mbedtlsError = mbedtls_ecp_group_load( &( pContext->group ), MBEDTLS_ECP_DP_SECP256R1 );
+        }
+
+        return mbedtlsError;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static int32_t generateKeyPair( EcdhePoolContext_t * pContext,
+                                    EcdheKeyPair_t * pKeyPair )
+    {
+        int32_t mbedtlsError = 0;
+        size_t publicKeyLength = 0U;
+        TickType_t startTicks = xTaskGetTickCount();
+
+        mbedtlsError = mbedtls_ecp_gen_keypair( &( pContext->group ),
+                                                &( pContext->privateKey ),
+                                                &( pContext->publicKey ),
+                                                mbedtls_ctr_drbg_random,
+                                                &( pContext->ctrDrbg ) );
+
+        if( mbedtlsError == 0 )
+        {
+            mbedtlsError = mbedtls_mpi_write_binary( &( pContext->privateKey ),
+                                                     pKeyPair->privateKey,
+                                                     sizeof( pKeyPair->privateKey ) );
+        }
+
+        if( mbedtlsError == 0 )
+        {
+            mbedtlsError = mbedtls_ecp_point_write_binary( &( pContext->group ),
+                                                           &( pContext->publicKey ),
+                                                           MBEDTLS_ECP_PF_UNCOMPRESSED,
+                                                           &publicKeyLength,
+                                                           pKeyPair->publicKey,
+                                                           sizeof( pKeyPair->publicKey ) );
+        }
+
+        /* Do not leave a copy of the private key in the task context. */
+        ( void ) mbedtls_mpi_lset( &( pContext->privateKey ), 0 );
+
+        if( mbedtlsError == 0 )
+        {
+            vTaskSuspendAll();
+            {
+                pKeyPair->ready = pdTRUE;
+                poolStats.keyPairsReady++;
+                poolStats.generateMs = ( uint32_t ) ( ( ( uint64_t ) ( xTaskGetTickCount() - startTicks ) * 1000U ) /
+                                                      configTICK_RATE_HZ );
+            }
+            ( void ) xTaskResumeAll();
+        }
+        else
+        {
+            mbedtls_platform_zeroize( pKeyPair->privateKey, sizeof( pKeyPair->privateKey ) );
+        }
+
+        return mbedtlsError;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static BaseType_t takeKeyPair( EcdheKeyPair_t * pKeyPair )
+    {
+        BaseType_t taken = pdFALSE;
+        size_t index = 0U;
+
+        vTaskSuspendAll();
+        {
+            for( index = 0U; ( index < MBEDTLS_FREERTOS_ECDHE_POOL_SIZE ) && ( taken == pdFALSE ); index++ )
+            {
+                if( keyPairs[ index ].ready == pdTRUE )
+                {
+                    ( void ) memcpy( pKeyPair, &( keyPairs[ index ] ), sizeof( EcdheKeyPair_t ) );
+                    mbedtls_platform_zeroize( &( keyPairs[ index ] ), sizeof( EcdheKeyPair_t ) );
+                    poolStats.keyPairsReady--;
+                    taken = pdTRUE;
+                }
+            }
+
+            if( taken == pdTRUE )
+            {
+                poolStats.hits++;
+            }
+            else
+            {
+                poolStats.misses++;
+            }
+        }
+        ( void ) xTaskResumeAll();
+
+        return taken;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void ecdhePoolTask( void * pvParameters )
+    {
+        int32_t mbedtlsError = 0;
+        size_t index = 0U;
+        EcdheKeyPair_t * pEmpty = NULL;
+
+        ( void ) pvParameters;
+
+        mbedtlsError = poolContextInit( &poolContext );
+
+        if( mbedtlsError != 0 )
+        {
+            LogError( ( "Failed to set up the ECDHE pool: mbedTLSError= -0x%04X. "
+                        "Key pairs will be generated in each handshake.",
+                        ( unsigned int ) -mbedtlsError ) );
+            poolTask = NULL;
+            vTaskDelete( NULL );
+        }
+
+        for( ; ; )
+        {
+            /* Only this task fills entries, so an entry that is empty here
+             * stays empty until it is filled below. */
+            pEmpty = NULL;
+
+            for( index = 0U; ( index < MBEDTLS_FREERTOS_ECDHE_POOL_SIZE ) && ( pEmpty == NULL ); index++ )
+            {
+                if( keyPairs[ index ].ready == pdFALSE )
+                {
+                    pEmpty = &( keyPairs[ index ] );
+                }
+            }
+
+            if( pEmpty == NULL )
+            {
+                /* Wait until a handshake takes a key pair. */
+                ( void ) ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+            }
+            else
+            {
+                mbedtlsError = generateKeyPair( &poolContext, pEmpty );
+
+                if( mbedtlsError != 0 )
+                {
+                    LogWarn( ( "Failed to generate an ECDHE key pair: mbedTLSError= -0x%04X.",
+                               ( unsigned int ) -mbedtlsError ) );
+                    vTaskDelay( pdMS_TO_TICKS( MBEDTLS_FREERTOS_ECDHE_POOL_RETRY_MS ) );
+                }
+            }
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    BaseType_t mbedtls_platform_ecdhe_pool_start( UBaseType_t priority )
+    {
+        BaseType_t status = pdFAIL;
+
+        configASSERT( poolTask == NULL );
+
+        status = xTaskCreate( ecdhePoolTask,
+                              "EcdhePool",
+                              MBEDTLS_FREERTOS_ECDHE_POOL_STACK_WORDS,
+                              NULL,
+                              priority,
+                              &poolTask );
+
+        if( status != pdPASS )
+        {
+            LogError( ( "Failed to create the ECDHE pool task." ) );
+            poolTask = NULL;
+        }
+
+        return status;
+    }
+
+/*-----------------------------------------------------------*/
+
+    void mbedtls_platform_ecdhe_pool_get_stats( MbedtlsEcdhePoolStats_t * pStats )
+    {
+        configASSERT( pStats != NULL );
+
+        vTaskSuspendAll();
+        {
+            ( void ) memcpy( pStats, &poolStats, sizeof( MbedtlsEcdhePoolStats_t ) );
+        }
+        ( void ) xTaskResumeAll();
+    }
+
+/*-----------------------------------------------------------*/
+
+    void mbedtls_platform_ecdhe_pool_log_stats( void )
+    {
+        MbedtlsEcdhePoolStats_t stats;
+
+        mbedtls_platform_ecdhe_pool_get_stats( &stats );
+
+        LogInfo( ( "ECDHE pool: %lu of %u key pairs ready, %lu taken from the pool, "
+                   "%lu generated in a handshake. %lu ms saved per key pair taken.",
+                   ( unsigned long ) stats.keyPairsReady,
+                   ( unsigned int ) MBEDTLS_FREERTOS_ECDHE_POOL_SIZE,
+                   ( unsigned long ) stats.hits,
+                   ( unsigned long ) stats.misses,
+                   ( unsigned long ) stats.generateMs ) );
+    }
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Replaces the implementation of ecdh.c, which MBEDTLS_ECDH_GEN_PUBLIC_ALT
+ * leaves out. Curves other than P-256 and an empty pool fall back to
+ * mbedtls_ecp_gen_keypair, which is what ecdh.c does.
+ */
+    int mbedtls_ecdh_gen_public( mbedtls_ecp_group * grp,
+                                 mbedtls_mpi * d,
+                                 mbedtls_ecp_point * Q,
+                                 int ( * f_rng )( void *, unsigned char *, size_t ),
+                                 void * p_rng )
+    {
+        int mbedtlsError = 0;
+        EcdheKeyPair_t keyPair;
+
+        configASSERT( grp != NULL );
+        configASSERT( d != NULL );
+        configASSERT( Q != NULL );
+
+        if( ( grp->id == MBEDTLS_ECP_DP_SECP256R1 ) &&
+            ( takeKeyPair( &keyPair ) == pdTRUE ) )
+        {
+            mbedtlsError = mbedtls_mpi_read_binary( d,
+                                                    keyPair.privateKey,
+                                                    sizeof( keyPair.privateKey ) );
+
+            if( mbedtlsError == 0 )
+            {
+                mbedtlsError = mbedtls_ecp_point_read_binary( grp,
+                                                              Q,
+                                                              keyPair.publicKey,
+                                                              sizeof( keyPair.publicKey ) );
+            }
+
+            mbedtls_platform_zeroize( &keyPair, sizeof( keyPair ) );
+
+            if( poolTask != NULL )
+            {
+                ( void ) xTaskNotifyGive( poolTask );
+            }
+        }
+        else
+        {
+            mbedtlsError = mbedtls_ecp_gen_keypair( grp, d, Q, f_rng, p_rng );
+        }
+
+        return mbedtlsError;
+    }
+
+#endif /* ifdef MBEDTLS_FREERTOS_ECDHE_POOL */
+
+/*-----------------------------------------------------------*/
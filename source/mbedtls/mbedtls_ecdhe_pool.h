@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/**
+ * @file mbedtls_ecdhe_pool.h
+ * @brief Pool of P-256 key pairs precomputed for the ECDHE key exchange.
+ *
+ * With MBEDTLS_FREERTOS_ECDHE_POOL defined in mbedtls_config.h, a low-priority
+ * task keeps a few ephemeral key pairs ready, and mbedtls_ecdh_gen_public
+ * hands one out instead of generating it. A client handshake generates its
+ * key pair after the ServerKeyExchange, so each pooled key pair takes the
+ * generation time off the handshake. Every key pair is used once and erased.
+ */
+
+#ifndef MBEDTLS_ECDHE_POOL_H_
+    #define MBEDTLS_ECDHE_POOL_H_
+
+    #include <stdint.h>
+
+/* FreeRTOS includes. */
+    #include "FreeRTOS.h"
+
+    #ifdef __cplusplus
+        extern "C" {
+    #endif
+
+/**
+ * @brief Counters of the key pair pool.
+ */
+    typedef struct MbedtlsEcdhePoolStats
+    {
+        uint32_t keyPairsReady; /**< @brief Key pairs in the pool now. */
+        uint32_t hits;          /**< @brief Key pairs handed out from the pool. */
+        uint32_t misses;        /**< @brief P-256 key pairs generated in a handshake because the pool was empty. */
+        uint32_t generateMs;    /**< @brief Time the pool task took for its last key pair, which is about what a hit saves. */
+    } MbedtlsEcdhePoolStats_t;
+
+/**
+ * @brief Create the task that fills the pool.
+ *
+ * Call it early, for example before the modem registers on the network, so
+ * that the pool is full by the first handshake. The task runs whenever no
+ * other task is ready at a higher priority, and refills the pool after each
+ * key pair is taken.
+ *
+ * @param[in] priority Priority of the task. tskIDLE_PRIORITY keeps key
+ * generation out of the way of everything else.
+ *
+ * @return pdPASS if the task runs, otherwise pdFAIL.
+ */
+    BaseType_t mbedtls_platform_ecdhe_pool_start( UBaseType_t priority );
+
+/**
+ * @brief Read the counters of the pool.
+ *
+ * @param[out] pStats Where to write the counters.
+ */
+    void mbedtls_platform_ecdhe_pool_get_stats( MbedtlsEcdhePoolStats_t * pStats );
+
+/**
+ * @brief Log the counters of the pool.
+ */
+    void mbedtls_platform_ecdhe_pool_log_stats( void );
+
+    #ifdef __cplusplus
+        }
+    #endif
+
+#endif /* ifndef MBEDTLS_ECDHE_POOL_H_ */
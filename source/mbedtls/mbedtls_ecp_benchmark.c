@@ -0,0 +1,446 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file mbedtls_ecp_benchmark.c
+ * @brief Timing and memory benchmark of the P-256 operations of a handshake.
+ */
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* mbed TLS includes. */
+#include "mbedtls_config.h"
+#include "mbedtls_ecp_benchmark.h"
+
+#ifdef MBEDTLS_FREERTOS_ECP_BENCHMARK
+
+    #include "mbedtls/ctr_drbg.h"
+    #include "mbedtls/ecdh.h"
+    #include "mbedtls/ecdsa.h"
+    #include "mbedtls/entropy.h"
+
+    #ifdef MBEDTLS_FREERTOS_SLAB_ALLOC
+        #include "mbedtls_slab_alloc.h"
+    #endif
+
+/* Configure logs for the functions in this file. */
+    #include "logging_levels.h"
+    #ifndef LIBRARY_LOG_NAME
+        #define LIBRARY_LOG_NAME     "EcpBenchmark"
+    #endif
+    #ifndef LIBRARY_LOG_LEVEL
+        #define LIBRARY_LOG_LEVEL    LOG_INFO
+    #endif
+    #include "logging_stack.h"
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief The operations that are timed.
+ */
+    typedef enum EcpOperation
+    {
+        ECP_OPERATION_ECDH_GEN_PUBLIC,
+        ECP_OPERATION_ECDH_COMPUTE_SHARED,
+        ECP_OPERATION_ECDSA_SIGN,
+        ECP_OPERATION_ECDSA_VERIFY
+    } EcpOperation_t;
+
+/**
+ * @brief Keys and outputs shared by the operations.
+ */
+    typedef struct EcpBenchmarkContext
+    {
+        mbedtls_entropy_context entropy;
+        mbedtls_ctr_drbg_context ctrDrbg;
+        mbedtls_ecp_group group;
+        mbedtls_mpi privateKey;
+        mbedtls_ecp_point publicKey;
+        mbedtls_mpi sharedSecret;
+        mbedtls_mpi r;
+        mbedtls_mpi s;
+    } EcpBenchmarkContext_t;
+
+/**
+ * @brief Benchmark context. Static so that the entropy pool is not placed on
+ * the stack of the calling task.
+ */
+    static EcpBenchmarkContext_t benchmarkContext;
+
+/**
+ * @brief Digest signed and verified by the ECDSA operations.
+ */
+    static const unsigned char benchmarkHash[ 32 ] = { 0x42 };
+
+/**
+ * @brief Heap held by mbed TLS. It is measured from the free heap around each
+ * allocation, so block headers are included.
+ */
+    static size_t heapBytesInUse = 0U;
+
+/**
+ * @brief Highest #heapBytesInUse since the last heapResetPeak().
+ */
+    static size_t heapPeakBytesInUse = 0U;
+
+/*-----------------------------------------------------------*/
+
+    #ifndef MBEDTLS_FREERTOS_SLAB_ALLOC
+
+/**
+ * @brief Read the heap held by mbed TLS and its peak.
+ *
+ * @param[out] pBytesInUse Heap held now, with block headers.
+ * @param[out] pPeakBytesInUse Highest heap held since the last
+ * heapResetPeak().
+ */
+        static void heapGetUsage( size_t * pBytesInUse,
+                                  size_t * pPeakBytesInUse );
+
+/**
+ * @brief Start a new peak of heapGetUsage() from the heap held now.
+ */
+        static void heapResetPeak( void );
+
+    #endif /* ifndef MBEDTLS_FREERTOS_SLAB_ALLOC */
+
+/**
+ * @brief Run an operation once.
+ *
+ * @param[in] pContext Benchmark context.
+ * @param[in] operation The operation.
+ *
+ * @return 0 on success, otherwise an mbed TLS error.
+ */
+    static int32_t runOperation( EcpBenchmarkContext_t * pContext,
+                                 EcpOperation_t operation );
+
+/**
+ * @brief Run an operation a number of times.
+ *
+ * @param[in] pContext Benchmark context.
+ * @param[in] operation The operation.
+ * @param[in] iterations Number of runs.
+ * @param[out] pAverageUs Average time of a run.
+ * @param[in,out] pPeakRamBytes Raised to the peak memory of the runs.
+ *
+ * @return 0 on success, otherwise an mbed TLS error.
+ */
+    static int32_t timeOperation( EcpBenchmarkContext_t * pContext,
+                                  EcpOperation_t operation,
+                                  uint32_t iterations,
+                                  uint32_t * pAverageUs,
+                                  uint32_t * pPeakRamBytes );
+
+/*-----------------------------------------------------------*/
+
+    void * mbedtls_platform_heap_tracked_calloc( size_t nmemb,
+                                                 size_t size )
+    {
+        void * pBuffer = NULL;
+        size_t freeHeapBefore = 0U;
+
+        /* Keep other tasks from using the heap between the two readings. */
+        vTaskSuspendAll();
+        {
+            freeHeapBefore = xPortGetFreeHeapSize();
+            pBuffer = mbedtls_platform_calloc( nmemb, size );
+            heapBytesInUse += freeHeapBefore - xPortGetFreeHeapSize();
+
+            if( heapBytesInUse > heapPeakBytesInUse )
+            {
+                heapPeakBytesInUse = heapBytesInUse;
+            }
+        }
+        ( void ) xTaskResumeAll();
+
+        return pBuffer;
+    }
+
+/*-----------------------------------------------------------*/
+
+    void mbedtls_platform_heap_tracked_free( void * ptr )
+    {
+        size_t freeHeapBefore = 0U;
+
+        vTaskSuspendAll();
+        {
+            freeHeapBefore = xPortGetFreeHeapSize();
+            mbedtls_platform_free( ptr );
+            heapBytesInUse -= xPortGetFreeHeapSize() - freeHeapBefore;
+        }
+        ( void ) xTaskResumeAll();
+    }
+
+/*-----------------------------------------------------------*/
+
+    #ifndef MBEDTLS_FREERTOS_SLAB_ALLOC
+
+        static void heapGetUsage( size_t * pBytesInUse,
+                                  size_t * pPeakBytesInUse )
+        {
+            vTaskSuspendAll();
+            {
+                *pBytesInUse = heapBytesInUse;
+                *pPeakBytesInUse = heapPeakBytesInUse;
+            }
+            ( void ) xTaskResumeAll();
+        }
+
+/*-----------------------------------------------------------*/
+
+        static void heapResetPeak( void )
+        {
+            vTaskSuspendAll();
+            {
+                heapPeakBytesInUse = heapBytesInUse;
+            }
+            ( void ) xTaskResumeAll();
+        }
+
+    #endif /* ifndef MBEDTLS_FREERTOS_SLAB_ALLOC */
+
+/*-----------------------------------------------------------*/
+
+    static int32_t runOperation( EcpBenchmarkContext_t * pContext,
+                                 EcpOperation_t operation )
+    {
+        int32_t mbedtlsError = 0;
+
+        switch( operation )
+        {
+            case ECP_OPERATION_ECDH_GEN_PUBLIC:
+                /* The same computation as mbedtls_ecdh_gen_public, which the
+                 * ECDHE pool may answer without computing anything. */
+                mbedtlsError = mbedtls_ecp_gen_keypair( &( pContext->group ),
+                                                        &( pContext->privateKey ),
+                                                        &( pContext->publicKey ),
+                                                        mbedtls_ctr_drbg_random,
+                                                        &( pContext->ctrDrbg ) );
+                break;
+
+            case ECP_OPERATION_ECDH_COMPUTE_SHARED:
+                /* The own public key stands in for the peer point. */
+                mbedtlsError = mbedtls_ecdh_compute_shared( &( pContext->group ),
+                                                            &( pContext->sharedSecret ),
+                                                            &( pContext->publicKey ),
+                                                            &( pContext->privateKey ),
+                                                            mbedtls_ctr_drbg_random,
+                                                            &( pContext->ctrDrbg ) );
+                break;
+
+            case ECP_OPERATION_ECDSA_SIGN:
+                mbedtlsError = mbedtls_ecdsa_sign( &( pContext->group ),
+                                                   &( pContext->r ),
+                                                   &( pContext->s ),
+                                                   &( pContext->privateKey ),
+                                                   benchmarkHash,
+                                                   sizeof( benchmarkHash ),
+                                                   mbedtls_ctr_drbg_random,
+                                                   &( pContext->ctrDrbg ) );
+                break;
+
+            case ECP_OPERATION_ECDSA_VERIFY:
+            default:
+                mbedtlsError = mbedtls_ecdsa_verify( &( pContext->group ),
+                                                     benchmarkHash,
+                                                     sizeof( benchmarkHash ),
+                                                     &( pContext->publicKey ),
+                                                     &( pContext->r ),
+                                                     &( pContext->s ) );
+                break;
+        }
+
+        return mbedtlsError;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static int32_t timeOperation( EcpBenchmarkContext_t * pContext,
+                                  EcpOperation_t operation,
+                                  uint32_t iterations,
+                                  uint32_t * pAverageUs,
+                                  uint32_t * pPeakRamBytes )
+    {
+        int32_t mbedtlsError = 0;
+        uint32_t run = 0U;
+        uint32_t peakRamBytes = 0U;
+        TickType_t startTicks = 0;
+        TickType_t elapsedTicks = 0;
+
+        #ifdef MBEDTLS_FREERTOS_SLAB_ALLOC
+            MbedtlsSlabStats_t stats;
+            size_t bytesInUseBefore = 0U;
+
+            mbedtls_platform_slab_get_stats( &stats );
+            bytesInUseBefore = stats.bytesInUse;
+            mbedtls_platform_slab_reset_peak();
+        #else
+            size_t bytesInUseBefore = 0U;
+            size_t bytesInUse = 0U;
+            size_t peakBytesInUse = 0U;
+
+            heapGetUsage( &bytesInUseBefore, &peakBytesInUse );
+            heapResetPeak();
+        #endif
+
+        startTicks = xTaskGetTickCount();
+
+        for( run = 0U; ( run < iterations ) && ( mbedtlsError == 0 ); run++ )
+        {
+            mbedtlsError = runOperation( pContext, operation );
+        }
+
+        elapsedTicks = xTaskGetTickCount() - startTicks;
+
+        #ifdef MBEDTLS_FREERTOS_SLAB_ALLOC
+            mbedtls_platform_slab_get_stats( &stats );
+            peakRamBytes = ( uint32_t ) ( stats.peakBytesInUse - bytesInUseBefore );
+
+            if( stats.heapAllocations > 0U )
+            {
+                LogDebug( ( "%lu allocations so far went to the heap and are not in the peak.",
+                            ( unsigned long ) stats.heapAllocations ) );
+            }
+        #else
+            heapGetUsage( &bytesInUse, &peakBytesInUse );
+            peakRamBytes = ( uint32_t ) ( peakBytesInUse - bytesInUseBefore );
+        #endif
+
+        *pAverageUs = ( uint32_t ) ( ( ( uint64_t ) elapsedTicks * 1000000U ) /
+                                     ( ( uint64_t ) configTICK_RATE_HZ * iterations ) );
+
+        if( peakRamBytes > *pPeakRamBytes )
+        {
+            *pPeakRamBytes = peakRamBytes;
+        }
+
+        return mbedtlsError;
+    }
+
+/*-----------------------------------------------------------*/
+
+    int32_t mbedtls_platform_ecp_benchmark( uint32_t iterations,
+                                            MbedtlsEcpBenchmark_t * pResult )
+    {
+        EcpBenchmarkContext_t * pContext = &benchmarkContext;
+        MbedtlsEcpBenchmark_t result = { 0 };
+        int32_t mbedtlsError = 0;
+
+        configASSERT( iterations > 0U );
+
+        mbedtls_entropy_init( &( pContext->entropy ) );
+        mbedtls_ctr_drbg_init( &( pContext->ctrDrbg ) );
+        mbedtls_ecp_group_init( &( pContext->group ) );
+        mbedtls_mpi_init( &( pContext->privateKey ) );
+        mbedtls_ecp_point_init( &( pContext->publicKey ) );
+        mbedtls_mpi_init( &( pContext->sharedSecret ) );
+        mbedtls_mpi_init( &( pContext->r ) );
+        mbedtls_mpi_init( &( pContext->s ) );
+
+        mbedtlsError = mbedtls_entropy_add_source( &( pContext->entropy ),
+                                                   mbedtls_platform_entropy_poll,
+                                                   NULL,
+                                                   32,
+                                                   MBEDTLS_ENTROPY_SOURCE_STRONG );
+
+        if( mbedtlsError == 0 )
+        {
+            mbedtlsError = mbedtls_ctr_drbg_seed( &( pContext->ctrDrbg ),
+                                                  mbedtls_entropy_func,
+                                                  &( pContext->entropy ),
+                                                  NULL,
+                                                  0 );
+        }
+
+        if( mbedtlsError == 0 )
+        {
+            mbedtlsError = mbedtls_ecp_group_load( &( pContext->group ), MBEDTLS_ECP_DP_SECP256R1 );
+        }
+
+        /* Each operation uses the outputs of the one before. */
+        if( mbedtlsError == 0 )
+        {
+            mbedtlsError = timeOperation( pContext, ECP_OPERATION_ECDH_GEN_PUBLIC, iterations,
+                                          &( result.ecdhGenPublicUs ), &( result.peakRamBytes ) );
+        }
+
+        if( mbedtlsError == 0 )
+        {
+            mbedtlsError = timeOperation( pContext, ECP_OPERATION_ECDH_COMPUTE_SHARED, iterations,
+                                          &( result.ecdhComputeSharedUs ), &( result.peakRamBytes ) );
+        }
+
+        if( mbedtlsError == 0 )
+        {
+            mbedtlsError = timeOperation( pContext, ECP_OPERATION_ECDSA_SIGN, iterations,
+                                          &( result.ecdsaSignUs ), &( result.peakRamBytes ) );
+        }
+
+        if( mbedtlsError == 0 )
+        {
+            mbedtlsError = timeOperation( pContext, ECP_OPERATION_ECDSA_VERIFY, iterations,
+                                          &( result.ecdsaVerifyUs ), &( result.peakRamBytes ) );
+        }
+
+        if( mbedtlsError == 0 )
+        {
+            LogInfo( ( "P-256 with window %u, fixed-point optimization %u, %lu iterations:",
+                       ( unsigned int ) MBEDTLS_ECP_WINDOW_SIZE,
+                       ( unsigned int ) MBEDTLS_ECP_FIXED_POINT_OPTIM,
+                       ( unsigned long ) iterations ) );
+            LogInfo( ( "ECDHE key pair %lu us, shared secret %lu us. "
+                       "ECDSA sign %lu us, verify %lu us. Peak RAM %lu bytes.",
+                       ( unsigned long ) result.ecdhGenPublicUs,
+                       ( unsigned long ) result.ecdhComputeSharedUs,
+                       ( unsigned long ) result.ecdsaSignUs,
+                       ( unsigned long ) result.ecdsaVerifyUs,
+                       ( unsigned long ) result.peakRamBytes ) );
+        }
+        else
+        {
+            LogError( ( "ECP benchmark failed: mbedTLSError= -0x%04X.",
+                        ( unsigned int ) -mbedtlsError ) );
+        }
+
+        mbedtls_mpi_free( &( pContext->s ) );
+        mbedtls_mpi_free( &( pContext->r ) );
+        mbedtls_mpi_free( &( pContext->sharedSecret ) );
+        mbedtls_ecp_point_free( &( pContext->publicKey ) );
+        mbedtls_mpi_free( &( pContext->privateKey ) );
+        mbedtls_ecp_group_free( &( pContext->group ) );
+        mbedtls_ctr_drbg_free( &( pContext->ctrDrbg ) );
+        mbedtls_entropy_free( &( pContext->entropy ) );
+
+        if( pResult != NULL )
+        {
+            *pResult = result;
+        }
+
+        return mbedtlsError;
+    }
+
+#endif /* ifdef MBEDTLS_FREERTOS_ECP_BENCHMARK */
+
+/*-----------------------------------------------------------*/
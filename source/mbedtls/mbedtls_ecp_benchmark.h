@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file mbedtls_ecp_benchmark.h
+ * @brief Timing and memory benchmark of the P-256 operations of a handshake.
+ *
+ * Built when MBEDTLS_FREERTOS_ECP_BENCHMARK is defined in mbedtls_config.h.
+ * Run it with and without MBEDTLS_FREERTOS_ECP_LOW_RAM_PROFILE to compare the
+ * two ECP settings of mbedtls_config.h.
+ */
+
+#ifndef MBEDTLS_ECP_BENCHMARK_H_
+    #define MBEDTLS_ECP_BENCHMARK_H_
+
+    #include <stddef.h>
+    #include <stdint.h>
+
+    #ifdef __cplusplus
+        extern "C" {
+    #endif
+
+/**
+ * @brief Average cost of each P-256 operation of an ECDHE-ECDSA handshake.
+ */
+    typedef struct MbedtlsEcpBenchmark
+    {
+        uint32_t ecdhGenPublicUs;     /**< @brief ECDHE key pair generation, a multiplication of the generator. */
+        uint32_t ecdhComputeSharedUs; /**< @brief ECDHE shared secret, a multiplication of the peer point. */
+        uint32_t ecdsaSignUs;         /**< @brief ECDSA signature, as for CertificateVerify. */
+        uint32_t ecdsaVerifyUs;       /**< @brief ECDSA verification, as for each certificate and ServerKeyExchange. */
+        uint32_t peakRamBytes;        /**< @brief Peak memory allocated by mbed TLS during one operation. */
+    } MbedtlsEcpBenchmark_t;
+
+/**
+ * @brief Time the P-256 operations and log the results.
+ *
+ * Times are taken from the tick count, so use enough iterations for the total
+ * of each operation to span many ticks. Peak memory is what mbed TLS holds
+ * during an operation beyond what it held before, whoever allocates it, so
+ * run the benchmark before other tasks use mbed TLS. With
+ * MBEDTLS_FREERTOS_SLAB_ALLOC it counts the slab blocks, and is too low if an
+ * allocation does not fit in the pools; otherwise it counts the FreeRTOS heap
+ * blocks with their headers.
+ *
+ * @param[in] iterations Number of times each operation is run.
+ * @param[out] pResult Where to write the results. May be NULL.
+ *
+ * @return 0 on success, otherwise the first mbed TLS error.
+ */
+    int32_t mbedtls_platform_ecp_benchmark( uint32_t iterations,
+                                            MbedtlsEcpBenchmark_t * pResult );
+
+/**
+ * @brief mbedtls_platform_calloc() that also counts the FreeRTOS heap it takes,
+ * for the peak memory of the benchmark.
+ *
+ * mbedtls_config.h makes it the allocator of mbed TLS when
+ * MBEDTLS_FREERTOS_ECP_BENCHMARK is defined.
+ *
+ * @param[in] nmemb Number of members that need to be allocated.
+ * @param[in] size Size of each member.
+ *
+ * @return The block, or NULL.
+ */
+    void * mbedtls_platform_heap_tracked_calloc( size_t nmemb,
+                                                 size_t size );
+
+/**
+ * @brief mbedtls_platform_free() for blocks of
+ * mbedtls_platform_heap_tracked_calloc().
+ *
+ * @param[in] ptr The block, or NULL.
+ */
+    void mbedtls_platform_heap_tracked_free( void * ptr );
+
+    #ifdef __cplusplus
+        }
+    #endif
+
+#endif /* ifndef MBEDTLS_ECP_BENCHMARK_H_ */
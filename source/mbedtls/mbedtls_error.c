@@ -25,6 +25,12 @@
  * @brief This files defines the stringification utilities for mbed TLS high-level and low-level codes.
  */
 
+#include <stddef.h>
+#include <stdlib.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
 #include "mbedtls_error.h"
 
 #if !defined( MBEDTLS_CONFIG_FILE )
@@ -33,6 +39,8 @@
     #include MBEDTLS_CONFIG_FILE
 #endif
 
+#include "mbedtls/version.h"
+
 #if defined( MBEDTLS_AES_C )
     #include "mbedtls/aes.h"
 #endif
@@ -202,663 +210,635 @@
 #endif
 
 
-const char * mbedtls_strerror_highlevel( int32_t errnum )
-{
-    const char * rc = NULL;
-    uint32_t use_ret = 0;
-
-    if( errnum < 0 )
-    {
-        use_ret = ( uint32_t ) -errnum;
-    }
-    else
-    {
-        use_ret = ( uint32_t ) errnum;
-    }
-
-    use_ret &= 0xFF80;
-
-    /* High level error codes */
-    switch( use_ret )
-    {
-        #if defined( MBEDTLS_CIPHER_C )
-            case -( MBEDTLS_ERR_CIPHER_FEATURE_UNAVAILABLE ):
-                rc = "CIPHER - The selected feature is not available";
-                break;
-
-            case -( MBEDTLS_ERR_CIPHER_BAD_INPUT_DATA ):
-                rc = "CIPHER - Bad input parameters";
-                break;
-
-            case -( MBEDTLS_ERR_CIPHER_ALLOC_FAILED ):
-                rc = "CIPHER - Failed to allocate memory";
-                break;
-
-            case -( MBEDTLS_ERR_CIPHER_INVALID_PADDING ):
-                rc = "CIPHER - Input data contains invalid padding and is rejected";
-                break;
-
-            case -( MBEDTLS_ERR_CIPHER_FULL_BLOCK_EXPECTED ):
-                rc = "CIPHER - Decryption of block requires a full block";
-                break;
-
-            case -( MBEDTLS_ERR_CIPHER_AUTH_FAILED ):
-                rc = "CIPHER - Authentication failed (for AEAD modes)";
-                break;
-
-            case -( MBEDTLS_ERR_CIPHER_INVALID_CONTEXT ):
-                rc = "CIPHER - The context is invalid. For example, because it was freed";
-                break;
-
-            case -( MBEDTLS_ERR_CIPHER_HW_ACCEL_FAILED ):
-                rc = "CIPHER - Cipher hardware accelerator failed";
-                break;
-        #endif /* MBEDTLS_CIPHER_C */
-
-        #if defined( MBEDTLS_DHM_C )
-            case -( MBEDTLS_ERR_DHM_BAD_INPUT_DATA ):
-                rc = "DHM - Bad input parameters";
-                break;
-
-            case -( MBEDTLS_ERR_DHM_READ_PARAMS_FAILED ):
-                rc = "DHM - Reading of the DHM parameters failed";
-                break;
-
-            case -( MBEDTLS_ERR_DHM_MAKE_PARAMS_FAILED ):
-                rc = "DHM - Making of the DHM parameters failed";
-                break;
-
-            case -( MBEDTLS_ERR_DHM_READ_PUBLIC_FAILED ):
-                rc = "DHM - Reading of the public values failed";
-                break;
-
-            case -( MBEDTLS_ERR_DHM_MAKE_PUBLIC_FAILED ):
-                rc = "DHM - Making of the public value failed";
-                break;
-
-            case -( MBEDTLS_ERR_DHM_CALC_SECRET_FAILED ):
-                rc = "DHM - Calculation of the DHM secret failed";
-                break;
-
-            case -( MBEDTLS_ERR_DHM_INVALID_FORMAT ):
-                rc = "DHM - The ASN.1 data is not formatted correctly";
-                break;
-
-            case -( MBEDTLS_ERR_DHM_ALLOC_FAILED ):
-                rc = "DHM - Allocation of memory failed";
-                break;
-
-            case -( MBEDTLS_ERR_DHM_FILE_IO_ERROR ):
-                rc = "DHM - Read or write of file failed";
-                break;
-
-            case -( MBEDTLS_ERR_DHM_HW_ACCEL_FAILED ):
-                rc = "DHM - DHM hardware accelerator failed";
-                break;
-
-            case -( MBEDTLS_ERR_DHM_SET_GROUP_FAILED ):
-                rc = "DHM - Setting the modulus and generator failed";
-                break;
-        #endif /* MBEDTLS_DHM_C */
-
-        #if defined( MBEDTLS_ECP_C )
-            case -( MBEDTLS_ERR_ECP_BAD_INPUT_DATA ):
-                rc = "ECP - Bad input parameters to function";
-                break;
-
-            case -( MBEDTLS_ERR_ECP_BUFFER_TOO_SMALL ):
-                rc = "ECP - The buffer is too small to write to";
-                break;
-
-            case -( MBEDTLS_ERR_ECP_FEATURE_UNAVAILABLE ):
-                rc = "ECP - The requested feature is not available, for example, the requested curve is not supported";
-                break;
-
-            case -( MBEDTLS_ERR_ECP_VERIFY_FAILED ):
-                rc = "ECP - The signature is not valid";
-                break;
-
-            case -( MBEDTLS_ERR_ECP_ALLOC_FAILED ):
-                rc = "ECP - Memory allocation failed";
-                break;
-
-            case -( MBEDTLS_ERR_ECP_RANDOM_FAILED ):
-                rc = "ECP - Generation of random value, such as ephemeral key, failed";
-                break;
-
-            case -( MBEDTLS_ERR_ECP_INVALID_KEY ):
-                rc = "ECP - Invalid private or public key";
-                break;
-
-            case -( MBEDTLS_ERR_ECP_SIG_LEN_MISMATCH ):
-                rc = "ECP - The buffer contains a valid signature followed by more data";
-                break;
-
-            case -( MBEDTLS_ERR_ECP_HW_ACCEL_FAILED ):
-                rc = "ECP - The ECP hardware accelerator failed";
-                break;
-
-            case -( MBEDTLS_ERR_ECP_IN_PROGRESS ):
-                rc = "ECP - Operation in progress, call again with the same parameters to continue";
-                break;
-        #endif /* MBEDTLS_ECP_C */
-
-        #if defined( MBEDTLS_MD_C )
-            case -( MBEDTLS_ERR_MD_FEATURE_UNAVAILABLE ):
-                rc = "MD - The selected feature is not available";
-                break;
+/**
+ * @brief Mask of the high-level part of an mbed TLS error code.
+ */
+#define HIGH_LEVEL_CODE_MASK    0xFF80U
 
-            case -( MBEDTLS_ERR_MD_BAD_INPUT_DATA ):
-                rc = "MD - Bad input parameters to function";
-                break;
+/**
+ * @brief Mask of the low-level part of an mbed TLS error code.
+ */
+#define LOW_LEVEL_CODE_MASK     0x007FU
 
-            case -( MBEDTLS_ERR_MD_ALLOC_FAILED ):
-                rc = "MD - Failed to allocate memory";
-                break;
+/**
+ * @brief Number of error codes in a table, without the terminating entry.
+ */
+#define ERROR_TABLE_LENGTH( table )    ( ( sizeof( table ) / sizeof( ( table )[ 0 ] ) ) - 1U )
 
-            case -( MBEDTLS_ERR_MD_FILE_IO_ERROR ):
-                rc = "MD - Opening or reading of file failed";
-                break;
+#if !defined( MBEDTLS_ERROR_NUMERIC_ONLY )
 
-            case -( MBEDTLS_ERR_MD_HW_ACCEL_FAILED ):
-                rc = "MD - MD hardware accelerator failed";
-                break;
-        #endif /* MBEDTLS_MD_C */
+/**
+ * @brief An mbed TLS error code and its description.
+ */
+    typedef struct ErrorString
+    {
+        uint16_t code;         /**< @brief Negated value of the error code. */
+        const char * pString;  /**< @brief Description of the error code. */
+    } ErrorString_t;
 
+/**
+ * @brief Descriptions of the high-level error codes.
+ *
+ * The entries are sorted by the values that the codes have in mbed TLS 2.28,
+ * so that findErrorString() can use a binary search. The order is checked by
+ * an assert on the first lookup. Codes that mbed TLS 3.0 removed are only
+ * listed for mbed TLS 2.x.
+ */
+    static const ErrorString_t highLevelErrors[] =
+    {
         #if defined( MBEDTLS_PEM_PARSE_C ) || defined( MBEDTLS_PEM_WRITE_C )
-            case -( MBEDTLS_ERR_PEM_NO_HEADER_FOOTER_PRESENT ):
-                rc = "PEM - No PEM header or footer found";
-                break;
-
-            case -( MBEDTLS_ERR_PEM_INVALID_DATA ):
-                rc = "PEM - PEM string is not as expected";
-                break;
-
-            case -( MBEDTLS_ERR_PEM_ALLOC_FAILED ):
-                rc = "PEM - Failed to allocate memory";
-                break;
-
-            case -( MBEDTLS_ERR_PEM_INVALID_ENC_IV ):
-                rc = "PEM - RSA IV is not in hex-format";
-                break;
-
-            case -( MBEDTLS_ERR_PEM_UNKNOWN_ENC_ALG ):
-                rc = "PEM - Unsupported key encryption algorithm";
-                break;
-
-            case -( MBEDTLS_ERR_PEM_PASSWORD_REQUIRED ):
-                rc = "PEM - Private key password can't be empty";
-                break;
-
-            case -( MBEDTLS_ERR_PEM_PASSWORD_MISMATCH ):
-                rc = "PEM - Given private key password does not allow for correct decryption";
-                break;
-
-            case -( MBEDTLS_ERR_PEM_FEATURE_UNAVAILABLE ):
-                rc = "PEM - Unavailable feature, e.g. hashing/encryption combination";
-                break;
-
-            case -( MBEDTLS_ERR_PEM_BAD_INPUT_DATA ):
-                rc = "PEM - Bad input parameters to function";
-                break;
-        #endif /* MBEDTLS_PEM_PARSE_C || MBEDTLS_PEM_WRITE_C */
-
-        #if defined( MBEDTLS_PK_C )
-            case -( MBEDTLS_ERR_PK_ALLOC_FAILED ):
-                rc = "PK - Memory allocation failed";
-                break;
-
-            case -( MBEDTLS_ERR_PK_TYPE_MISMATCH ):
-                rc = "PK - Type mismatch, eg attempt to encrypt with an ECDSA key";
-                break;
-
-            case -( MBEDTLS_ERR_PK_BAD_INPUT_DATA ):
-                rc = "PK - Bad input parameters to function";
-                break;
-
-            case -( MBEDTLS_ERR_PK_FILE_IO_ERROR ):
-                rc = "PK - Read/write of file failed";
-                break;
-
-            case -( MBEDTLS_ERR_PK_KEY_INVALID_VERSION ):
-                rc = "PK - Unsupported key version";
-                break;
-
-            case -( MBEDTLS_ERR_PK_KEY_INVALID_FORMAT ):
-                rc = "PK - Invalid key tag or value";
-                break;
-
-            case -( MBEDTLS_ERR_PK_UNKNOWN_PK_ALG ):
-                rc = "PK - Key algorithm is unsupported (only RSA and EC are supported)";
-                break;
-
-            case -( MBEDTLS_ERR_PK_PASSWORD_REQUIRED ):
-                rc = "PK - Private key password can't be empty";
-                break;
-
-            case -( MBEDTLS_ERR_PK_PASSWORD_MISMATCH ):
-                rc = "PK - Given private key password does not allow for correct decryption";
-                break;
-
-            case -( MBEDTLS_ERR_PK_INVALID_PUBKEY ):
-                rc = "PK - The pubkey tag or value is invalid (only RSA and EC are supported)";
-                break;
-
-            case -( MBEDTLS_ERR_PK_INVALID_ALG ):
-                rc = "PK - The algorithm tag or value is invalid";
-                break;
-
-            case -( MBEDTLS_ERR_PK_UNKNOWN_NAMED_CURVE ):
-                rc = "PK - Elliptic curve is unsupported (only NIST curves are supported)";
-                break;
-
-            case -( MBEDTLS_ERR_PK_FEATURE_UNAVAILABLE ):
-                rc = "PK - Unavailable feature, e.g. RSA disabled for RSA key";
-                break;
-
-            case -( MBEDTLS_ERR_PK_SIG_LEN_MISMATCH ):
-                rc = "PK - The buffer contains a valid signature followed by more data";
-                break;
-
-            case -( MBEDTLS_ERR_PK_HW_ACCEL_FAILED ):
-                rc = "PK - PK hardware accelerator failed";
-                break;
-        #endif /* MBEDTLS_PK_C */
-
+            { -( MBEDTLS_ERR_PEM_NO_HEADER_FOOTER_PRESENT ), "PEM - No PEM header or footer found" },
+            { -( MBEDTLS_ERR_PEM_INVALID_DATA ), "PEM - PEM string is not as expected" },
+            { -( MBEDTLS_ERR_PEM_ALLOC_FAILED ), "PEM - Failed to allocate memory" },
+            { -( MBEDTLS_ERR_PEM_INVALID_ENC_IV ), "PEM - RSA IV is not in hex-format" },
+            { -( MBEDTLS_ERR_PEM_UNKNOWN_ENC_ALG ), "PEM - Unsupported key encryption algorithm" },
+            { -( MBEDTLS_ERR_PEM_PASSWORD_REQUIRED ), "PEM - Private key password can't be empty" },
+            { -( MBEDTLS_ERR_PEM_PASSWORD_MISMATCH ), "PEM - Given private key password does not allow for correct decryption" },
+            { -( MBEDTLS_ERR_PEM_FEATURE_UNAVAILABLE ), "PEM - Unavailable feature, e.g. hashing/encryption combination" },
+            { -( MBEDTLS_ERR_PEM_BAD_INPUT_DATA ), "PEM - Bad input parameters to function" },
+        #endif
         #if defined( MBEDTLS_PKCS12_C )
-            case -( MBEDTLS_ERR_PKCS12_BAD_INPUT_DATA ):
-                rc = "PKCS12 - Bad input parameters to function";
-                break;
-
-            case -( MBEDTLS_ERR_PKCS12_FEATURE_UNAVAILABLE ):
-                rc = "PKCS12 - Feature not available, e.g. unsupported encryption scheme";
-                break;
-
-            case -( MBEDTLS_ERR_PKCS12_PBE_INVALID_FORMAT ):
-                rc = "PKCS12 - PBE ASN.1 data not as expected";
-                break;
-
-            case -( MBEDTLS_ERR_PKCS12_PASSWORD_MISMATCH ):
-                rc = "PKCS12 - Given private key password does not allow for correct decryption";
-                break;
-        #endif /* MBEDTLS_PKCS12_C */
-
+            { -( MBEDTLS_ERR_PKCS12_PASSWORD_MISMATCH ), "PKCS12 - Given private key password does not allow for correct decryption" },
+            { -( MBEDTLS_ERR_PKCS12_PBE_INVALID_FORMAT ), "PKCS12 - PBE ASN.1 data not as expected" },
+            { -( MBEDTLS_ERR_PKCS12_FEATURE_UNAVAILABLE ), "PKCS12 - Feature not available, e.g. unsupported encryption scheme" },
+            { -( MBEDTLS_ERR_PKCS12_BAD_INPUT_DATA ), "PKCS12 - Bad input parameters to function" },
+        #endif
+        #if defined( MBEDTLS_X509_USE_C ) || defined( MBEDTLS_X509_CREATE_C )
+            { -( MBEDTLS_ERR_X509_FEATURE_UNAVAILABLE ), "X509 - Unavailable feature, e.g. RSA hashing/encryption combination" },
+            { -( MBEDTLS_ERR_X509_UNKNOWN_OID ), "X509 - Requested OID is unknown" },
+            { -( MBEDTLS_ERR_X509_INVALID_FORMAT ), "X509 - The CRT/CRL/CSR format is invalid, e.g. different type expected" },
+            { -( MBEDTLS_ERR_X509_INVALID_VERSION ), "X509 - The CRT/CRL/CSR version element is invalid" },
+            { -( MBEDTLS_ERR_X509_INVALID_SERIAL ), "X509 - The serial tag or value is invalid" },
+            { -( MBEDTLS_ERR_X509_INVALID_ALG ), "X509 - The algorithm tag or value is invalid" },
+            { -( MBEDTLS_ERR_X509_INVALID_NAME ), "X509 - The name tag or value is invalid" },
+            { -( MBEDTLS_ERR_X509_INVALID_DATE ), "X509 - The date tag or value is invalid" },
+            { -( MBEDTLS_ERR_X509_INVALID_SIGNATURE ), "X509 - The signature tag or value invalid" },
+            { -( MBEDTLS_ERR_X509_INVALID_EXTENSIONS ), "X509 - The extension tag or value is invalid" },
+            { -( MBEDTLS_ERR_X509_UNKNOWN_VERSION ), "X509 - CRT/CRL/CSR has an unsupported version number" },
+            { -( MBEDTLS_ERR_X509_UNKNOWN_SIG_ALG ), "X509 - Signature algorithm (oid) is unsupported" },
+            { -( MBEDTLS_ERR_X509_SIG_MISMATCH ), "X509 - Signature algorithms do not match. (see \\c ::mbedtls_x509_crt sig_oid)" },
+            { -( MBEDTLS_ERR_X509_CERT_VERIFY_FAILED ), "X509 - Certificate verification failed, e.g. CRL, CA or signature check failed" },
+            { -( MBEDTLS_ERR_X509_CERT_UNKNOWN_FORMAT ), "X509 - Format not recognized as DER or PEM" },
+            { -( MBEDTLS_ERR_X509_BAD_INPUT_DATA ), "X509 - Input invalid" },
+            { -( MBEDTLS_ERR_X509_ALLOC_FAILED ), "X509 - Allocation of memory failed" },
+            { -( MBEDTLS_ERR_X509_FILE_IO_ERROR ), "X509 - Read/write of file failed" },
+            { -( MBEDTLS_ERR_X509_BUFFER_TOO_SMALL ), "X509 - Destination buffer is too small" },
+        #endif
         #if defined( MBEDTLS_PKCS5_C )
-            case -( MBEDTLS_ERR_PKCS5_BAD_INPUT_DATA ):
-                rc = "PKCS5 - Bad input parameters to function";
-                break;
-
-            case -( MBEDTLS_ERR_PKCS5_INVALID_FORMAT ):
-                rc = "PKCS5 - Unexpected ASN.1 data";
-                break;
-
-            case -( MBEDTLS_ERR_PKCS5_FEATURE_UNAVAILABLE ):
-                rc = "PKCS5 - Requested encryption or digest alg not available";
-                break;
-
-            case -( MBEDTLS_ERR_PKCS5_PASSWORD_MISMATCH ):
-                rc = "PKCS5 - Given private key password does not allow for correct decryption";
-                break;
-        #endif /* MBEDTLS_PKCS5_C */
-
+            { -( MBEDTLS_ERR_PKCS5_PASSWORD_MISMATCH ), "PKCS5 - Given private key password does not allow for correct decryption" },
+            { -( MBEDTLS_ERR_PKCS5_FEATURE_UNAVAILABLE ), "PKCS5 - Requested encryption or digest alg not available" },
+            { -( MBEDTLS_ERR_PKCS5_INVALID_FORMAT ), "PKCS5 - Unexpected ASN.1 data" },
+            { -( MBEDTLS_ERR_PKCS5_BAD_INPUT_DATA ), "PKCS5 - Bad input parameters to function" },
+        #endif
+        #if defined( MBEDTLS_X509_USE_C ) || defined( MBEDTLS_X509_CREATE_C )
+            { -( MBEDTLS_ERR_X509_FATAL_ERROR ), "X509 - A fatal error occured, eg the chain is too long or the vrfy callback failed" },
+        #endif
+        #if defined( MBEDTLS_DHM_C )
+            { -( MBEDTLS_ERR_DHM_BAD_INPUT_DATA ), "DHM - Bad input parameters" },
+            { -( MBEDTLS_ERR_DHM_READ_PARAMS_FAILED ), "DHM - Reading of the DHM parameters failed" },
+            { -( MBEDTLS_ERR_DHM_MAKE_PARAMS_FAILED ), "DHM - Making of the DHM parameters failed" },
+            { -( MBEDTLS_ERR_DHM_READ_PUBLIC_FAILED ), "DHM - Reading of the public values failed" },
+            { -( MBEDTLS_ERR_DHM_MAKE_PUBLIC_FAILED ), "DHM - Making of the public value failed" },
+            { -( MBEDTLS_ERR_DHM_CALC_SECRET_FAILED ), "DHM - Calculation of the DHM secret failed" },
+            { -( MBEDTLS_ERR_DHM_INVALID_FORMAT ), "DHM - The ASN.1 data is not formatted correctly" },
+            { -( MBEDTLS_ERR_DHM_ALLOC_FAILED ), "DHM - Allocation of memory failed" },
+            { -( MBEDTLS_ERR_DHM_FILE_IO_ERROR ), "DHM - Read or write of file failed" },
+        #endif
+        #if defined( MBEDTLS_DHM_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_DHM_HW_ACCEL_FAILED ), "DHM - DHM hardware accelerator failed" },
+        #endif
+        #if defined( MBEDTLS_DHM_C )
+            { -( MBEDTLS_ERR_DHM_SET_GROUP_FAILED ), "DHM - Setting the modulus and generator failed" },
+        #endif
+        #if defined( MBEDTLS_PK_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_PK_HW_ACCEL_FAILED ), "PK - PK hardware accelerator failed" },
+        #endif
+        #if defined( MBEDTLS_PK_C )
+            { -( MBEDTLS_ERR_PK_SIG_LEN_MISMATCH ), "PK - The buffer contains a valid signature followed by more data" },
+            { -( MBEDTLS_ERR_PK_FEATURE_UNAVAILABLE ), "PK - Unavailable feature, e.g. RSA disabled for RSA key" },
+            { -( MBEDTLS_ERR_PK_UNKNOWN_NAMED_CURVE ), "PK - Elliptic curve is unsupported (only NIST curves are supported)" },
+            { -( MBEDTLS_ERR_PK_INVALID_ALG ), "PK - The algorithm tag or value is invalid" },
+            { -( MBEDTLS_ERR_PK_INVALID_PUBKEY ), "PK - The pubkey tag or value is invalid (only RSA and EC are supported)" },
+            { -( MBEDTLS_ERR_PK_PASSWORD_MISMATCH ), "PK - Given private key password does not allow for correct decryption" },
+            { -( MBEDTLS_ERR_PK_PASSWORD_REQUIRED ), "PK - Private key password can't be empty" },
+            { -( MBEDTLS_ERR_PK_UNKNOWN_PK_ALG ), "PK - Key algorithm is unsupported (only RSA and EC are supported)" },
+            { -( MBEDTLS_ERR_PK_KEY_INVALID_FORMAT ), "PK - Invalid key tag or value" },
+            { -( MBEDTLS_ERR_PK_KEY_INVALID_VERSION ), "PK - Unsupported key version" },
+            { -( MBEDTLS_ERR_PK_FILE_IO_ERROR ), "PK - Read/write of file failed" },
+            { -( MBEDTLS_ERR_PK_BAD_INPUT_DATA ), "PK - Bad input parameters to function" },
+            { -( MBEDTLS_ERR_PK_TYPE_MISMATCH ), "PK - Type mismatch, eg attempt to encrypt with an ECDSA key" },
+            { -( MBEDTLS_ERR_PK_ALLOC_FAILED ), "PK - Memory allocation failed" },
+        #endif
         #if defined( MBEDTLS_RSA_C )
-            case -( MBEDTLS_ERR_RSA_BAD_INPUT_DATA ):
-                rc = "RSA - Bad input parameters to function";
-                break;
-
-            case -( MBEDTLS_ERR_RSA_INVALID_PADDING ):
-                rc = "RSA - Input data contains invalid padding and is rejected";
-                break;
-
-            case -( MBEDTLS_ERR_RSA_KEY_GEN_FAILED ):
-                rc = "RSA - Something failed during generation of a key";
-                break;
-
-            case -( MBEDTLS_ERR_RSA_KEY_CHECK_FAILED ):
-                rc = "RSA - Key failed to pass the validity check of the library";
-                break;
-
-            case -( MBEDTLS_ERR_RSA_PUBLIC_FAILED ):
-                rc = "RSA - The public key operation failed";
-                break;
-
-            case -( MBEDTLS_ERR_RSA_PRIVATE_FAILED ):
-                rc = "RSA - The private key operation failed";
-                break;
-
-            case -( MBEDTLS_ERR_RSA_VERIFY_FAILED ):
-                rc = "RSA - The PKCS#1 verification failed";
-                break;
-
-            case -( MBEDTLS_ERR_RSA_OUTPUT_TOO_LARGE ):
-                rc = "RSA - The output buffer for decryption is not large enough";
-                break;
-
-            case -( MBEDTLS_ERR_RSA_RNG_FAILED ):
-                rc = "RSA - The random generator failed to generate non-zeros";
-                break;
-
-            case -( MBEDTLS_ERR_RSA_UNSUPPORTED_OPERATION ):
-                rc = "RSA - The implementation does not offer the requested operation, for example, because of security violations or lack of functionality";
-                break;
-
-            case -( MBEDTLS_ERR_RSA_HW_ACCEL_FAILED ):
-                rc = "RSA - RSA hardware accelerator failed";
-                break;
-        #endif /* MBEDTLS_RSA_C */
-
+            { -( MBEDTLS_ERR_RSA_BAD_INPUT_DATA ), "RSA - Bad input parameters to function" },
+            { -( MBEDTLS_ERR_RSA_INVALID_PADDING ), "RSA - Input data contains invalid padding and is rejected" },
+            { -( MBEDTLS_ERR_RSA_KEY_GEN_FAILED ), "RSA - Something failed during generation of a key" },
+            { -( MBEDTLS_ERR_RSA_KEY_CHECK_FAILED ), "RSA - Key failed to pass the validity check of the library" },
+            { -( MBEDTLS_ERR_RSA_PUBLIC_FAILED ), "RSA - The public key operation failed" },
+            { -( MBEDTLS_ERR_RSA_PRIVATE_FAILED ), "RSA - The private key operation failed" },
+            { -( MBEDTLS_ERR_RSA_VERIFY_FAILED ), "RSA - The PKCS#1 verification failed" },
+            { -( MBEDTLS_ERR_RSA_OUTPUT_TOO_LARGE ), "RSA - The output buffer for decryption is not large enough" },
+            { -( MBEDTLS_ERR_RSA_RNG_FAILED ), "RSA - The random generator failed to generate non-zeros" },
+            { -( MBEDTLS_ERR_RSA_UNSUPPORTED_OPERATION ), "RSA - The implementation does not offer the requested operation, for example, because of security violations or lack of functionality" },
+        #endif
+        #if defined( MBEDTLS_RSA_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_RSA_HW_ACCEL_FAILED ), "RSA - RSA hardware accelerator failed" },
+        #endif
+        #if defined( MBEDTLS_ECP_C )
+            { -( MBEDTLS_ERR_ECP_IN_PROGRESS ), "ECP - Operation in progress, call again with the same parameters to continue" },
+        #endif
+        #if defined( MBEDTLS_ECP_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_ECP_HW_ACCEL_FAILED ), "ECP - The ECP hardware accelerator failed" },
+        #endif
+        #if defined( MBEDTLS_ECP_C )
+            { -( MBEDTLS_ERR_ECP_SIG_LEN_MISMATCH ), "ECP - The buffer contains a valid signature followed by more data" },
+            { -( MBEDTLS_ERR_ECP_INVALID_KEY ), "ECP - Invalid private or public key" },
+            { -( MBEDTLS_ERR_ECP_RANDOM_FAILED ), "ECP - Generation of random value, such as ephemeral key, failed" },
+            { -( MBEDTLS_ERR_ECP_ALLOC_FAILED ), "ECP - Memory allocation failed" },
+            { -( MBEDTLS_ERR_ECP_VERIFY_FAILED ), "ECP - The signature is not valid" },
+            { -( MBEDTLS_ERR_ECP_FEATURE_UNAVAILABLE ), "ECP - The requested feature is not available, for example, the requested curve is not supported" },
+            { -( MBEDTLS_ERR_ECP_BUFFER_TOO_SMALL ), "ECP - The buffer is too small to write to" },
+            { -( MBEDTLS_ERR_ECP_BAD_INPUT_DATA ), "ECP - Bad input parameters to function" },
+        #endif
+        #if defined( MBEDTLS_MD_C )
+            { -( MBEDTLS_ERR_MD_FEATURE_UNAVAILABLE ), "MD - The selected feature is not available" },
+            { -( MBEDTLS_ERR_MD_BAD_INPUT_DATA ), "MD - Bad input parameters to function" },
+            { -( MBEDTLS_ERR_MD_ALLOC_FAILED ), "MD - Failed to allocate memory" },
+            { -( MBEDTLS_ERR_MD_FILE_IO_ERROR ), "MD - Opening or reading of file failed" },
+        #endif
+        #if defined( MBEDTLS_MD_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_MD_HW_ACCEL_FAILED ), "MD - MD hardware accelerator failed" },
+        #endif
+        #if defined( MBEDTLS_HKDF_C )
+            { -( MBEDTLS_ERR_HKDF_BAD_INPUT_DATA ), "HKDF - Bad input parameters to function" },
+        #endif
+        #if defined( MBEDTLS_CIPHER_C )
+            { -( MBEDTLS_ERR_CIPHER_FEATURE_UNAVAILABLE ), "CIPHER - The selected feature is not available" },
+            { -( MBEDTLS_ERR_CIPHER_BAD_INPUT_DATA ), "CIPHER - Bad input parameters" },
+            { -( MBEDTLS_ERR_CIPHER_ALLOC_FAILED ), "CIPHER - Failed to allocate memory" },
+            { -( MBEDTLS_ERR_CIPHER_INVALID_PADDING ), "CIPHER - Input data contains invalid padding and is rejected" },
+            { -( MBEDTLS_ERR_CIPHER_FULL_BLOCK_EXPECTED ), "CIPHER - Decryption of block requires a full block" },
+            { -( MBEDTLS_ERR_CIPHER_AUTH_FAILED ), "CIPHER - Authentication failed (for AEAD modes)" },
+            { -( MBEDTLS_ERR_CIPHER_INVALID_CONTEXT ), "CIPHER - The context is invalid. For example, because it was freed" },
+        #endif
+        #if defined( MBEDTLS_CIPHER_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_CIPHER_HW_ACCEL_FAILED ), "CIPHER - Cipher hardware accelerator failed" },
+        #endif
         #if defined( MBEDTLS_SSL_TLS_C )
-            case -( MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE ):
-                rc = "SSL - The requested feature is not available";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_BAD_INPUT_DATA ):
-                rc = "SSL - Bad input parameters to function";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_INVALID_MAC ):
-                rc = "SSL - Verification of the message MAC failed";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_INVALID_RECORD ):
-                rc = "SSL - An invalid SSL record was received";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_CONN_EOF ):
-                rc = "SSL - The connection indicated an EOF";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_UNKNOWN_CIPHER ):
-                rc = "SSL - An unknown cipher was received";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_NO_CIPHER_CHOSEN ):
-                rc = "SSL - The server has no ciphersuites in common with the client";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_NO_RNG ):
-                rc = "SSL - No RNG was provided to the SSL module";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_NO_CLIENT_CERTIFICATE ):
-                rc = "SSL - No client certification received from the client, but required by the authentication mode";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_CERTIFICATE_TOO_LARGE ):
-                rc = "SSL - Our own certificate(s) is/are too large to send in an SSL message";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_CERTIFICATE_REQUIRED ):
-                rc = "SSL - The own certificate is not set, but needed by the server";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_PRIVATE_KEY_REQUIRED ):
-                rc = "SSL - The own private key or pre-shared key is not set, but needed";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_CA_CHAIN_REQUIRED ):
-                rc = "SSL - No CA Chain is set, but required to operate";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_UNEXPECTED_MESSAGE ):
-                rc = "SSL - An unexpected message was received from our peer";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_FATAL_ALERT_MESSAGE ):
-                rc = "SSL - A fatal alert message was received from our peer";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_PEER_VERIFY_FAILED ):
-                rc = "SSL - Verification of our peer failed";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY ):
-                rc = "SSL - The peer notified us that the connection is going to be closed";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_BAD_HS_CLIENT_HELLO ):
-                rc = "SSL - Processing of the ClientHello handshake message failed";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_BAD_HS_SERVER_HELLO ):
-                rc = "SSL - Processing of the ServerHello handshake message failed";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_BAD_HS_CERTIFICATE ):
-                rc = "SSL - Processing of the Certificate handshake message failed";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_BAD_HS_CERTIFICATE_REQUEST ):
-                rc = "SSL - Processing of the CertificateRequest handshake message failed";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_BAD_HS_SERVER_KEY_EXCHANGE ):
-                rc = "SSL - Processing of the ServerKeyExchange handshake message failed";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_BAD_HS_SERVER_HELLO_DONE ):
-                rc = "SSL - Processing of the ServerHelloDone handshake message failed";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_BAD_HS_CLIENT_KEY_EXCHANGE ):
-                rc = "SSL - Processing of the ClientKeyExchange handshake message failed";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_BAD_HS_CLIENT_KEY_EXCHANGE_RP ):
-                rc = "SSL - Processing of the ClientKeyExchange handshake message failed in DHM / ECDH Read Public";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_BAD_HS_CLIENT_KEY_EXCHANGE_CS ):
-                rc = "SSL - Processing of the ClientKeyExchange handshake message failed in DHM / ECDH Calculate Secret";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_BAD_HS_CERTIFICATE_VERIFY ):
-                rc = "SSL - Processing of the CertificateVerify handshake message failed";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_BAD_HS_CHANGE_CIPHER_SPEC ):
-                rc = "SSL - Processing of the ChangeCipherSpec handshake message failed";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_BAD_HS_FINISHED ):
-                rc = "SSL - Processing of the Finished handshake message failed";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_ALLOC_FAILED ):
-                rc = "SSL - Memory allocation failed";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_HW_ACCEL_FAILED ):
-                rc = "SSL - Hardware acceleration function returned with error";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_HW_ACCEL_FALLTHROUGH ):
-                rc = "SSL - Hardware acceleration function skipped / left alone data";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_COMPRESSION_FAILED ):
-                rc = "SSL - Processing of the compression / decompression failed";
-                break;
-
-            case -( MBEDTLS_ERR_SSL_BAD_HS_PROTOCOL_VERSION ):
-                rc = "SSL - Handshake protocol not within min/max boundaries";
-                break;
+            { -( MBEDTLS_ERR_SSL_EARLY_MESSAGE ), "SSL - Internal-only message signaling that a message arrived early" },
+            { -( MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS ), "SSL - The asynchronous operation is not completed yet" },
+            { -( MBEDTLS_ERR_SSL_CONTINUE_PROCESSING ), "SSL - Internal-only message signaling that further message-processing should be done" },
+            { -( MBEDTLS_ERR_SSL_INVALID_VERIFY_HASH ), "SSL - Couldn't set the hash for verifying CertificateVerify" },
+            { -( MBEDTLS_ERR_SSL_NON_FATAL ), "SSL - The alert message received indicates a non-fatal error" },
+            { -( MBEDTLS_ERR_SSL_UNEXPECTED_RECORD ), "SSL - Record header looks valid but is not expected" },
+            { -( MBEDTLS_ERR_SSL_CLIENT_RECONNECT ), "SSL - The client initiated a reconnect from the same port" },
+            { -( MBEDTLS_ERR_SSL_TIMEOUT ), "SSL - The operation timed out" },
+            { -( MBEDTLS_ERR_SSL_WANT_WRITE ), "SSL - Connection requires a write call" },
+            { -( MBEDTLS_ERR_SSL_WANT_READ ), "SSL - No data of requested type currently available on underlying transport" },
+            { -( MBEDTLS_ERR_SSL_NO_USABLE_CIPHERSUITE ), "SSL - None of the common ciphersuites is usable (eg, no suitable certificate, see debug messages)" },
+            { -( MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL ), "SSL - A buffer is too small to receive or write a message" },
+            { -( MBEDTLS_ERR_SSL_HELLO_VERIFY_REQUIRED ), "SSL - DTLS client must retry for hello verification" },
+            { -( MBEDTLS_ERR_SSL_WAITING_SERVER_HELLO_RENEGO ), "SSL - Unexpected message at ServerHello in renegotiation" },
+            { -( MBEDTLS_ERR_SSL_COUNTER_WRAPPING ), "SSL - A counter would wrap (eg, too many messages exchanged)" },
+            { -( MBEDTLS_ERR_SSL_INTERNAL_ERROR ), "SSL - Internal error (eg, unexpected failure in lower-level module)" },
+            { -( MBEDTLS_ERR_SSL_UNKNOWN_IDENTITY ), "SSL - Unknown identity received (eg, PSK identity)" },
+            { -( MBEDTLS_ERR_SSL_PK_TYPE_MISMATCH ), "SSL - Public key type mismatch (eg, asked for RSA key exchange and presented EC key)" },
+            { -( MBEDTLS_ERR_SSL_SESSION_TICKET_EXPIRED ), "SSL - Session ticket has expired" },
+            { -( MBEDTLS_ERR_SSL_BAD_HS_NEW_SESSION_TICKET ), "SSL - Processing of the NewSessionTicket handshake message failed" },
+            { -( MBEDTLS_ERR_SSL_BAD_HS_PROTOCOL_VERSION ), "SSL - Handshake protocol not within min/max boundaries" },
+            { -( MBEDTLS_ERR_SSL_COMPRESSION_FAILED ), "SSL - Processing of the compression / decompression failed" },
+        #endif
+        #if defined( MBEDTLS_SSL_TLS_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_SSL_HW_ACCEL_FALLTHROUGH ), "SSL - Hardware acceleration function skipped / left alone data" },
+        #endif
+        #if defined( MBEDTLS_SSL_TLS_C )
+            { -( MBEDTLS_ERR_SSL_CRYPTO_IN_PROGRESS ), "SSL - A cryptographic operation is in progress. Try again later" },
+            { -( MBEDTLS_ERR_SSL_FEATURE_UNAVAILABLE ), "SSL - The requested feature is not available" },
+            { -( MBEDTLS_ERR_SSL_BAD_INPUT_DATA ), "SSL - Bad input parameters to function" },
+            { -( MBEDTLS_ERR_SSL_INVALID_MAC ), "SSL - Verification of the message MAC failed" },
+            { -( MBEDTLS_ERR_SSL_INVALID_RECORD ), "SSL - An invalid SSL record was received" },
+            { -( MBEDTLS_ERR_SSL_CONN_EOF ), "SSL - The connection indicated an EOF" },
+            { -( MBEDTLS_ERR_SSL_UNKNOWN_CIPHER ), "SSL - An unknown cipher was received" },
+            { -( MBEDTLS_ERR_SSL_NO_CIPHER_CHOSEN ), "SSL - The server has no ciphersuites in common with the client" },
+            { -( MBEDTLS_ERR_SSL_NO_RNG ), "SSL - No RNG was provided to the SSL module" },
+            { -( MBEDTLS_ERR_SSL_NO_CLIENT_CERTIFICATE ), "SSL - No client certification received from the client, but required by the authentication mode" },
+            { -( MBEDTLS_ERR_SSL_CERTIFICATE_TOO_LARGE ), "SSL - Our own certificate(s) is/are too large to send in an SSL message" },
+            { -( MBEDTLS_ERR_SSL_CERTIFICATE_REQUIRED ), "SSL - The own certificate is not set, but needed by the server" },
+            { -( MBEDTLS_ERR_SSL_PRIVATE_KEY_REQUIRED ), "SSL - The own private key or pre-shared key is not set, but needed" },
+            { -( MBEDTLS_ERR_SSL_CA_CHAIN_REQUIRED ), "SSL - No CA Chain is set, but required to operate" },
+            { -( MBEDTLS_ERR_SSL_UNEXPECTED_MESSAGE ), "SSL - An unexpected message was received from our peer" },
+            { -( MBEDTLS_ERR_SSL_FATAL_ALERT_MESSAGE ), "SSL - A fatal alert message was received from our peer" },
+            { -( MBEDTLS_ERR_SSL_PEER_VERIFY_FAILED ), "SSL - Verification of our peer failed" },
+            { -( MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY ), "SSL - The peer notified us that the connection is going to be closed" },
+            { -( MBEDTLS_ERR_SSL_BAD_HS_CLIENT_HELLO ), "SSL - Processing of the ClientHello handshake message failed" },
+            { -( MBEDTLS_ERR_SSL_BAD_HS_SERVER_HELLO ), "SSL - Processing of the ServerHello handshake message failed" },
+            { -( MBEDTLS_ERR_SSL_BAD_HS_CERTIFICATE ), "SSL - Processing of the Certificate handshake message failed" },
+            { -( MBEDTLS_ERR_SSL_BAD_HS_CERTIFICATE_REQUEST ), "SSL - Processing of the CertificateRequest handshake message failed" },
+            { -( MBEDTLS_ERR_SSL_BAD_HS_SERVER_KEY_EXCHANGE ), "SSL - Processing of the ServerKeyExchange handshake message failed" },
+            { -( MBEDTLS_ERR_SSL_BAD_HS_SERVER_HELLO_DONE ), "SSL - Processing of the ServerHelloDone handshake message failed" },
+            { -( MBEDTLS_ERR_SSL_BAD_HS_CLIENT_KEY_EXCHANGE ), "SSL - Processing of the ClientKeyExchange handshake message failed" },
+            { -( MBEDTLS_ERR_SSL_BAD_HS_CLIENT_KEY_EXCHANGE_RP ), "SSL - Processing of the ClientKeyExchange handshake message failed in DHM / ECDH Read Public" },
+            { -( MBEDTLS_ERR_SSL_BAD_HS_CLIENT_KEY_EXCHANGE_CS ), "SSL - Processing of the ClientKeyExchange handshake message failed in DHM / ECDH Calculate Secret" },
+            { -( MBEDTLS_ERR_SSL_BAD_HS_CERTIFICATE_VERIFY ), "SSL - Processing of the CertificateVerify handshake message failed" },
+            { -( MBEDTLS_ERR_SSL_BAD_HS_CHANGE_CIPHER_SPEC ), "SSL - Processing of the ChangeCipherSpec handshake message failed" },
+            { -( MBEDTLS_ERR_SSL_BAD_HS_FINISHED ), "SSL - Processing of the Finished handshake message failed" },
+            { -( MBEDTLS_ERR_SSL_ALLOC_FAILED ), "SSL - Memory allocation failed" },
+        #endif
+        #if defined( MBEDTLS_SSL_TLS_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_SSL_HW_ACCEL_FAILED ), "SSL - Hardware acceleration function returned with error" },
+        #endif
+
+        /* Terminates the table, so that it is never empty. Lookups do not
+         * search this entry. */
+        { 0U, NULL }
+    };
 
-            case -( MBEDTLS_ERR_SSL_BAD_HS_NEW_SESSION_TICKET ):
-                rc = "SSL - Processing of the NewSessionTicket handshake message failed";
-                break;
+/**
+ * @brief Descriptions of the low-level error codes.
+ *
+ * The entries are sorted by the values that the codes have in mbed TLS 2.28,
+ * so that findErrorString() can use a binary search. The order is checked by
+ * an assert on the first lookup. Codes that mbed TLS 3.0 removed are only
+ * listed for mbed TLS 2.x.
+ */
+    static const ErrorString_t lowLevelErrors[] =
+    {
+        #if defined( MBEDTLS_BIGNUM_C )
+            { -( MBEDTLS_ERR_MPI_FILE_IO_ERROR ), "BIGNUM - An error occurred while reading from or writing to a file" },
+        #endif
+        #if defined( MBEDTLS_HMAC_DRBG_C )
+            { -( MBEDTLS_ERR_HMAC_DRBG_REQUEST_TOO_BIG ), "HMAC_DRBG - Too many random requested in single call" },
+        #endif
+        #if defined( MBEDTLS_BIGNUM_C )
+            { -( MBEDTLS_ERR_MPI_BAD_INPUT_DATA ), "BIGNUM - Bad input parameters to function" },
+        #endif
+        #if defined( MBEDTLS_HMAC_DRBG_C )
+            { -( MBEDTLS_ERR_HMAC_DRBG_INPUT_TOO_BIG ), "HMAC_DRBG - Input too large (Entropy + additional)" },
+        #endif
+        #if defined( MBEDTLS_BIGNUM_C )
+            { -( MBEDTLS_ERR_MPI_INVALID_CHARACTER ), "BIGNUM - There is an invalid character in the digit string" },
+        #endif
+        #if defined( MBEDTLS_HMAC_DRBG_C )
+            { -( MBEDTLS_ERR_HMAC_DRBG_FILE_IO_ERROR ), "HMAC_DRBG - Read/write error in file" },
+        #endif
+        #if defined( MBEDTLS_BIGNUM_C )
+            { -( MBEDTLS_ERR_MPI_BUFFER_TOO_SMALL ), "BIGNUM - The buffer is too small to write to" },
+        #endif
+        #if defined( MBEDTLS_HMAC_DRBG_C )
+            { -( MBEDTLS_ERR_HMAC_DRBG_ENTROPY_SOURCE_FAILED ), "HMAC_DRBG - The entropy source failed" },
+        #endif
+        #if defined( MBEDTLS_BIGNUM_C )
+            { -( MBEDTLS_ERR_MPI_NEGATIVE_VALUE ), "BIGNUM - The input arguments are negative or result in illegal output" },
+        #endif
+        #if defined( MBEDTLS_OID_C )
+            { -( MBEDTLS_ERR_OID_BUF_TOO_SMALL ), "OID - output buffer is too small" },
+        #endif
+        #if defined( MBEDTLS_BIGNUM_C )
+            { -( MBEDTLS_ERR_MPI_DIVISION_BY_ZERO ), "BIGNUM - The input argument for division is zero, which is not allowed" },
+        #endif
+        #if defined( MBEDTLS_CCM_C )
+            { -( MBEDTLS_ERR_CCM_BAD_INPUT ), "CCM - Bad input parameters to the function" },
+        #endif
+        #if defined( MBEDTLS_BIGNUM_C )
+            { -( MBEDTLS_ERR_MPI_NOT_ACCEPTABLE ), "BIGNUM - The input arguments are not acceptable" },
+        #endif
+        #if defined( MBEDTLS_CCM_C )
+            { -( MBEDTLS_ERR_CCM_AUTH_FAILED ), "CCM - Authenticated decryption failed" },
+        #endif
+        #if defined( MBEDTLS_BIGNUM_C )
+            { -( MBEDTLS_ERR_MPI_ALLOC_FAILED ), "BIGNUM - Memory allocation failed" },
+        #endif
+        #if defined( MBEDTLS_CCM_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_CCM_HW_ACCEL_FAILED ), "CCM - CCM hardware accelerator failed" },
+        #endif
+        #if defined( MBEDTLS_GCM_C )
+            { -( MBEDTLS_ERR_GCM_AUTH_FAILED ), "GCM - Authenticated decryption failed" },
+        #endif
+        #if defined( MBEDTLS_GCM_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_GCM_HW_ACCEL_FAILED ), "GCM - GCM hardware accelerator failed" },
+        #endif
+        #if defined( MBEDTLS_GCM_C )
+            { -( MBEDTLS_ERR_GCM_BAD_INPUT ), "GCM - Bad input parameters to function" },
+        #endif
+        #if defined( MBEDTLS_BLOWFISH_C )
+            { -( MBEDTLS_ERR_BLOWFISH_BAD_INPUT_DATA ), "BLOWFISH - Bad input data" },
+        #endif
+        #if defined( MBEDTLS_BLOWFISH_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_BLOWFISH_HW_ACCEL_FAILED ), "BLOWFISH - Blowfish hardware accelerator failed" },
+        #endif
+        #if defined( MBEDTLS_BLOWFISH_C )
+            { -( MBEDTLS_ERR_BLOWFISH_INVALID_INPUT_LENGTH ), "BLOWFISH - Invalid data input length" },
+        #endif
+        #if defined( MBEDTLS_ARC4_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_ARC4_HW_ACCEL_FAILED ), "ARC4 - ARC4 hardware accelerator failed" },
+        #endif
+        #if defined( MBEDTLS_THREADING_C )
+            { -( MBEDTLS_ERR_THREADING_FEATURE_UNAVAILABLE ), "THREADING - The selected feature is not available" },
+            { -( MBEDTLS_ERR_THREADING_BAD_INPUT_DATA ), "THREADING - Bad input parameters to function" },
+            { -( MBEDTLS_ERR_THREADING_MUTEX_ERROR ), "THREADING - Locking / unlocking / free failed with error code" },
+        #endif
+        #if defined( MBEDTLS_AES_C )
+            { -( MBEDTLS_ERR_AES_INVALID_KEY_LENGTH ), "AES - Invalid key length" },
+            { -( MBEDTLS_ERR_AES_BAD_INPUT_DATA ), "AES - Invalid input data" },
+            { -( MBEDTLS_ERR_AES_INVALID_INPUT_LENGTH ), "AES - Invalid data input length" },
+            { -( MBEDTLS_ERR_AES_FEATURE_UNAVAILABLE ), "AES - Feature not available. For example, an unsupported AES key size" },
+        #endif
+        #if defined( MBEDTLS_CAMELLIA_C )
+            { -( MBEDTLS_ERR_CAMELLIA_BAD_INPUT_DATA ), "CAMELLIA - Bad input data" },
+        #endif
+        #if defined( MBEDTLS_AES_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_AES_HW_ACCEL_FAILED ), "AES - AES hardware accelerator failed" },
+        #endif
+        #if defined( MBEDTLS_CAMELLIA_C )
+            { -( MBEDTLS_ERR_CAMELLIA_INVALID_INPUT_LENGTH ), "CAMELLIA - Invalid data input length" },
+        #endif
+        #if defined( MBEDTLS_CAMELLIA_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_CAMELLIA_HW_ACCEL_FAILED ), "CAMELLIA - Camellia hardware accelerator failed" },
+        #endif
+        #if defined( MBEDTLS_XTEA_C )
+            { -( MBEDTLS_ERR_XTEA_INVALID_INPUT_LENGTH ), "XTEA - The data input has an invalid length" },
+        #endif
+        #if defined( MBEDTLS_XTEA_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_XTEA_HW_ACCEL_FAILED ), "XTEA - XTEA hardware accelerator failed" },
+        #endif
+        #if defined( MBEDTLS_BASE64_C )
+            { -( MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL ), "BASE64 - Output buffer too small" },
+        #endif
+        #if defined( MBEDTLS_MD2_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_MD2_HW_ACCEL_FAILED ), "MD2 - MD2 hardware accelerator failed" },
+        #endif
+        #if defined( MBEDTLS_BASE64_C )
+            { -( MBEDTLS_ERR_BASE64_INVALID_CHARACTER ), "BASE64 - Invalid character in input" },
+        #endif
+        #if defined( MBEDTLS_MD4_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_MD4_HW_ACCEL_FAILED ), "MD4 - MD4 hardware accelerator failed" },
+        #endif
+        #if defined( MBEDTLS_OID_C )
+            { -( MBEDTLS_ERR_OID_NOT_FOUND ), "OID - OID is not found" },
+        #endif
+        #if defined( MBEDTLS_MD5_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_MD5_HW_ACCEL_FAILED ), "MD5 - MD5 hardware accelerator failed" },
+        #endif
+        #if defined( MBEDTLS_PADLOCK_C )
+            { -( MBEDTLS_ERR_PADLOCK_DATA_MISALIGNED ), "PADLOCK - Input data should be aligned" },
+        #endif
+        #if defined( MBEDTLS_RIPEMD160_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_RIPEMD160_HW_ACCEL_FAILED ), "RIPEMD160 - RIPEMD160 hardware accelerator failed" },
+        #endif
+        #if defined( MBEDTLS_DES_C )
+            { -( MBEDTLS_ERR_DES_INVALID_INPUT_LENGTH ), "DES - The data input has an invalid length" },
+        #endif
+        #if defined( MBEDTLS_DES_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_DES_HW_ACCEL_FAILED ), "DES - DES hardware accelerator failed" },
+        #endif
+        #if defined( MBEDTLS_CTR_DRBG_C )
+            { -( MBEDTLS_ERR_CTR_DRBG_ENTROPY_SOURCE_FAILED ), "CTR_DRBG - The entropy source failed" },
+        #endif
+        #if defined( MBEDTLS_SHA1_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_SHA1_HW_ACCEL_FAILED ), "SHA1 - SHA-1 hardware accelerator failed" },
+        #endif
+        #if defined( MBEDTLS_CTR_DRBG_C )
+            { -( MBEDTLS_ERR_CTR_DRBG_REQUEST_TOO_BIG ), "CTR_DRBG - The requested random buffer length is too big" },
+        #endif
+        #if defined( MBEDTLS_SHA256_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_SHA256_HW_ACCEL_FAILED ), "SHA256 - SHA-256 hardware accelerator failed" },
+        #endif
+        #if defined( MBEDTLS_CTR_DRBG_C )
+            { -( MBEDTLS_ERR_CTR_DRBG_INPUT_TOO_BIG ), "CTR_DRBG - The input (entropy + additional data) is too large" },
+        #endif
+        #if defined( MBEDTLS_SHA512_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_SHA512_HW_ACCEL_FAILED ), "SHA512 - SHA-512 hardware accelerator failed" },
+        #endif
+        #if defined( MBEDTLS_CTR_DRBG_C )
+            { -( MBEDTLS_ERR_CTR_DRBG_FILE_IO_ERROR ), "CTR_DRBG - Read or write error in file" },
+        #endif
+        #if defined( MBEDTLS_ENTROPY_C )
+            { -( MBEDTLS_ERR_ENTROPY_SOURCE_FAILED ), "ENTROPY - Critical entropy source failure" },
+            { -( MBEDTLS_ERR_ENTROPY_NO_STRONG_SOURCE ), "ENTROPY - No strong sources have been added to poll" },
+            { -( MBEDTLS_ERR_ENTROPY_MAX_SOURCES ), "ENTROPY - No more sources can be added" },
+            { -( MBEDTLS_ERR_ENTROPY_FILE_IO_ERROR ), "ENTROPY - Read/write error in file" },
+            { -( MBEDTLS_ERR_ENTROPY_NO_SOURCES_DEFINED ), "ENTROPY - No sources have been added to poll" },
+        #endif
+        #if defined( MBEDTLS_NET_C )
+            { -( MBEDTLS_ERR_NET_SOCKET_FAILED ), "NET - Failed to open a socket" },
+            { -( MBEDTLS_ERR_NET_BUFFER_TOO_SMALL ), "NET - Buffer is too small to hold the data" },
+            { -( MBEDTLS_ERR_NET_CONNECT_FAILED ), "NET - The connection to the given server / port failed" },
+            { -( MBEDTLS_ERR_NET_INVALID_CONTEXT ), "NET - The context is invalid, eg because it was free()ed" },
+            { -( MBEDTLS_ERR_NET_BIND_FAILED ), "NET - Binding of the socket failed" },
+            { -( MBEDTLS_ERR_NET_POLL_FAILED ), "NET - Polling the net context failed" },
+            { -( MBEDTLS_ERR_NET_LISTEN_FAILED ), "NET - Could not listen on the socket" },
+            { -( MBEDTLS_ERR_NET_BAD_INPUT_DATA ), "NET - Input invalid" },
+            { -( MBEDTLS_ERR_NET_ACCEPT_FAILED ), "NET - Could not accept the incoming connection" },
+            { -( MBEDTLS_ERR_NET_RECV_FAILED ), "NET - Reading information from the socket failed" },
+            { -( MBEDTLS_ERR_NET_SEND_FAILED ), "NET - Sending information through the socket failed" },
+            { -( MBEDTLS_ERR_NET_CONN_RESET ), "NET - Connection was reset by peer" },
+        #endif
+        #if defined( MBEDTLS_CHACHA20_C )
+            { -( MBEDTLS_ERR_CHACHA20_BAD_INPUT_DATA ), "CHACHA20 - Invalid input parameter(s)" },
+        #endif
+        #if defined( MBEDTLS_NET_C )
+            { -( MBEDTLS_ERR_NET_UNKNOWN_HOST ), "NET - Failed to get an IP address for the given hostname" },
+        #endif
+        #if defined( MBEDTLS_CHACHA20_C )
+            { -( MBEDTLS_ERR_CHACHA20_FEATURE_UNAVAILABLE ), "CHACHA20 - Feature not available. For example, s part of the API is not implemented" },
+        #endif
+        #if defined( MBEDTLS_CHACHAPOLY_C )
+            { -( MBEDTLS_ERR_CHACHAPOLY_BAD_STATE ), "CHACHAPOLY - The requested operation is not permitted in the current state" },
+        #endif
+        #if defined( MBEDTLS_CHACHA20_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_CHACHA20_HW_ACCEL_FAILED ), "CHACHA20 - Chacha20 hardware accelerator failed" },
+        #endif
+        #if defined( MBEDTLS_CHACHAPOLY_C )
+            { -( MBEDTLS_ERR_CHACHAPOLY_AUTH_FAILED ), "CHACHAPOLY - Authenticated decryption failed: data was not authentic" },
+        #endif
+        #if defined( MBEDTLS_POLY1305_C )
+            { -( MBEDTLS_ERR_POLY1305_BAD_INPUT_DATA ), "POLY1305 - Invalid input parameter(s)" },
+        #endif
+        #if defined( MBEDTLS_ARIA_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_ARIA_HW_ACCEL_FAILED ), "ARIA - ARIA hardware accelerator failed" },
+        #endif
+        #if defined( MBEDTLS_POLY1305_C )
+            { -( MBEDTLS_ERR_POLY1305_FEATURE_UNAVAILABLE ), "POLY1305 - Feature not available. For example, s part of the API is not implemented" },
+        #endif
+        #if defined( MBEDTLS_ARIA_C )
+            { -( MBEDTLS_ERR_ARIA_FEATURE_UNAVAILABLE ), "ARIA - Feature not available. For example, an unsupported ARIA key size" },
+        #endif
+        #if defined( MBEDTLS_POLY1305_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_POLY1305_HW_ACCEL_FAILED ), "POLY1305 - Poly1305 hardware accelerator failed" },
+        #endif
+        #if defined( MBEDTLS_ARIA_C )
+            { -( MBEDTLS_ERR_ARIA_BAD_INPUT_DATA ), "ARIA - Bad input data" },
+            { -( MBEDTLS_ERR_ARIA_INVALID_INPUT_LENGTH ), "ARIA - Invalid data input length" },
+        #endif
+        #if defined( MBEDTLS_ASN1_PARSE_C )
+            { -( MBEDTLS_ERR_ASN1_OUT_OF_DATA ), "ASN1 - Out of data when parsing an ASN1 data structure" },
+            { -( MBEDTLS_ERR_ASN1_UNEXPECTED_TAG ), "ASN1 - ASN1 tag was of an unexpected value" },
+            { -( MBEDTLS_ERR_ASN1_INVALID_LENGTH ), "ASN1 - Error when trying to determine the length or invalid length" },
+            { -( MBEDTLS_ERR_ASN1_LENGTH_MISMATCH ), "ASN1 - Actual length differs from expected length" },
+            { -( MBEDTLS_ERR_ASN1_INVALID_DATA ), "ASN1 - Data is invalid. (not used)" },
+            { -( MBEDTLS_ERR_ASN1_ALLOC_FAILED ), "ASN1 - Memory allocation failed" },
+            { -( MBEDTLS_ERR_ASN1_BUF_TOO_SMALL ), "ASN1 - Buffer too small when writing ASN.1 data structure" },
+        #endif
+        #if defined( MBEDTLS_PLATFORM_C )
+            { -( MBEDTLS_ERR_PLATFORM_HW_ACCEL_FAILED ), "PLATFORM - Hardware accelerator failed" },
+            { -( MBEDTLS_ERR_PLATFORM_FEATURE_UNSUPPORTED ), "PLATFORM - The requested feature is not supported by the platform" },
+        #endif
+        #if defined( MBEDTLS_SHA1_C )
+            { -( MBEDTLS_ERR_SHA1_BAD_INPUT_DATA ), "SHA1 - SHA-1 input data was malformed" },
+        #endif
+        #if defined( MBEDTLS_SHA256_C )
+            { -( MBEDTLS_ERR_SHA256_BAD_INPUT_DATA ), "SHA256 - SHA-256 input data was malformed" },
+        #endif
+        #if defined( MBEDTLS_SHA512_C )
+            { -( MBEDTLS_ERR_SHA512_BAD_INPUT_DATA ), "SHA512 - SHA-512 input data was malformed" },
+        #endif
+        #if defined( MBEDTLS_CMAC_C ) && ( MBEDTLS_VERSION_MAJOR < 3 )
+            { -( MBEDTLS_ERR_CMAC_HW_ACCEL_FAILED ), "CMAC - CMAC hardware accelerator failed" },
+        #endif
 
-            case -( MBEDTLS_ERR_SSL_SESSION_TICKET_EXPIRED ):
-                rc = "SSL - Session ticket has expired";
-                break;
+        /* Terminates the table, so that it is never empty. Lookups do not
+         * search this entry. */
+        { 0U, NULL }
+    };
 
-            case -( MBEDTLS_ERR_SSL_PK_TYPE_MISMATCH ):
-                rc = "SSL - Public key type mismatch (eg, asked for RSA key exchange and presented EC key)";
-                break;
+/*-----------------------------------------------------------*/
 
-            case -( MBEDTLS_ERR_SSL_UNKNOWN_IDENTITY ):
-                rc = "SSL - Unknown identity received (eg, PSK identity)";
-                break;
+/**
+ * @brief Compare an error code with the code of a table entry, for bsearch().
+ *
+ * @param[in] pKey The uint16_t error code.
+ * @param[in] pEntry The ErrorString_t entry.
+ *
+ * @return Negative, zero or positive if the code is below, equal to or above
+ * the code of the entry.
+ */
+    static int compareErrorCode( const void * pKey,
+                                 const void * pEntry );
 
-            case -( MBEDTLS_ERR_SSL_INTERNAL_ERROR ):
-                rc = "SSL - Internal error (eg, unexpected failure in lower-level module)";
-                break;
+    #if ( configASSERT_DEFINED == 1 )
 
-            case -( MBEDTLS_ERR_SSL_COUNTER_WRAPPING ):
-                rc = "SSL - A counter would wrap (eg, too many messages exchanged)";
-                break;
+/**
+ * @brief Check that the codes of a table are in strictly ascending order.
+ *
+ * @param[in] pTable The table.
+ * @param[in] length Number of entries to check.
+ *
+ * @return pdTRUE if the table is sorted, else pdFALSE.
+ */
+        static BaseType_t isErrorTableSorted( const ErrorString_t * pTable,
+                                              size_t length );
+    #endif
 
-            case -( MBEDTLS_ERR_SSL_WAITING_SERVER_HELLO_RENEGO ):
-                rc = "SSL - Unexpected message at ServerHello in renegotiation";
-                break;
+/**
+ * @brief Find the description of an error code in a table.
+ *
+ * @param[in] pTable Table sorted by code.
+ * @param[in] length Number of entries in the table, without the terminating
+ * entry.
+ * @param[in] code The negated error code, masked to the level of the table.
+ *
+ * @return The description, or NULL if the table does not hold the code.
+ */
+    static const char * findErrorString( const ErrorString_t * pTable,
+                                         size_t length,
+                                         uint32_t code );
 
-            case -( MBEDTLS_ERR_SSL_HELLO_VERIFY_REQUIRED ):
-                rc = "SSL - DTLS client must retry for hello verification";
-                break;
+/*-----------------------------------------------------------*/
 
-            case -( MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL ):
-                rc = "SSL - A buffer is too small to receive or write a message";
-                break;
+    static int compareErrorCode( const void * pKey,
+                                 const void * pEntry )
+    {
+        uint16_t key = *( ( const uint16_t * ) pKey );
+        uint16_t entryCode = ( ( const ErrorString_t * ) pEntry )->code;
 
-            case -( MBEDTLS_ERR_SSL_NO_USABLE_CIPHERSUITE ):
-                rc = "SSL - None of the common ciphersuites is usable (eg, no suitable certificate, see debug messages)";
-                break;
+        return ( int ) key - ( int ) entryCode;
+    }
 
-            case -( MBEDTLS_ERR_SSL_WANT_READ ):
-                rc = "SSL - No data of requested type currently available on underlying transport";
-                break;
+/*-----------------------------------------------------------*/
 
-            case -( MBEDTLS_ERR_SSL_WANT_WRITE ):
-                rc = "SSL - Connection requires a write call";
-                break;
+    #if ( configASSERT_DEFINED == 1 )
+        static BaseType_t isErrorTableSorted( const ErrorString_t * pTable,
+                                              size_t length )
+        {
+            BaseType_t sorted = pdTRUE;
+            size_t i;
 
-            case -( MBEDTLS_ERR_SSL_TIMEOUT ):
-                rc = "SSL - The operation timed out";
-                break;
+            for( i = 1U; ( i < length ) && ( sorted == pdTRUE ); i++ )
+            {
+                if( pTable[ i - 1U ].code >= pTable[ i ].code )
+                {
+                    sorted = pdFALSE;
+                }
+            }
 
-            case -( MBEDTLS_ERR_SSL_CLIENT_RECONNECT ):
-                rc = "SSL - The client initiated a reconnect from the same port";
-                break;
+            return sorted;
+        }
+    #endif
 
-            case -( MBEDTLS_ERR_SSL_UNEXPECTED_RECORD ):
-                rc = "SSL - Record header looks valid but is not expected";
-                break;
+/*-----------------------------------------------------------*/
 
-            case -( MBEDTLS_ERR_SSL_NON_FATAL ):
-                rc = "SSL - The alert message received indicates a non-fatal error";
-                break;
+    static const char * findErrorString( const ErrorString_t * pTable,
+                                         size_t length,
+                                         uint32_t code )
+    {
+        const ErrorString_t * pEntry = NULL;
+        uint16_t key = ( uint16_t ) code;
+
+        #if ( configASSERT_DEFINED == 1 )
+            static BaseType_t tablesChecked = pdFALSE;
+
+            /* An entry out of order would make bsearch() miss codes, so check
+             * both tables once. Two tasks may both do the check, which is
+             * harmless. */
+            if( tablesChecked == pdFALSE )
+            {
+                configASSERT( isErrorTableSorted( highLevelErrors,
+                                                  ERROR_TABLE_LENGTH( highLevelErrors ) ) == pdTRUE );
+                configASSERT( isErrorTableSorted( lowLevelErrors,
+                                                  ERROR_TABLE_LENGTH( lowLevelErrors ) ) == pdTRUE );
+                tablesChecked = pdTRUE;
+            }
+        #endif
+
+        pEntry = bsearch( &key, pTable, length, sizeof( ErrorString_t ), compareErrorCode );
+
+        return ( pEntry != NULL ) ? pEntry->pString : NULL;
+    }
 
-            case -( MBEDTLS_ERR_SSL_INVALID_VERIFY_HASH ):
-                rc = "SSL - Couldn't set the hash for verifying CertificateVerify";
-                break;
+#endif /* if !defined( MBEDTLS_ERROR_NUMERIC_ONLY ) */
 
-            case -( MBEDTLS_ERR_SSL_CONTINUE_PROCESSING ):
-                rc = "SSL - Internal-only message signaling that further message-processing should be done";
-                break;
+/*-----------------------------------------------------------*/
 
-            case -( MBEDTLS_ERR_SSL_ASYNC_IN_PROGRESS ):
-                rc = "SSL - The asynchronous operation is not completed yet";
-                break;
+const char * mbedtls_strerror_highlevel( int32_t errnum )
+{
+    const char * rc = NULL;
+    uint32_t use_ret = 0;
 
-            case -( MBEDTLS_ERR_SSL_EARLY_MESSAGE ):
-                rc = "SSL - Internal-only message signaling that a message arrived early";
-                break;
+    if( errnum < 0 )
+    {
+        use_ret = ( uint32_t ) -errnum;
+    }
+    else
+    {
+        use_ret = ( uint32_t ) errnum;
+    }
 
-            case -( MBEDTLS_ERR_SSL_CRYPTO_IN_PROGRESS ):
-                rc = "SSL - A cryptographic operation is in progress. Try again later";
-                break;
-        #endif /* MBEDTLS_SSL_TLS_C */
+    use_ret &= HIGH_LEVEL_CODE_MASK;
 
-        #if defined( MBEDTLS_X509_USE_C ) || defined( MBEDTLS_X509_CREATE_C )
-            case -( MBEDTLS_ERR_X509_FEATURE_UNAVAILABLE ):
-                rc = "X509 - Unavailable feature, e.g. RSA hashing/encryption combination";
-                break;
-
-            case -( MBEDTLS_ERR_X509_UNKNOWN_OID ):
-                rc = "X509 - Requested OID is unknown";
-                break;
-
-            case -( MBEDTLS_ERR_X509_INVALID_FORMAT ):
-                rc = "X509 - The CRT/CRL/CSR format is invalid, e.g. different type expected";
-                break;
-
-            case -( MBEDTLS_ERR_X509_INVALID_VERSION ):
-                rc = "X509 - The CRT/CRL/CSR version element is invalid";
-                break;
-
-            case -( MBEDTLS_ERR_X509_INVALID_SERIAL ):
-                rc = "X509 - The serial tag or value is invalid";
-                break;
-
-            case -( MBEDTLS_ERR_X509_INVALID_ALG ):
-                rc = "X509 - The algorithm tag or value is invalid";
-                break;
-
-            case -( MBEDTLS_ERR_X509_INVALID_NAME ):
-                rc = "X509 - The name tag or value is invalid";
-                break;
-
-            case -( MBEDTLS_ERR_X509_INVALID_DATE ):
-                rc = "X509 - The date tag or value is invalid";
-                break;
-
-            case -( MBEDTLS_ERR_X509_INVALID_SIGNATURE ):
-                rc = "X509 - The signature tag or value invalid";
-                break;
-
-            case -( MBEDTLS_ERR_X509_INVALID_EXTENSIONS ):
-                rc = "X509 - The extension tag or value is invalid";
-                break;
-
-            case -( MBEDTLS_ERR_X509_UNKNOWN_VERSION ):
-                rc = "X509 - CRT/CRL/CSR has an unsupported version number";
-                break;
-
-            case -( MBEDTLS_ERR_X509_UNKNOWN_SIG_ALG ):
-                rc = "X509 - Signature algorithm (oid) is unsupported";
-                break;
-
-            case -( MBEDTLS_ERR_X509_SIG_MISMATCH ):
-                rc = "X509 - Signature algorithms do not match. (see \\c ::mbedtls_x509_crt sig_oid)";
-                break;
-
-            case -( MBEDTLS_ERR_X509_CERT_VERIFY_FAILED ):
-                rc = "X509 - Certificate verification failed, e.g. CRL, CA or signature check failed";
-                break;
-
-            case -( MBEDTLS_ERR_X509_CERT_UNKNOWN_FORMAT ):
-                rc = "X509 - Format not recognized as DER or PEM";
-                break;
-
-            case -( MBEDTLS_ERR_X509_BAD_INPUT_DATA ):
-                rc = "X509 - Input invalid";
-                break;
-
-            case -( MBEDTLS_ERR_X509_ALLOC_FAILED ):
-                rc = "X509 - Allocation of memory failed";
-                break;
-
-            case -( MBEDTLS_ERR_X509_FILE_IO_ERROR ):
-                rc = "X509 - Read/write of file failed";
-                break;
-
-            case -( MBEDTLS_ERR_X509_BUFFER_TOO_SMALL ):
-                rc = "X509 - Destination buffer is too small";
-                break;
-
-            case -( MBEDTLS_ERR_X509_FATAL_ERROR ):
-                rc = "X509 - A fatal error occured, eg the chain is too long or the vrfy callback failed";
-                break;
-        #endif /* MBEDTLS_X509_USE_C || MBEDTLS_X509_CREATE_C */
-
-        default:
-            rc = NULL;
-            break;
-    }
+    #if !defined( MBEDTLS_ERROR_NUMERIC_ONLY )
+        if( use_ret != 0U )
+        {
+            rc = findErrorString( highLevelErrors,
+                                  ERROR_TABLE_LENGTH( highLevelErrors ),
+                                  use_ret );
+        }
+    #endif
 
     return rc;
 }
 
+/*-----------------------------------------------------------*/
+
 const char * mbedtls_strerror_lowlevel( int32_t errnum )
 {
     const char * rc = NULL;
@@ -873,468 +853,16 @@ const char * mbedtls_strerror_lowlevel( int32_t errnum )
         use_ret = ( uint32_t ) errnum;
     }
 
-    use_ret &= 0xFF80;
-
-    /* Low level error codes */
-    /* */
-    switch( use_ret )
-    {
-        #if defined( MBEDTLS_AES_C )
-            case -( MBEDTLS_ERR_AES_INVALID_KEY_LENGTH ):
-                rc = "AES - Invalid key length";
-                break;
-
-            case -( MBEDTLS_ERR_AES_INVALID_INPUT_LENGTH ):
-                rc = "AES - Invalid data input length";
-                break;
-
-            case -( MBEDTLS_ERR_AES_BAD_INPUT_DATA ):
-                rc = "AES - Invalid input data";
-                break;
-
-            case -( MBEDTLS_ERR_AES_FEATURE_UNAVAILABLE ):
-                rc = "AES - Feature not available. For example, an unsupported AES key size";
-                break;
-
-            case -( MBEDTLS_ERR_AES_HW_ACCEL_FAILED ):
-                rc = "AES - AES hardware accelerator failed";
-                break;
-        #endif /* MBEDTLS_AES_C */
-
-        #if defined( MBEDTLS_ARC4_C )
-            case -( MBEDTLS_ERR_ARC4_HW_ACCEL_FAILED ):
-                rc = "ARC4 - ARC4 hardware accelerator failed";
-                break;
-        #endif /* MBEDTLS_ARC4_C */
-
-        #if defined( MBEDTLS_ARIA_C )
-            case -( MBEDTLS_ERR_ARIA_BAD_INPUT_DATA ):
-                rc = "ARIA - Bad input data";
-                break;
-
-            case -( MBEDTLS_ERR_ARIA_INVALID_INPUT_LENGTH ):
-                rc = "ARIA - Invalid data input length";
-                break;
-
-            case -( MBEDTLS_ERR_ARIA_FEATURE_UNAVAILABLE ):
-                rc = "ARIA - Feature not available. For example, an unsupported ARIA key size";
-                break;
-
-            case -( MBEDTLS_ERR_ARIA_HW_ACCEL_FAILED ):
-                rc = "ARIA - ARIA hardware accelerator failed";
-                break;
-        #endif /* MBEDTLS_ARIA_C */
-
-        #if defined( MBEDTLS_ASN1_PARSE_C )
-            case -( MBEDTLS_ERR_ASN1_OUT_OF_DATA ):
-                rc = "ASN1 - Out of data when parsing an ASN1 data structure";
-                break;
-
-            case -( MBEDTLS_ERR_ASN1_UNEXPECTED_TAG ):
-                rc = "ASN1 - ASN1 tag was of an unexpected value";
-                break;
-
-            case -( MBEDTLS_ERR_ASN1_INVALID_LENGTH ):
-                rc = "ASN1 - Error when trying to determine the length or invalid length";
-                break;
-
-            case -( MBEDTLS_ERR_ASN1_LENGTH_MISMATCH ):
-                rc = "ASN1 - Actual length differs from expected length";
-                break;
-
-            case -( MBEDTLS_ERR_ASN1_INVALID_DATA ):
-                rc = "ASN1 - Data is invalid. (not used)";
-                break;
-
-            case -( MBEDTLS_ERR_ASN1_ALLOC_FAILED ):
-                rc = "ASN1 - Memory allocation failed";
-                break;
-
-            case -( MBEDTLS_ERR_ASN1_BUF_TOO_SMALL ):
-                rc = "ASN1 - Buffer too small when writing ASN.1 data structure";
-                break;
-        #endif /* MBEDTLS_ASN1_PARSE_C */
-
-        #if defined( MBEDTLS_BASE64_C )
-            case -( MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL ):
-                rc = "BASE64 - Output buffer too small";
-                break;
-
-            case -( MBEDTLS_ERR_BASE64_INVALID_CHARACTER ):
-                rc = "BASE64 - Invalid character in input";
-                break;
-        #endif /* MBEDTLS_BASE64_C */
-
-        #if defined( MBEDTLS_BIGNUM_C )
-            case -( MBEDTLS_ERR_MPI_FILE_IO_ERROR ):
-                rc = "BIGNUM - An error occurred while reading from or writing to a file";
-                break;
-
-            case -( MBEDTLS_ERR_MPI_BAD_INPUT_DATA ):
-                rc = "BIGNUM - Bad input parameters to function";
-                break;
-
-            case -( MBEDTLS_ERR_MPI_INVALID_CHARACTER ):
-                rc = "BIGNUM - There is an invalid character in the digit string";
-                break;
-
-            case -( MBEDTLS_ERR_MPI_BUFFER_TOO_SMALL ):
-                rc = "BIGNUM - The buffer is too small to write to";
-                break;
+    use_ret &= LOW_LEVEL_CODE_MASK;
 
-            case -( MBEDTLS_ERR_MPI_NEGATIVE_VALUE ):
-                rc = "BIGNUM - The input arguments are negative or result in illegal output";
-                break;
-
-            case -( MBEDTLS_ERR_MPI_DIVISION_BY_ZERO ):
-                rc = "BIGNUM - The input argument for division is zero, which is not allowed";
-                break;
-
-            case -( MBEDTLS_ERR_MPI_NOT_ACCEPTABLE ):
-                rc = "BIGNUM - The input arguments are not acceptable";
-                break;
-
-            case -( MBEDTLS_ERR_MPI_ALLOC_FAILED ):
-                rc = "BIGNUM - Memory allocation failed";
-                break;
-        #endif /* MBEDTLS_BIGNUM_C */
-
-        #if defined( MBEDTLS_BLOWFISH_C )
-            case -( MBEDTLS_ERR_BLOWFISH_BAD_INPUT_DATA ):
-                rc = "BLOWFISH - Bad input data";
-                break;
-
-            case -( MBEDTLS_ERR_BLOWFISH_INVALID_INPUT_LENGTH ):
-                rc = "BLOWFISH - Invalid data input length";
-                break;
-
-            case -( MBEDTLS_ERR_BLOWFISH_HW_ACCEL_FAILED ):
-                rc = "BLOWFISH - Blowfish hardware accelerator failed";
-                break;
-        #endif /* MBEDTLS_BLOWFISH_C */
-
-        #if defined( MBEDTLS_CAMELLIA_C )
-            case -( MBEDTLS_ERR_CAMELLIA_BAD_INPUT_DATA ):
-                rc = "CAMELLIA - Bad input data";
-                break;
-
-            case -( MBEDTLS_ERR_CAMELLIA_INVALID_INPUT_LENGTH ):
-                rc = "CAMELLIA - Invalid data input length";
-                break;
-
-            case -( MBEDTLS_ERR_CAMELLIA_HW_ACCEL_FAILED ):
-                rc = "CAMELLIA - Camellia hardware accelerator failed";
-                break;
-        #endif /* MBEDTLS_CAMELLIA_C */
-
-        #if defined( MBEDTLS_CCM_C )
-            case -( MBEDTLS_ERR_CCM_BAD_INPUT ):
-                rc = "CCM - Bad input parameters to the function";
-                break;
-
-            case -( MBEDTLS_ERR_CCM_AUTH_FAILED ):
-                rc = "CCM - Authenticated decryption failed";
-                break;
-
-            case -( MBEDTLS_ERR_CCM_HW_ACCEL_FAILED ):
-                rc = "CCM - CCM hardware accelerator failed";
-                break;
-        #endif /* MBEDTLS_CCM_C */
-
-        #if defined( MBEDTLS_CHACHA20_C )
-            case -( MBEDTLS_ERR_CHACHA20_BAD_INPUT_DATA ):
-                rc = "CHACHA20 - Invalid input parameter(s)";
-                break;
-
-            case -( MBEDTLS_ERR_CHACHA20_FEATURE_UNAVAILABLE ):
-                rc = "CHACHA20 - Feature not available. For example, s part of the API is not implemented";
-                break;
-
-            case -( MBEDTLS_ERR_CHACHA20_HW_ACCEL_FAILED ):
-                rc = "CHACHA20 - Chacha20 hardware accelerator failed";
-                break;
-        #endif /* MBEDTLS_CHACHA20_C */
-
-        #if defined( MBEDTLS_CHACHAPOLY_C )
-            case -( MBEDTLS_ERR_CHACHAPOLY_BAD_STATE ):
-                rc = "CHACHAPOLY - The requested operation is not permitted in the current state";
-                break;
-
-            case -( MBEDTLS_ERR_CHACHAPOLY_AUTH_FAILED ):
-                rc = "CHACHAPOLY - Authenticated decryption failed: data was not authentic";
-                break;
-        #endif /* MBEDTLS_CHACHAPOLY_C */
-
-        #if defined( MBEDTLS_CMAC_C )
-            case -( MBEDTLS_ERR_CMAC_HW_ACCEL_FAILED ):
-                rc = "CMAC - CMAC hardware accelerator failed";
-                break;
-        #endif /* MBEDTLS_CMAC_C */
-
-        #if defined( MBEDTLS_CTR_DRBG_C )
-            case -( MBEDTLS_ERR_CTR_DRBG_ENTROPY_SOURCE_FAILED ):
-                rc = "CTR_DRBG - The entropy source failed";
-                break;
-
-            case -( MBEDTLS_ERR_CTR_DRBG_REQUEST_TOO_BIG ):
-                rc = "CTR_DRBG - The requested random buffer length is too big";
-                break;
-
-            case -( MBEDTLS_ERR_CTR_DRBG_INPUT_TOO_BIG ):
-                rc = "CTR_DRBG - The input (entropy + additional data) is too large";
-                break;
-
-            case -( MBEDTLS_ERR_CTR_DRBG_FILE_IO_ERROR ):
-                rc = "CTR_DRBG - Read or write error in file";
-                break;
-        #endif /* MBEDTLS_CTR_DRBG_C */
-
-        #if defined( MBEDTLS_DES_C )
-            case -( MBEDTLS_ERR_DES_INVALID_INPUT_LENGTH ):
-                rc = "DES - The data input has an invalid length";
-                break;
-
-            case -( MBEDTLS_ERR_DES_HW_ACCEL_FAILED ):
-                rc = "DES - DES hardware accelerator failed";
-                break;
-        #endif /* MBEDTLS_DES_C */
-
-        #if defined( MBEDTLS_ENTROPY_C )
-            case -( MBEDTLS_ERR_ENTROPY_SOURCE_FAILED ):
-                rc = "ENTROPY - Critical entropy source failure";
-                break;
-
-            case -( MBEDTLS_ERR_ENTROPY_MAX_SOURCES ):
-                rc = "ENTROPY - No more sources can be added";
-                break;
-
-            case -( MBEDTLS_ERR_ENTROPY_NO_SOURCES_DEFINED ):
-                rc = "ENTROPY - No sources have been added to poll";
-                break;
-
-            case -( MBEDTLS_ERR_ENTROPY_NO_STRONG_SOURCE ):
-                rc = "ENTROPY - No strong sources have been added to poll";
-                break;
-
-            case -( MBEDTLS_ERR_ENTROPY_FILE_IO_ERROR ):
-                rc = "ENTROPY - Read/write error in file";
-                break;
-        #endif /* MBEDTLS_ENTROPY_C */
-
-        #if defined( MBEDTLS_GCM_C )
-            case -( MBEDTLS_ERR_GCM_AUTH_FAILED ):
-                rc = "GCM - Authenticated decryption failed";
-                break;
-
-            case -( MBEDTLS_ERR_GCM_HW_ACCEL_FAILED ):
-                rc = "GCM - GCM hardware accelerator failed";
-                break;
-
-            case -( MBEDTLS_ERR_GCM_BAD_INPUT ):
-                rc = "GCM - Bad input parameters to function";
-                break;
-        #endif /* MBEDTLS_GCM_C */
-
-        #if defined( MBEDTLS_HKDF_C )
-            case -( MBEDTLS_ERR_HKDF_BAD_INPUT_DATA ):
-                rc = "HKDF - Bad input parameters to function";
-                break;
-        #endif /* MBEDTLS_HKDF_C */
-
-        #if defined( MBEDTLS_HMAC_DRBG_C )
-            case -( MBEDTLS_ERR_HMAC_DRBG_REQUEST_TOO_BIG ):
-                rc = "HMAC_DRBG - Too many random requested in single call";
-                break;
-
-            case -( MBEDTLS_ERR_HMAC_DRBG_INPUT_TOO_BIG ):
-                rc = "HMAC_DRBG - Input too large (Entropy + additional)";
-                break;
-
-            case -( MBEDTLS_ERR_HMAC_DRBG_FILE_IO_ERROR ):
-                rc = "HMAC_DRBG - Read/write error in file";
-                break;
-
-            case -( MBEDTLS_ERR_HMAC_DRBG_ENTROPY_SOURCE_FAILED ):
-                rc = "HMAC_DRBG - The entropy source failed";
-                break;
-        #endif /* MBEDTLS_HMAC_DRBG_C */
-
-        #if defined( MBEDTLS_MD2_C )
-            case -( MBEDTLS_ERR_MD2_HW_ACCEL_FAILED ):
-                rc = "MD2 - MD2 hardware accelerator failed";
-                break;
-        #endif /* MBEDTLS_MD2_C */
-
-        #if defined( MBEDTLS_MD4_C )
-            case -( MBEDTLS_ERR_MD4_HW_ACCEL_FAILED ):
-                rc = "MD4 - MD4 hardware accelerator failed";
-                break;
-        #endif /* MBEDTLS_MD4_C */
-
-        #if defined( MBEDTLS_MD5_C )
-            case -( MBEDTLS_ERR_MD5_HW_ACCEL_FAILED ):
-                rc = "MD5 - MD5 hardware accelerator failed";
-                break;
-        #endif /* MBEDTLS_MD5_C */
-
-        #if defined( MBEDTLS_NET_C )
-            case -( MBEDTLS_ERR_NET_SOCKET_FAILED ):
-                rc = "NET - Failed to open a socket";
-                break;
-
-            case -( MBEDTLS_ERR_NET_CONNECT_FAILED ):
-                rc = "NET - The connection to the given server / port failed";
-                break;
-
-            case -( MBEDTLS_ERR_NET_BIND_FAILED ):
-                rc = "NET - Binding of the socket failed";
-                break;
-
-            case -( MBEDTLS_ERR_NET_LISTEN_FAILED ):
-                rc = "NET - Could not listen on the socket";
-                break;
-
-            case -( MBEDTLS_ERR_NET_ACCEPT_FAILED ):
-                rc = "NET - Could not accept the incoming connection";
-                break;
-
-            case -( MBEDTLS_ERR_NET_RECV_FAILED ):
-                rc = "NET - Reading information from the socket failed";
-                break;
-
-            case -( MBEDTLS_ERR_NET_SEND_FAILED ):
-                rc = "NET - Sending information through the socket failed";
-                break;
-
-            case -( MBEDTLS_ERR_NET_CONN_RESET ):
-                rc = "NET - Connection was reset by peer";
-                break;
-
-            case -( MBEDTLS_ERR_NET_UNKNOWN_HOST ):
-                rc = "NET - Failed to get an IP address for the given hostname";
-                break;
-
-            case -( MBEDTLS_ERR_NET_BUFFER_TOO_SMALL ):
-                rc = "NET - Buffer is too small to hold the data";
-                break;
-
-            case -( MBEDTLS_ERR_NET_INVALID_CONTEXT ):
-                rc = "NET - The context is invalid, eg because it was free()ed";
-                break;
-
-            case -( MBEDTLS_ERR_NET_POLL_FAILED ):
-                rc = "NET - Polling the net context failed";
-                break;
-
-            case -( MBEDTLS_ERR_NET_BAD_INPUT_DATA ):
-                rc = "NET - Input invalid";
-                break;
-        #endif /* MBEDTLS_NET_C */
-
-        #if defined( MBEDTLS_OID_C )
-            case -( MBEDTLS_ERR_OID_NOT_FOUND ):
-                rc = "OID - OID is not found";
-                break;
-
-            case -( MBEDTLS_ERR_OID_BUF_TOO_SMALL ):
-                rc = "OID - output buffer is too small";
-                break;
-        #endif /* MBEDTLS_OID_C */
-
-        #if defined( MBEDTLS_PADLOCK_C )
-            case -( MBEDTLS_ERR_PADLOCK_DATA_MISALIGNED ):
-                rc = "PADLOCK - Input data should be aligned";
-                break;
-        #endif /* MBEDTLS_PADLOCK_C */
-
-        #if defined( MBEDTLS_PLATFORM_C )
-            case -( MBEDTLS_ERR_PLATFORM_HW_ACCEL_FAILED ):
-                rc = "PLATFORM - Hardware accelerator failed";
-                break;
-
-            case -( MBEDTLS_ERR_PLATFORM_FEATURE_UNSUPPORTED ):
-                rc = "PLATFORM - The requested feature is not supported by the platform";
-                break;
-        #endif /* MBEDTLS_PLATFORM_C */
-
-        #if defined( MBEDTLS_POLY1305_C )
-            case -( MBEDTLS_ERR_POLY1305_BAD_INPUT_DATA ):
-                rc = "POLY1305 - Invalid input parameter(s)";
-                break;
-
-            case -( MBEDTLS_ERR_POLY1305_FEATURE_UNAVAILABLE ):
-                rc = "POLY1305 - Feature not available. For example, s part of the API is not implemented";
-                break;
-
-            case -( MBEDTLS_ERR_POLY1305_HW_ACCEL_FAILED ):
-                rc = "POLY1305 - Poly1305 hardware accelerator failed";
-                break;
-        #endif /* MBEDTLS_POLY1305_C */
-
-        #if defined( MBEDTLS_RIPEMD160_C )
-            case -( MBEDTLS_ERR_RIPEMD160_HW_ACCEL_FAILED ):
-                rc = "RIPEMD160 - RIPEMD160 hardware accelerator failed";
-                break;
-        #endif /* MBEDTLS_RIPEMD160_C */
-
-        #if defined( MBEDTLS_SHA1_C )
-            case -( MBEDTLS_ERR_SHA1_HW_ACCEL_FAILED ):
-                rc = "SHA1 - SHA-1 hardware accelerator failed";
-                break;
-
-            case -( MBEDTLS_ERR_SHA1_BAD_INPUT_DATA ):
-                rc = "SHA1 - SHA-1 input data was malformed";
-                break;
-        #endif /* MBEDTLS_SHA1_C */
-
-        #if defined( MBEDTLS_SHA256_C )
-            case -( MBEDTLS_ERR_SHA256_HW_ACCEL_FAILED ):
-                rc = "SHA256 - SHA-256 hardware accelerator failed";
-                break;
-
-            case -( MBEDTLS_ERR_SHA256_BAD_INPUT_DATA ):
-                rc = "SHA256 - SHA-256 input data was malformed";
-                break;
-        #endif /* MBEDTLS_SHA256_C */
-
-        #if defined( MBEDTLS_SHA512_C )
-            case -( MBEDTLS_ERR_SHA512_HW_ACCEL_FAILED ):
-                rc = "SHA512 - SHA-512 hardware accelerator failed";
-                break;
-
-            case -( MBEDTLS_ERR_SHA512_BAD_INPUT_DATA ):
-                rc = "SHA512 - SHA-512 input data was malformed";
-                break;
-        #endif /* MBEDTLS_SHA512_C */
-
-        #if defined( MBEDTLS_THREADING_C )
-            case -( MBEDTLS_ERR_THREADING_FEATURE_UNAVAILABLE ):
-                rc = "THREADING - The selected feature is not available";
-                break;
-
-            case -( MBEDTLS_ERR_THREADING_BAD_INPUT_DATA ):
-                rc = "THREADING - Bad input parameters to function";
-                break;
-
-            case -( MBEDTLS_ERR_THREADING_MUTEX_ERROR ):
-                rc = "THREADING - Locking / unlocking / free failed with error code";
-                break;
-        #endif /* MBEDTLS_THREADING_C */
-
-        #if defined( MBEDTLS_XTEA_C )
-            case -( MBEDTLS_ERR_XTEA_INVALID_INPUT_LENGTH ):
-                rc = "XTEA - The data input has an invalid length";
-                break;
-
-            case -( MBEDTLS_ERR_XTEA_HW_ACCEL_FAILED ):
-                rc = "XTEA - XTEA hardware accelerator failed";
-                break;
-        #endif /* MBEDTLS_XTEA_C */
-
-        default:
-            rc = NULL;
-            break;
-    }
+    #if !defined( MBEDTLS_ERROR_NUMERIC_ONLY )
+        if( use_ret != 0U )
+        {
+            rc = findErrorString( lowLevelErrors,
+                                  ERROR_TABLE_LENGTH( lowLevelErrors ),
+                                  use_ret );
+        }
+    #endif
 
     return rc;
 }
@@ -40,6 +40,7 @@
  *
  * @param errnum The error code containing the high-level code.
  * @return The string representation if high-level code is present; otherwise NULL.
+ * Always NULL when MBEDTLS_ERROR_NUMERIC_ONLY is defined.
  *
  * @warning The string returned by this function must never be modified.
  */
@@ -51,6 +52,7 @@
  *
  * @param errnum The error code containing the low-level code.
  * @return The string representation if low-level code is present; otherwise NULL.
+ * Always NULL when MBEDTLS_ERROR_NUMERIC_ONLY is defined.
  *
  * @warning The string returned by this function must never be modified.
  */
@@ -33,6 +33,10 @@
 #include "threading_alt.h"
 #include "mbedtls/entropy.h"
 
+#ifdef MBEDTLS_FREERTOS_SLAB_ALLOC
+    #include "mbedtls_slab_alloc.h"
+#endif
+
 /* Socket wrapper includes. */
 #include "sockets_wrapper.h"
 
@@ -45,6 +49,9 @@
  * @param[in] size Size of each member.
  *
  * @return Pointer to the beginning of newly allocated memory.
+ *
+ * @note With MBEDTLS_FREERTOS_SLAB_ALLOC defined, small requests are served by
+ * the size-class pools of mbedtls_slab_alloc.c instead of the FreeRTOS heap.
  */
 void * mbedtls_platform_calloc( size_t nmemb,
                                 size_t size )
@@ -58,7 +65,11 @@ void * mbedtls_platform_calloc( size_t nmemb,
         /* Overflow check. */
         if( ( totalSize / size ) == nmemb )
         {
-            pBuffer = pvPortMalloc( totalSize );
+            #ifdef MBEDTLS_FREERTOS_SLAB_ALLOC
+                pBuffer = mbedtls_platform_slab_alloc( totalSize );
+            #else
+                pBuffer = pvPortMalloc( totalSize );
+            #endif
 
             if( pBuffer != NULL )
             {
@@ -79,7 +90,11 @@ void * mbedtls_platform_calloc( size_t nmemb,
  */
 void mbedtls_platform_free( void * ptr )
 {
-    vPortFree( ptr );
+    #ifdef MBEDTLS_FREERTOS_SLAB_ALLOC
+        mbedtls_platform_slab_free( ptr );
+    #else
+        vPortFree( ptr );
+    #endif
 }
 
 /*-----------------------------------------------------------*/
@@ -0,0 +1,428 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file mbedtls_slab_alloc.c
+ * @brief Size-class slab allocator for the mbed TLS platform allocator.
+ */
+
+/* Standard includes. */
+#include <string.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* mbed TLS includes. */
+#include "mbedtls_config.h"
+#include "mbedtls_slab_alloc.h"
+
+/* Configure logs for the functions in this file. */
+#include "logging_levels.h"
+#ifndef LIBRARY_LOG_NAME
+    #define LIBRARY_LOG_NAME     "MbedtlsSlab"
+#endif
+#ifndef LIBRARY_LOG_LEVEL
+    #define LIBRARY_LOG_LEVEL    LOG_INFO
+#endif
+#include "logging_stack.h"
+
+/*-----------------------------------------------------------*/
+
+/* Number of blocks of each size class. The defaults are the highest peaks
+ * of each class, rounded up to a multiple of 4, over 10 mutual-auth TLS 1.2
+ * handshakes with RSA-2048 certificates and 10 with P-256 ones, recorded with
+ * MBEDTLS_FREERTOS_SLAB_HISTOGRAM on the host build of mbed TLS 2.28:
+ *
+ * class   RSA peak  P-256 peak
+ *   32       16         81
+ *   64        1          8
+ *  128       57         52
+ *  256       22         16
+ *  512       21         12
+ * 1024       18          5
+ *
+ * RSA operands fill the 128 and 256 byte classes, ECP points and bignum limbs
+ * the smaller ones, and the parsed certificates the 512 and 1024 byte ones;
+ * only the record buffers and a few larger structures go to the heap. The
+ * configuration and cipher suites of the target change these numbers, so
+ * check them with mbedtls_platform_slab_log_stats() and override the counts
+ * below in mbedtls_config.h. */
+#ifndef MBEDTLS_FREERTOS_SLAB_BLOCKS_32
+    #define MBEDTLS_FREERTOS_SLAB_BLOCKS_32    84U
+#endif
+#ifndef MBEDTLS_FREERTOS_SLAB_BLOCKS_64
+    #define MBEDTLS_FREERTOS_SLAB_BLOCKS_64    8U
+#endif
+#ifndef MBEDTLS_FREERTOS_SLAB_BLOCKS_128
+    #define MBEDTLS_FREERTOS_SLAB_BLOCKS_128    60U
+#endif
+#ifndef MBEDTLS_FREERTOS_SLAB_BLOCKS_256
+    #define MBEDTLS_FREERTOS_SLAB_BLOCKS_256    24U
+#endif
+#ifndef MBEDTLS_FREERTOS_SLAB_BLOCKS_512
+    #define MBEDTLS_FREERTOS_SLAB_BLOCKS_512    24U
+#endif
+#ifndef MBEDTLS_FREERTOS_SLAB_BLOCKS_1024
+    #define MBEDTLS_FREERTOS_SLAB_BLOCKS_1024    20U
+#endif
+
+/**
+ * @brief Define the storage of a size class, aligned for any mbed TLS type.
+ */
+#define SLAB_POOL( blockSize, blockCount ) \
+    static uint64_t slabPool ## blockSize[ ( ( blockSize ) * ( blockCount ) ) / sizeof( uint64_t ) ]
+
+/**
+ * @brief Smallest request size counted by the first histogram bucket.
+ */
+#define SLAB_HISTOGRAM_FIRST_BUCKET_SIZE    16U
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief A pool of equally sized blocks.
+ */
+typedef struct SlabClass
+{
+    uint8_t * pPool;   /**< @brief First byte of the pool. */
+    size_t blockSize;  /**< @brief Size of each block in bytes. */
+    size_t blockCount; /**< @brief Number of blocks in the pool. */
+    size_t nextUnused; /**< @brief Index of the first block never handed out. */
+    void * pFreeList;  /**< @brief Freed blocks, linked through their first bytes. */
+} SlabClass_t;
+
+/*-----------------------------------------------------------*/
+
+SLAB_POOL( 32U, MBEDTLS_FREERTOS_SLAB_BLOCKS_32 );
+SLAB_POOL( 64U, MBEDTLS_FREERTOS_SLAB_BLOCKS_64 );
+SLAB_POOL( 128U, MBEDTLS_FREERTOS_SLAB_BLOCKS_128 );
+SLAB_POOL( 256U, MBEDTLS_FREERTOS_SLAB_BLOCKS_256 );
+SLAB_POOL( 512U, MBEDTLS_FREERTOS_SLAB_BLOCKS_512 );
+SLAB_POOL( 1024U, MBEDTLS_FREERTOS_SLAB_BLOCKS_1024 );
+
+/**
+ * @brief The size classes, in increasing block size.
+ */
+static SlabClass_t slabClasses[ MBEDTLS_SLAB_CLASS_COUNT ] =
+{
+    { ( uint8_t * ) slabPool32U,   32U,   MBEDTLS_FREERTOS_SLAB_BLOCKS_32,   0U, NULL },
+    { ( uint8_t * ) slabPool64U,   64U,   MBEDTLS_FREERTOS_SLAB_BLOCKS_64,   0U, NULL },
+    { ( uint8_t * ) slabPool128U,  128U,  MBEDTLS_FREERTOS_SLAB_BLOCKS_128,  0U, NULL },
+    { ( uint8_t * ) slabPool256U,  256U,  MBEDTLS_FREERTOS_SLAB_BLOCKS_256,  0U, NULL },
+    { ( uint8_t * ) slabPool512U,  512U,  MBEDTLS_FREERTOS_SLAB_BLOCKS_512,  0U, NULL },
+    { ( uint8_t * ) slabPool1024U, 1024U, MBEDTLS_FREERTOS_SLAB_BLOCKS_1024, 0U, NULL }
+};
+
+/**
+ * @brief Usage counters, updated with the scheduler suspended.
+ */
+static MbedtlsSlabStats_t slabStats;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Take a free block from a size class.
+ *
+ * @param[in] pClass The size class.
+ *
+ * @return The block, or NULL if every block of the class is allocated.
+ */
+static void * takeBlock( SlabClass_t * pClass );
+
+/**
+ * @brief Find the size class whose pool holds a block.
+ *
+ * @param[in] ptr The block.
+ * @param[out] pIndex Index of the size class.
+ *
+ * @return The size class, or NULL if @p ptr came from the heap.
+ */
+static SlabClass_t * findClass( const void * ptr,
+                                size_t * pIndex );
+
+#ifdef MBEDTLS_FREERTOS_SLAB_HISTOGRAM
+
+/**
+ * @brief Count a request in the allocation size histogram.
+ *
+ * @param[in] size The requested size.
+ */
+    static void recordSize( size_t size );
+#endif
+
+/*-----------------------------------------------------------*/
+
+static void * takeBlock( SlabClass_t * pClass )
+{
+    void * pBlock = NULL;
+
+    if( pClass->pFreeList != NULL )
+    {
+        pBlock = pClass->pFreeList;
+        pClass->pFreeList = *( ( void ** ) pBlock );
+    }
+    else if( pClass->nextUnused < pClass->blockCount )
+    {
+        pBlock = &( pClass->pPool[ pClass->nextUnused * pClass->blockSize ] );
+        pClass->nextUnused++;
+    }
+    else
+    {
+        /* Empty else MISRA 15.7 */
+    }
+
+    return pBlock;
+}
+
+/*-----------------------------------------------------------*/
+
+static SlabClass_t * findClass( const void * ptr,
+                                size_t * pIndex )
+{
+    SlabClass_t * pClass = NULL;
+    uintptr_t address = ( uintptr_t ) ptr;
+    uintptr_t poolStart = 0U;
+    size_t index = 0U;
+
+    for( index = 0U; ( index < MBEDTLS_SLAB_CLASS_COUNT ) && ( pClass == NULL ); index++ )
+    {
+        poolStart = ( uintptr_t ) slabClasses[ index ].pPool;
+
+        if( ( address >= poolStart ) &&
+            ( address < ( poolStart + ( slabClasses[ index ].blockSize * slabClasses[ index ].blockCount ) ) ) )
+        {
+            /* Only the start of a block can be freed. */
+            configASSERT( ( ( address - poolStart ) % slabClasses[ index ].blockSize ) == 0U );
+
+            pClass = &( slabClasses[ index ] );
+            *pIndex = index;
+        }
+    }
+
+    return pClass;
+}
+
+/*-----------------------------------------------------------*/
+
+#ifdef MBEDTLS_FREERTOS_SLAB_HISTOGRAM
+
+    static void recordSize( size_t size )
+    {
+        size_t bucket = 0U;
+        size_t bucketSize = SLAB_HISTOGRAM_FIRST_BUCKET_SIZE;
+
+        while( ( size > bucketSize ) && ( bucket < ( MBEDTLS_SLAB_HISTOGRAM_BUCKETS - 1U ) ) )
+        {
+            bucketSize <<= 1;
+            bucket++;
+        }
+
+        slabStats.histogram[ bucket ]++;
+    }
+
+#endif /* ifdef MBEDTLS_FREERTOS_SLAB_HISTOGRAM */
+
+/*-----------------------------------------------------------*/
+
+void * mbedtls_platform_slab_alloc( size_t size )
+{
+    void * pBlock = NULL;
+    MbedtlsSlabClassStats_t * pClassStats = NULL;
+    size_t index = 0U;
+
+    configASSERT( size > 0U );
+
+    vTaskSuspendAll();
+    {
+        #ifdef MBEDTLS_FREERTOS_SLAB_HISTOGRAM
+            recordSize( size );
+        #endif
+
+        /* Use the smallest class that fits. When it is full, a larger class
+         * is still cheaper than the heap. */
+        for( index = 0U; ( index < MBEDTLS_SLAB_CLASS_COUNT ) && ( pBlock == NULL ); index++ )
+        {
+            if( size <= slabClasses[ index ].blockSize )
+            {
+                pClassStats = &( slabStats.classes[ index ] );
+                pBlock = takeBlock( &( slabClasses[ index ] ) );
+
+                if( pBlock != NULL )
+                {
+                    pClassStats->allocations++;
+                    pClassStats->inUse++;
+
+                    if( pClassStats->inUse > pClassStats->peakInUse )
+                    {
+                        pClassStats->peakInUse = pClassStats->inUse;
+                    }
+
+                    slabStats.bytesInUse += slabClasses[ index ].blockSize;
+
+                    if( slabStats.bytesInUse > slabStats.peakBytesInUse )
+                    {
+                        slabStats.peakBytesInUse = slabStats.bytesInUse;
+                    }
+                }
+                else
+                {
+                    pClassStats->exhausted++;
+                }
+            }
+        }
+
+        if( pBlock == NULL )
+        {
+            pBlock = pvPortMalloc( size );
+
+            if( pBlock != NULL )
+            {
+                slabStats.heapAllocations++;
+            }
+        }
+    }
+    ( void ) xTaskResumeAll();
+
+    return pBlock;
+}
+
+/*-----------------------------------------------------------*/
+
+void mbedtls_platform_slab_free( void * ptr )
+{
+    SlabClass_t * pClass = NULL;
+    size_t index = 0U;
+
+    if( ptr != NULL )
+    {
+        vTaskSuspendAll();
+        {
+            pClass = findClass( ptr, &index );
+
+            if( pClass != NULL )
+            {
+                *( ( void ** ) ptr ) = pClass->pFreeList;
+                pClass->pFreeList = ptr;
+
+                slabStats.classes[ index ].inUse--;
+                slabStats.bytesInUse -= pClass->blockSize;
+            }
+            else
+            {
+                vPortFree( ptr );
+                slabStats.heapFrees++;
+            }
+        }
+        ( void ) xTaskResumeAll();
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void mbedtls_platform_slab_get_stats( MbedtlsSlabStats_t * pStats )
+{
+    size_t index = 0U;
+
+    configASSERT( pStats != NULL );
+
+    vTaskSuspendAll();
+    {
+        ( void ) memcpy( pStats, &slabStats, sizeof( MbedtlsSlabStats_t ) );
+    }
+    ( void ) xTaskResumeAll();
+
+    for( index = 0U; index < MBEDTLS_SLAB_CLASS_COUNT; index++ )
+    {
+        pStats->classes[ index ].blockSize = slabClasses[ index ].blockSize;
+        pStats->classes[ index ].blockCount = slabClasses[ index ].blockCount;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void mbedtls_platform_slab_reset_peak( void )
+{
+    size_t index = 0U;
+
+    vTaskSuspendAll();
+    {
+        for( index = 0U; index < MBEDTLS_SLAB_CLASS_COUNT; index++ )
+        {
+            slabStats.classes[ index ].peakInUse = slabStats.classes[ index ].inUse;
+        }
+
+        slabStats.peakBytesInUse = slabStats.bytesInUse;
+    }
+    ( void ) xTaskResumeAll();
+}
+
+/*-----------------------------------------------------------*/
+
+void mbedtls_platform_slab_log_stats( void )
+{
+    MbedtlsSlabStats_t stats;
+    size_t index = 0U;
+    size_t poolBytes = 0U;
+
+    mbedtls_platform_slab_get_stats( &stats );
+
+    for( index = 0U; index < MBEDTLS_SLAB_CLASS_COUNT; index++ )
+    {
+        LogInfo( ( "Slab %4lu B: %lu/%lu blocks in use, peak %lu, %lu allocations, %lu exhausted.",
+                   ( unsigned long ) stats.classes[ index ].blockSize,
+                   ( unsigned long ) stats.classes[ index ].inUse,
+                   ( unsigned long ) stats.classes[ index ].blockCount,
+                   ( unsigned long ) stats.classes[ index ].peakInUse,
+                   ( unsigned long ) stats.classes[ index ].allocations,
+                   ( unsigned long ) stats.classes[ index ].exhausted ) );
+
+        poolBytes += stats.classes[ index ].blockSize * stats.classes[ index ].blockCount;
+    }
+
+    LogInfo( ( "Slab bytes in use %lu, peak %lu of %lu. Heap allocations %lu, frees %lu.",
+               ( unsigned long ) stats.bytesInUse,
+               ( unsigned long ) stats.peakBytesInUse,
+               ( unsigned long ) poolBytes,
+               ( unsigned long ) stats.heapAllocations,
+               ( unsigned long ) stats.heapFrees ) );
+
+    #ifdef MBEDTLS_FREERTOS_SLAB_HISTOGRAM
+        for( index = 0U; index < MBEDTLS_SLAB_HISTOGRAM_BUCKETS; index++ )
+        {
+            if( index < ( MBEDTLS_SLAB_HISTOGRAM_BUCKETS - 1U ) )
+            {
+                LogInfo( ( "Requests <= %5lu B: %lu",
+                           ( unsigned long ) ( SLAB_HISTOGRAM_FIRST_BUCKET_SIZE << index ),
+                           ( unsigned long ) stats.histogram[ index ] ) );
+            }
+            else
+            {
+                LogInfo( ( "Requests  > %5lu B: %lu",
+                           ( unsigned long ) ( SLAB_HISTOGRAM_FIRST_BUCKET_SIZE << ( index - 1U ) ),
+                           ( unsigned long ) stats.histogram[ index ] ) );
+            }
+        }
+    #endif /* ifdef MBEDTLS_FREERTOS_SLAB_HISTOGRAM */
+}
+
+/*-----------------------------------------------------------*/
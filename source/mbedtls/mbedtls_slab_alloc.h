@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file mbedtls_slab_alloc.h
+ * @brief Size-class slab allocator for the mbed TLS platform allocator.
+ *
+ * mbed TLS makes many short-lived allocations of a few dozen to a few hundred
+ * bytes while parsing certificates and running the handshake. With
+ * MBEDTLS_FREERTOS_SLAB_ALLOC defined in mbedtls_config.h,
+ * mbedtls_platform_calloc serves those from fixed pools of equally sized
+ * blocks and only passes larger requests, such as the record buffers, to the
+ * FreeRTOS heap.
+ */
+
+#ifndef MBEDTLS_SLAB_ALLOC_H_
+    #define MBEDTLS_SLAB_ALLOC_H_
+
+    #include <stddef.h>
+    #include <stdint.h>
+
+    #ifdef __cplusplus
+        extern "C" {
+    #endif
+
+/**
+ * @brief Number of size classes served by the slab allocator.
+ */
+    #define MBEDTLS_SLAB_CLASS_COUNT    6U
+
+/**
+ * @brief Number of buckets of the allocation size histogram.
+ *
+ * Bucket n counts the requests of up to 16 << n bytes; the last bucket counts
+ * every larger request.
+ */
+    #define MBEDTLS_SLAB_HISTOGRAM_BUCKETS    12U
+
+/**
+ * @brief Usage counters of one size class.
+ */
+    typedef struct MbedtlsSlabClassStats
+    {
+        size_t blockSize;      /**< @brief Size of each block in bytes. */
+        size_t blockCount;     /**< @brief Number of blocks in the pool. */
+        size_t inUse;          /**< @brief Blocks currently allocated. */
+        size_t peakInUse;      /**< @brief Highest value of inUse so far. */
+        uint32_t allocations;  /**< @brief Requests served from this class. */
+        uint32_t exhausted;    /**< @brief Requests that fitted but found the pool full. */
+    } MbedtlsSlabClassStats_t;
+
+/**
+ * @brief Usage counters of the slab allocator.
+ */
+    typedef struct MbedtlsSlabStats
+    {
+        MbedtlsSlabClassStats_t classes[ MBEDTLS_SLAB_CLASS_COUNT ];
+        size_t bytesInUse;        /**< @brief Bytes of slab blocks currently allocated. */
+        size_t peakBytesInUse;    /**< @brief Highest value of bytesInUse so far. */
+        uint32_t heapAllocations; /**< @brief Requests passed to the FreeRTOS heap. */
+        uint32_t heapFrees;       /**< @brief Frees passed to the FreeRTOS heap. */
+
+        /**
+         * @brief Requested sizes, filled in when MBEDTLS_FREERTOS_SLAB_HISTOGRAM
+         * is defined. Used to tune the size classes.
+         */
+        uint32_t histogram[ MBEDTLS_SLAB_HISTOGRAM_BUCKETS ];
+    } MbedtlsSlabStats_t;
+
+/**
+ * @brief Allocate a block of at least @p size bytes.
+ *
+ * The block is taken from the smallest size class that fits and still has a
+ * free block; otherwise it is allocated with pvPortMalloc.
+ *
+ * @param[in] size Number of bytes required. Must not be 0.
+ *
+ * @return Pointer to the block, or NULL if the heap is exhausted. The block is
+ * not zeroed.
+ */
+    void * mbedtls_platform_slab_alloc( size_t size );
+
+/**
+ * @brief Return a block obtained from #mbedtls_platform_slab_alloc.
+ *
+ * @param[in] ptr The block to free. NULL is ignored.
+ */
+    void mbedtls_platform_slab_free( void * ptr );
+
+/**
+ * @brief Copy the current usage counters of the slab allocator.
+ *
+ * @param[out] pStats Where to write the counters.
+ */
+    void mbedtls_platform_slab_get_stats( MbedtlsSlabStats_t * pStats );
+
+/**
+ * @brief Restart the peak counters from the current usage, to measure the peak
+ * of a later operation.
+ */
+    void mbedtls_platform_slab_reset_peak( void );
+
+/**
+ * @brief Log the usage counters of every size class and the peak usage.
+ */
+    void mbedtls_platform_slab_log_stats( void );
+
+    #ifdef __cplusplus
+        }
+    #endif
+
+#endif /* ifndef MBEDTLS_SLAB_ALLOC_H_ */
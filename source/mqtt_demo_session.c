@@ -0,0 +1,1646 @@
+/*
+ * FreeRTOS
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file mqtt_demo_session.c
+ * @brief Persistent MQTT session of the demos, over a TLS connection on the
+ * cellular network.
+ */
+
+/* Standard includes. */
+#include <string.h>
+#include <stdio.h>
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Demo Specific configs. */
+#include "demo_config.h"
+
+#include "mqtt_demo_session.h"
+
+/* QoS1 publisher with several messages in flight. */
+#include "mqtt_publish_window.h"
+
+/* Outgoing publish records of coreMQTT, for publishGathered(). */
+#include "core_mqtt_state.h"
+
+/* Recovery of the transport, escalating through tiers. */
+#include "mqtt_reconnect.h"
+
+/* Persistent session that outlives the TLS connections. */
+#include "mqtt_session.h"
+
+/* Cellular library, for the recovery tiers and the operator of the network. */
+#include "cellular_config.h"
+#include "cellular_config_defaults.h"
+#include "cellular_api.h"
+
+/* Store-and-forward queue of the messages produced while offline. */
+#ifdef democonfigOFFLINE_QUEUE_FILE
+    #include "mqtt_offline_queue.h"
+#endif
+
+/* Aggregation of telemetry samples into compact payloads. */
+#ifdef democonfigTELEMETRY
+    #include "mqtt_telemetry.h"
+#endif
+
+/* Agent that lets several tasks publish on the connection. */
+#ifdef democonfigMQTT_AGENT
+    #include "mqtt_command_agent.h"
+#endif
+
+/* Keep-alive interval learned from the NAT of the network. */
+#ifdef democonfigADAPTIVE_KEEP_ALIVE_FILE
+    #include "mqtt_keep_alive.h"
+#endif
+
+/*-----------------------------------------------------------*/
+
+#if defined( democonfigOFFLINE_QUEUE_FILE ) && !defined( MQTT_OFFLINE_QUEUE )
+    #error "democonfigOFFLINE_QUEUE_FILE requires MQTT_OFFLINE_QUEUE in core_mqtt_config.h."
+#endif
+
+#if defined( democonfigMQTT_AGENT ) && !defined( MQTT_COMMAND_AGENT )
+    #error "democonfigMQTT_AGENT requires MQTT_COMMAND_AGENT in core_mqtt_config.h."
+#endif
+
+#if defined( democonfigMQTT_AGENT ) && defined( democonfigTELEMETRY )
+    #error "democonfigMQTT_AGENT and democonfigTELEMETRY are exclusive."
+#endif
+
+#if defined( democonfigADAPTIVE_KEEP_ALIVE_FILE ) && !defined( MQTT_ADAPTIVE_KEEP_ALIVE )
+    #error "democonfigADAPTIVE_KEEP_ALIVE_FILE requires MQTT_ADAPTIVE_KEEP_ALIVE in core_mqtt_config.h."
+#endif
+
+#if defined( democonfigADAPTIVE_KEEP_ALIVE_FILE ) && defined( democonfigMQTT_AGENT )
+    #error "democonfigADAPTIVE_KEEP_ALIVE_FILE and democonfigMQTT_AGENT are exclusive."
+#endif
+
+#if defined( democonfigEVENT_DRIVEN ) && ( defined( democonfigMQTT_AGENT ) || defined( democonfigTELEMETRY ) )
+    #error "democonfigEVENT_DRIVEN excludes democonfigMQTT_AGENT and democonfigTELEMETRY."
+#endif
+
+/* keepAliveWaitMs() reads the keep-alive state of MQTTContext_t, which is
+ * internal to coreMQTT v1. Only coreMQTT v2 defines MQTT_SEND_TIMEOUT_MS. */
+#if defined( democonfigEVENT_DRIVEN ) && defined( MQTT_SEND_TIMEOUT_MS )
+    #error "democonfigEVENT_DRIVEN requires coreMQTT v1."
+#endif
+
+/*-----------------------------------------------------------*/
+
+#ifndef CELLULAR_PDN_CONTEXT_NUM
+    #define CELLULAR_PDN_CONTEXT_NUM    ( CELLULAR_PDN_CONTEXT_ID_MAX - CELLULAR_PDN_CONTEXT_ID_MIN + 1U )
+#endif
+
+/**
+ * @brief Longest wait for the registration of the modem, after the radio is
+ * turned off and on by the registration tier of the reconnect manager.
+ */
+#define REGISTRATION_TIMEOUT_MS            ( 180000U )
+
+/**
+ * @brief Interval between the checks of the registration.
+ */
+#define REGISTRATION_POLL_MS               ( 1000U )
+
+/**
+ * @brief Wait before the reconnect manager starts again from the socket
+ * tier, once it has run out of attempts on the last tier. The device keeps
+ * trying at this pace instead of stopping.
+ */
+#define RECOVERY_BACKOFF_MS                ( 300000U )
+
+/**
+ * @brief Largest random time added to #RECOVERY_BACKOFF_MS, so that devices
+ * that lost the network together do not all come back at once.
+ */
+#define RECOVERY_BACKOFF_JITTER_MS         ( 60000U )
+
+/**
+ * @brief Value of CellularPdnStatus_t.state for an activated PDN context. The
+ * cellular library reports the state of AT+CGACT, where 1 is activated and 0
+ * deactivated.
+ */
+#define PDN_STATE_ACTIVATED                ( 1U )
+
+/**
+ * @brief Number of messages between two logs of the session statistics.
+ */
+#define SESSION_STATS_INTERVAL             ( 10U )
+
+/**
+ * @brief Size of the file of the offline queue with democonfigOFFLINE_QUEUE_FILE.
+ */
+#define OFFLINE_QUEUE_SIZE                 ( 16384U )
+
+/**
+ * @brief What the offline queue does when it is full.
+ */
+#define OFFLINE_QUEUE_POLICY               MQTT_OFFLINE_QUEUE_DROP_OLDEST
+
+/**
+ * @brief Number of telemetry producer tasks with democonfigTELEMETRY. Each
+ * one samples its own sensor.
+ */
+#define TELEMETRY_PRODUCER_COUNT           ( 2U )
+
+/**
+ * @brief Time between two samples of a telemetry producer.
+ */
+#define TELEMETRY_SAMPLE_PERIOD_TICKS      ( pdMS_TO_TICKS( 500U ) )
+
+/**
+ * @brief Longest time a telemetry sample waits for its payload to fill.
+ */
+#define TELEMETRY_FLUSH_INTERVAL_MS        ( 10000U )
+
+/**
+ * @brief Number of tasks that publish through the agent with
+ * democonfigMQTT_AGENT.
+ */
+#define AGENT_PUBLISHER_COUNT              ( 3U )
+
+/**
+ * @brief Receive timeout of the transport with democonfigMQTT_AGENT. When the
+ * connection is idle, MQTT_ProcessLoop waits this long before the agent can
+ * take the next command.
+ */
+#define AGENT_RECV_TIMEOUT_MS              ( 10U )
+
+/**
+ * @brief Interval between publishes with democonfigADAPTIVE_KEEP_ALIVE_FILE.
+ * The connection stays idle in between, as on a battery powered device, so
+ * that the PINGREQs and not the publishes keep the NAT binding.
+ */
+#define KEEP_ALIVE_PUBLISH_INTERVAL_MS     ( 30U * 60U * 1000U )
+
+/**
+ * @brief Receive timeout of the transport with democonfigEVENT_DRIVEN. The
+ * MQTT task only reads after a data-ready callback, so it waits this long
+ * once, after the last packet of the data.
+ */
+#define EVENT_RECV_TIMEOUT_MS              ( 10U )
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Traffic counters of the demo.
+ */
+typedef struct DemoSessionStats
+{
+    uint32_t handshakes;            /**< @brief TLS connections established. */
+    uint32_t messagesAcked;         /**< @brief Publishes acknowledged by the broker. */
+    uint64_t bytesSent;             /**< @brief MQTT bytes sent, including CONNECT, SUBSCRIBE and PINGREQ. */
+    uint64_t bytesReceived;         /**< @brief MQTT bytes received. */
+    uint32_t commandsTimed;         /**< @brief Incoming publishes timed from their data-ready callback. */
+    uint32_t commandLatencyTotalMs; /**< @brief Sum of their data-ready to handler latencies. */
+    uint32_t commandLatencyMaxMs;   /**< @brief Longest of their data-ready to handler latencies. */
+} DemoSessionStats_t;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Attempt one TLS connection, for the reconnect manager.
+ *
+ * @param[in] pContext Not used.
+ *
+ * @return Whether the TLS connection succeeded.
+ */
+static bool connectTls( void * pContext );
+
+/**
+ * @brief Find the lowest recovery tier that can fix the connection, from
+ * the state of the modem.
+ *
+ * @param[in] pContext Not used.
+ *
+ * @return #MQTTReconnectTierModem if the modem does not answer,
+ * #MQTTReconnectTierRegistration if it is not registered,
+ * #MQTTReconnectTierPdn if the PDN is not active, and #MQTTReconnectTierSocket
+ * otherwise.
+ */
+static MQTTReconnectTier_t classifyConnectionFailure( void * pContext );
+
+/**
+ * @brief Run the recovery of a tier above the socket.
+ *
+ * @param[in] pContext Not used.
+ * @param[in] tier The tier.
+ *
+ * @return Whether the recovery succeeded.
+ */
+static bool recoverConnection( void * pContext,
+                               MQTTReconnectTier_t tier );
+
+/**
+ * @brief Register on the network again, by turning the radio off and on,
+ * and re-activate the PDN.
+ *
+ * @return Whether the modem registered and the PDN is active.
+ */
+static bool registerAgain( void );
+
+/**
+ * @brief Set up the modules of the connection selected in demo_config.h, and
+ * start their tasks.
+ */
+static void initModules( void );
+
+/**
+ * @brief Connect the TLS connection of the session through the recovery
+ * tiers, and time the data that arrives on it.
+ *
+ * @param[in] pContext Not used.
+ *
+ * @return Whether the TLS connection is established.
+ */
+static bool sessionConnect( void * pContext );
+
+/**
+ * @brief Close the TLS connection of the session.
+ *
+ * @param[in] pContext Not used.
+ */
+static void sessionDisconnect( void * pContext );
+
+/**
+ * @brief Ask the broker to keep the session, with its subscriptions and
+ * queued QoS1 messages, while the client is away.
+ *
+ * @param[in] pContext Not used.
+ * @param[out] pSessionPresent Whether the broker resumed the session.
+ *
+ * @return #MQTTSuccess, or the error of the CONNECT.
+ */
+static MQTTStatus_t sessionSendConnect( void * pContext,
+                                        bool * pSessionPresent );
+
+/**
+ * @brief Subscribe to the topics of the demo.
+ *
+ * @param[in] pContext Not used.
+ *
+ * @return #MQTTSuccess, or the error that failed the subscription.
+ */
+static MQTTStatus_t sessionSubscribe( void * pContext );
+
+/**
+ * @brief Shorten the receive timeout of the TLS connection once the session
+ * is up, if the modules need it, and call the ready function of the demo.
+ *
+ * @param[in] pContext Not used.
+ */
+static void sessionReady( void * pContext );
+
+#ifndef democonfigMQTT_AGENT
+
+/**
+ * @brief Publish the next message, or the telemetry samples that are due,
+ * and log the session statistics now and then.
+ *
+ * @param[in] pContext Not used.
+ *
+ * @return #MQTTSuccess, or the error of the publish.
+ */
+    static MQTTStatus_t sessionPublish( void * pContext );
+#endif
+
+#if !defined( democonfigMQTT_AGENT ) && !defined( democonfigTELEMETRY )
+
+/**
+ * @brief Process the connection until the next publish is due.
+ *
+ * @param[in] pContext Not used.
+ *
+ * @return #MQTTSuccess, or the first error of MQTT_ProcessLoop.
+ */
+    static MQTTStatus_t sessionIdle( void * pContext );
+#endif
+
+/**
+ * @brief Log the session statistics after each connection.
+ *
+ * @param[in] pContext Not used.
+ */
+static void sessionLogStats( void * pContext );
+
+/**
+ * @brief Data-ready callback of the TLS connection. Records when the data
+ * arrived, and with democonfigEVENT_DRIVEN wakes the MQTT task.
+ *
+ * @param[in] socket Not used.
+ * @param[in] pContext Handle of the MQTT task.
+ */
+static void dataReadyCallback( Socket_t socket,
+                               void * pContext );
+
+#ifndef democonfigMQTT_AGENT
+
+/**
+ * @brief Publish the message of the demo through the publish window, without
+ * waiting for its PUBACK unless the window is full.
+ *
+ * @return The status of MQTTPublishWindow_Publish().
+ */
+    static MQTTStatus_t publishMessage( void );
+#endif
+
+#ifdef democonfigOFFLINE_QUEUE_FILE
+
+/**
+ * @brief Store the message that would have been published in the offline
+ * queue.
+ *
+ * @param[in] pContext Not used.
+ */
+    static void storeMessageOffline( void * pContext );
+#endif
+
+#ifdef democonfigTELEMETRY
+
+/**
+ * @brief Task that samples a simulated sensor and adds the samples to the
+ * telemetry aggregator.
+ *
+ * @param[in] pParameters Sensor ID of the task.
+ */
+    static void telemetryProducerTask( void * pParameters );
+#endif
+
+#ifdef democonfigMQTT_AGENT
+
+/**
+ * @brief Task that publishes through the agent, and waits for each PUBACK.
+ *
+ * @param[in] pParameters Index of the task in agentPublisherTasks.
+ */
+    static void agentPublisherTask( void * pParameters );
+
+/**
+ * @brief Completion callback of the commands of agentPublisherTask.
+ *
+ * @param[in] pContext Handle of the task that sent the command.
+ * @param[in] status Outcome of the command.
+ */
+    static void agentCommandComplete( void * pContext,
+                                      MQTTStatus_t status );
+#endif
+
+#ifdef democonfigADAPTIVE_KEEP_ALIVE_FILE
+
+/**
+ * @brief Select the keep-alive of the operator the modem is registered on.
+ */
+    static void selectKeepAliveNetwork( void );
+
+/**
+ * @brief Process the connection until the next publish is due.
+ *
+ * @return #MQTTSuccess, or the first error of MQTT_ProcessLoop.
+ */
+    static MQTTStatus_t idleWithKeepAlive( void );
+#endif
+
+#ifdef democonfigEVENT_DRIVEN
+
+/**
+ * @brief Process the connection for a duration, reading only after a
+ * data-ready callback and otherwise sleeping until the keep-alive is due.
+ *
+ * @param[in] durationMs Time to process the connection for.
+ *
+ * @return #MQTTSuccess, or the first error of MQTT_ProcessLoop.
+ */
+    static MQTTStatus_t processEvents( uint32_t durationMs );
+
+/**
+ * @brief Time until MQTT_ProcessLoop has keep-alive work to do.
+ *
+ * @return Milliseconds until the next PINGREQ is due, or the period at which
+ * to check for a missing PINGRESP.
+ */
+    static uint32_t keepAliveWaitMs( void );
+#endif
+
+/**
+ * @brief Event callback of the MQTT context. Completes the commands of the
+ * MQTT agent, matches the PUBACKs of the publish window and times incoming
+ * publishes for the command latency. It passes the incoming publishes and the
+ * acknowledgments it did not match to the event callback of the demo.
+ *
+ * @param[in] pMqttContext MQTT context pointer.
+ * @param[in] pPacketInfo Packet Info pointer for the incoming packet.
+ * @param[in] pDeserializedInfo Deserialized information from the incoming packet.
+ */
+static void eventCallback( MQTTContext_t * pMqttContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo );
+
+/**
+ * @brief Transport send function that counts the bytes sent.
+ *
+ * @param[in] pNetworkContext Network context.
+ * @param[in] pBuffer Data to send.
+ * @param[in] bytesToSend Length of the data.
+ *
+ * @return The return value of TLS_FreeRTOS_send().
+ */
+static int32_t transportSend( NetworkContext_t * pNetworkContext,
+                              const void * pBuffer,
+                              size_t bytesToSend );
+
+/**
+ * @brief Transport receive function that counts the bytes received.
+ *
+ * @param[in] pNetworkContext Network context.
+ * @param[out] pBuffer Buffer to receive into.
+ * @param[in] bytesToRecv Size of the buffer.
+ *
+ * @return The return value of TLS_FreeRTOS_recv().
+ */
+static int32_t transportRecv( NetworkContext_t * pNetworkContext,
+                              void * pBuffer,
+                              size_t bytesToRecv );
+
+/**
+ * @brief Transport vectored send function that counts the bytes sent.
+ *
+ * @param[in] pNetworkContext Network context.
+ * @param[in] pIoVec Buffers to send.
+ * @param[in] ioVecCount Number of buffers.
+ *
+ * @return The return value of TLS_FreeRTOS_writev().
+ */
+static int32_t transportWritev( NetworkContext_t * pNetworkContext,
+                                TransportOutVector_t * pIoVec,
+                                size_t ioVecCount );
+
+/**
+ * @brief Send function of the publish window. It sends a PUBLISH as
+ * MQTT_Publish() does, but hands its header and payload to
+ * TLS_FreeRTOS_writev() together, so that they share a TLS record instead of
+ * taking one record and one modem send each.
+ *
+ * @param[in] pMqttContext MQTT context.
+ * @param[in] pPublishInfo The message.
+ * @param[in] packetId Packet ID of the message, 0 for QoS0.
+ *
+ * @return #MQTTSuccess, or the error MQTT_Publish() would return.
+ */
+static MQTTStatus_t publishGathered( MQTTContext_t * pMqttContext,
+                                     const MQTTPublishInfo_t * pPublishInfo,
+                                     uint16_t packetId );
+
+/**
+ * @brief Record activity of the connection, for the adaptive keep-alive.
+ */
+static void recordActivity( void );
+
+/**
+ * @brief Log the number of messages per TLS handshake and of MQTT bytes per
+ * message since the start of the demo, and the counters of the modules.
+ */
+static void logStats( void );
+
+extern UBaseType_t uxRand( void );
+
+/* Setup of the modem, from cellular_setup.c. */
+extern bool setupCellular( void );
+
+/**
+ * @brief Handle of the modem, from cellular_setup.c.
+ */
+extern CellularHandle_t CellularHandle;
+
+/**
+ * @brief Context ID of the PDN of the sockets, from cellular_setup.c.
+ */
+extern uint8_t CellularSocketPdnContextId;
+
+/*-----------------------------------------------------------*/
+
+/**
+ * @brief Broker, messages and callbacks of the demo.
+ */
+static MQTTDemoSessionConfig_t demoConfig;
+
+/**
+ * @brief TLS connection of the session.
+ */
+static NetworkContext_t networkContext;
+
+/**
+ * @brief MQTT context of the session, kept across TLS connections.
+ */
+static MQTTContext_t mqttContext;
+
+/**
+ * @brief QoS1 messages waiting for their PUBACK, matched by packet ID.
+ */
+static MQTTPublishWindow_t publishWindow;
+
+/**
+ * @brief Reconnect manager of the TLS connection.
+ */
+static MQTTReconnect_t reconnect;
+
+/**
+ * @brief MQTT session that outlives the TLS connections.
+ */
+static MQTTSession_t session;
+
+/**
+ * @brief Traffic counters since the start of the demo, logged by #logStats.
+ */
+static DemoSessionStats_t stats = { 0 };
+
+/**
+ * @brief Time of the first data-ready callback not yet followed by a read, or
+ * 0. Set in the task of the cellular library.
+ */
+static volatile uint32_t dataReadyTimeMs = 0U;
+
+/**
+ * @brief Time at which the data last read from the transport arrived, or 0
+ * when it arrived without a data-ready callback.
+ */
+static uint32_t packetArrivalTimeMs = 0U;
+
+#ifdef democonfigOFFLINE_QUEUE_FILE
+
+/**
+ * @brief File that holds the offline queue.
+ */
+    static MQTTOfflineFileStorage_t offlineQueueFile;
+
+/**
+ * @brief Messages produced while the connection is down.
+ */
+    static MQTTOfflineQueue_t offlineQueue;
+#endif
+
+#ifdef democonfigTELEMETRY
+
+/**
+ * @brief Samples of the producer tasks, published in batches.
+ */
+    static MQTTTelemetry_t telemetry;
+#endif
+
+#ifdef democonfigADAPTIVE_KEEP_ALIVE_FILE
+
+/**
+ * @brief Keep-alive interval of the connection, learned per network.
+ */
+    static MQTTKeepAlive_t keepAlive;
+#endif
+
+#ifdef democonfigMQTT_AGENT
+
+/**
+ * @brief Commands of the publisher tasks.
+ */
+    static MQTTCommandAgent_t commandAgent;
+
+/**
+ * @brief Publisher tasks, notified by the completion callback.
+ */
+    static TaskHandle_t agentPublisherTasks[ AGENT_PUBLISHER_COUNT ];
+#endif
+
+/*-----------------------------------------------------------*/
+
+static bool connectTls( void * pContext )
+{
+    TlsTransportStatus_t status;
+
+    ( void ) pContext;
+
+    LogInfo( ( "Creating a TLS connection to %s:%u.\r\n",
+               demoConfig.pHostName,
+               demoConfig.port ) );
+    status = TLS_FreeRTOS_Connect( &networkContext,
+                                   demoConfig.pHostName,
+                                   demoConfig.port,
+                                   demoConfig.pNetworkCredentials,
+                                   demoConfig.transportTimeoutMs,
+                                   demoConfig.transportTimeoutMs );
+
+    if( status == TLS_TRANSPORT_SUCCESS )
+    {
+        stats.handshakes++;
+    }
+
+    return( status == TLS_TRANSPORT_SUCCESS );
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTReconnectTier_t classifyConnectionFailure( void * pContext )
+{
+    MQTTReconnectTier_t tier = MQTTReconnectTierPdn;
+    CellularServiceStatus_t serviceStatus = { 0 };
+    CellularPdnStatus_t pdnStatus[ CELLULAR_PDN_CONTEXT_NUM ] = { 0 };
+    uint8_t statusCount = 0U;
+    uint8_t i;
+
+    ( void ) pContext;
+
+    if( Cellular_GetServiceStatus( CellularHandle, &serviceStatus ) != CELLULAR_SUCCESS )
+    {
+        /* The modem does not answer, or was left closed by a failed reset. */
+        tier = MQTTReconnectTierModem;
+    }
+    else if( ( serviceStatus.psRegistrationStatus != REGISTRATION_STATUS_REGISTERED_HOME ) &&
+             ( serviceStatus.psRegistrationStatus != REGISTRATION_STATUS_ROAMING_REGISTERED ) )
+    {
+        tier = MQTTReconnectTierRegistration;
+    }
+    else if( Cellular_GetPdnStatus( CellularHandle, pdnStatus, CELLULAR_PDN_CONTEXT_NUM,
+                                    &statusCount ) == CELLULAR_SUCCESS )
+    {
+        for( i = 0U; i < statusCount; i++ )
+        {
+            if( ( pdnStatus[ i ].contextId == CellularSocketPdnContextId ) &&
+                ( pdnStatus[ i ].state == PDN_STATE_ACTIVATED ) )
+            {
+                tier = MQTTReconnectTierSocket;
+            }
+        }
+    }
+    else
+    {
+        /* The PDN status is unknown, so re-activate it. */
+    }
+
+    return tier;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool recoverConnection( void * pContext,
+                               MQTTReconnectTier_t tier )
+{
+    bool recovered = false;
+
+    ( void ) pContext;
+
+    switch( tier )
+    {
+        case MQTTReconnectTierPdn:
+            /* The deactivation fails if the network has already dropped the
+             * PDN, which is fine. */
+            ( void ) Cellular_DeactivatePdn( CellularHandle, CellularSocketPdnContextId );
+            recovered = ( Cellular_ActivatePdn( CellularHandle, CellularSocketPdnContextId ) == CELLULAR_SUCCESS );
+            break;
+
+        case MQTTReconnectTierRegistration:
+            recovered = registerAgain();
+            break;
+
+        case MQTTReconnectTierModem:
+            /* Without a reset line, the modem is reset by closing the cellular
+             * library and setting it up again, which restarts the radio,
+             * registers and activates the PDN. */
+            ( void ) Cellular_Cleanup( CellularHandle );
+            CellularHandle = NULL;
+            recovered = setupCellular();
+            break;
+
+        default:
+            recovered = true;
+            break;
+    }
+
+    if( recovered == false )
+    {
+        LogWarn( ( "Recovery of tier %d failed.\r\n", ( int ) tier ) );
+    }
+
+    return recovered;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool registerAgain( void )
+{
+    CellularServiceStatus_t serviceStatus = { 0 };
+    uint32_t startTimeMs = demoConfig.getTime();
+    bool registered = false;
+
+    /* Turning the radio off and on makes the modem scan and attach again. */
+    if( ( Cellular_RfOff( CellularHandle ) == CELLULAR_SUCCESS ) &&
+        ( Cellular_RfOn( CellularHandle ) == CELLULAR_SUCCESS ) )
+    {
+        while( ( registered == false ) &&
+               ( ( demoConfig.getTime() - startTimeMs ) < REGISTRATION_TIMEOUT_MS ) )
+        {
+            vTaskDelay( pdMS_TO_TICKS( REGISTRATION_POLL_MS ) );
+
+            if( Cellular_GetServiceStatus( CellularHandle, &serviceStatus ) == CELLULAR_SUCCESS )
+            {
+                registered = ( ( serviceStatus.psRegistrationStatus == REGISTRATION_STATUS_REGISTERED_HOME ) ||
+                               ( serviceStatus.psRegistrationStatus == REGISTRATION_STATUS_ROAMING_REGISTERED ) );
+            }
+        }
+    }
+
+    return ( registered == true ) &&
+           ( Cellular_ActivatePdn( CellularHandle, CellularSocketPdnContextId ) == CELLULAR_SUCCESS );
+}
+
+/*-----------------------------------------------------------*/
+
+static void initModules( void )
+{
+    MQTTStatus_t mqttStatus = MQTTSuccess;
+
+    #ifdef democonfigADAPTIVE_KEEP_ALIVE_FILE
+        mqttStatus = MQTTKeepAlive_Init( &keepAlive, &mqttContext, democonfigADAPTIVE_KEEP_ALIVE_FILE );
+        configASSERT( mqttStatus == MQTTSuccess );
+    #endif
+
+    #ifdef democonfigOFFLINE_QUEUE_FILE
+    {
+        MQTTOfflineStorage_t storage;
+        MQTTOfflineQueueStatus_t queueStatus;
+
+        /* Messages queued before a reset are recovered from the file. */
+        queueStatus = MQTTOfflineQueue_OpenFile( &offlineQueueFile, democonfigOFFLINE_QUEUE_FILE,
+                                                 OFFLINE_QUEUE_SIZE, &storage );
+
+        if( queueStatus == MQTT_OFFLINE_QUEUE_SUCCESS )
+        {
+            queueStatus = MQTTOfflineQueue_Init( &offlineQueue, &storage, OFFLINE_QUEUE_POLICY );
+        }
+
+        configASSERT( queueStatus == MQTT_OFFLINE_QUEUE_SUCCESS );
+    }
+    #endif /* ifdef democonfigOFFLINE_QUEUE_FILE */
+
+    #ifdef democonfigTELEMETRY
+    {
+        uint32_t sensor;
+        BaseType_t taskStatus;
+
+        mqttStatus = MQTTTelemetry_Init( &telemetry, &publishWindow, demoConfig.pTopic,
+                                         ( uint16_t ) strlen( demoConfig.pTopic ),
+                                         TELEMETRY_FLUSH_INTERVAL_MS );
+        configASSERT( mqttStatus == MQTTSuccess );
+
+        /* Producers keep sampling while the connection is down, until the
+         * queue of the aggregator is full. */
+        for( sensor = 0U; sensor < TELEMETRY_PRODUCER_COUNT; sensor++ )
+        {
+            taskStatus = xTaskCreate( telemetryProducerTask,
+                                      "Telemetry",
+                                      democonfigDEMO_STACKSIZE,
+                                      ( void * ) ( uintptr_t ) sensor,
+                                      democonfigDEMO_PRIORITY,
+                                      NULL );
+            configASSERT( taskStatus == pdPASS );
+        }
+    }
+    #endif /* ifdef democonfigTELEMETRY */
+
+    #ifdef democonfigMQTT_AGENT
+    {
+        uint32_t publisher;
+        BaseType_t taskStatus;
+
+        mqttStatus = MQTTCommandAgent_Init( &commandAgent, &publishWindow );
+        configASSERT( mqttStatus == MQTTSuccess );
+
+        /* Commands queue up while the connection is down. */
+        for( publisher = 0U; publisher < AGENT_PUBLISHER_COUNT; publisher++ )
+        {
+            taskStatus = xTaskCreate( agentPublisherTask,
+                                      "Publisher",
+                                      democonfigDEMO_STACKSIZE,
+                                      ( void * ) ( uintptr_t ) publisher,
+                                      democonfigDEMO_PRIORITY,
+                                      &( agentPublisherTasks[ publisher ] ) );
+            configASSERT( taskStatus == pdPASS );
+        }
+    }
+    #endif /* ifdef democonfigMQTT_AGENT */
+
+    ( void ) mqttStatus;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool sessionConnect( void * pContext )
+{
+    bool connected;
+
+    ( void ) pContext;
+
+    /* The reconnect manager retries a failed connection, then recovers the
+     * layers below it, from the PDN up to the modem, until the last tier runs
+     * out of attempts. */
+    connected = MQTTReconnect_Connect( &reconnect );
+
+    if( connected == true )
+    {
+        /* Timestamp the data of the new connection as it arrives. */
+        dataReadyTimeMs = 0U;
+        packetArrivalTimeMs = 0U;
+        ( void ) TLS_FreeRTOS_SetDataReadyCallback( &networkContext, dataReadyCallback,
+                                                    xTaskGetCurrentTaskHandle() );
+
+        #ifdef democonfigADAPTIVE_KEEP_ALIVE_FILE
+            selectKeepAliveNetwork();
+        #endif
+    }
+
+    return connected;
+}
+
+/*-----------------------------------------------------------*/
+
+static void sessionDisconnect( void * pContext )
+{
+    ( void ) pContext;
+
+    TLS_FreeRTOS_Disconnect( &networkContext );
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t sessionSendConnect( void * pContext,
+                                        bool * pSessionPresent )
+{
+    uint16_t keepAliveSeconds = demoConfig.keepAliveSeconds;
+
+    ( void ) pContext;
+
+    #ifdef democonfigADAPTIVE_KEEP_ALIVE_FILE
+        /* selectKeepAliveNetwork has picked the network. While its interval
+         * is searched, the broker must tolerate any interval the client may
+         * learn; once settled, the broker is given that interval plus a
+         * margin, so that it notices a dead client sooner. The client then
+         * pings at the learned interval. */
+        keepAliveSeconds = MQTTKeepAlive_GetConnectSeconds( &keepAlive );
+    #endif
+
+    LogInfo( ( "Creating an MQTT connection to %s.\r\n", demoConfig.pHostName ) );
+
+    return demoConfig.sendConnect( &mqttContext, keepAliveSeconds, pSessionPresent );
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t sessionSubscribe( void * pContext )
+{
+    ( void ) pContext;
+
+    return demoConfig.subscribe( &mqttContext );
+}
+
+/*-----------------------------------------------------------*/
+
+static void sessionReady( void * pContext )
+{
+    ( void ) pContext;
+
+    #if defined( democonfigEVENT_DRIVEN )
+        /* From here on, reads only follow a data-ready callback, so they need
+         * not wait for data. */
+        ( void ) Sockets_SetReceiveTimeout( networkContext.tcpSocket, EVENT_RECV_TIMEOUT_MS );
+    #elif defined( democonfigMQTT_AGENT )
+        /* The agent takes the next command between two reads. */
+        ( void ) Sockets_SetReceiveTimeout( networkContext.tcpSocket, AGENT_RECV_TIMEOUT_MS );
+    #endif
+
+    if( demoConfig.ready != NULL )
+    {
+        demoConfig.ready( &mqttContext );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+#ifndef democonfigMQTT_AGENT
+    static MQTTStatus_t sessionPublish( void * pContext )
+    {
+        static uint32_t lastLoggedCount = 0U;
+        MQTTStatus_t mqttStatus;
+
+        ( void ) pContext;
+
+        #ifdef democonfigTELEMETRY
+            /* Publish the samples once a payload is full or due. */
+            mqttStatus = MQTTTelemetry_Process( &telemetry );
+        #else
+            LogInfo( ( "Publish to the MQTT topic %s.\r\n", demoConfig.pTopic ) );
+            mqttStatus = publishMessage();
+        #endif
+
+        if( ( stats.messagesAcked - lastLoggedCount ) >= SESSION_STATS_INTERVAL )
+        {
+            lastLoggedCount = stats.messagesAcked;
+            logStats();
+        }
+
+        return mqttStatus;
+    }
+
+/*-----------------------------------------------------------*/
+#endif /* ifndef democonfigMQTT_AGENT */
+
+#if !defined( democonfigMQTT_AGENT ) && !defined( democonfigTELEMETRY )
+    static MQTTStatus_t sessionIdle( void * pContext )
+    {
+        MQTTStatus_t mqttStatus = MQTTSuccess;
+
+        ( void ) pContext;
+
+        #if defined( democonfigADAPTIVE_KEEP_ALIVE_FILE )
+            mqttStatus = idleWithKeepAlive();
+        #elif defined( democonfigEVENT_DRIVEN )
+            mqttStatus = processEvents( demoConfig.publishIntervalMs );
+        #else
+            vTaskDelay( pdMS_TO_TICKS( demoConfig.publishIntervalMs ) );
+        #endif
+
+        return mqttStatus;
+    }
+
+/*-----------------------------------------------------------*/
+#endif /* if !defined( democonfigMQTT_AGENT ) && !defined( democonfigTELEMETRY ) */
+
+static void sessionLogStats( void * pContext )
+{
+    ( void ) pContext;
+
+    logStats();
+}
+
+/*-----------------------------------------------------------*/
+
+static void dataReadyCallback( Socket_t socket,
+                               void * pContext )
+{
+    ( void ) socket;
+
+    /* Only the first callback before a read counts, as the data of the later
+     * ones waits behind it. */
+    if( dataReadyTimeMs == 0U )
+    {
+        dataReadyTimeMs = demoConfig.getTime();
+    }
+
+    #ifdef democonfigEVENT_DRIVEN
+        ( void ) xTaskNotifyGive( ( TaskHandle_t ) pContext );
+    #else
+        ( void ) pContext;
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+
+#ifndef democonfigMQTT_AGENT
+    static MQTTStatus_t publishMessage( void )
+    {
+        MQTTStatus_t mqttStatus;
+        MQTTPublishInfo_t publishInfo;
+        uint16_t packetId = 0U;
+
+        ( void ) memset( ( void * ) &publishInfo, 0x00, sizeof( publishInfo ) );
+
+        publishInfo.qos = MQTTQoS1;
+        publishInfo.retain = false;
+        publishInfo.pTopicName = demoConfig.pTopic;
+        publishInfo.topicNameLength = ( uint16_t ) strlen( demoConfig.pTopic );
+        publishInfo.pPayload = demoConfig.pMessage;
+        publishInfo.payloadLength = strlen( demoConfig.pMessage );
+
+        /* The window keeps a copy of the publish info, whose topic and
+         * payload stay valid for the whole demo. */
+        mqttStatus = MQTTPublishWindow_Publish( &publishWindow, &publishInfo, &packetId );
+
+        if( mqttStatus == MQTTSuccess )
+        {
+            LogDebug( ( "PUBLISH sent with packet Id %u, %u in flight.\r\n",
+                        packetId, ( unsigned int ) publishWindow.inFlight ) );
+        }
+
+        return mqttStatus;
+    }
+
+/*-----------------------------------------------------------*/
+#endif /* ifndef democonfigMQTT_AGENT */
+
+#ifdef democonfigOFFLINE_QUEUE_FILE
+    static void storeMessageOffline( void * pContext )
+    {
+        MQTTOfflineQueueStatus_t queueStatus;
+
+        ( void ) pContext;
+
+        queueStatus = MQTTOfflineQueue_Append( &offlineQueue,
+                                               demoConfig.pTopic,
+                                               ( uint16_t ) strlen( demoConfig.pTopic ),
+                                               demoConfig.pMessage,
+                                               strlen( demoConfig.pMessage ) );
+
+        if( queueStatus == MQTT_OFFLINE_QUEUE_SUCCESS )
+        {
+            LogInfo( ( "Offline. Queued the message, %u messages waiting.\r\n",
+                       ( unsigned int ) MQTTOfflineQueue_Count( &offlineQueue ) ) );
+        }
+        else
+        {
+            LogWarn( ( "Offline. Failed to queue the message: %d.\r\n", ( int ) queueStatus ) );
+        }
+    }
+
+/*-----------------------------------------------------------*/
+#endif /* ifdef democonfigOFFLINE_QUEUE_FILE */
+
+#ifdef democonfigTELEMETRY
+    static void telemetryProducerTask( void * pParameters )
+    {
+        uint8_t sensorId = ( uint8_t ) ( uintptr_t ) pParameters;
+        TickType_t lastWakeTime = xTaskGetTickCount();
+
+        for( ; ; )
+        {
+            /* The free heap stands in for a sensor reading. */
+            if( MQTTTelemetry_AddSample( &telemetry, sensorId,
+                                         ( int32_t ) xPortGetFreeHeapSize() ) == false )
+            {
+                LogDebug( ( "Telemetry queue full. Dropped a sample of sensor %u.\r\n",
+                            ( unsigned int ) sensorId ) );
+            }
+
+            vTaskDelayUntil( &lastWakeTime, TELEMETRY_SAMPLE_PERIOD_TICKS );
+        }
+    }
+
+/*-----------------------------------------------------------*/
+#endif /* ifdef democonfigTELEMETRY */
+
+#ifdef democonfigMQTT_AGENT
+    static void agentPublisherTask( void * pParameters )
+    {
+        uint32_t publisher = ( uint32_t ) ( uintptr_t ) pParameters;
+        MQTTPublishInfo_t publishInfo;
+        MQTTStatus_t status;
+        uint32_t notifiedStatus = 0U;
+
+        ( void ) memset( ( void * ) &publishInfo, 0x00, sizeof( publishInfo ) );
+        publishInfo.qos = MQTTQoS1;
+        publishInfo.pTopicName = demoConfig.pTopic;
+        publishInfo.topicNameLength = ( uint16_t ) strlen( demoConfig.pTopic );
+        publishInfo.pPayload = demoConfig.pMessage;
+        publishInfo.payloadLength = strlen( demoConfig.pMessage );
+
+        for( ; ; )
+        {
+            status = MQTTCommandAgent_Publish( &commandAgent, &publishInfo,
+                                               agentCommandComplete,
+                                               ( void * ) agentPublisherTasks[ publisher ],
+                                               portMAX_DELAY );
+
+            if( status == MQTTSuccess )
+            {
+                ( void ) xTaskNotifyWait( 0U, UINT32_MAX, &notifiedStatus, portMAX_DELAY );
+                status = ( MQTTStatus_t ) notifiedStatus;
+            }
+
+            if( status != MQTTSuccess )
+            {
+                LogWarn( ( "Publisher %u: publish failed with status %s.\r\n",
+                           ( unsigned int ) publisher,
+                           MQTT_Status_strerror( status ) ) );
+            }
+
+            vTaskDelay( pdMS_TO_TICKS( demoConfig.publishIntervalMs ) );
+        }
+    }
+
+/*-----------------------------------------------------------*/
+
+    static void agentCommandComplete( void * pContext,
+                                      MQTTStatus_t status )
+    {
+        /* Runs in the agent task. */
+        ( void ) xTaskNotify( ( TaskHandle_t ) pContext, ( uint32_t ) status, eSetValueWithOverwrite );
+    }
+
+/*-----------------------------------------------------------*/
+#endif /* ifdef democonfigMQTT_AGENT */
+
+#ifdef democonfigADAPTIVE_KEEP_ALIVE_FILE
+    static void selectKeepAliveNetwork( void )
+    {
+        CellularPlmnInfo_t plmnInfo;
+        char networkId[ MQTT_KEEP_ALIVE_NETWORK_ID_LENGTH + 1U ] = "unknown";
+
+        /* The NAT belongs to the operator, identified by its MCC and MNC. */
+        if( Cellular_GetRegisteredNetwork( CellularHandle, &plmnInfo ) == CELLULAR_SUCCESS )
+        {
+            ( void ) snprintf( networkId, sizeof( networkId ), "%s-%s", plmnInfo.mcc, plmnInfo.mnc );
+        }
+        else
+        {
+            LogWarn( ( "Failed to read the registered network.\r\n" ) );
+        }
+
+        MQTTKeepAlive_SelectNetwork( &keepAlive, networkId );
+    }
+
+/*-----------------------------------------------------------*/
+
+    static MQTTStatus_t idleWithKeepAlive( void )
+    {
+        MQTTStatus_t mqttStatus = MQTTSuccess;
+
+        #ifdef democonfigEVENT_DRIVEN
+            mqttStatus = processEvents( KEEP_ALIVE_PUBLISH_INTERVAL_MS );
+        #else
+            uint32_t startTimeMs = demoConfig.getTime();
+
+            /* MQTT_ProcessLoop sends the PINGREQs once the connection has been
+             * idle for the learned interval. */
+            while( ( mqttStatus == MQTTSuccess ) &&
+                   ( ( demoConfig.getTime() - startTimeMs ) < KEEP_ALIVE_PUBLISH_INTERVAL_MS ) )
+            {
+                mqttStatus = MQTT_ProcessLoop( &mqttContext, demoConfig.processLoopTimeoutMs );
+                MQTTKeepAlive_Process( &keepAlive );
+            }
+        #endif /* ifdef democonfigEVENT_DRIVEN */
+
+        return mqttStatus;
+    }
+
+/*-----------------------------------------------------------*/
+#endif /* ifdef democonfigADAPTIVE_KEEP_ALIVE_FILE */
+
+#ifdef democonfigEVENT_DRIVEN
+    static MQTTStatus_t processEvents( uint32_t durationMs )
+    {
+        MQTTStatus_t mqttStatus = MQTTSuccess;
+        uint32_t startTimeMs = demoConfig.getTime();
+        uint32_t elapsedMs = 0U;
+        uint32_t waitMs = 0U;
+        uint64_t bytesReceived = 0U;
+
+        while( ( mqttStatus == MQTTSuccess ) && ( elapsedMs < durationMs ) )
+        {
+            waitMs = keepAliveWaitMs();
+
+            if( waitMs > ( durationMs - elapsedMs ) )
+            {
+                waitMs = durationMs - elapsedMs;
+            }
+
+            /* A callback during the previous pass left the notification
+             * pending, so the wait returns at once. The extra tick makes up
+             * for the rounding down of pdMS_TO_TICKS. */
+            ( void ) ulTaskNotifyTake( pdTRUE, pdMS_TO_TICKS( waitMs ) + 1U );
+
+            /* Each MQTT_ProcessLoop reads at most one packet, and also sends
+             * the PINGREQ when it is due. Read until the data runs out, as
+             * mbed TLS can hold several packets without a new callback. */
+            do
+            {
+                bytesReceived = stats.bytesReceived;
+                mqttStatus = MQTT_ProcessLoop( &mqttContext, 0U );
+            } while( ( mqttStatus == MQTTSuccess ) &&
+                     ( stats.bytesReceived != bytesReceived ) );
+
+            #ifdef democonfigADAPTIVE_KEEP_ALIVE_FILE
+                MQTTKeepAlive_Process( &keepAlive );
+            #endif
+
+            elapsedMs = demoConfig.getTime() - startTimeMs;
+        }
+
+        return mqttStatus;
+    }
+
+/*-----------------------------------------------------------*/
+
+    static uint32_t keepAliveWaitMs( void )
+    {
+        uint32_t waitMs = UINT32_MAX;
+        uint32_t idleMs = 0U;
+        uint32_t keepAliveMs = ( uint32_t ) mqttContext.keepAliveIntervalSec * 1000U;
+
+        if( mqttContext.waitingForPingResp == true )
+        {
+            /* The PINGRESP itself wakes the task. Check now and then whether
+             * it is overdue. */
+            waitMs = demoConfig.processLoopTimeoutMs;
+        }
+        else if( keepAliveMs > 0U )
+        {
+            idleMs = demoConfig.getTime() - mqttContext.lastPacketTime;
+            waitMs = ( idleMs < keepAliveMs ) ? ( keepAliveMs - idleMs ) : 0U;
+        }
+        else
+        {
+            /* No keep-alive. */
+        }
+
+        return waitMs;
+    }
+
+/*-----------------------------------------------------------*/
+#endif /* ifdef democonfigEVENT_DRIVEN */
+
+static void eventCallback( MQTTContext_t * pMqttContext,
+                           MQTTPacketInfo_t * pPacketInfo,
+                           MQTTDeserializedInfo_t * pDeserializedInfo )
+{
+    bool acked = false;
+    uint32_t latencyMs = 0U;
+
+    #ifdef democonfigMQTT_AGENT
+        /* Acknowledgments of the commands of the publisher tasks complete
+         * them. */
+        acked = MQTTCommandAgent_Ack( &commandAgent,
+                                      pPacketInfo->type,
+                                      pDeserializedInfo->packetIdentifier,
+                                      pDeserializedInfo->deserializationResult );
+    #endif
+
+    if( ( pPacketInfo->type & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH )
+    {
+        /* Time from the arrival of the data to its handler, which is what the
+         * device owes to a command sent to it. */
+        if( packetArrivalTimeMs != 0U )
+        {
+            latencyMs = demoConfig.getTime() - packetArrivalTimeMs;
+            stats.commandsTimed++;
+            stats.commandLatencyTotalMs += latencyMs;
+
+            if( latencyMs > stats.commandLatencyMaxMs )
+            {
+                stats.commandLatencyMaxMs = latencyMs;
+            }
+        }
+
+        demoConfig.eventCallback( pMqttContext, pPacketInfo, pDeserializedInfo );
+    }
+    else if( pPacketInfo->type == MQTT_PACKET_TYPE_PUBACK )
+    {
+        /* Match the ACK to one of the messages in flight. */
+        if( ( acked == true ) ||
+            ( MQTTPublishWindow_Ack( &publishWindow, pDeserializedInfo->packetIdentifier ) == true ) )
+        {
+            LogInfo( ( "PUBACK received for packet Id %u.\r\n", pDeserializedInfo->packetIdentifier ) );
+            stats.messagesAcked++;
+        }
+        else
+        {
+            demoConfig.eventCallback( pMqttContext, pPacketInfo, pDeserializedInfo );
+        }
+    }
+    else if( acked == false )
+    {
+        demoConfig.eventCallback( pMqttContext, pPacketInfo, pDeserializedInfo );
+    }
+    else
+    {
+        /* A SUBACK or UNSUBACK of a command of the agent. */
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t transportSend( NetworkContext_t * pNetworkContext,
+                              const void * pBuffer,
+                              size_t bytesToSend )
+{
+    int32_t sent = TLS_FreeRTOS_send( pNetworkContext, pBuffer, bytesToSend );
+
+    if( sent > 0 )
+    {
+        stats.bytesSent += ( uint64_t ) sent;
+        recordActivity();
+    }
+
+    return sent;
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t transportRecv( NetworkContext_t * pNetworkContext,
+                              void * pBuffer,
+                              size_t bytesToRecv )
+{
+    int32_t received = TLS_FreeRTOS_recv( pNetworkContext, pBuffer, bytesToRecv );
+
+    if( received > 0 )
+    {
+        stats.bytesReceived += ( uint64_t ) received;
+
+        /* Data read after a data-ready callback arrived with it. Later reads
+         * without a new callback belong to the same arrival. */
+        if( dataReadyTimeMs != 0U )
+        {
+            packetArrivalTimeMs = dataReadyTimeMs;
+            dataReadyTimeMs = 0U;
+        }
+
+        recordActivity();
+    }
+
+    return received;
+}
+
+/*-----------------------------------------------------------*/
+
+static int32_t transportWritev( NetworkContext_t * pNetworkContext,
+                                TransportOutVector_t * pIoVec,
+                                size_t ioVecCount )
+{
+    int32_t sent = TLS_FreeRTOS_writev( pNetworkContext, pIoVec, ioVecCount );
+
+    if( sent > 0 )
+    {
+        stats.bytesSent += ( uint64_t ) sent;
+        recordActivity();
+    }
+
+    return sent;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t publishGathered( MQTTContext_t * pMqttContext,
+                                     const MQTTPublishInfo_t * pPublishInfo,
+                                     uint16_t packetId )
+{
+    MQTTStatus_t status;
+    MQTTPublishState_t publishState = MQTTStateNull;
+    TransportOutVector_t ioVec[ 2 ];
+    size_t ioVecCount;
+    size_t remainingLength = 0U;
+    size_t packetSize = 0U;
+    size_t headerSize = 0U;
+    size_t sent = 0U;
+    int32_t bytesSent;
+    uint32_t lastProgressMs;
+
+    configASSERT( ( pMqttContext != NULL ) && ( pPublishInfo != NULL ) );
+
+    /* The fixed header, topic and packet ID go through the network buffer,
+     * as with MQTT_Publish(). */
+    status = MQTT_GetPublishPacketSize( pPublishInfo, &remainingLength, &packetSize );
+
+    if( status == MQTTSuccess )
+    {
+        status = MQTT_SerializePublishHeader( pPublishInfo, packetId, remainingLength,
+                                              &( pMqttContext->networkBuffer ), &headerSize );
+    }
+
+    if( ( status == MQTTSuccess ) && ( pPublishInfo->qos != MQTTQoS0 ) )
+    {
+        status = MQTT_ReserveState( pMqttContext, packetId, pPublishInfo->qos );
+
+        /* A retransmission reuses the record of the first send. */
+        if( ( status == MQTTStateCollision ) && ( pPublishInfo->dup == true ) )
+        {
+            status = MQTTSuccess;
+        }
+    }
+
+    lastProgressMs = pMqttContext->getTime();
+
+    /* After a partial write, start again from the first unsent byte. */
+    while( ( status == MQTTSuccess ) && ( sent < ( headerSize + pPublishInfo->payloadLength ) ) )
+    {
+        if( sent < headerSize )
+        {
+            ioVec[ 0 ].iov_base = &( pMqttContext->networkBuffer.pBuffer[ sent ] );
+            ioVec[ 0 ].iov_len = headerSize - sent;
+            ioVec[ 1 ].iov_base = pPublishInfo->pPayload;
+            ioVec[ 1 ].iov_len = pPublishInfo->payloadLength;
+            ioVecCount = 2U;
+        }
+        else
+        {
+            ioVec[ 0 ].iov_base = &( ( ( const uint8_t * ) pPublishInfo->pPayload )[ sent - headerSize ] );
+            ioVec[ 0 ].iov_len = headerSize + pPublishInfo->payloadLength - sent;
+            ioVecCount = 1U;
+        }
+
+        bytesSent = transportWritev( &networkContext, ioVec, ioVecCount );
+
+        if( bytesSent < 0 )
+        {
+            LogError( ( "Transport send failed with %d.", ( int ) bytesSent ) );
+            status = MQTTSendFailed;
+        }
+        else if( bytesSent > 0 )
+        {
+            sent += ( size_t ) bytesSent;
+            lastProgressMs = pMqttContext->getTime();
+        }
+        else if( ( pMqttContext->getTime() - lastProgressMs ) >= MQTT_SEND_RETRY_TIMEOUT_MS )
+        {
+            LogError( ( "Transport took no data for %u ms.", ( unsigned int ) MQTT_SEND_RETRY_TIMEOUT_MS ) );
+            status = MQTTSendFailed;
+        }
+        else
+        {
+            /* Empty else for MISRA 15.7 compliance. */
+        }
+    }
+
+    if( status == MQTTSuccess )
+    {
+        pMqttContext->lastPacketTime = lastProgressMs;
+
+        if( pPublishInfo->qos != MQTTQoS0 )
+        {
+            status = MQTT_UpdateStatePublish( pMqttContext, packetId, MQTT_SEND,
+                                              pPublishInfo->qos, &publishState );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static void recordActivity( void )
+{
+    #ifdef democonfigADAPTIVE_KEEP_ALIVE_FILE
+        MQTTKeepAlive_RecordActivity( &keepAlive );
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+
+static void logStats( void )
+{
+    uint32_t messages = stats.messagesAcked;
+    uint32_t handshakes = stats.handshakes;
+
+    /* Bytes per message include the CONNECT, SUBSCRIBE, PINGREQ and their
+     * responses, shared over the messages. TLS record overhead and the
+     * handshakes themselves are not counted. */
+    LogInfo( ( "Session stats: %u messages acknowledged over %u TLS handshakes, "
+               "%u messages per handshake, %u MQTT bytes per message.\r\n",
+               ( unsigned int ) messages,
+               ( unsigned int ) handshakes,
+               ( unsigned int ) ( ( handshakes > 0U ) ? ( messages / handshakes ) : 0U ),
+               ( unsigned int ) ( ( messages > 0U ) ?
+                                  ( ( stats.bytesSent + stats.bytesReceived ) / messages ) : 0U ) ) );
+
+    if( stats.commandsTimed > 0U )
+    {
+        LogInfo( ( "Command latency: %u incoming publishes, %u ms average and %u ms maximum "
+                   "from data-ready to handler.\r\n",
+                   ( unsigned int ) stats.commandsTimed,
+                   ( unsigned int ) ( stats.commandLatencyTotalMs / stats.commandsTimed ),
+                   ( unsigned int ) stats.commandLatencyMaxMs ) );
+    }
+
+    MQTTReconnect_LogStats( &reconnect );
+    MQTTSession_LogStats( &session );
+
+    #ifdef democonfigTELEMETRY
+        MQTTTelemetry_LogStats( &telemetry );
+    #endif
+
+    #ifdef democonfigADAPTIVE_KEEP_ALIVE_FILE
+        MQTTKeepAlive_LogStats( &keepAlive );
+    #endif
+}
+
+/*-----------------------------------------------------------*/
+
+void MQTTDemoSession_Run( const MQTTDemoSessionConfig_t * pConfig )
+{
+    TransportInterface_t transport;
+    MQTTReconnectInterface_t reconnectInterface = { 0 };
+    MQTTSessionInterface_t sessionInterface = { 0 };
+    MQTTSessionConfig_t sessionConfig = { 0 };
+    MQTTStatus_t mqttStatus;
+
+    configASSERT( pConfig != NULL );
+    configASSERT( ( pConfig->pHostName != NULL ) && ( pConfig->pNetworkCredentials != NULL ) );
+    configASSERT( ( pConfig->pTopic != NULL ) && ( pConfig->pMessage != NULL ) );
+    configASSERT( ( pConfig->pNetworkBuffer != NULL ) && ( pConfig->getTime != NULL ) );
+    configASSERT( ( pConfig->eventCallback != NULL ) && ( pConfig->sendConnect != NULL ) );
+    configASSERT( pConfig->subscribe != NULL );
+
+    demoConfig = *pConfig;
+
+    /* The MQTT context outlives the TLS connections, so that packet
+     * identifiers and the messages in flight carry over to the next one. The
+     * transport wrappers count the MQTT bytes for #logStats. */
+    transport.pNetworkContext = &networkContext;
+    transport.send = transportSend;
+    transport.recv = transportRecv;
+
+    mqttStatus = MQTT_Init( &mqttContext, &transport, demoConfig.getTime, eventCallback,
+                            demoConfig.pNetworkBuffer );
+    configASSERT( mqttStatus == MQTTSuccess );
+
+    /* Keep up to MQTT_STATE_ARRAY_MAX_COUNT messages in flight. */
+    mqttStatus = MQTTPublishWindow_Init( &publishWindow, &mqttContext,
+                                         MQTT_PUBLISH_WINDOW_SIZE, MQTT_PUBLISH_WINDOW_RETRY_MS );
+    configASSERT( mqttStatus == MQTTSuccess );
+
+    /* coreMQTT v1 sends the header and the payload of a PUBLISH separately,
+     * so the window sends them through TLS_FreeRTOS_writev() instead. */
+    MQTTPublishWindow_SetSend( &publishWindow, publishGathered );
+
+    /* Connections escalate from new TLS connections to the recovery of the
+     * PDN, of the registration and of the modem. */
+    reconnectInterface.connect = connectTls;
+    reconnectInterface.classify = classifyConnectionFailure;
+    reconnectInterface.recover = recoverConnection;
+    reconnectInterface.getTime = demoConfig.getTime;
+    reconnectInterface.getRandom = uxRand;
+    mqttStatus = MQTTReconnect_Init( &reconnect, &reconnectInterface );
+    configASSERT( mqttStatus == MQTTSuccess );
+
+    initModules();
+
+    sessionInterface.connect = sessionConnect;
+    sessionInterface.disconnect = sessionDisconnect;
+    sessionInterface.sendConnect = sessionSendConnect;
+    sessionInterface.subscribe = sessionSubscribe;
+    sessionInterface.ready = sessionReady;
+    sessionInterface.logStats = sessionLogStats;
+    sessionInterface.getTime = demoConfig.getTime;
+    sessionInterface.getRandom = uxRand;
+
+    sessionConfig.pMqttContext = &mqttContext;
+    sessionConfig.pWindow = &publishWindow;
+    sessionConfig.recoveryBackoffMs = RECOVERY_BACKOFF_MS;
+    sessionConfig.recoveryJitterMs = RECOVERY_BACKOFF_JITTER_MS;
+
+    #ifdef democonfigMQTT_AGENT
+        /* The agent publishes the commands of the publisher tasks. */
+        sessionConfig.pCommandAgent = &commandAgent;
+    #else
+        sessionInterface.publish = sessionPublish;
+    #endif
+
+    /* With telemetry, the producers set the pace and the MQTT_ProcessLoop of
+     * the window is the wait. */
+    #if !defined( democonfigMQTT_AGENT ) && !defined( democonfigTELEMETRY )
+        sessionInterface.idle = sessionIdle;
+    #endif
+
+    #ifdef democonfigEVENT_DRIVEN
+        /* The acks are read by processEvents when they arrive. */
+        sessionConfig.windowPollMs = 0U;
+    #else
+        sessionConfig.windowPollMs = MQTT_PUBLISH_WINDOW_POLL_MS;
+    #endif
+
+    #ifdef democonfigOFFLINE_QUEUE_FILE
+        /* Keep producing messages while out of coverage. */
+        sessionConfig.pOfflineQueue = &offlineQueue;
+        sessionConfig.drainTimeoutMs = demoConfig.processLoopTimeoutMs;
+        sessionConfig.offlineIntervalMs = demoConfig.publishIntervalMs;
+        sessionInterface.storeOffline = storeMessageOffline;
+    #endif
+
+    #ifdef democonfigADAPTIVE_KEEP_ALIVE_FILE
+        sessionConfig.pKeepAlive = &keepAlive;
+    #endif
+
+    mqttStatus = MQTTSession_Init( &session, &sessionInterface, &sessionConfig );
+    configASSERT( mqttStatus == MQTTSuccess );
+
+    MQTTSession_Run( &session );
+}
+
+/*-----------------------------------------------------------*/
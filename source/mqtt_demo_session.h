@@ -0,0 +1,113 @@
+/*
+ * FreeRTOS
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://aws.amazon.com/freertos
+ * http://www.FreeRTOS.org
+ */
+
+/**
+ * @file mqtt_demo_session.h
+ * @brief Persistent MQTT session of the demos, over a TLS connection on the
+ * cellular network.
+ *
+ * The session connects through the recovery tiers of mqtt_reconnect.h,
+ * from a new TLS connection up to a reset of the modem, and is kept across
+ * connections by mqtt_session.h. It also sets up the modules selected in
+ * demo_config.h: the offline queue, telemetry, the command agent, the
+ * adaptive keep-alive and the event-driven receive. The demo provides the
+ * MQTT CONNECT and SUBSCRIBE, and handles the incoming publishes and the
+ * acknowledgments of its own requests.
+ */
+
+#ifndef MQTT_DEMO_SESSION_H
+#define MQTT_DEMO_SESSION_H
+
+/* Standard includes. */
+#include <stdbool.h>
+#include <stdint.h>
+
+/* MQTT library includes. */
+#include "core_mqtt.h"
+
+/* Transport interface implementation include header for TLS. */
+#include "using_mbedtls.h"
+
+/**
+ * @brief Broker, messages and callbacks of the demo.
+ */
+typedef struct MQTTDemoSessionConfig
+{
+    const char * pHostName;                     /**< @brief Host name of the broker. */
+    uint16_t port;                              /**< @brief Port of the broker. */
+    NetworkCredentials_t * pNetworkCredentials; /**< @brief Credentials of the TLS connections. */
+    uint32_t transportTimeoutMs;                /**< @brief Send and receive timeout of the TLS connections. */
+    const char * pTopic;                        /**< @brief Topic of the messages. */
+    const char * pMessage;                      /**< @brief Message published to pTopic. */
+    uint32_t publishIntervalMs;                 /**< @brief Time between two publishes. */
+    uint32_t processLoopTimeoutMs;              /**< @brief Longest wait for acknowledgments. */
+    uint16_t keepAliveSeconds;                  /**< @brief Keep-alive of CONNECT without an adaptive keep-alive. */
+    const MQTTFixedBuffer_t * pNetworkBuffer;   /**< @brief Network buffer of the MQTT context. */
+    MQTTGetCurrentTimeFunc_t getTime;           /**< @brief Time in milliseconds. */
+    MQTTEventCallback_t eventCallback;          /**< @brief Incoming publishes, and acknowledgments of other packets than the messages of the session. */
+
+    /**
+     * @brief Send CONNECT with a clean session flag of 0, and wait for
+     * CONNACK.
+     *
+     * @param[in] pMqttContext MQTT context of the session.
+     * @param[in] keepAliveSeconds Keep-alive to send in CONNECT.
+     * @param[out] pSessionPresent Whether the broker resumed the session.
+     *
+     * @return #MQTTSuccess, or the error of coreMQTT.
+     */
+    MQTTStatus_t ( * sendConnect )( MQTTContext_t * pMqttContext,
+                                    uint16_t keepAliveSeconds,
+                                    bool * pSessionPresent );
+
+    /**
+     * @brief Subscribe to the topics of the demo, when the broker did not
+     * resume the session.
+     *
+     * @param[in] pMqttContext MQTT context of the session.
+     *
+     * @return #MQTTSuccess, or the error that failed the subscription.
+     */
+    MQTTStatus_t ( * subscribe )( MQTTContext_t * pMqttContext );
+
+    /**
+     * @brief Optional. Called on each connection once the session is up,
+     * before the first publish.
+     *
+     * @param[in] pMqttContext MQTT context of the session.
+     */
+    void ( * ready )( MQTTContext_t * pMqttContext );
+} MQTTDemoSessionConfig_t;
+
+/**
+ * @brief Set up the modules of the connection, and keep one MQTT session
+ * open across TLS connections. Does not return.
+ *
+ * @param[in] pConfig Broker, messages and callbacks of the demo. All the
+ * fields but ready are required.
+ */
+void MQTTDemoSession_Run( const MQTTDemoSessionConfig_t * pConfig );
+
+#endif /* ifndef MQTT_DEMO_SESSION_H */
@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy of
+# this software and associated documentation files (the "Software"), to deal in
+# the Software without restriction, including without limitation the rights to
+# use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+# the Software, and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+# FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+# COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+# IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+"""
+Convert the PEM credentials of a demo_config.h into compile-time DER arrays.
+
+The demos normally hand PEM strings to the TLS transport, which base64 decodes
+them on every connect and requires MBEDTLS_PEM_PARSE_C and MBEDTLS_BASE64_C.
+This script reads the democonfigROOT_CA_PEM, democonfigCLIENT_CERTIFICATE_PEM
+and democonfigCLIENT_PRIVATE_KEY_PEM macros of a demo_config.h and writes
+demo_credentials_der.h, which the demo uses when democonfigUSE_DER_CREDENTIALS
+is defined.
+
+Usage:
+    python3 tools/pem_to_der_header.py projects/<project_name>/demo_config.h
+
+The output is written next to the input unless -o is given.
+"""
+
+import argparse
+import base64
+import os
+import re
+import sys
+
+# Macro name in demo_config.h -> array name in the generated header.
+CREDENTIALS = [
+    ( "democonfigROOT_CA_PEM", "ucRootCaDer" ),
+    ( "democonfigCLIENT_CERTIFICATE_PEM", "ucClientCertificateDer" ),
+    ( "democonfigCLIENT_PRIVATE_KEY_PEM", "ucClientPrivateKeyDer" ),
+]
+
+PEM_BLOCK = re.compile( r"-----BEGIN ([A-Z ]+)-----(.*?)-----END \1-----", re.S )
+STRING_LITERAL = re.compile( r'"((?:[^"\\]|\\.)*)"' )
+
+
+def read_macro_string( text, name ):
+    """Return the concatenated string literals of an active #define, or None."""
+    lines = text.splitlines()
+
+    for index, line in enumerate( lines ):
+        if re.match( r"^\s*#\s*define\s+" + name + r"\b", line ) is None:
+            continue
+
+        body = line
+        while body.rstrip().endswith( "\\" ) and ( index + 1 ) < len( lines ):
+            index += 1
+            body = body.rstrip()[ :-1 ] + lines[ index ]
+
+        literal = "".join( STRING_LITERAL.findall( body ) )
+        return literal.encode( "ascii" ).decode( "unicode_escape" )
+
+    return None
+
+
+def pem_to_der( pem ):
+    """Decode every PEM block and concatenate the DER encodings in order."""
+    der = b""
+
+    for _, payload in PEM_BLOCK.findall( pem ):
+        if "Proc-Type:" in payload:
+            raise ValueError( "encrypted PEM keys are not supported" )
+        der += base64.b64decode( "".join( payload.split() ) )
+
+    if len( der ) == 0:
+        raise ValueError( "no PEM block found" )
+
+    return der
+
+
+def format_array( name, source, der ):
+    rows = []
+
+    for offset in range( 0, len( der ), 12 ):
+        chunk = der[ offset:offset + 12 ]
+        rows.append( "    " + ", ".join( "0x%02x" % b for b in chunk ) + "," )
+
+    return ( "/* DER encoding of %s (%u bytes). */\n"
+             "static const uint8_t %s[] =\n{\n%s\n};\n"
+             % ( source, len( der ), name, "\n".join( rows ) ) )
+
+
+def main():
+    parser = argparse.ArgumentParser( description = __doc__.strip().splitlines()[ 0 ] )
+    parser.add_argument( "demo_config", help = "path to the demo_config.h holding the PEM macros" )
+    parser.add_argument( "-o", "--output", help = "path of the generated header" )
+    args = parser.parse_args()
+
+    output = args.output or os.path.join( os.path.dirname( args.demo_config ),
+                                          "demo_credentials_der.h" )
+
+    with open( args.demo_config, "r" ) as config_file:
+        text = config_file.read()
+
+    arrays = []
+
+    for macro, array in CREDENTIALS:
+        pem = read_macro_string( text, macro )
+
+        if pem is None:
+            continue
+
+        try:
+            arrays.append( format_array( array, macro, pem_to_der( pem ) ) )
+        except ValueError as error:
+            sys.exit( "%s: %s" % ( macro, error ) )
+
+    if len( arrays ) == 0:
+        sys.exit( "No PEM credentials defined in %s." % args.demo_config )
+
+    with open( output, "w" ) as header:
+        header.write( "/*\n"
+                      " * Generated by tools/pem_to_der_header.py from %s.\n"
+                      " * Do not edit; regenerate after changing the PEM credentials.\n"
+                      " */\n\n"
+                      "#ifndef DEMO_CREDENTIALS_DER_H\n"
+                      "#define DEMO_CREDENTIALS_DER_H\n\n"
+                      "#include <stdint.h>\n\n"
+                      % os.path.basename( args.demo_config ) )
+        header.write( "\n".join( arrays ) )
+        header.write( "\n#endif /* DEMO_CREDENTIALS_DER_H */\n" )
+
+    print( "Wrote %u credential(s) to %s." % ( len( arrays ), output ) )
+
+
+if __name__ == "__main__":
+    main()